@@ -14,6 +14,7 @@ sub cmd($)
 
 my @mans = ("scamper/scamper.1",
 	    "lib/libscamperfile/libscamperfile.3",
+	    "lib/libscamperfile/cols.5",
 	    "lib/libscamperfile/warts.5",
 	    "lib/libscamperctrl/libscamperctrl.3",
 	    "utils/sc_ally/sc_ally.1",
@@ -36,6 +37,7 @@ my @mans = ("scamper/scamper.1",
 	    "utils/sc_tbitpmtud/sc_tbitpmtud.1",
 	    "utils/sc_tracediff/sc_tracediff.1",
 	    "utils/sc_uptime/sc_uptime.1",
+	    "utils/sc_warts2cols/sc_warts2cols.1",
 	    "utils/sc_warts2csv/sc_warts2csv.1",
 	    "utils/sc_warts2json/sc_warts2json.1",
 	    "utils/sc_warts2pcap/sc_warts2pcap.1",
@@ -134,6 +134,11 @@ typedef unsigned short sa_family_t;
 #define HAVE_EPOLL
 #endif
 
+#if defined(HAVE_SYS_TIMERFD_H) && defined(HAVE_TIMERFD_CREATE)
+#include <sys/timerfd.h>
+#define HAVE_TIMERFD
+#endif
+
 #ifndef _WIN32 /* include headers that are not on windows */
 #include <sys/param.h>
 #include <sys/time.h>
@@ -196,6 +201,14 @@ typedef unsigned short sa_family_t;
 #include <poll.h>
 #endif
 
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
+#ifdef HAVE_SYS_EVENTFD_H
+#include <sys/eventfd.h>
+#endif
+
 #if defined(__linux__)
 #ifdef HAVE_LINUX_IF_PACKET_H
 #include <linux/if_packet.h>
@@ -211,6 +224,13 @@ typedef unsigned short sa_family_t;
 #include <linux/sockios.h>
 #include <linux/errqueue.h>
 
+#ifdef HAVE_LINUX_NET_TSTAMP_H
+#include <linux/net_tstamp.h>
+#if defined(SO_TIMESTAMPING) && defined(SCM_TIMESTAMPING)
+#define HAVE_SO_TIMESTAMPING
+#endif
+#endif
+
 #ifdef HAVE_LINUX_NETLINK_H
 #include <linux/netlink.h>
 #endif
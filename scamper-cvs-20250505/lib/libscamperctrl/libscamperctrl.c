@@ -61,6 +61,21 @@
 #include <sys/time.h>
 #endif
 
+#if !defined(HAVE_KQUEUE) && defined(HAVE_SYS_EPOLL_H) && \
+  defined(HAVE_EPOLL_WAIT)
+#include <sys/epoll.h>
+#define HAVE_EPOLL
+#endif
+
+/*
+ * a local scamper can write results into a ring in shared memory, which
+ * needs mmap and the ability to receive file descriptors.
+ */
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP) && defined(SCM_RIGHTS)
+#include <sys/mman.h>
+#define SC_RING
+#endif
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -96,6 +111,10 @@ typedef struct sc_tx
   int                txtype;   /* type of frame */
   scamper_inst_t    *inst;     /* pointer to instance */
   scamper_task_t    *task;     /* pointer to task */
+  scamper_task_t   **tasks;    /* tasks in a batch */
+  uint32_t           taskc;    /* number of tasks in a batch */
+  uint32_t           taski;    /* next task in batch to expect a reply */
+  uint8_t            flags;    /* flags */
 } sc_tx_t;
 
 typedef struct sc_fd
@@ -108,6 +127,9 @@ typedef struct sc_fd
   int                fdtype;   /* type of file descriptor */
   dlist_t           *queue;    /* queue of items to write */
   int                write;    /* has write want been signalled? */
+#ifdef HAVE_EPOLL
+  uint32_t           events;   /* events registered with epoll */
+#endif
   dlist_node_t      *fdsdn;    /* entry in ctrl->fds */
   void              *data;     /* pointer to scamper_inst_t / scamper_mux_t */
 } sc_fd_t;
@@ -120,6 +142,13 @@ typedef struct sc_muxchan
   uint32_t           chan;
 } sc_muxchan_t;
 
+typedef struct sc_held
+{
+  uint32_t           id;       /* ID of the task the data is for */
+  uint8_t           *data;     /* the decoded data */
+  size_t             len;      /* length of the data */
+} sc_held_t;
+
 struct scamper_ctrl
 {
   dlist_t           *fds;      /* list of file descriptors */
@@ -133,8 +162,44 @@ struct scamper_ctrl
 #ifdef HAVE_KQUEUE
   int                kqfd;     /* kqueue fd */
 #endif
+#ifdef HAVE_EPOLL
+  int                epfd;     /* epoll fd */
+#endif
 };
 
+#ifdef SC_RING
+/*
+ * sc_ring_hdr_t
+ *
+ * the header at the start of a result ring shared with scamper.  this
+ * must match control_ring_hdr_t in scamper_control.c.  scamper advances
+ * head as it writes records, and we advance tail as we consume them.
+ * rwait says we are about to sleep on the data eventfd, and wwait says
+ * scamper is waiting on the space eventfd for us to make room.  each
+ * record has a 32-bit length and 32-bit task id, and is padded to eight
+ * bytes; a length of SC_RING_WRAP sends us back to the start.
+ */
+typedef struct sc_ring_hdr
+{
+  uint32_t           magic;
+  uint32_t           version;
+  uint64_t           size;
+  uint8_t            pad0[48];
+  uint64_t           head;
+  uint8_t            pad1[56];
+  uint64_t           tail;
+  uint8_t            pad2[56];
+  uint32_t           rwait;
+  uint32_t           wwait;
+  uint8_t            pad3[56];
+} sc_ring_hdr_t;
+
+#define SC_RING_MAGIC   0x53435247
+#define SC_RING_VERSION 1
+#define SC_RING_WRAP    0xFFFFFFFF
+#define SC_RING_RECLEN(len) ((8 + (uint64_t)(len) + 7) & ~((uint64_t)7))
+#endif
+
 struct scamper_inst
 {
   scamper_ctrl_t    *ctrl;     /* backpointer to overall control structure */
@@ -172,6 +237,32 @@ struct scamper_inst
   size_t             data_o;
   size_t             data_len;
   size_t             data_left;
+
+  /*
+   * scamper may start the tasks in a batch before it has read the
+   * whole batch and replied with the IDs it assigned, so data can
+   * arrive for an ID we do not know yet.  data_id is the ID of such
+   * data while we recv it, and held contains those we are still
+   * waiting on an OK for.
+   */
+  uint32_t           data_id;
+  slist_t           *held;
+
+#ifdef SC_RING
+  /*
+   * the ring scamper writes results into, if we asked for one when
+   * attaching.  ring_fds holds the memfd and the data and space
+   * eventfds that came with the OK, until the ring is mapped.  we wait
+   * on the data eventfd through ring_fdn.
+   */
+  sc_ring_hdr_t     *ring;
+  uint8_t           *ring_data;
+  uint64_t           ring_size;
+  sc_fd_t           *ring_fdn;
+  int                ring_spacefd;
+  int                ring_fds[3];
+  int                ring_fdc;
+#endif
 };
 
 struct scamper_task
@@ -191,6 +282,7 @@ struct scamper_attp
   uint32_t           l_id;      /* list id */
   uint32_t           c_id;      /* cycle id */
   uint32_t           priority;  /* mix priority */
+  uint32_t           ring;      /* size of shared memory ring */
   char              *l_name;    /* list name */
   char              *l_descr;   /* list description */
   char              *l_monitor; /* list monitor */
@@ -243,16 +335,23 @@ struct scamper_vp
   ((tx)->txtype == TX_TYPE_ATTACH || \
    (tx)->txtype == TX_TYPE_HALT ||   \
    (tx)->txtype == TX_TYPE_TASK ||   \
-   (tx)->txtype == TX_TYPE_DONE))
+   (tx)->txtype == TX_TYPE_DONE ||   \
+   (tx)->txtype == TX_TYPE_BATCH ||  \
+   (tx)->txtype == TX_TYPE_TMPL))
 
 #define TX_TYPE_ATTACH           1
 #define TX_TYPE_HALT             2
 #define TX_TYPE_TASK             3
 #define TX_TYPE_DONE             4
 #define TX_TYPE_MUXVP_OPEN       5
+#define TX_TYPE_BATCH            6
+#define TX_TYPE_TMPL             7
+
+#define TX_FLAG_SINGLE           0x01 /* batch not understood by scamper */
 
 #define SCAMPER_INST_FLAG_DONE   0x01 /* "done" sent for this inst */
 #define SCAMPER_INST_FLAG_FREE   0x02 /* the inst is in the waitlist to free */
+#define SCAMPER_INST_FLAG_RING   0x04 /* asked scamper for a result ring */
 
 #define SCAMPER_TASK_FLAG_QUEUE  0x01
 #define SCAMPER_TASK_FLAG_WAITOK 0x02
@@ -264,6 +363,7 @@ struct scamper_vp
 #define SCAMPER_ATTP_FLAG_LISTID   0x01
 #define SCAMPER_ATTP_FLAG_CYCLEID  0x02
 #define SCAMPER_ATTP_FLAG_PRIORITY 0x04
+#define SCAMPER_ATTP_FLAG_RING     0x08
 
 #define MUX_HDRLEN             8 /* channel_id:4 + msglen:4 */
 
@@ -286,6 +386,7 @@ struct scamper_vp
 
 #define FD_TYPE_INST           0
 #define FD_TYPE_MUX            1
+#define FD_TYPE_RING           2
 
 #ifndef DMALLOC
 static void *malloc_zero(size_t len)
@@ -442,10 +543,18 @@ static int unix_fd(const char *path, char *err, size_t errlen)
 static void tx_free(sc_tx_t *tx)
 {
   if(tx->buf != NULL) free(tx->buf);
+  if(tx->tasks != NULL) free(tx->tasks);
   free(tx);
   return;
 }
 
+static void held_free(sc_held_t *held)
+{
+  if(held->data != NULL) free(held->data);
+  free(held);
+  return;
+}
+
 static int fd_nonblock(int fd, char *err, size_t errlen)
 {
 #ifdef HAVE_FCNTL
@@ -458,6 +567,39 @@ static int fd_nonblock(int fd, char *err, size_t errlen)
   return 0;
 }
 
+#ifdef HAVE_EPOLL
+/*
+ * fd_epoll
+ *
+ * update the events that epoll monitors the file descriptor for.  a
+ * file descriptor is removed from the epoll set when it is closed.
+ */
+static int fd_epoll(scamper_ctrl_t *ctrl, sc_fd_t *fdn, uint32_t events)
+{
+  struct epoll_event ev;
+  int op;
+
+  if(fdn->events == events || socket_isinvalid(fdn->fd))
+    return 0;
+
+  if(fdn->events == 0)
+    op = EPOLL_CTL_ADD;
+  else if(events == 0)
+    op = EPOLL_CTL_DEL;
+  else
+    op = EPOLL_CTL_MOD;
+
+  memset(&ev, 0, sizeof(ev));
+  ev.events = events;
+  ev.data.ptr = fdn;
+  if(epoll_ctl(ctrl->epfd, op, fdn->fd, &ev) != 0)
+    return -1;
+  fdn->events = events;
+
+  return 0;
+}
+#endif
+
 static int fd_set_read(scamper_ctrl_t *ctrl, sc_fd_t *fdn)
 {
 #ifdef HAVE_KQUEUE
@@ -465,6 +607,10 @@ static int fd_set_read(scamper_ctrl_t *ctrl, sc_fd_t *fdn)
   EV_SET(&kev, fdn->fd, EVFILT_READ, EV_ADD, 0, 0, fdn);
   if(kevent(ctrl->kqfd, &kev, 1, NULL, 0, NULL) != 0)
     return -1;
+#endif
+#ifdef HAVE_EPOLL
+  if(fd_epoll(ctrl, fdn, fdn->events | EPOLLIN) != 0)
+    return -1;
 #endif
   return 0;
 }
@@ -481,6 +627,10 @@ static int fd_set_write(scamper_ctrl_t *ctrl, sc_fd_t *fdn)
       EV_SET(&kev, fdn->fd, EVFILT_WRITE, EV_ADD, 0, 0, fdn);
       if(kevent(ctrl->kqfd, &kev, 1, NULL, 0, NULL) != 0)
 	return -1;
+#endif
+#ifdef HAVE_EPOLL
+      if(fd_epoll(ctrl, fdn, fdn->events | EPOLLOUT) != 0)
+	return -1;
 #endif
       fdn->write = 1;
     }
@@ -500,6 +650,10 @@ static int fd_unset_write(scamper_ctrl_t *ctrl, sc_fd_t *fdn)
       EV_SET(&kev, fdn->fd, EVFILT_WRITE, EV_DELETE, 0, 0, fdn);
       if(kevent(ctrl->kqfd, &kev, 1, NULL, 0, NULL) != 0)
 	return -1;
+#endif
+#ifdef HAVE_EPOLL
+      if(fd_epoll(ctrl, fdn, fdn->events & ~EPOLLOUT) != 0)
+	return -1;
 #endif
       fdn->write = 0;
     }
@@ -512,6 +666,7 @@ static int fd_write(scamper_ctrl_t *ctrl, sc_fd_t *fdn)
   scamper_task_t *task;
   sc_tx_t *tx;
   ssize_t rc;
+  uint32_t i;
 
   tx = dlist_head_item(fdn->queue);
   assert(tx != NULL);
@@ -563,6 +718,16 @@ static int fd_write(scamper_ctrl_t *ctrl, sc_fd_t *fdn)
 
       if(tx->txtype == TX_TYPE_TASK)
 	task->flags |= SCAMPER_TASK_FLAG_WAITOK;
+      else if(tx->txtype == TX_TYPE_BATCH)
+	{
+	  for(i=0; i<tx->taskc; i++)
+	    {
+	      task = tx->tasks[i];
+	      assert((task->flags & SCAMPER_TASK_FLAG_QUEUE) != 0);
+	      task->flags &= (~SCAMPER_TASK_FLAG_QUEUE);
+	      task->flags |= SCAMPER_TASK_FLAG_WAITOK;
+	    }
+	}
     }
   else if(rc > 0)
     {
@@ -711,10 +876,11 @@ static int attp_str_isvalid(const char *str)
   return 1;
 }
 
-static int attp_attach(const scamper_attp_t *attp, char *buf, size_t len)
+static int attp_attach(const scamper_attp_t *attp, uint8_t type,
+		       char *buf, size_t len)
 {
   char cycleid[24], descr[128], listid[24], monitor[128], name[128];
-  char priority[24];
+  char priority[24], ring[24];
 
   if(attp != NULL && attp->flags & SCAMPER_ATTP_FLAG_CYCLEID)
     snprintf(cycleid, sizeof(cycleid), " cycle_id %u", attp->c_id);
@@ -746,12 +912,21 @@ static int attp_attach(const scamper_attp_t *attp, char *buf, size_t len)
   else
     priority[0] = '\0';
 
+  /* only a scamper on the same host can share memory with us */
+#ifdef SC_RING
+  if(attp != NULL && attp->flags & SCAMPER_ATTP_FLAG_RING &&
+     type == SCAMPER_INST_TYPE_UNIX)
+    snprintf(ring, sizeof(ring), " ring %u", attp->ring);
+  else
+#endif
+    ring[0] = '\0';
+
   if(6 + strlen(cycleid) + strlen(descr) + strlen(listid) + strlen(monitor) +
-     strlen(name) + strlen(priority) >= len)
+     strlen(name) + strlen(priority) + strlen(ring) >= len)
     return -1;
 
-  snprintf(buf, len, "attach%s%s%s%s%s%s",
-	   cycleid, descr, listid, monitor, name, priority);
+  snprintf(buf, len, "attach%s%s%s%s%s%s%s",
+	   cycleid, descr, listid, monitor, name, priority, ring);
   return 0;
 }
 
@@ -816,6 +991,496 @@ static sc_tx_t *inst_tx(scamper_inst_t *inst, int type, const char *str)
   return NULL;
 }
 
+/*
+ * err_str
+ *
+ * return a pointer to the message that follows a space in an ERR
+ * line, provided the message is printable.
+ */
+static char *err_str(char *str, size_t *size)
+{
+  size_t i = 0;
+
+  *size = 0;
+  if(str[0] != ' ' || str[1] == '\0')
+    return NULL;
+  str++;
+  while(isprint((unsigned char)str[i]))
+    i++;
+  if(str[i] != '\0')
+    return NULL;
+  *size = i;
+
+  return str;
+}
+
+/*
+ * task_gotid
+ *
+ * scamper has accepted the task and assigned it an id.  if the user
+ * asked to halt the task before we had the id, then do so now.
+ */
+static int task_gotid(scamper_inst_t *inst, scamper_task_t *task, uint32_t id)
+{
+  scamper_ctrl_t *ctrl = inst->ctrl;
+
+  task->id = id;
+  task->flags &= (~SCAMPER_TASK_FLAG_WAITOK);
+  task->flags |= SCAMPER_TASK_FLAG_GOTID;
+  assert(splaytree_find(inst->tree, task) == NULL);
+  if(splaytree_insert(inst->tree, task) == NULL)
+    {
+      snprintf(ctrl->err, sizeof(ctrl->err), "could not add task");
+      return -1;
+    }
+  task->tx = NULL;
+
+  if((task->flags & SCAMPER_TASK_FLAG_HALT) != 0 &&
+     scamper_task_halt(task) != 0)
+    {
+      snprintf(ctrl->err, sizeof(ctrl->err), "could not halt task");
+      return -1;
+    }
+
+  return 0;
+}
+
+/*
+ * batch_ok
+ *
+ * handle an OK reply to a batch of commands.  if scamper understood
+ * the batch, the OK carries the range of IDs assigned to the tasks it
+ * accepted, in order.  otherwise, scamper treated each command in the
+ * batch separately, and the OK is for the next task.
+ */
+static int batch_ok(scamper_inst_t *inst, sc_tx_t *tx, char *str)
+{
+  scamper_ctrl_t *ctrl = inst->ctrl;
+  scamper_task_t *task;
+  uint32_t i, id, prev = 0;
+  long first, last;
+  char *ptr;
+
+  if((tx->flags & TX_FLAG_SINGLE) != 0)
+    {
+      if(strncasecmp(str, " id-", 4) != 0 ||
+	 (first = strtol(str+4, NULL, 10)) < 1)
+	{
+	  snprintf(ctrl->err, sizeof(ctrl->err), "invalid ID number in OK");
+	  return -1;
+	}
+      task = tx->tasks[tx->taski];
+      tx->tasks[tx->taski++] = NULL;
+      return task_gotid(inst, task, first);
+    }
+
+  /* none of the commands were accepted */
+  if(str[0] == '\0')
+    {
+      for(i=0; i<tx->taskc; i++)
+	{
+	  if(tx->tasks[i] != NULL)
+	    {
+	      snprintf(ctrl->err, sizeof(ctrl->err), "no IDs for batch");
+	      return -1;
+	    }
+	}
+      tx->taski = tx->taskc;
+      return 0;
+    }
+
+  if(strncasecmp(str, " id-", 4) != 0 ||
+     (first = strtol(str+4, &ptr, 10)) < 1 || *ptr != '-' ||
+     (last = strtol(ptr+1, NULL, 10)) < 1)
+    {
+      snprintf(ctrl->err, sizeof(ctrl->err), "invalid ID range in OK");
+      return -1;
+    }
+
+  /* ids are assigned sequentially, skipping zero when they wrap */
+  id = first;
+  for(i=0; i<tx->taskc; i++)
+    {
+      if((task = tx->tasks[i]) == NULL)
+	continue;
+      tx->tasks[i] = NULL;
+      if(task_gotid(inst, task, id) != 0)
+	return -1;
+      prev = id;
+      if(++id == 0)
+	id = 1;
+    }
+  tx->taski = tx->taskc;
+
+  if(prev != (uint32_t)last)
+    {
+      snprintf(ctrl->err, sizeof(ctrl->err), "ID range does not match batch");
+      return -1;
+    }
+
+  return 0;
+}
+
+/*
+ * batch_err
+ *
+ * handle an ERR reply to a batch of commands.  scamper identifies
+ * each command in a batch that it did not accept by its index.  an
+ * ERR without an index means scamper did not accept the batch itself,
+ * and will reply to each command that follows separately.
+ */
+static int batch_err(scamper_inst_t *inst, sc_tx_t *tx, char *str)
+{
+  scamper_ctrl_t *ctrl = inst->ctrl;
+  scamper_task_t *task;
+  size_t size;
+  char *ptr;
+  long lo;
+
+  if((tx->flags & TX_FLAG_SINGLE) == 0)
+    {
+      if(strncasecmp(str, " batch-", 7) != 0)
+	{
+	  tx->flags |= TX_FLAG_SINGLE;
+	  return 0;
+	}
+      if((lo = strtol(str+7, &ptr, 10)) < 0 || lo >= tx->taskc ||
+	 (task = tx->tasks[lo]) == NULL)
+	{
+	  snprintf(ctrl->err, sizeof(ctrl->err), "invalid index in ERR");
+	  return -1;
+	}
+      tx->tasks[lo] = NULL;
+      ptr = err_str(ptr, &size);
+      ctrl->cb(inst, SCAMPER_CTRL_TYPE_ERR, task, ptr, size);
+      scamper_task_free(task);
+      return 0;
+    }
+
+  task = tx->tasks[tx->taski];
+  tx->tasks[tx->taski++] = NULL;
+  ptr = err_str(str, &size);
+  ctrl->cb(inst, SCAMPER_CTRL_TYPE_ERR, task, ptr, size);
+  scamper_task_free(task);
+  ctrl->cb(inst, SCAMPER_CTRL_TYPE_MORE, NULL, NULL, 0);
+  return 0;
+}
+
+#ifdef SC_RING
+static void inst_ring_fds_close(scamper_inst_t *inst)
+{
+  int i;
+  for(i=0; i<inst->ring_fdc; i++)
+    if(inst->ring_fds[i] != -1)
+      close(inst->ring_fds[i]);
+  inst->ring_fdc = 0;
+  return;
+}
+
+/*
+ * inst_ring_recv
+ *
+ * recv from a unix socket that scamper might pass the ring's file
+ * descriptors over.
+ */
+static ssize_t inst_ring_recv(scamper_inst_t *inst, uint8_t *buf, size_t len)
+{
+  struct msghdr msg;
+  struct cmsghdr *cmsg;
+  struct iovec iov;
+  union {
+    struct cmsghdr hdr;
+    uint8_t        buf[CMSG_SPACE(sizeof(int) * 3)];
+  } cbuf;
+  size_t i, c;
+  ssize_t rc;
+  int fd, flags = 0;
+
+#ifdef MSG_CMSG_CLOEXEC
+  flags |= MSG_CMSG_CLOEXEC;
+#endif
+
+  iov.iov_base = buf;
+  iov.iov_len = len;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = cbuf.buf;
+  msg.msg_controllen = sizeof(cbuf.buf);
+
+  if((rc = recvmsg(inst->fdn->fd, &msg, flags)) <= 0)
+    return rc;
+
+  for(cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL;
+      cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+      if(cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+	continue;
+      c = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+      for(i=0; i<c; i++)
+	{
+	  memcpy(&fd, CMSG_DATA(cmsg) + (i * sizeof(int)), sizeof(int));
+	  if(inst->ring_fdc < 3)
+	    inst->ring_fds[inst->ring_fdc++] = fd;
+	  else
+	    close(fd);
+	}
+    }
+
+  return rc;
+}
+
+/*
+ * inst_ring_init
+ *
+ * scamper has agreed to write results into a ring of the given size,
+ * and passed us the memfd holding it along with the two eventfds.  map
+ * the ring and start waiting on the data eventfd.
+ */
+static int inst_ring_init(scamper_inst_t *inst, const char *str)
+{
+  scamper_ctrl_t *ctrl = inst->ctrl;
+  sc_ring_hdr_t *hdr;
+  sc_fd_t *fdn;
+  uint64_t size;
+  void *map;
+
+  if(inst->ring_fdc != 3)
+    {
+      snprintf(ctrl->err, sizeof(ctrl->err), "ring without descriptors");
+      return -1;
+    }
+
+  size = strtoull(str, NULL, 10);
+  if(size == 0 || (size & (size - 1)) != 0 || size > SIZE_MAX / 2)
+    {
+      snprintf(ctrl->err, sizeof(ctrl->err), "invalid ring size");
+      return -1;
+    }
+
+  map = mmap(NULL, sizeof(sc_ring_hdr_t) + size, PROT_READ | PROT_WRITE,
+	     MAP_SHARED, inst->ring_fds[0], 0);
+  if(map == MAP_FAILED)
+    {
+      snprintf(ctrl->err, sizeof(ctrl->err), "could not mmap ring: %s",
+	       strerror(errno));
+      return -1;
+    }
+  hdr = map;
+  inst->ring = hdr;
+  inst->ring_data = (uint8_t *)map + sizeof(sc_ring_hdr_t);
+  inst->ring_size = size;
+  if(hdr->magic != SC_RING_MAGIC || hdr->version != SC_RING_VERSION ||
+     hdr->size != size)
+    {
+      snprintf(ctrl->err, sizeof(ctrl->err), "ring header mismatch");
+      return -1;
+    }
+
+  /* the mapping keeps the memfd alive */
+  close(inst->ring_fds[0]);
+  inst->ring_fds[0] = -1;
+
+  if((fdn = fd_alloc(inst->ring_fds[1])) == NULL)
+    {
+      snprintf(ctrl->err, sizeof(ctrl->err), "could not alloc ring fd");
+      return -1;
+    }
+  inst->ring_fds[1] = -1;
+  inst->ring_spacefd = inst->ring_fds[2];
+  inst->ring_fds[2] = -1;
+  inst->ring_fdc = 0;
+
+  if((fdn->fdsdn = dlist_tail_push(ctrl->fds, fdn)) == NULL)
+    {
+      snprintf(ctrl->err, sizeof(ctrl->err), "could not add to fd list");
+      fd_free(fdn);
+      return -1;
+    }
+  inst->ring_fdn = fdn;
+  fdn->fdtype = FD_TYPE_RING;
+  fdn->data = inst;
+
+  if(fd_set_read(ctrl, fdn) != 0)
+    {
+      snprintf(ctrl->err, sizeof(ctrl->err), "could not set ring read");
+      return -1;
+    }
+
+  return 0;
+}
+
+/*
+ * inst_ring_tail
+ *
+ * tell scamper how far through the ring we are, and wake it if it is
+ * waiting for room.
+ */
+static void inst_ring_tail(scamper_inst_t *inst, uint64_t tail)
+{
+  sc_ring_hdr_t *hdr = inst->ring;
+  uint64_t one = 1;
+
+  __atomic_store_n(&hdr->tail, tail, __ATOMIC_RELEASE);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if(__atomic_load_n(&hdr->wwait, __ATOMIC_RELAXED) != 0)
+    {
+      __atomic_store_n(&hdr->wwait, 0, __ATOMIC_RELAXED);
+      if(write(inst->ring_spacefd, &one, sizeof(one)) != sizeof(one))
+	return;
+    }
+  return;
+}
+
+/*
+ * inst_ring_read
+ *
+ * pass the records in the ring to the callback without copying them.
+ * a record for a task whose ID is still on its way over the socket is
+ * left in the ring until the ID has been read.
+ */
+static int inst_ring_read(scamper_inst_t *inst)
+{
+  scamper_ctrl_t *ctrl = inst->ctrl;
+  sc_ring_hdr_t *hdr = inst->ring;
+  scamper_task_t fm, *task;
+  uint64_t head, tail, done, off, reclen;
+  uint32_t *rec;
+  int rc = -1;
+
+  done = tail = hdr->tail;
+  for(;;)
+    {
+      head = __atomic_load_n(&hdr->head, __ATOMIC_ACQUIRE);
+      if(head == tail)
+	{
+	  /* say we are going to wait, then check again */
+	  __atomic_store_n(&hdr->rwait, 1, __ATOMIC_RELAXED);
+	  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+	  head = __atomic_load_n(&hdr->head, __ATOMIC_ACQUIRE);
+	  if(head == tail)
+	    break;
+	}
+
+      off = tail & (inst->ring_size - 1);
+      rec = (uint32_t *)(inst->ring_data + off);
+      if(rec[0] == SC_RING_WRAP)
+	{
+	  tail += inst->ring_size - off;
+	  continue;
+	}
+
+      reclen = SC_RING_RECLEN(rec[0]);
+      if(reclen > inst->ring_size - off || reclen > head - tail)
+	{
+	  snprintf(ctrl->err, sizeof(ctrl->err), "invalid ring record");
+	  goto done;
+	}
+
+      task = NULL;
+      if(rec[1] != 0)
+	{
+	  fm.id = rec[1];
+	  if((task = splaytree_find(inst->tree, &fm)) == NULL)
+	    {
+	      if(slist_count(inst->waitok) > 0)
+		break;
+	      snprintf(ctrl->err, sizeof(ctrl->err),
+		       "could not find task with ID %u", rec[1]);
+	      goto done;
+	    }
+	  splaytree_remove_item(inst->tree, &fm);
+	  task->inst = NULL;
+	  task->flags |= SCAMPER_TASK_FLAG_DONE;
+	}
+
+      ctrl->cb(inst, SCAMPER_CTRL_TYPE_DATA, task, rec + 2, rec[0]);
+      if(task != NULL)
+	scamper_task_free(task);
+      tail += reclen;
+
+      /* do not hold scamper up while working through a full ring */
+      if(tail - done >= inst->ring_size / 4)
+	{
+	  inst_ring_tail(inst, tail);
+	  done = tail;
+	}
+    }
+  rc = 0;
+
+ done:
+  if(tail != done)
+    inst_ring_tail(inst, tail);
+  return rc;
+}
+#endif
+
+/*
+ * inst_held_add
+ *
+ * hold the data we just received until we get the OK that tells us
+ * which task it belongs to.
+ */
+static int inst_held_add(scamper_inst_t *inst)
+{
+  scamper_ctrl_t *ctrl = inst->ctrl;
+  sc_held_t *held = NULL;
+
+  if((inst->held == NULL && (inst->held = slist_alloc()) == NULL) ||
+     (held = malloc(sizeof(sc_held_t))) == NULL ||
+     slist_tail_push(inst->held, held) == NULL)
+    {
+      snprintf(ctrl->err, sizeof(ctrl->err), "could not hold data");
+      if(held != NULL) free(held);
+      return -1;
+    }
+
+  held->id = inst->data_id;
+  held->data = inst->data;
+  held->len = inst->data_o;
+  inst->data_id = 0;
+  inst->data = NULL;
+  inst->data_o = 0;
+  inst->data_len = 0;
+  return 0;
+}
+
+/*
+ * inst_held_flush
+ *
+ * pass on held data, in the order it arrived, for tasks that we now
+ * have an ID for.  it is an error for data to be held once there are
+ * no more OKs to come.
+ */
+static int inst_held_flush(scamper_inst_t *inst)
+{
+  scamper_ctrl_t *ctrl = inst->ctrl;
+  scamper_task_t fm, *task;
+  sc_held_t *held;
+
+  while((held = slist_head_item(inst->held)) != NULL)
+    {
+      fm.id = held->id;
+      if((task = splaytree_find(inst->tree, &fm)) == NULL)
+	{
+	  if(slist_count(inst->waitok) > 0)
+	    return 0;
+	  snprintf(ctrl->err, sizeof(ctrl->err),
+		   "could not find task with ID %u", held->id);
+	  return -1;
+	}
+      slist_head_pop(inst->held);
+      splaytree_remove_item(inst->tree, &fm);
+      task->inst = NULL;
+      task->flags |= SCAMPER_TASK_FLAG_DONE;
+      ctrl->cb(inst, SCAMPER_CTRL_TYPE_DATA, task, held->data, held->len);
+      scamper_task_free(task);
+      held_free(held);
+    }
+
+  return 0;
+}
+
 static int inst_rx(scamper_inst_t *inst, uint8_t *buf, size_t len)
 {
   scamper_ctrl_t *ctrl = inst->ctrl;
@@ -872,6 +1537,42 @@ static int inst_rx(scamper_inst_t *inst, uint8_t *buf, size_t len)
 	    {
 	      ctrl->cb(inst, SCAMPER_CTRL_TYPE_MORE, NULL, NULL, 0);
 	    }
+	  else if(strncasecmp(start, "OK", 2) == 0 &&
+		  (tx = slist_head_item(inst->waitok)) != NULL &&
+		  tx->txtype == TX_TYPE_BATCH)
+	    {
+	      if(batch_ok(inst, tx, start + 2) != 0)
+		goto done;
+	      if(tx->taski == tx->taskc)
+		{
+		  slist_head_pop(inst->waitok);
+		  tx_free(tx);
+		}
+	    }
+	  else if(strncasecmp(start, "ERR", 3) == 0 &&
+		  (tx = slist_head_item(inst->waitok)) != NULL &&
+		  tx->txtype == TX_TYPE_BATCH)
+	    {
+	      if(batch_err(inst, tx, start + 3) != 0)
+		goto done;
+	      if(tx->taski == tx->taskc)
+		{
+		  slist_head_pop(inst->waitok);
+		  tx_free(tx);
+		}
+	    }
+#ifdef SC_RING
+	  else if(strncasecmp(start, "OK ring ", 8) == 0 &&
+		  (tx = slist_head_item(inst->waitok)) != NULL &&
+		  tx->txtype == TX_TYPE_ATTACH)
+	    {
+	      slist_head_pop(inst->waitok);
+	      tx_free(tx);
+	      inst->flags &= (~SCAMPER_INST_FLAG_RING);
+	      if(inst_ring_init(inst, start + 8) != 0)
+		goto done;
+	    }
+#endif
 	  else if(strncasecmp(start, "OK id-", 6) == 0)
 	    {
 	      if((lo = strtol(start+6, NULL, 10)) < 1)
@@ -886,39 +1587,39 @@ static int inst_rx(scamper_inst_t *inst, uint8_t *buf, size_t len)
 		  goto done;
 		}
 	      assert(tx->txtype == TX_TYPE_TASK);
-	      tx->task->id = lo;
-	      tx->task->flags &= (~SCAMPER_TASK_FLAG_WAITOK);
-	      tx->task->flags |= SCAMPER_TASK_FLAG_GOTID;
-	      assert(splaytree_find(inst->tree, tx->task) == NULL);
-	      if(splaytree_insert(inst->tree, tx->task) == NULL)
-		{
-		  snprintf(ctrl->err, sizeof(ctrl->err), "could not add task");
-		  goto done;
-		}
-	      tx->task->tx = NULL; tx->task = NULL;
+	      if(task_gotid(inst, tx->task, lo) != 0)
+		goto done;
+	      tx->task = NULL;
 	      tx_free(tx);
 	    }
 	  else if(strncasecmp(start, "OK", 2) == 0)
 	    {
 	      tx = slist_head_pop(inst->waitok);
 	      assert(tx->txtype != TX_TYPE_TASK);
+#ifdef SC_RING
+	      /* scamper could not give us a ring, so use the socket */
+	      if(tx->txtype == TX_TYPE_ATTACH)
+		{
+		  inst->flags &= (~SCAMPER_INST_FLAG_RING);
+		  inst_ring_fds_close(inst);
+		}
+#endif
+	      tx_free(tx);
+	    }
+	  else if(strncasecmp(start, "ERR", 3) == 0 &&
+		  (tx = slist_head_item(inst->waitok)) != NULL &&
+		  tx->txtype == TX_TYPE_TMPL)
+	    {
+	      slist_head_pop(inst->waitok);
+	      ptr = err_str(start + 3, &size);
+	      ctrl->cb(inst, SCAMPER_CTRL_TYPE_ERR, NULL, ptr, size);
 	      tx_free(tx);
 	    }
 	  else if(strncasecmp(start, "ERR", 3) == 0)
 	    {
 	      tx = slist_head_pop(inst->waitok);
 	      assert(tx->txtype == TX_TYPE_TASK);
-	      ptr = NULL; size = 0;
-	      if(start[3] == ' ' && start[4] != '\0')
-		{
-		  ptr = start + 4; i = 0;
-		  while(isprint((unsigned char)ptr[i]))
-		    i++;
-		  if(ptr[i] == '\0')
-		    size = i;
-		  else
-		    ptr = NULL;
-		}
+	      ptr = err_str(start + 3, &size);
 	      ctrl->cb(inst, SCAMPER_CTRL_TYPE_ERR, tx->task, ptr, size);
 	      scamper_task_free(tx->task); tx->task = NULL;
 	      ctrl->cb(inst, SCAMPER_CTRL_TYPE_MORE, NULL, NULL, 0);
@@ -965,15 +1666,22 @@ static int inst_rx(scamper_inst_t *inst, uint8_t *buf, size_t len)
 		      goto done;
 		    }
 		  fm.id = lo;
-		  if((inst->task = splaytree_find(inst->tree, &fm)) == NULL)
+		  if((inst->task = splaytree_find(inst->tree, &fm)) != NULL)
+		    splaytree_remove_item(inst->tree, &fm);
+		  else if(slist_count(inst->waitok) > 0)
+		    inst->data_id = fm.id;
+		  else
 		    {
 		      snprintf(ctrl->err, sizeof(ctrl->err),
 			       "could not find task with ID %ld", lo);
 		      goto done;
 		    }
-		  splaytree_remove_item(inst->tree, &fm);
 		}
 	    }
+
+	  /* pass on any data that was waiting for this OK */
+	  if(inst->held != NULL && inst_held_flush(inst) != 0)
+	    goto done;
 	}
       else
 	{
@@ -1045,7 +1753,12 @@ static int inst_rx(scamper_inst_t *inst, uint8_t *buf, size_t len)
 
 	next:
 	  inst->data_left -= (linelen + 1);
-	  if(inst->data_left == 0)
+	  if(inst->data_left == 0 && inst->data_id != 0)
+	    {
+	      if(inst_held_add(inst) != 0)
+		goto done;
+	    }
+	  else if(inst->data_left == 0)
 	    {
 	      if(inst->task != NULL)
 		{
@@ -1102,6 +1815,9 @@ static void inst_set_null(scamper_inst_t *inst)
   inst->idn = NULL;
   inst->fdn = NULL;
   inst->mc = NULL;
+#ifdef SC_RING
+  inst->ring_fdn = NULL;
+#endif
   return;
 }
 
@@ -1163,6 +1879,19 @@ static void inst_free(scamper_inst_t *inst)
       assert(inst->type == SCAMPER_INST_TYPE_MUXVP);
       inst->mc->inst = NULL;
     }
+#ifdef SC_RING
+  if(inst->ring_fdn != NULL)
+    {
+      assert(inst->ctrl != NULL);
+      dlist_node_pop(inst->ctrl->fds, inst->ring_fdn->fdsdn);
+      fd_free(inst->ring_fdn);
+    }
+  if(inst->ring != NULL)
+    munmap(inst->ring, sizeof(sc_ring_hdr_t) + inst->ring_size);
+  if(inst->ring_spacefd != -1)
+    close(inst->ring_spacefd);
+  inst_ring_fds_close(inst);
+#endif
   if(inst->idn != NULL)
     dlist_node_pop(inst->list, inst->idn);
   if(inst->name != NULL)
@@ -1173,6 +1902,8 @@ static void inst_free(scamper_inst_t *inst)
     splaytree_free(inst->tree, (splaytree_free_t)scamper_task_free);
   if(inst->data != NULL)
     free(inst->data);
+  if(inst->held != NULL)
+    slist_free_cb(inst->held, (slist_free_t)held_free);
   if(inst->vp != NULL)
     scamper_vp_free(inst->vp);
   free(inst);
@@ -1207,6 +1938,9 @@ static scamper_inst_t *inst_alloc_dm(scamper_ctrl_t *ctrl, uint8_t type,
     }
 
   memset(inst, 0, len);
+#ifdef SC_RING
+  inst->ring_spacefd = -1;
+#endif
 
   if((inst->name = strdup(name)) == NULL ||
      (inst->waitok = slist_alloc()) == NULL ||
@@ -1720,6 +2454,97 @@ scamper_task_t *scamper_inst_do(scamper_inst_t *inst, const char *str, void *p)
   return task;
 }
 
+int scamper_inst_do_batch(scamper_inst_t *inst, const char * const *cmds,
+			  size_t cmdc, void * const *params,
+			  scamper_task_t **tasks)
+{
+  scamper_task_t **bt = NULL;
+  sc_tx_t *tx = NULL;
+  char *buf = NULL;
+  size_t i, len, off;
+
+  if(inst->ctrl == NULL)
+    {
+      snprintf(inst->err, sizeof(inst->err), "no corresponding control");
+      return -1;
+    }
+
+  /* can't send a command after sending done message */
+  if((inst->flags & SCAMPER_INST_FLAG_DONE) != 0)
+    {
+      snprintf(inst->err, sizeof(inst->err), "instance marked done");
+      return -1;
+    }
+
+  if(cmdc < 1 || cmdc > SCAMPER_INST_BATCH_MAX)
+    {
+      snprintf(inst->err, sizeof(inst->err), "invalid batch size");
+      return -1;
+    }
+
+  if((bt = malloc_zero(sizeof(scamper_task_t *) * cmdc)) == NULL)
+    {
+      snprintf(inst->err, sizeof(inst->err), "could not malloc batch");
+      return -1;
+    }
+
+  /* allocate the tasks to return to the caller */
+  len = 12; /* batch 65535 */
+  for(i=0; i<cmdc; i++)
+    {
+      if((bt[i] = malloc_zero(sizeof(scamper_task_t))) == NULL)
+	{
+	  snprintf(inst->err, sizeof(inst->err), "could not malloc task");
+	  goto err;
+	}
+      bt[i]->inst = inst;
+      bt[i]->refcnt = 1;
+      if(task_set_str(inst, bt[i], cmds[i]) != 0)
+	goto err;
+      len += strlen(bt[i]->str) + 1;
+    }
+
+  /* put the batch command and the commands in a single message */
+  if((buf = malloc(len)) == NULL)
+    {
+      snprintf(inst->err, sizeof(inst->err), "could not malloc batch");
+      goto err;
+    }
+  off = snprintf(buf, len, "batch %u", (uint32_t)cmdc);
+  for(i=0; i<cmdc; i++)
+    {
+      buf[off++] = '\n';
+      len = strlen(bt[i]->str);
+      memcpy(buf + off, bt[i]->str, len);
+      off += len;
+    }
+  buf[off] = '\0';
+
+  if((tx = inst_tx(inst, TX_TYPE_BATCH, buf)) == NULL)
+    goto err;
+  free(buf);
+
+  tx->tasks = bt;
+  tx->taskc = cmdc;
+  for(i=0; i<cmdc; i++)
+    {
+      bt[i]->tx = tx;
+      bt[i]->flags |= SCAMPER_TASK_FLAG_QUEUE;
+      bt[i]->param = params != NULL ? params[i] : NULL;
+      tasks[i] = bt[i];
+    }
+
+  return 0;
+
+ err:
+  if(buf != NULL) free(buf);
+  for(i=0; i<cmdc; i++)
+    if(bt[i] != NULL)
+      scamper_task_free(bt[i]);
+  free(bt);
+  return -1;
+}
+
 int scamper_task_halt(scamper_task_t *task)
 {
   scamper_inst_t *inst;
@@ -1750,6 +2575,16 @@ int scamper_task_halt(scamper_task_t *task)
     {
       assert(task->tx != NULL); assert(task->tx->qdn != NULL);
 
+      /*
+       * a task in a batch cannot be taken out of the batch, so halt
+       * the task once scamper has assigned it an ID.
+       */
+      if(task->tx->txtype == TX_TYPE_BATCH)
+	{
+	  task->flags |= SCAMPER_TASK_FLAG_HALT;
+	  return 0;
+	}
+
       if(INST_HAS_FDN(inst))
 	dlist_node_pop(inst->fdn->queue, task->tx->qdn);
       else
@@ -1812,6 +2647,54 @@ scamper_vp_t *scamper_inst_vp_get(const scamper_inst_t *inst)
   return inst->vp;
 }
 
+int scamper_inst_tmpl(scamper_inst_t *inst, const char *name, const char *cmd)
+{
+  char buf[512];
+  size_t i;
+
+  if(inst->ctrl == NULL)
+    {
+      snprintf(inst->err, sizeof(inst->err), "no corresponding control");
+      return -1;
+    }
+
+  if((inst->flags & SCAMPER_INST_FLAG_DONE) != 0)
+    {
+      snprintf(inst->err, sizeof(inst->err), "instance marked done");
+      return -1;
+    }
+
+  for(i=0; name[i] != '\0'; i++)
+    if(isalnum((unsigned char)name[i]) == 0 && name[i] != '-' &&
+       name[i] != '_')
+      break;
+  if(i == 0 || i >= 32 || name[i] != '\0')
+    {
+      snprintf(inst->err, sizeof(inst->err), "invalid template name");
+      return -1;
+    }
+
+  if((size_t)snprintf(buf, sizeof(buf), "template %s %s", name, cmd) >=
+     sizeof(buf))
+    {
+      snprintf(inst->err, sizeof(inst->err), "template too long");
+      return -1;
+    }
+  for(i=0; buf[i] != '\0'; i++)
+    {
+      if(isprint((unsigned char)buf[i]) == 0)
+	{
+	  snprintf(inst->err, sizeof(inst->err), "unprintable char in command");
+	  return -1;
+	}
+    }
+
+  if(inst_tx(inst, TX_TYPE_TMPL, buf) == NULL)
+    return -1;
+
+  return 0;
+}
+
 int scamper_inst_done(scamper_inst_t *inst)
 {
   /* set the done flag if not already set */
@@ -1995,7 +2878,8 @@ scamper_inst_t *scamper_inst_inet(scamper_ctrl_t *ctrl,
   SOCKET fd = INVALID_SOCKET;
 #endif
 
-  if(attp_attach(attp, attp_buf, sizeof(attp_buf)) != 0)
+  if(attp_attach(attp, SCAMPER_INST_TYPE_INET,
+		 attp_buf, sizeof(attp_buf)) != 0)
     {
       snprintf(ctrl->err, sizeof(ctrl->err), "could not form attach");
       goto err;
@@ -2060,7 +2944,8 @@ scamper_inst_t *scamper_inst_unix(scamper_ctrl_t *ctrl,
   char attp_buf[512];
   int fd = -1;
 
-  if(attp_attach(attp, attp_buf, sizeof(attp_buf)) != 0)
+  if(attp_attach(attp, SCAMPER_INST_TYPE_UNIX,
+		 attp_buf, sizeof(attp_buf)) != 0)
     {
       snprintf(ctrl->err, sizeof(ctrl->err), "could not form attach");
       goto err;
@@ -2073,6 +2958,11 @@ scamper_inst_t *scamper_inst_unix(scamper_ctrl_t *ctrl,
      inst_tx(inst, TX_TYPE_ATTACH, attp_buf) == NULL)
     goto err;
 
+#ifdef SC_RING
+  if(attp != NULL && attp->flags & SCAMPER_ATTP_FLAG_RING)
+    inst->flags |= SCAMPER_INST_FLAG_RING;
+#endif
+
   return inst;
 
  err:
@@ -2124,7 +3014,12 @@ static int scamper_inst_read(scamper_inst_t *inst)
   ctrl = inst->ctrl;
   fdn = inst->fdn;
 
-  rc = recv(fdn->fd, buf, sizeof(buf), 0);
+#ifdef SC_RING
+  if(inst->flags & SCAMPER_INST_FLAG_RING)
+    rc = inst_ring_recv(inst, buf, sizeof(buf));
+  else
+#endif
+    rc = recv(fdn->fd, buf, sizeof(buf), 0);
 
   /* if the scamper process exits, pass that through */
   if(rc == 0)
@@ -2132,6 +3027,12 @@ static int scamper_inst_read(scamper_inst_t *inst)
       socket_close(fdn->fd);
       fdn->fd = socket_invalid();
 
+#ifdef SC_RING
+      /* pass through results left in the ring before the EOF */
+      if(inst->ring != NULL && inst_ring_read(inst) != 0)
+	ctrl->cb(inst, SCAMPER_CTRL_TYPE_FATAL, NULL, NULL, 0);
+#endif
+
       /*
        * signal EOF on callback.  the callback might call scamper_inst_free,
        * which we can detect because it will not be on ctrl->insts, rather
@@ -2162,12 +3063,48 @@ static int scamper_inst_read(scamper_inst_t *inst)
   if(inst_rx(inst, buf, rc) != 0)
     goto fatal;
 
+#ifdef SC_RING
+  /* the socket might have carried IDs for results waiting in the ring */
+  if(inst->ring != NULL && inst_ring_read(inst) != 0)
+    goto fatal;
+#endif
+
+  return 0;
+
+ fatal:
+  ctrl->cb(inst, SCAMPER_CTRL_TYPE_FATAL, NULL, NULL, 0);
+  return 0;
+}
+
+#ifdef SC_RING
+/*
+ * scamper_inst_ring
+ *
+ * scamper has signalled that there are results in the ring.
+ */
+static int scamper_inst_ring(scamper_inst_t *inst)
+{
+  scamper_ctrl_t *ctrl = inst->ctrl;
+  uint64_t u64;
+
+  if(read(inst->ring_fdn->fd, &u64, sizeof(u64)) == -1 &&
+     errno != EAGAIN && errno != EINTR)
+    {
+      snprintf(ctrl->err, sizeof(ctrl->err), "could not read ring: %s",
+	       strerror(errno));
+      goto fatal;
+    }
+
+  if(inst_ring_read(inst) != 0)
+    goto fatal;
+
   return 0;
 
  fatal:
   ctrl->cb(inst, SCAMPER_CTRL_TYPE_FATAL, NULL, NULL, 0);
   return 0;
 }
+#endif
 
 scamper_ctrl_t *scamper_inst_ctrl_get(const scamper_inst_t *inst)
 {
@@ -2324,6 +3261,12 @@ scamper_mux_t *scamper_mux_add(scamper_ctrl_t *ctrl, const char *path)
     goto err;
   mux->ctrl = ctrl;
 
+  if(fd_set_read(ctrl, mux->fdn) != 0)
+    {
+      snprintf(ctrl->err, sizeof(ctrl->err), "could not set read");
+      goto err;
+    }
+
   return mux;
 
  err:
@@ -2543,6 +3486,13 @@ int scamper_ctrl_wait(scamper_ctrl_t *ctrl, struct timeval *to)
 	      if(mux_read(fdn->data) != 0)
 		goto done;
 	    }
+#ifdef SC_RING
+	  else if(fdn->fdtype == FD_TYPE_RING)
+	    {
+	      if(scamper_inst_ring(fdn->data) != 0)
+		goto done;
+	    }
+#endif
 	}
       else if(events[i].filter == EVFILT_WRITE && socket_isvalid(fdn->fd))
 	{
@@ -2558,6 +3508,70 @@ int scamper_ctrl_wait(scamper_ctrl_t *ctrl, struct timeval *to)
  done:
   return ctrl_wait_done(ctrl, rc);
 }
+#elif defined(HAVE_EPOLL)
+int scamper_ctrl_wait(scamper_ctrl_t *ctrl, struct timeval *to)
+{
+  struct epoll_event events[128];
+  int eventc = sizeof(events) / sizeof(struct epoll_event);
+  int i, c, timeout, rc = -1;
+  sc_fd_t *fdn;
+
+  /* round the timeout up to milliseconds, so that we do not spin */
+  if(to != NULL)
+    timeout = (to->tv_sec * 1000) + ((to->tv_usec + 999) / 1000);
+  else
+    timeout = -1;
+
+  if((c = epoll_wait(ctrl->epfd, events, eventc, timeout)) == -1)
+    {
+      if(errno == EINTR)
+	rc = 0;
+      else
+	snprintf(ctrl->err, sizeof(ctrl->err), "could not epoll_wait: %s",
+		 strerror(errno));
+      goto done;
+    }
+
+  ctrl->wait = 1;
+  for(i=0; i<c; i++)
+    {
+      fdn = events[i].data.ptr;
+      if((events[i].events & (EPOLLIN|EPOLLHUP|EPOLLERR)) != 0 &&
+	 socket_isvalid(fdn->fd))
+	{
+	  if(fdn->fdtype == FD_TYPE_INST)
+	    {
+	      if(scamper_inst_read(fdn->data) != 0)
+		goto done;
+	    }
+	  else if(fdn->fdtype == FD_TYPE_MUX)
+	    {
+	      if(mux_read(fdn->data) != 0)
+		goto done;
+	    }
+#ifdef SC_RING
+	  else if(fdn->fdtype == FD_TYPE_RING)
+	    {
+	      if(scamper_inst_ring(fdn->data) != 0)
+		goto done;
+	    }
+#endif
+	}
+      if((events[i].events & EPOLLOUT) != 0 && fdn->write != 0 &&
+	 socket_isvalid(fdn->fd))
+	{
+	  assert(fdn->fdtype == FD_TYPE_INST ||
+		 fdn->fdtype == FD_TYPE_MUX);
+	  if(fd_write(ctrl, fdn) != 0)
+	    goto done;
+	}
+    }
+
+  rc = 0;
+
+ done:
+  return ctrl_wait_done(ctrl, rc);
+}
 #else
 int scamper_ctrl_wait(scamper_ctrl_t *ctrl, struct timeval *to)
 {
@@ -2622,6 +3636,13 @@ int scamper_ctrl_wait(scamper_ctrl_t *ctrl, struct timeval *to)
 	      if(mux_read(fdn->data) != 0)
 		goto done;
 	    }
+#ifdef SC_RING
+	  else if(fdn->fdtype == FD_TYPE_RING)
+	    {
+	      if(scamper_inst_ring(fdn->data) != 0)
+		goto done;
+	    }
+#endif
 	}
       if(wfdsp != NULL && FD_ISSET(fd, wfdsp))
 	{
@@ -2678,6 +3699,10 @@ void scamper_ctrl_free(scamper_ctrl_t *ctrl)
   if(ctrl->kqfd != -1)
     close(ctrl->kqfd);
 #endif
+#ifdef HAVE_EPOLL
+  if(ctrl->epfd != -1)
+    close(ctrl->epfd);
+#endif
 
   free(ctrl);
   return;
@@ -2708,6 +3733,10 @@ scamper_ctrl_t *scamper_ctrl_alloc_dm(scamper_ctrl_cb_t cb,
   if((ctrl->kqfd = kqueue()) == -1)
     goto err;
 #endif
+#ifdef HAVE_EPOLL
+  if((ctrl->epfd = epoll_create(10)) == -1)
+    goto err;
+#endif
 
 #ifndef DMALLOC
   ctrl->insts = dlist_alloc();
@@ -2864,6 +3893,13 @@ void scamper_attp_priority_set(scamper_attp_t *attp, uint32_t priority)
   return;
 }
 
+void scamper_attp_ring_set(scamper_attp_t *attp, uint32_t ring)
+{
+  attp->flags |= SCAMPER_ATTP_FLAG_RING;
+  attp->ring = ring;
+  return;
+}
+
 void scamper_attp_free(scamper_attp_t *attp)
 {
   if(attp == NULL)
@@ -45,6 +45,8 @@ typedef struct scamper_vpset scamper_vpset_t;
 #define SCAMPER_INST_TYPE_REMOTE 3
 #define SCAMPER_INST_TYPE_MUXVP  4
 
+#define SCAMPER_INST_BATCH_MAX   65535
+
 typedef void (*scamper_ctrl_cb_t)(scamper_inst_t *inst, uint8_t type,
 				  scamper_task_t *task,
 				  const void *data, size_t len);
@@ -119,6 +121,10 @@ scamper_inst_t *scamper_inst_inet(scamper_ctrl_t *ctrl,
 scamper_inst_t *scamper_inst_remote(scamper_ctrl_t *ctrl, const char *path);
 void scamper_inst_free(scamper_inst_t *inst);
 scamper_task_t *scamper_inst_do(scamper_inst_t *inst, const char *cmd, void *p);
+int scamper_inst_do_batch(scamper_inst_t *inst, const char * const *cmds,
+			  size_t cmdc, void * const *params,
+			  scamper_task_t **tasks);
+int scamper_inst_tmpl(scamper_inst_t *inst, const char *name, const char *cmd);
 int scamper_inst_done(scamper_inst_t *inst);
 
 void *scamper_inst_param_get(const scamper_inst_t *inst);
@@ -166,6 +172,7 @@ int scamper_attp_listdescr_set(scamper_attp_t *attp, char *list_descr);
 int scamper_attp_listmonitor_set(scamper_attp_t *attp, char *list_monitor);
 void scamper_attp_cycleid_set(scamper_attp_t *attp, uint32_t cycle_id);
 void scamper_attp_priority_set(scamper_attp_t *attp, uint32_t priority);
+void scamper_attp_ring_set(scamper_attp_t *attp, uint32_t ring);
 void scamper_attp_free(scamper_attp_t *attp);
 
 #endif /* __LIBSCAMPERCTRL_H */
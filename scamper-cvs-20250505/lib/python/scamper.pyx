@@ -278,6 +278,7 @@ import os, stat
 import binascii
 import enum
 import re
+import collections.abc
 
 cimport cscamper_addr
 cimport cscamper_list
@@ -320,6 +321,7 @@ SCAMPER_CTRL_TYPE_MORE  = 2
 SCAMPER_CTRL_TYPE_ERR   = 3
 SCAMPER_CTRL_TYPE_EOF   = 4
 SCAMPER_CTRL_TYPE_FATAL = 5
+SCAMPER_INST_BATCH_MAX  = 65535
 
 # from scamper_trace.h
 SCAMPER_TRACE_TYPE_ICMP_ECHO_PARIS = 4
@@ -9237,6 +9239,61 @@ cdef class ScamperCtrl:
             raise RuntimeError("could not schedule command")
         return self._task(c, (<ScamperInst>inst)._c, sync)
 
+    cdef _dobatch(self, list cmds, ScamperInst inst):
+        cdef clibscamperctrl.scamper_task_t **tasks = NULL
+        cdef const char **cstrs = NULL
+        cdef size_t i, x
+        enc = [c.encode('UTF-8') for c in cmds]
+        out = []
+        n = len(enc)
+        x = min(n, SCAMPER_INST_BATCH_MAX)
+        tasks = <clibscamperctrl.scamper_task_t **>PyMem_Malloc(
+            sizeof(clibscamperctrl.scamper_task_t *) * x)
+        cstrs = <const char **>PyMem_Malloc(sizeof(const char *) * x)
+        try:
+            if tasks == NULL or cstrs == NULL:
+                raise MemoryError()
+            off = 0
+            while off < n:
+                x = min(n - off, SCAMPER_INST_BATCH_MAX)
+                for i in range(x):
+                    cstrs[i] = enc[off + i]
+                if clibscamperctrl.scamper_inst_do_batch(inst._c, cstrs, x,
+                                                         NULL, tasks) != 0:
+                    raise RuntimeError("could not schedule commands")
+                for i in range(x):
+                    out.append(self._task(tasks[i], inst._c, False))
+                off += x
+        finally:
+            PyMem_Free(tasks)
+            PyMem_Free(cstrs)
+        return out
+
+    def _dotargets(self, args, targets, inst, sync):
+        # a single target is issued as a single command.  otherwise,
+        # the commands for an iterable of targets are issued as batches,
+        # which scamper acknowledges with a single reply each.
+        if (isinstance(targets, (str, bytes)) or
+            not isinstance(targets, collections.abc.Iterable)):
+            args.append(f"{targets}")
+            return self._dotasks(' '.join(args), inst, sync)
+
+        prefix = ' '.join(args)
+        cmds = [f"{prefix} {t}" for t in targets]
+        if sync:
+            return [self._dotasks(c, inst, sync) for c in cmds]
+        if len(cmds) == 0:
+            return []
+        if isinstance(inst, list):
+            tasks = []
+            for i in inst:
+                try:
+                    tasks.extend(self._dobatch(cmds, i))
+                except RuntimeError:
+                    continue
+            return tasks
+        return self._dobatch(cmds, inst)
+
     # the optional parameters are ordered roughly according to the order
     # these appear in the underlying trace command
     def do_trace(self, dst, confidence=None, dport=None,
@@ -9264,6 +9321,7 @@ cdef class ScamperCtrl:
         :py:exc:`RuntimeError` exception.
 
         :param string dst: The destination IP address to probe
+            or an iterable of them, issued as a batch
         :param ScamperInst inst: The specific instance to issue command over
         :param int attempts: The number of probes to send per hop
         :param bool all_attempts: Send all allotted attempts per hop
@@ -9295,6 +9353,7 @@ cdef class ScamperCtrl:
         :param bool sync: operate the measurement synchronously
             (the method returns when the measurement completes).
         :returns: a task object representing the traceroute
+            (a list of them if the dst is iterable)
         :rtype: ScamperTask
         """
 
@@ -9363,9 +9422,7 @@ cdef class ScamperCtrl:
             if not isinstance(wait_probe, datetime.timedelta):
                 wait_probe = datetime.timedelta(seconds=wait_probe)
             args.append(f"-W {wait_probe.total_seconds()}s")
-        args.append(f"{dst}")
-
-        return self._dotasks(' '.join(args), inst, sync)
+        return self._dotargets(args, dst, inst, sync)
 
     def do_tracelb(self, dst, confidence=None, dport=None,
                    firsthop=None, gaplimit=None, method=None,
@@ -9388,6 +9445,7 @@ cdef class ScamperCtrl:
         :py:exc:`RuntimeError` exception.
 
         :param string dst: The destination IP address to probe
+            or an iterable of them, issued as a batch
         :param ScamperInst inst: The specific instance to issue command over
         :param int attempts: The number of probes to send per hop
         :param int confidence: Confidence level before assuming all
@@ -9408,6 +9466,7 @@ cdef class ScamperCtrl:
         :param bool sync: operate the measurement synchronously
             (the method returns when the measurement completes).
         :returns: a task object representing the MDA traceroute
+            (a list of them if the dst is iterable)
         :rtype: ScamperTask
         """
 
@@ -9456,9 +9515,7 @@ cdef class ScamperCtrl:
             if not isinstance(wait_probe, datetime.timedelta):
                 wait_probe = datetime.timedelta(seconds=wait_probe)
             args.append(f"-W {wait_probe.total_seconds()}s")
-        args.append(f"{dst}")
-
-        return self._dotasks(' '.join(args), inst, sync)
+        return self._dotargets(args, dst, inst, sync)
 
     # the optional parameters are ordered roughly according to the order
     # these appear in the underlying ping command
@@ -9487,6 +9544,7 @@ cdef class ScamperCtrl:
         :py:exc:`RuntimeError` exception.
 
         :param string dst: The destination IP address to probe
+            or an iterable of them, issued as a batch
         :param ScamperInst inst: The specific instance to issue command over
         :param int attempts: The number of probes to send
         :param int dport: The TCP/UDP destination port to use in probes
@@ -9519,6 +9577,7 @@ cdef class ScamperCtrl:
         :param bool sync: operate the measurement synchronously
             (the method returns when the measurement completes).
         :returns: a task object representing the ping
+            (a list of them if the dst is iterable)
         :rtype: ScamperTask
         """
 
@@ -9610,9 +9669,7 @@ cdef class ScamperCtrl:
             args.append(f"-W {wait_timeout.total_seconds()}s")
         if tos is not None:
             args.append(f"-z {tos}")
-        args.append(f"{dst}")
-
-        return self._dotasks(' '.join(args), inst, sync)
+        return self._dotargets(args, dst, inst, sync)
 
     def do_dns(self, qname, server=None, qclass=None, qtype=None,
                attempts=None, rd=None, wait_timeout=None, tcp=None,
@@ -9630,6 +9687,7 @@ cdef class ScamperCtrl:
         :py:exc:`RuntimeError` exception.
 
         :param string qname: The name to query
+            or an iterable of them, issued as a batch
         :param ScamperInst inst: The specific instance to issue command over
         :param string server: The DNS server to use
         :param string qclass: The query class to use
@@ -9644,6 +9702,7 @@ cdef class ScamperCtrl:
         :param bool sync: operate the measurement synchronously
             (the method returns when the measurement completes).
         :returns: a task object representing the DNS measurement
+            (a list of them if the qname is iterable)
         :rtype: ScamperTask or the completed measurement if sync=True
         """
 
@@ -9676,9 +9735,7 @@ cdef class ScamperCtrl:
             args.append("-O nsid")
         if ecs is not None:
             args.append(f"-O subnet={ecs}")
-        args.append(f"{qname}")
-
-        return self._dotasks(' '.join(args), inst, sync)
+        return self._dotargets(args, qname, inst, sync)
 
     def do_ally(self, dst1, dst2, fudge=None, icmp_sum=None, dport=None,
                 sport=None, method=None, attempts=None, wait_probe=None,
@@ -9787,10 +9844,12 @@ cdef class ScamperCtrl:
         measurement, it will raise a :py:exc:`RuntimeError` exception.
 
         :param string dst: the destination to probe
+            or an iterable of them, issued as a batch
         :param ScamperInst inst: The specific instance to issue command over
         :param bool sync: operate the measurement synchronously
             (the method returns when the measurement completes).
         :returns: a task object representing the mercator alias resolution
+            (a list of them if the dst is iterable)
         :rtype: ScamperTask
         """
 
@@ -9800,9 +9859,7 @@ cdef class ScamperCtrl:
 
         if userid is not None:
             args.append(f"-U {userid}")
-        args.append(f"{dst}")
-
-        return self._dotasks(' '.join(args), inst, sync)
+        return self._dotargets(args, dst, inst, sync)
 
     def do_midarest(self, rounds=None, wait_probe=None, wait_round=None,
                     wait_timeout=None, probedefs=None, addrs=None,
@@ -10246,6 +10303,7 @@ cdef class ScamperCtrl:
         it will raise a :py:exc:`RuntimeError` exception.
 
         :param string dst: the destination address to send the probe to
+            or an iterable of them, issued as a batch
         :param int dport: the destination port to send the probe to
         :param bytes payload: the payload to include in the probe
         :param int attempts: the number of probes to send
@@ -10255,7 +10313,8 @@ cdef class ScamperCtrl:
         :param int userid: the userid value to tag with this measurement
         :param bool sync: operate the measurement synchronously
             (the method returns when the measurement completes).
-        :returns: an object representing the UDP probe task.
+        :returns: an object representing the UDP probe task
+            (a list of them if the dst is iterable).
         :rtype: ScamperTask
         """
 
@@ -10278,9 +10337,7 @@ cdef class ScamperCtrl:
             args.append(f"-S {src}")
         if userid is not None:
             args.append(f"-U {userid}")
-        args.append(f"{dst}")
-
-        return self._dotasks(' '.join(args), inst, sync)
+        return self._dotargets(args, dst, inst, sync)
 
     def do_tbit(self, dst, method=None, url=None,
                 inst=None, userid=None, sync=False):
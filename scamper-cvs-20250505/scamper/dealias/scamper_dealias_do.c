@@ -2481,6 +2481,14 @@ static void do_dealias_probe(scamper_task_t *task)
     {
       probe.pr_len   = state->pds[def->id]->pktbuf_len;
       probe.pr_data  = txbuf;
+
+      /*
+       * zero the payload, rather than sending whatever was left in the
+       * shared txbuf.  only the first two bytes of the payload are set
+       * below, so the sum of the payload is those two bytes.
+       */
+      memset(probe.pr_data, 0, probe.pr_len);
+      probe.pr_flags |= SCAMPER_PROBE_FLAG_DATASUM;
     }
 
   if(SCAMPER_ADDR_TYPE_IS_IPV4(def->dst))
@@ -2505,8 +2513,10 @@ static void do_dealias_probe(scamper_task_t *task)
       /* hack to get the udp csum to be a particular value, and be valid */
       u16 = htons(dealias->probec + 1);
       memcpy(probe.pr_data, &u16, 2);
+      probe.pr_data_sum = u16;
       u16 = scamper_udp4_cksum(&probe);
       memcpy(probe.pr_data, &u16, 2);
+      probe.pr_data_sum = u16;
     }
   else if(SCAMPER_DEALIAS_PROBEDEF_PROTO_IS_ICMP(def))
     {
@@ -2515,8 +2525,10 @@ static void do_dealias_probe(scamper_task_t *task)
       /* hack to get the icmp csum to be a particular value, and be valid */
       u16 = htons(def->un.icmp.csum);
       memcpy(probe.pr_data, &u16, 2);
+      probe.pr_data_sum = u16;
       u16 = scamper_icmp4_cksum(&probe);
       memcpy(probe.pr_data, &u16, 2);
+      probe.pr_data_sum = u16;
     }
   else if(SCAMPER_DEALIAS_PROBEDEF_PROTO_IS_TCP(def))
     {
@@ -273,6 +273,15 @@ scamper_ping_t *scamper_ping_dup(const scamper_ping_t *in)
      (out->data = memdup(in->data, in->datalen)) == NULL)
     goto err;
 
+  if(in->tsps != NULL)
+    {
+      if((out->tsps = scamper_ping_v4ts_alloc(in->tsps->ipc)) == NULL)
+	goto err;
+      for(i=0; i<in->tsps->ipc; i++)
+	if(in->tsps->ips[i] != NULL)
+	  out->tsps->ips[i] = scamper_addr_use(in->tsps->ips[i]);
+    }
+
   if(in->ping_sent > 0)
     {
       if(scamper_ping_probes_alloc(out, in->ping_sent) != 0)
@@ -42,6 +42,20 @@
 
 #define SCAMPER_DO_PING_PATTERN_MAX       32
 
+/*
+ * ping_tmpl
+ *
+ * a ping parsed once, from which pings to other destinations of the
+ * same address family are made.  tcprand records whether the TCP
+ * sequence / acknowledgement value was chosen at random, so that each
+ * ping made from the template gets its own.
+ */
+typedef struct ping_tmpl
+{
+  scamper_ping_t *ping;
+  uint8_t         tcprand;
+} ping_tmpl_t;
+
 #define PING_OPT_PAYLOAD      1
 #define PING_OPT_ATTEMPTS     2
 #define PING_OPT_PROBEICMPSUM 3
@@ -390,13 +404,43 @@ static int ping_tsopt(scamper_ping_t *ping, uint32_t *flags, char *tsopt)
 }
 
 /*
- * scamper_do_ping_alloc
+ * ping_tcp_rand
+ *
+ * choose the random TCP sequence and acknowledgement values for the
+ * ping.  if tcprand is zero, the user supplied the value that goes in
+ * the sequence field for tcp-syn / tcp-rst probes, or the value that
+ * goes in the acknowledgement field for the other TCP probe methods.
+ */
+static int ping_tcp_rand(scamper_ping_t *ping, int tcprand)
+{
+  if(ping->method == SCAMPER_PING_METHOD_TCP_SYN ||
+     ping->method == SCAMPER_PING_METHOD_TCP_SYN_SPORT ||
+     ping->method == SCAMPER_PING_METHOD_TCP_RST)
+    {
+      if(tcprand != 0 && random_u32(&ping->tcpseq) != 0)
+	return -1;
+      ping->tcpack = 0;
+    }
+  else
+    {
+      if(tcprand != 0 && random_u32(&ping->tcpack) != 0)
+	return -1;
+      if(random_u32(&ping->tcpseq) != 0)
+	return -1;
+    }
+  return 0;
+}
+
+/*
+ * ping_alloc
  *
  * given a string representing a ping task, parse the parameters and assemble
  * a ping.  return the ping structure so that it is all ready to go.
- *
+ * if tcprand is not null, record whether the TCP seq/ack value was chosen
+ * at random.
  */
-void *scamper_do_ping_alloc(char *str, char *errbuf, size_t errlen)
+static scamper_ping_t *ping_alloc(char *str, uint8_t *tcprand,
+				  char *errbuf, size_t errlen)
 {
   scamper_option_out_t *opts_out = NULL, *opt;
   scamper_ping_t *ping = NULL;
@@ -941,32 +985,25 @@ void *scamper_do_ping_alloc(char *str, char *errbuf, size_t errlen)
 
   if(SCAMPER_PING_METHOD_IS_TCP(ping))
     {
-      if(A == 0 && random_u32(&probe_tcpack) != 0)
-	{
-	  snprintf(errbuf, errlen, "could not generate random tcp seq/ack val");
-	  goto err;
-	}
-
       if(ping->method == SCAMPER_PING_METHOD_TCP_SYN ||
 	 ping->method == SCAMPER_PING_METHOD_TCP_SYN_SPORT ||
 	 ping->method == SCAMPER_PING_METHOD_TCP_RST)
-	{
-	  ping->tcpseq = probe_tcpack;
-	  ping->tcpack = 0;
-	}
+	ping->tcpseq = probe_tcpack;
       else
+	ping->tcpack = probe_tcpack;
+
+      if(ping_tcp_rand(ping, A == 0) != 0)
 	{
-	  ping->tcpack = probe_tcpack;
-	  if(random_u32(&ping->tcpseq) != 0)
-	    {
-	      snprintf(errbuf, errlen, "could not generate random tcp seq val");
-	      goto err;
-	    }
+	  snprintf(errbuf, errlen, "could not generate random tcp seq/ack val");
+	  goto err;
 	}
 
       ping->tcpmss     = probe_mss;
     }
 
+  if(tcprand != NULL)
+    *tcprand = (A == 0) ? 1 : 0;
+
   return ping;
 
  err:
@@ -976,3 +1013,83 @@ void *scamper_do_ping_alloc(char *str, char *errbuf, size_t errlen)
   if(opts_out != NULL) scamper_options_free(opts_out);
   return NULL;
 }
+
+void *scamper_do_ping_alloc(char *str, char *errbuf, size_t errlen)
+{
+  return ping_alloc(str, NULL, errbuf, errlen);
+}
+
+void scamper_do_ping_tmpl_free(void *data)
+{
+  ping_tmpl_t *pt = data;
+  if(pt->ping != NULL) scamper_ping_free(pt->ping);
+  free(pt);
+  return;
+}
+
+/*
+ * scamper_do_ping_tmpl_alloc
+ *
+ * parse a ping command, including a destination address, into a
+ * template.  the destination determines the address family of pings
+ * made from the template.
+ */
+void *scamper_do_ping_tmpl_alloc(char *str, char *errbuf, size_t errlen)
+{
+  ping_tmpl_t *pt;
+
+  if((pt = malloc_zero(sizeof(ping_tmpl_t))) == NULL)
+    {
+      snprintf(errbuf, errlen, "could not alloc template");
+      return NULL;
+    }
+  if((pt->ping = ping_alloc(str, &pt->tcprand, errbuf, errlen)) == NULL)
+    {
+      scamper_do_ping_tmpl_free(pt);
+      return NULL;
+    }
+
+  return pt;
+}
+
+/*
+ * scamper_do_ping_tmpl_data
+ *
+ * make a ping to the supplied address from the template, without
+ * parsing and validating the ping options again.
+ */
+void *scamper_do_ping_tmpl_data(const void *data, const char *addr,
+				char *errbuf, size_t errlen)
+{
+  const ping_tmpl_t *pt = data;
+  scamper_ping_t *ping = NULL;
+  scamper_addr_t *dst = NULL;
+
+  if((dst = scamper_addr_fromstr(pt->ping->dst->type, addr)) == NULL)
+    {
+      snprintf(errbuf, errlen, "invalid destination address");
+      goto err;
+    }
+
+  if((ping = scamper_ping_dup(pt->ping)) == NULL)
+    {
+      snprintf(errbuf, errlen, "could not dup ping");
+      goto err;
+    }
+  scamper_addr_free(ping->dst);
+  ping->dst = dst; dst = NULL;
+
+  if(SCAMPER_PING_METHOD_IS_TCP(ping) &&
+     ping_tcp_rand(ping, pt->tcprand) != 0)
+    {
+      snprintf(errbuf, errlen, "could not generate random tcp seq/ack val");
+      goto err;
+    }
+
+  return ping;
+
+ err:
+  if(dst != NULL) scamper_addr_free(dst);
+  if(ping != NULL) scamper_ping_free(ping);
+  return NULL;
+}
@@ -30,4 +30,9 @@ int scamper_do_ping_arg_validate(int argc, char *argv[], int *stop,
 				 char *errbuf, size_t errlen);
 const char *scamper_do_ping_usage(void);
 
+void *scamper_do_ping_tmpl_alloc(char *str, char *errbuf, size_t errlen);
+void *scamper_do_ping_tmpl_data(const void *tmpl, const char *addr,
+				char *errbuf, size_t errlen);
+void scamper_do_ping_tmpl_free(void *tmpl);
+
 #endif /* __SCAMPER_PING_CMD_H */
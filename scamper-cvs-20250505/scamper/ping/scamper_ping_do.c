@@ -68,6 +68,7 @@ typedef struct ping_state
   uint16_t           seq;
   uint8_t           *payload;
   uint16_t           payload_len;
+  uint16_t           payload_sum;
 
   /* ip pre-specified timestamp options */
   struct in_addr     tsps_ips[4];
@@ -1222,6 +1223,13 @@ static int ping_state_payload(scamper_ping_t *ping, ping_state_t *state)
   if(state->payload_len > off)
     memset(state->payload+off, 0, state->payload_len-off);
 
+  /*
+   * the payload is the same in every probe, apart from the timestamp
+   * and the checksum scratch space, which are zero here.  sum it once
+   * so that each probe's checksum does not need to cover the payload.
+   */
+  state->payload_sum = in_cksum_add(0, state->payload, state->payload_len);
+
   return 0;
 }
 
@@ -1439,6 +1447,8 @@ static void do_ping_probe(scamper_task_t *task)
   probe.pr_ip_id     = ipid;
   probe.pr_data      = state->payload;
   probe.pr_len       = state->payload_len;
+  probe.pr_data_sum  = state->payload_sum;
+  probe.pr_flags    |= SCAMPER_PROBE_FLAG_DATASUM;
 
   if(ping->dst->type == SCAMPER_ADDR_TYPE_IPV4)
     probe.pr_ip_off  = IP_DF;
@@ -1485,20 +1495,30 @@ static void do_ping_probe(scamper_task_t *task)
 	  gettimeofday_wrap(&tv);
 	  bytes_htonl(state->payload,
 		      ((tv.tv_sec % 86400) * 1000) + (tv.tv_usec / 1000));
+	  probe.pr_data_sum = in_cksum_add(probe.pr_data_sum, state->payload, 4);
 	  i += 12;
 	}
 
       if(SCAMPER_PING_FLAG_IS_ICMPSUM(ping))
 	{
-	  probe.pr_icmp_sum = u16 = htons(ping->icmpsum);
+	  /*
+	   * compute the checksum with the scratch space zeroed, and then
+	   * the checksum with the requested checksum in the scratch space.
+	   * placing the latter in the scratch space gives the probe the
+	   * requested checksum.
+	   */
+	  probe.pr_icmp_sum = htons(ping->icmpsum);
 	  if(SCAMPER_PING_FLAG_IS_SPOOF(ping))
 	    i += 4;
-	  memcpy(state->payload+i, &u16, 2);
 	  if(SCAMPER_ADDR_TYPE_IS_IPV4(ping->dst))
 	    u16 = scamper_icmp4_cksum(&probe);
 	  else
 	    u16 = scamper_icmp6_cksum(&probe);
+	  if((u16 = in_cksum_update(u16, 0, probe.pr_icmp_sum)) == 0)
+	    u16 = 0xffff;
 	  memcpy(state->payload+i, &u16, 2);
+	  probe.pr_data_sum = in_cksum_add(probe.pr_data_sum,
+					   state->payload+i, 2);
 	}
 
       if(state->icmp != NULL)
@@ -48,6 +48,7 @@
 #include "scamper_sources.h"
 #include "scamper_source_cmdline.h"
 #include "scamper_source_file.h"
+#include "scamper_source_hitlist.h"
 #include "scamper_queue.h"
 #include "scamper_getsrc.h"
 #include "scamper_addr2mac.h"
@@ -59,6 +60,7 @@
 #include "scamper_udp4.h"
 #include "scamper_udp6.h"
 #include "scamper_tcp4.h"
+#include "scamper_tstamp.h"
 #include "scamper_rtsock.h"
 #include "scamper_firewall.h"
 #include "scamper_priv.h"
@@ -67,6 +69,10 @@
 #endif
 #include "scamper_control.h"
 #include "scamper_osinfo.h"
+#include "scamper_stats.h"
+#ifdef ENABLE_SCAMPER_SIMNET
+#include "scamper_simnet.h"
+#endif
 #ifndef DISABLE_SCAMPER_TRACE
 #include "trace/scamper_trace_cmd.h"
 #include "trace/scamper_trace_do.h"
@@ -163,6 +169,14 @@
 #if defined(__linux__) || defined(BIOCSETFNR)
 #define FLAG_DYNFILTER       0x00004000
 #endif
+#define FLAG_PACE            0x00008000
+#ifdef HAVE_SO_TIMESTAMPING
+#define FLAG_TSTAMP_HW       0x00010000
+#endif
+#ifdef HAVE_ZLIB
+#define FLAG_ZLIB_REMOTE     0x00020000
+#endif
+#define FLAG_SHUFFLE         0x00040000
 
 #define SCAMPER_OPTION_HOLDTIME_MIN  0
 #define SCAMPER_OPTION_HOLDTIME_DEF  5
@@ -170,6 +184,9 @@
 
 #define SCAMPER_OPTION_COMMAND_DEF   "trace"
 
+#define SCAMPER_OPTION_PACESPIN_MIN  0
+#define SCAMPER_OPTION_PACESPIN_MAX  10000
+
 /*
  * parameters configurable by the command line:
  *
@@ -181,6 +198,7 @@
  * outfile:     where to send results by default
  * outtype:     format to use when writing results to outfile
  * intype:      format of input file
+ * cycles:      number of cycles to make over a hitlist, zero for no limit
  * ctrl_inet_addr: address to use for control socket
  * ctrl_inet_port: port to use for control socket
  * ctrl_unix:   file to use for unix domain control
@@ -206,6 +224,7 @@ int           holdtime     = SCAMPER_OPTION_HOLDTIME_DEF;
 static char  *outfile      = "-";
 static char  *outtype      = NULL;
 static char  *intype       = NULL;
+static uint32_t cycles     = 1;
 static char  *ctrl_inet_addr = NULL;
 static uint16_t ctrl_inet_port = 0;
 static char  *ctrl_unix    = NULL;
@@ -241,10 +260,19 @@ static uid_t  euid;
  * wait_between:   calculated wait between probes to reach pps, in microseconds
  * probe_window:   maximum extension of probing window before truncation
  * exit_when_done: exit scamper when current window of tasks is completed
+ * pace_spin:      microseconds before a probe is due to busy-poll
+ * pace_fd:        timerfd used to wake up when the next probe is due
+ * pace_armed:     the time pace_fd is armed to go off
  */
 static int    wait_between   = 1000000 / SCAMPER_OPTION_PPS_DEF;
 static int    probe_window   = 250000;
 static int    exit_when_done = 1;
+static int    pace_spin      = 0;
+#ifdef HAVE_TIMERFD
+static int             pace_fd    = -1;
+static scamper_fd_t   *pace_fdn   = NULL;
+static struct timeval  pace_armed;
+#endif
 
 #ifdef HAVE_SIGACTION
 #define HAVE_EXIT_NOW
@@ -401,7 +429,12 @@ static void usage(uint32_t opt_mask)
       usage_line("warts.xz: output results in xz warts format");
 #endif
       usage_line("cmdfile: input file specifies whole commands");
+      usage_line("hitlist: input file is a large list of addresses/prefixes");
+      usage_line("hitlist-bin: input file is a list of packed IPv4 addresses");
+      usage_line("shuffle: probe a hitlist in a random order");
+      usage_line("cycles=n: probe a hitlist n times, 0 for no limit");
       usage_line("json: output results in json format, better to use warts");
+      usage_line("cols: output ping, trace, dealias results in columns");
       usage_line("planetlab: necessary to use safe raw sockets on planetlab");
       usage_line("noinitndc: do not initialise neighbour discovery cache");
       usage_line("rawtcp: use raw socket to send IPv4 TCP probes");
@@ -415,6 +448,9 @@ static void usage(uint32_t opt_mask)
       usage_line("client-certfile=file: use cert in file for remote auth");
       usage_line("client-privfile=file: use privkey in file for remote auth");
 #endif
+#ifdef FLAG_ZLIB_REMOTE
+      usage_line("zlib-remote: offer to compress results to remote controller");
+#endif
 #ifndef DISABLE_SCAMPER_SELECT
       usage_line("select: use select(2)");
 #endif
@@ -439,6 +475,11 @@ static void usage(uint32_t opt_mask)
 #ifdef FLAG_DYNFILTER
       usage_line("dyn-filter: use dynamic BPF filters on datalink interfaces");
 #endif
+#ifdef FLAG_TSTAMP_HW
+      usage_line("tstamp-hw: use NIC hardware timestamps when available");
+#endif
+      usage_line("pace: send probes evenly spaced, rather than in bursts");
+      usage_line("pace-spin=us: busy-poll for the last us before a probe");
     }
 
   if((opt_mask & OPT_PPS) != 0)
@@ -642,7 +683,8 @@ static int check_options(int argc, char *argv[])
   char *opt_ctrl_inet = NULL, *opt_ctrl_unix = NULL, *opt_monitorname = NULL;
   char *opt_pps = NULL, *opt_command = NULL, *opt_window = NULL;
   char *opt_firewall = NULL, *opt_pidfile = NULL, *opt_ctrl_remote = NULL;
-  char *opt_holdtime = NULL, *opt_nameserver = NULL;
+  char *opt_holdtime = NULL, *opt_nameserver = NULL, *opt_pace_spin = NULL;
+  char *opt_cycles = NULL;
 
 #ifdef HAVE_STRUCT_TPACKET_REQ3
   char *opt_ring_blocks = NULL, *opt_ring_block_size = NULL;
@@ -774,6 +816,8 @@ static int check_options(int argc, char *argv[])
 	    outtype = optarg;
 	  else if(strcasecmp(optarg, "json") == 0)
 	    outtype = optarg;
+	  else if(strcasecmp(optarg, "cols") == 0)
+	    outtype = optarg;
 #ifdef HAVE_ZLIB
 	  else if(strcasecmp(optarg, "warts.gz") == 0)
 	    outtype = optarg;
@@ -786,8 +830,14 @@ static int check_options(int argc, char *argv[])
 	  else if(strcasecmp(optarg, "warts.xz") == 0)
 	    outtype = optarg;
 #endif
-	  else if(strcasecmp(optarg, "cmdfile") == 0)
+	  else if(strcasecmp(optarg, "cmdfile") == 0 ||
+		  strcasecmp(optarg, "hitlist") == 0 ||
+		  strcasecmp(optarg, "hitlist-bin") == 0)
 	    intype = optarg;
+	  else if(strcasecmp(optarg, "shuffle") == 0)
+	    flags |= FLAG_SHUFFLE;
+	  else if(strncasecmp(optarg, "cycles=", 7) == 0)
+	    opt_cycles = optarg + 7;
 	  else if(strcasecmp(optarg, "planetlab") == 0)
 	    flags |= FLAG_PLANETLAB;
 	  else if(strcasecmp(optarg, "noinitndc") == 0)
@@ -803,6 +853,10 @@ static int check_options(int argc, char *argv[])
 	    flags |= FLAG_NOTLS_REMOTE;
 	  else if(strcasecmp(optarg, "notls") == 0)
 	    flags |= FLAG_NOTLS;
+#ifdef FLAG_ZLIB_REMOTE
+	  else if(strcasecmp(optarg, "zlib-remote") == 0)
+	    flags |= FLAG_ZLIB_REMOTE;
+#endif
 #ifndef DISABLE_SCAMPER_SELECT
 	  else if(strcasecmp(optarg, "select") == 0)
 	    flags |= FLAG_SELECT;
@@ -839,6 +893,17 @@ static int check_options(int argc, char *argv[])
 	  else if(strcasecmp(optarg, "dyn-filter") == 0)
 	    flags |= FLAG_DYNFILTER;
 #endif
+#ifdef FLAG_TSTAMP_HW
+	  else if(strcasecmp(optarg, "tstamp-hw") == 0)
+	    flags |= FLAG_TSTAMP_HW;
+#endif
+	  else if(strcasecmp(optarg, "pace") == 0)
+	    flags |= FLAG_PACE;
+	  else if(strncasecmp(optarg, "pace-spin=", 10) == 0)
+	    {
+	      flags |= FLAG_PACE;
+	      opt_pace_spin = optarg + 10;
+	    }
 #ifdef HAVE_STRUCT_TPACKET_REQ3
 	  else if(strcasecmp(optarg, "ring") == 0)
 	    flags |= FLAG_RING;
@@ -945,6 +1010,42 @@ static int check_options(int argc, char *argv[])
       return -1;
     }
 
+  if(flags & FLAG_PACE)
+    {
+      if(opt_pace_spin != NULL)
+	{
+	  if(string_tolong(opt_pace_spin, &lo) != 0 ||
+	     lo < SCAMPER_OPTION_PACESPIN_MIN ||
+	     lo > SCAMPER_OPTION_PACESPIN_MAX)
+	    {
+	      usage(OPT_OPTION);
+	      fprintf(stderr, "invalid pace-spin\n");
+	      return -1;
+	    }
+	  pace_spin = (int)lo;
+	}
+    }
+
+  if((flags & FLAG_SHUFFLE) || opt_cycles != NULL)
+    {
+      if(intype == NULL || strncasecmp(intype, "hitlist", 7) != 0)
+	{
+	  usage(OPT_OPTION);
+	  fprintf(stderr, "shuffle and cycles apply to a hitlist\n");
+	  return -1;
+	}
+      if(opt_cycles != NULL)
+	{
+	  if(string_tolong(opt_cycles, &lo) != 0 || lo < 0 || lo > 65535)
+	    {
+	      usage(OPT_OPTION);
+	      fprintf(stderr, "invalid cycles\n");
+	      return -1;
+	    }
+	  cycles = (uint32_t)lo;
+	}
+    }
+
   if(options & OPT_FIREWALL && (firewall = strdup(opt_firewall)) == NULL)
     {
       printerror(__func__, "could not strdup firewall");
@@ -1075,6 +1176,10 @@ static int check_options(int argc, char *argv[])
 	{
 	  outtype = "json";
 	}
+      else if(string_endswith(outfile, ".cols") != 0)
+	{
+	  outtype = "cols";
+	}
       else if(string_endswith(outfile, ".warts") != 0)
 	{
 	  outtype = "warts";
@@ -1086,7 +1191,8 @@ static int check_options(int argc, char *argv[])
     }
 
 #ifdef HAVE_ISATTY
-  if(strncasecmp(outtype, "warts", 5) == 0 && strcasecmp(outfile, "-") == 0 &&
+  if((strncasecmp(outtype, "warts", 5) == 0 ||
+      strcasecmp(outtype, "cols") == 0) && strcasecmp(outfile, "-") == 0 &&
      isatty(STDOUT_FILENO) != 0)
     {
       usage(OPT_OUTFILE);
@@ -1429,6 +1535,15 @@ int scamper_option_notls(void)
 #endif
 }
 
+int scamper_option_zlib_remote(void)
+{
+#ifdef FLAG_ZLIB_REMOTE
+  if(flags & FLAG_ZLIB_REMOTE)
+    return 1;
+#endif
+  return 0;
+}
+
 int scamper_option_daemon(void)
 {
   if(options & OPT_DAEMON) return 1;
@@ -1453,6 +1568,15 @@ int scamper_option_dynfilter(void)
   return 0;
 }
 
+int scamper_option_tstamp_hw(void)
+{
+#ifdef FLAG_TSTAMP_HW
+  if(flags & FLAG_TSTAMP_HW)
+    return 1;
+#endif
+  return 0;
+}
+
 #ifdef HAVE_STRUCT_TPACKET_REQ3
 int scamper_option_ring(void)
 {
@@ -1737,6 +1861,17 @@ static int scamper_timeout(struct timeval *timeout,
       set++;
     }
 
+  /*
+   * if a source is waiting for its pps cap to allow another task, then
+   * set the timer to go off when it may continue.
+   */
+  if(scamper_sources_waittime(&tv) > 0)
+    {
+      if(set == 0 || timeval_cmp(&tv, timeout) < 0)
+	timeval_cpy(timeout, &tv);
+      set++;
+    }
+
   /* nothing to probe, and been told to exit */
   if(set == 0 && exit_when_done != 0 && scamper_sources_isempty() != 0)
     return 2;
@@ -1752,6 +1887,16 @@ static int scamper_timeout(struct timeval *timeout,
       set++;
     }
 
+#ifdef ENABLE_SCAMPER_SIMNET
+  /* wake up when the simulated network has a response to deliver */
+  if(scamper_simnet_waittime(&tv) > 0)
+    {
+      if(set == 0 || timeval_cmp(&tv, timeout) < 0)
+	timeval_cpy(timeout, &tv);
+      set++;
+    }
+#endif
+
   /* no timeout value computed */
   if(set == 0)
     return 1;
@@ -1759,6 +1904,98 @@ static int scamper_timeout(struct timeval *timeout,
   return 0;
 }
 
+#ifdef HAVE_TIMERFD
+static void pace_read_cb(int fd, void *param)
+{
+  uint64_t expirations;
+  if(read(fd, &expirations, sizeof(expirations)) == -1 &&
+     errno != EAGAIN && errno != EINTR)
+    printerror(__func__, "could not read timerfd");
+  return;
+}
+
+static int pace_init(void)
+{
+  if((pace_fd = timerfd_create(CLOCK_REALTIME,
+			       TFD_NONBLOCK | TFD_CLOEXEC)) == -1)
+    {
+      printerror(__func__, "could not create timerfd");
+      return -1;
+    }
+  if((pace_fdn = scamper_fd_private(pace_fd,NULL,pace_read_cb,NULL)) == NULL)
+    return -1;
+  return 0;
+}
+#endif
+
+/*
+ * pace_from
+ *
+ * when pacing, time lost to a late wakeup is made up by sending probes
+ * half a gap apart, rather than in a burst.  return the time to count
+ * the gap to the next probe from: the time the last probe was due,
+ * unless that would put the next probe less than half a gap after the
+ * last probe was actually sent.
+ */
+static void pace_from(struct timeval *from, const struct timeval *lastprobe,
+		      const struct timeval *lasttx)
+{
+  timeval_sub_us(from, lasttx, wait_between / 2);
+  if(timeval_cmp(from, lastprobe) < 0)
+    timeval_cpy(from, lastprobe);
+  return;
+}
+
+/*
+ * pace_timeout
+ *
+ * adjust the relative timeout passed to poll so that scamper wakes up
+ * when the next timeout is due, rather than when the next millisecond
+ * boundary after it is.  if the timeout is within pace_spin microseconds,
+ * poll without blocking so that scamper busy-waits until it is due.
+ */
+static void pace_timeout(const struct timeval *timeout, struct timeval *tv)
+{
+#ifdef HAVE_TIMERFD
+  struct itimerspec its;
+  struct timeval arm;
+#endif
+
+  if(tv->tv_sec == 0 && tv->tv_usec <= pace_spin)
+    {
+      memset(tv, 0, sizeof(struct timeval));
+      return;
+    }
+
+#ifdef HAVE_TIMERFD
+  if(pace_fd != -1)
+    {
+      /* the timerfd wakes scamper, the poll timeout is a backstop */
+      timeval_sub_us(&arm, timeout, pace_spin);
+      if(timeval_cmp(&arm, &pace_armed) != 0)
+	{
+	  memset(&its, 0, sizeof(its));
+	  its.it_value.tv_sec = arm.tv_sec;
+	  its.it_value.tv_nsec = arm.tv_usec * 1000;
+	  if(timerfd_settime(pace_fd, TFD_TIMER_ABSTIME, &its, NULL) != 0)
+	    printerror(__func__, "could not set timerfd");
+	  else
+	    timeval_cpy(&pace_armed, &arm);
+	}
+      timeval_add_ms(tv, tv, 1);
+      return;
+    }
+#endif
+
+  /*
+   * poll and epoll round the timeout down to milliseconds, so return
+   * early enough that the remainder is spent in a busy-wait.
+   */
+  timeval_sub_us(tv, tv, pace_spin);
+  tv->tv_usec -= (tv->tv_usec % 1000);
+  return;
+}
+
 /*
  * scamper_process_done:
  *
@@ -1805,6 +2042,9 @@ static void cleanup(void)
   scamper_icmp6_cleanup();
   scamper_udp4_cleanup();
   scamper_tcp4_cleanup();
+#ifndef _WIN32 /* windows does not have msghdr struct */
+  scamper_tstamp_cleanup();
+#endif
 
   scamper_addr2mac_cleanup();
   scamper_ifname_int_cleanup();
@@ -1857,8 +2097,29 @@ static void cleanup(void)
     }
 #endif
 
+#ifdef HAVE_TIMERFD
+  if(pace_fdn != NULL)
+    {
+      scamper_fd_free(pace_fdn);
+      pace_fdn = NULL;
+    }
+  if(pace_fd != -1)
+    {
+      close(pace_fd);
+      pace_fd = -1;
+    }
+#endif
+
+#ifdef ENABLE_SCAMPER_SIMNET
+  scamper_simnet_stats_print();
+#endif
+
   scamper_fds_cleanup();
 
+#ifdef ENABLE_SCAMPER_SIMNET
+  scamper_simnet_cleanup();
+#endif
+
 #ifndef DISABLE_SCAMPER_PRIVSEP
   scamper_privsep_cleanup();
 #endif
@@ -1905,6 +2166,7 @@ static void cleanup(void)
       free(command);
       command = NULL;
     }
+  scamper_stats_cleanup();
   scamper_queue_cleanup();
   scamper_task_cleanup();
   scamper_probe_cleanup();
@@ -1972,6 +2234,7 @@ static int scamper(int argc, char *argv[])
   struct timeval           tv;
   struct timeval           lastprobe;
   struct timeval           nextprobe;
+  struct timeval           lasttx, from;
   struct timeval           timeout, *timeout_ptr;
   scamper_source_params_t  ssp;
   scamper_source_t        *source = NULL;
@@ -2201,10 +2464,20 @@ static int scamper(int argc, char *argv[])
   if(scamper_queue_init() == -1)
     goto done;
 
+  /* start collecting statistics on scamper's operation */
+  if(scamper_stats_init() != 0)
+    goto done;
+
   /* setup the file descriptor monitoring code */
   if(scamper_fds_init() == -1)
     goto done;
 
+#ifdef ENABLE_SCAMPER_SIMNET
+  /* setup the simulated network that replaces raw sockets */
+  if(scamper_simnet_init() != 0)
+    goto done;
+#endif
+
   /* initialise the subsystem responsible for obtaining source addresses */
   if(scamper_getsrc_init() == -1)
     goto done;
@@ -2343,6 +2616,17 @@ static int scamper(int argc, char *argv[])
 	source = scamper_source_file_alloc(&ssp, arglist[0], command);
       else if(strcasecmp(intype, "cmdfile") == 0)
 	source = scamper_source_file_alloc(&ssp, arglist[0], NULL);
+      else
+	{
+	  if(strcasecmp(intype, "hitlist-bin") == 0)
+	    x = SCAMPER_SOURCE_HITLIST_FLAG_BINARY;
+	  else
+	    x = 0;
+	  if(flags & FLAG_SHUFFLE)
+	    x |= SCAMPER_SOURCE_HITLIST_FLAG_SHUFFLE;
+	  source = scamper_source_hitlist_alloc(&ssp, arglist[0], command,
+						(uint8_t)x, cycles);
+	}
       if(source == NULL)
 	goto done;
     }
@@ -2363,13 +2647,24 @@ static int scamper(int argc, char *argv[])
     }
 #endif
 
+#ifdef HAVE_TIMERFD
+  if((flags & FLAG_PACE) && pace_init() != 0)
+    goto done;
+#endif
+
   gettimeofday_wrap(&lastprobe);
+  timeval_cpy(&lasttx, &lastprobe);
 
   for(;;)
     {
       scamper_process_done();
 
-      if((x = scamper_timeout(&timeout, &lastprobe)) == 0)
+      if(flags & FLAG_PACE)
+	pace_from(&from, &lastprobe, &lasttx);
+      else
+	timeval_cpy(&from, &lastprobe);
+
+      if((x = scamper_timeout(&timeout, &from)) == 0)
 	{
 	  /*
 	   * we've been told to calculate a timeout value.  figure out what
@@ -2380,6 +2675,8 @@ static int scamper(int argc, char *argv[])
 	    memset(&tv, 0, sizeof(tv));
 	  else
 	    timeval_diff_tv(&tv, &tv, &timeout);
+	  if(flags & FLAG_PACE)
+	    pace_timeout(&timeout, &tv);
 	  timeout_ptr = &tv;
 	}
       else if(x == 1)
@@ -2401,11 +2698,17 @@ static int scamper(int argc, char *argv[])
 #endif
 
       /* listen until it is time to send the next probe */
+      scamper_stats_poll_enter();
       if(scamper_fds_poll(timeout_ptr) == -1)
 	goto done;
 
       /* get the current time */
       gettimeofday_wrap(&tv);
+      scamper_stats_poll_exit(&tv);
+
+#ifdef ENABLE_SCAMPER_SIMNET
+      scamper_simnet_run(&tv);
+#endif
 
       if(scamper_queue_event_proc(&tv) != 0)
 	goto done;
@@ -2436,7 +2739,11 @@ static int scamper(int argc, char *argv[])
 	   */
 	  for(;;)
 	    {
-	      timeval_add_us(&nextprobe, &lastprobe, wait_between);
+	      if(flags & FLAG_PACE)
+		pace_from(&from, &lastprobe, &lasttx);
+	      else
+		timeval_cpy(&from, &lastprobe);
+	      timeval_add_us(&nextprobe, &from, wait_between);
 
 	      /* if the next probe is not due to be sent, don't send one */
 	      if(timeval_cmp(&nextprobe, &tv) > 0)
@@ -2465,8 +2772,15 @@ static int scamper(int argc, char *argv[])
 		    break;
 		}
 
+	      /* when pacing, the next probe is timed from this one */
+	      if(flags & FLAG_PACE)
+		timeval_cpy(&lasttx, &tv);
+
 	      scamper_task_probe(task);
-	      timeval_cpy(&lastprobe, &nextprobe);
+	      timeval_add_us(&lastprobe, &lastprobe, wait_between);
+
+	      if(flags & FLAG_PACE)
+		gettimeofday_wrap(&tv);
 	    }
 	}
     }
@@ -58,6 +58,7 @@ int scamper_option_pollfunc_get(void);
 int scamper_option_planetlab(void);
 int scamper_option_noinitndc(void);
 int scamper_option_notls(void);
+int scamper_option_zlib_remote(void);
 int scamper_option_rawtcp(void);
 int scamper_option_icmp_rxerr(void);
 int scamper_option_debugfileappend(void);
@@ -70,6 +71,7 @@ int scamper_option_ring_locked(void);
 
 int scamper_option_dlany(void);
 int scamper_option_dynfilter(void);
+int scamper_option_tstamp_hw(void);
 
 void scamper_exitwhendone(int on);
 
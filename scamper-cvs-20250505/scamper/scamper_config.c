@@ -133,13 +133,127 @@ static int host_cb(const char *key_in, char *val, scamper_config_t *cf)
   return rc < 0 ? rc : 0;
 }
 
+static int check_num(const char *key_in, const char *val,
+		     long min, long max, long *out)
+{
+  if(string_tolong(val, out) != 0 || *out < min || *out > max)
+    {
+      printerror_msg(__func__, "%s: expected value between %ld and %ld",
+		     key_in, min, max);
+      return -1;
+    }
+  return 0;
+}
+
+static int simnet_cb(const char *key_in, char *val, scamper_config_t *cf)
+{
+  const char *key = key_in + 7;
+  long lo;
+
+  if(strcasecmp(key, "seed") == 0)
+    {
+      if(check_num(key_in, val, 0, 0x7fffffffL, &lo) != 0)
+	return -1;
+      cf->simnet_seed = (uint32_t)lo;
+    }
+  else if(strcasecmp(key, "hops-min") == 0)
+    {
+      if(check_num(key_in, val, 1, 255, &lo) != 0)
+	return -1;
+      cf->simnet_hops_min = (uint8_t)lo;
+    }
+  else if(strcasecmp(key, "hops-max") == 0)
+    {
+      if(check_num(key_in, val, 1, 255, &lo) != 0)
+	return -1;
+      cf->simnet_hops_max = (uint8_t)lo;
+    }
+  else if(strcasecmp(key, "hop-rtt") == 0)
+    {
+      if(check_num(key_in, val, 0, 1000000, &lo) != 0)
+	return -1;
+      cf->simnet_hop_rtt = (uint32_t)lo;
+    }
+  else if(strcasecmp(key, "loss") == 0)
+    {
+      if(check_num(key_in, val, 0, 100, &lo) != 0)
+	return -1;
+      cf->simnet_loss = (uint8_t)lo;
+    }
+  else if(strcasecmp(key, "dst-resp") == 0)
+    {
+      if(check_num(key_in, val, 0, 100, &lo) != 0)
+	return -1;
+      cf->simnet_dst_resp = (uint8_t)lo;
+    }
+  else if(strcasecmp(key, "hop-resp") == 0)
+    {
+      if(check_num(key_in, val, 0, 100, &lo) != 0)
+	return -1;
+      cf->simnet_hop_resp = (uint8_t)lo;
+    }
+  else if(strcasecmp(key, "ratelimit") == 0)
+    {
+      if(check_num(key_in, val, 0, 1000000, &lo) != 0)
+	return -1;
+      cf->simnet_ratelimit = (uint32_t)lo;
+    }
+  else if(strcasecmp(key, "lb-pct") == 0)
+    {
+      if(check_num(key_in, val, 0, 100, &lo) != 0)
+	return -1;
+      cf->simnet_lb_pct = (uint8_t)lo;
+    }
+  else if(strcasecmp(key, "lb-width") == 0)
+    {
+      if(check_num(key_in, val, 1, 16, &lo) != 0)
+	return -1;
+      cf->simnet_lb_width = (uint8_t)lo;
+    }
+
+  return 0;
+}
+
+static int control_cb(const char *key_in, char *val, scamper_config_t *cf)
+{
+  const char *key = key_in + 8;
+  long lo;
+
+  if(strcasecmp(key, "budget") == 0)
+    {
+      if(check_num(key_in, val, 0, 0x7fffffffL, &lo) != 0)
+	return -1;
+      cf->control_budget = (uint32_t)lo;
+    }
+
+  return 0;
+}
+
+static int stats_cb(const char *key_in, char *val, scamper_config_t *cf)
+{
+  const char *key = key_in + 6;
+  long lo;
+
+  if(strcasecmp(key, "interval") == 0)
+    {
+      if(check_num(key_in, val, 0, 86400, &lo) != 0)
+	return -1;
+      cf->stats_interval = (uint32_t)lo;
+    }
+
+  return 0;
+}
+
 static int config_line(char *line, void *param)
 {
   conf_cb_t cbs[] = {
+    {"control.",  8, control_cb},
     {"dealias.",  8, dealias_cb},
     {"host.",     5, host_cb},
     {"http.",     5, http_cb},
     {"ping.",     5, ping_cb},
+    {"simnet.",   7, simnet_cb},
+    {"stats.",    6, stats_cb},
     {"sting.",    6, sting_cb},
     {"tbit.",     5, tbit_cb},
     {"trace.",    6, trace_cb},
@@ -262,6 +376,15 @@ int scamper_config_init(const char *filename)
   cf->http_enable = 1;
   cf->host_enable = 1;
 
+  cf->simnet_seed = 1;
+  cf->simnet_hops_min = 6;
+  cf->simnet_hops_max = 20;
+  cf->simnet_hop_rtt = 2000;
+  cf->simnet_dst_resp = 90;
+  cf->simnet_hop_resp = 95;
+  cf->simnet_lb_pct = 10;
+  cf->simnet_lb_width = 2;
+
   if(filename != NULL && file_lines(filename, config_line, cf) != 0)
     goto err;
 
@@ -38,6 +38,24 @@ typedef struct scamper_config
   uint8_t   trace_enable;
   uint8_t   tracelb_enable;
   uint8_t   udpprobe_enable;
+
+  /* how often to emit a line of JSON statistics, in seconds */
+  uint32_t  stats_interval;
+
+  /* bytes of results an attached control client may have queued */
+  uint32_t  control_budget;
+
+  /* parameters of the simulated network, if compiled in */
+  uint32_t  simnet_seed;
+  uint8_t   simnet_hops_min;
+  uint8_t   simnet_hops_max;
+  uint32_t  simnet_hop_rtt;
+  uint8_t   simnet_loss;
+  uint8_t   simnet_dst_resp;
+  uint8_t   simnet_hop_resp;
+  uint32_t  simnet_ratelimit;
+  uint8_t   simnet_lb_pct;
+  uint8_t   simnet_lb_width;
 } scamper_config_t;
 
 int scamper_config_read(const char *filename);
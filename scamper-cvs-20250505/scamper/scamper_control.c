@@ -31,6 +31,7 @@
 #include "internal.h"
 
 #include "scamper.h"
+#include "scamper_config.h"
 #include "scamper_control.h"
 #include "scamper_debug.h"
 #include "scamper_fds.h"
@@ -43,8 +44,10 @@
 #include "scamper_queue.h"
 #include "scamper_sources.h"
 #include "scamper_source_file.h"
+#include "scamper_source_hitlist.h"
 #include "scamper_source_control.h"
 #include "scamper_priv.h"
+#include "scamper_stats.h"
 #include "mjl_list.h"
 #include "utils.h"
 
@@ -67,6 +70,77 @@
 
 #define REMOTE_HDRLEN 10
 
+/*
+ * a local client may ask for results to be written into a ring in
+ * shared memory rather than uuencoded over its socket.  this needs a
+ * memfd to share and eventfds to signal through.
+ */
+#if defined(HAVE_MEMFD_CREATE) && defined(HAVE_SYS_EVENTFD_H) && \
+  defined(HAVE_MMAP) && defined(MFD_CLOEXEC)
+#define CONTROL_RING
+#endif
+
+#define CONTROL_RING_MIN     (1 << 20)
+#define CONTROL_RING_MAX     (1 << 30)
+
+#ifdef CONTROL_RING
+/*
+ * control_ring_hdr_t
+ *
+ * the header at the start of a result ring shared with a local client.
+ * libscamperctrl has its own copy of this layout, so the two must change
+ * together.  head is only written by scamper and tail only by the client,
+ * and each is in its own cache line.  rwait is set by a client that is
+ * about to sleep on the data eventfd, and wwait by scamper when the ring
+ * is full and it wants to be told through the space eventfd when there
+ * is room.
+ *
+ * each record in the data area starts with a 32-bit length and a 32-bit
+ * task id (zero if the object has none), and is padded to eight bytes.
+ * a record is never split across the end of the ring: a length of
+ * CONTROL_RING_WRAP says the next record is at the start of the ring.
+ */
+typedef struct control_ring_hdr
+{
+  uint32_t            magic;
+  uint32_t            version;
+  uint64_t            size;
+  uint8_t             pad0[48];
+  uint64_t            head;
+  uint8_t             pad1[56];
+  uint64_t            tail;
+  uint8_t             pad2[56];
+  uint32_t            rwait;
+  uint32_t            wwait;
+  uint8_t             pad3[56];
+} control_ring_hdr_t;
+
+/*
+ * client_ring_t
+ *
+ * hdr:     the shared mapping, starting with the header
+ * data:    the data area following the header
+ * size:    the size of the data area, a power of two
+ * datafd:  eventfd to wake a client waiting for data
+ * spacefd: eventfd the client uses to wake us when there is room
+ * fdn:     scamper_fd_t monitoring spacefd
+ */
+typedef struct client_ring
+{
+  control_ring_hdr_t *hdr;
+  uint8_t            *data;
+  uint64_t            size;
+  int                 datafd;
+  int                 spacefd;
+  scamper_fd_t       *fdn;
+} client_ring_t;
+
+#define CONTROL_RING_MAGIC   0x53435247
+#define CONTROL_RING_VERSION 1
+#define CONTROL_RING_WRAP    0xFFFFFFFF
+#define CONTROL_RING_RECLEN(len) ((8 + (uint64_t)(len) + 7) & ~((uint64_t)7))
+#endif
+
 /*
  * client_obj_t
  *
@@ -161,6 +235,13 @@ typedef struct control_remote
   SSL                *ssl;
   BIO                *ssl_rbio;
   BIO                *ssl_wbio;
+  uint8_t             ssl_txbuf[TLS_RECORD_LEN];
+  size_t              ssl_txoff;
+#endif
+
+#ifdef HAVE_ZLIB
+  z_stream           *zs;          /* compresses channel messages */
+  int                 zlib;        /* remoted agreed to compression */
 #endif
 } control_remote_t;
 
@@ -225,6 +306,9 @@ typedef struct client
    *  sof_obj:    current object partially written over socket.
    *  sof_off:    offset into current object being written.
    *  sof_format: the format (warts/json) of results being sent to clients
+   *  sof_bytes:  the number of bytes of results generated for the client
+   *  sof_qbytes: the number of bytes of results not yet sent to the client
+   *  sof_budget: the sof_qbytes at which the client's source is paused
    */
   scamper_source_t   *source;
   scamper_outfile_t  *sof;
@@ -232,6 +316,30 @@ typedef struct client
   client_obj_t       *sof_obj;
   size_t              sof_off;
   uint8_t             sof_format;
+  uint64_t            sof_bytes;
+  uint64_t            sof_qbytes;
+  uint64_t            sof_budget;
+
+#ifdef CONTROL_RING
+  /* shared memory ring the results are written into, if any */
+  client_ring_t      *ring;
+#endif
+
+  /*
+   * the next set of variables are used when the client supplies a
+   * block of commands with the batch command.
+   *
+   *  batch_left: the number of commands in the batch still to come.
+   *  batch_i:    the index of the next command in the batch.
+   *  batch_ok:   the number of commands in the batch accepted so far.
+   *  batch_id:   the id assigned to the first accepted command.
+   *  batch_more: a MORE is to be sent once the batch is acknowledged.
+   */
+  uint32_t            batch_left;
+  uint32_t            batch_i;
+  uint32_t            batch_ok;
+  uint32_t            batch_id;
+  uint8_t             batch_more;
 } client_t;
 
 #define CLIENT_MODE_INTERACTIVE 0
@@ -246,6 +354,8 @@ typedef struct client
 
 #define CLIENT_OBJ_FLAG_ID      0x01
 
+#define CLIENT_BATCH_MAX        65535
+
 #define REMOTE_MODE_CONNECT     0
 #define REMOTE_MODE_GO          1
 
@@ -272,6 +382,8 @@ static dlist_t *remote_list = NULL;
 static control_unix_t *ctrl_unix = NULL;
 static control_inet_t *ctrl_inet = NULL;
 
+extern scamper_config_t *config;
+
 #ifdef HAVE_OPENSSL
 extern SSL_CTX *remote_tls_ctx;
 #endif
@@ -286,6 +398,8 @@ extern SSL_CTX *remote_tls_ctx;
 #define CONTROL_MASTER_REJ   7 /* scamper <-- remoted */
 #define CONTROL_MASTER_OK    8 /* scamper <-- remoted */
 
+#define CONTROL_OPT_ZLIB     0x01 /* compress channel messages */
+
 /* forward declare remote_reconnect so that it may be used throughout */
 static int remote_reconnect(void *param);
 static int remote_tx_ka(void *param);
@@ -441,6 +555,22 @@ static char *client_sockaddr_tostr(client_t *client, char *buf, size_t len)
   return buf;
 }
 
+#ifdef CONTROL_RING
+static void client_ring_free(client_ring_t *ring)
+{
+  if(ring->fdn != NULL)
+    scamper_fd_free(ring->fdn);
+  if(ring->spacefd != -1)
+    close(ring->spacefd);
+  if(ring->datafd != -1)
+    close(ring->datafd);
+  if(ring->hdr != NULL)
+    munmap(ring->hdr, sizeof(control_ring_hdr_t) + ring->size);
+  free(ring);
+  return;
+}
+#endif
+
 /*
  * client_free
  *
@@ -524,6 +654,14 @@ static void client_free(client_t *client)
       client->sof_objs = NULL;
     }
 
+#ifdef CONTROL_RING
+  if(client->ring != NULL)
+    {
+      client_ring_free(client->ring);
+      client->ring = NULL;
+    }
+#endif
+
   if(client->txt != NULL)
     {
       slist_free_cb(client->txt, (slist_free_t)client_txt_free);
@@ -549,19 +687,18 @@ static int client_send(client_t *client, char *fs, ...)
 
   va_start(ap, fs);
   len = vsnprintf(msg, sizeof(msg), fs, ap);
+  va_end(ap);
   ret = (int)len;
   if(len < size)
     {
-      va_end(ap);
       str = msg;
     }
   else
     {
+      /* the va_list was consumed by the first call, so restart it */
       if((str = malloc_zero((size_t)(len+1))) == NULL)
-	{
-	  va_end(ap);
-	  goto err;
-	}
+	goto err;
+      va_start(ap, fs);
       vsnprintf(str, len+1, fs, ap);
       va_end(ap);
     }
@@ -698,7 +835,9 @@ static char *source_tostr(char *str, const size_t len,
 			  const scamper_source_t *source)
 {
   const char *ptr;
-  char descr[256], outfile[256], type[512];
+  char descr[256], outfile[256], type[512], limits[64];
+  size_t off;
+  uint32_t u32;
   int i;
 
   /* format type-specific data */
@@ -718,6 +857,12 @@ static char *source_tostr(char *str, const size_t len,
       snprintf(type, sizeof(type), "type 'control'");
       break;
 
+    case SCAMPER_SOURCE_TYPE_HITLIST:
+      snprintf(type, sizeof(type),
+	       "type 'hitlist' file '%s'",
+	       scamper_source_hitlist_getfilename(source));
+      break;
+
     default:
       printerror_msg(__func__, "unknown source type %d", i);
       return NULL;
@@ -735,19 +880,312 @@ static char *source_tostr(char *str, const size_t len,
   else
     outfile[0] = '\0';
 
+  /* per-source limits */
+  limits[0] = '\0'; off = 0;
+  if((u32 = scamper_source_getpps(source)) != 0)
+    string_concaf(limits, sizeof(limits), &off, " pps %u", u32);
+  if((u32 = scamper_source_getwindow(source)) != 0)
+    string_concaf(limits, sizeof(limits), &off, " window %u", u32);
+
   snprintf(str, len,
-	   "name '%s'%s list_id %u cycle_id %u priority %u%s %s",
+	   "name '%s'%s list_id %u cycle_id %u priority %u%s%s %s",
 	   scamper_source_getname(source),
 	   descr,
 	   scamper_source_getlistid(source),
 	   scamper_source_getcycleid(source),
 	   scamper_source_getpriority(source),
+	   limits,
 	   outfile,
 	   type);
 
   return str;
 }
 
+/*
+ * client_backlog_check
+ *
+ * when the results waiting to be sent to the client exceed its budget,
+ * stop offering tasks from the client's source so that a client that
+ * reads slowly does not grow scamper's memory without bound.  resume
+ * once the backlog has drained to half the budget.
+ */
+static void client_backlog_check(client_t *client)
+{
+  if(client->sof_budget == 0 || client->source == NULL)
+    return;
+
+  if(scamper_source_ispaused(client->source) == 0)
+    {
+      if(client->sof_qbytes > client->sof_budget)
+	{
+	  scamper_debug(__func__, "pause %s, backlog %llu",
+			scamper_source_getname(client->source),
+			(unsigned long long)client->sof_qbytes);
+	  scamper_source_pause(client->source);
+	}
+    }
+  else if(client->sof_qbytes <= client->sof_budget / 2)
+    {
+      scamper_debug(__func__, "resume %s, backlog %llu",
+		    scamper_source_getname(client->source),
+		    (unsigned long long)client->sof_qbytes);
+      scamper_source_resume(client->source);
+    }
+
+  return;
+}
+
+#ifdef CONTROL_RING
+/*
+ * client_ring_fits
+ *
+ * records are never split across the end of the ring, so a record that
+ * needs more than half the ring might never find contiguous room.  such
+ * objects are sent over the socket instead.
+ */
+static int client_ring_fits(const client_ring_t *ring, size_t len)
+{
+  if(len > UINT32_MAX - 8 || CONTROL_RING_RECLEN(len) > ring->size / 2)
+    return 0;
+  return 1;
+}
+
+/*
+ * client_ring_push
+ *
+ * copy an object into the ring and wake the client if it is waiting.
+ * returns -1 if there is not currently room, in which case the client
+ * has been asked to signal the space eventfd once it has made some.
+ */
+static int client_ring_push(client_ring_t *ring, const void *data,
+			    size_t len, uint32_t id)
+{
+  control_ring_hdr_t *hdr = ring->hdr;
+  uint64_t head, tail, off, need, pad = 0, one = 1;
+  uint32_t *rec;
+
+  need = CONTROL_RING_RECLEN(len);
+  head = hdr->head;
+  off = head & (ring->size - 1);
+  if(off + need > ring->size)
+    pad = ring->size - off;
+
+  tail = __atomic_load_n(&hdr->tail, __ATOMIC_ACQUIRE);
+  if(head + pad + need - tail > ring->size)
+    {
+      __atomic_store_n(&hdr->wwait, 1, __ATOMIC_RELAXED);
+      __atomic_thread_fence(__ATOMIC_SEQ_CST);
+      tail = __atomic_load_n(&hdr->tail, __ATOMIC_ACQUIRE);
+      if(head + pad + need - tail > ring->size)
+	return -1;
+      __atomic_store_n(&hdr->wwait, 0, __ATOMIC_RELAXED);
+    }
+
+  if(pad != 0)
+    {
+      rec = (uint32_t *)(ring->data + off);
+      rec[0] = CONTROL_RING_WRAP;
+      head += pad;
+      off = 0;
+    }
+
+  rec = (uint32_t *)(ring->data + off);
+  rec[0] = (uint32_t)len;
+  rec[1] = id;
+  memcpy(rec + 2, data, len);
+  __atomic_store_n(&hdr->head, head + need, __ATOMIC_RELEASE);
+
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if(__atomic_load_n(&hdr->rwait, __ATOMIC_RELAXED) != 0)
+    {
+      __atomic_store_n(&hdr->rwait, 0, __ATOMIC_RELAXED);
+      if(write(ring->datafd, &one, sizeof(one)) == -1 && errno != EAGAIN)
+	printerror(__func__, "could not signal client");
+    }
+
+  return 0;
+}
+
+/*
+ * client_ring_drain
+ *
+ * move as many queued objects into the ring as will fit.  if the next
+ * object has to go over the socket, or the client has been told it is
+ * finished, then let client_write deal with it.
+ */
+static void client_ring_drain(client_t *client)
+{
+  client_ring_t *ring = client->ring;
+  client_obj_t *o;
+  uint32_t id;
+  int sock = 0;
+
+  while((o = slist_head_item(client->sof_objs)) != NULL)
+    {
+      if(client_ring_fits(ring, o->len) == 0)
+	{
+	  sock = 1;
+	  break;
+	}
+      id = (o->flags & CLIENT_OBJ_FLAG_ID) ? o->id : 0;
+      if(client_ring_push(ring, o->data, o->len, id) != 0)
+	break;
+      slist_head_pop(client->sof_objs);
+      client->sof_qbytes -= o->len;
+      client_obj_free(o);
+    }
+  client_backlog_check(client);
+
+  if((sock != 0 || client->mode == CLIENT_MODE_FLUSH) &&
+     client->un.sock.fdn != NULL)
+    scamper_fd_write_unpause(client->un.sock.fdn);
+
+  return;
+}
+
+static void client_ring_space(const int fd, client_t *client)
+{
+  uint64_t u64;
+  if(read(fd, &u64, sizeof(u64)) == -1 && errno != EAGAIN && errno != EINTR)
+    printerror(__func__, "could not read eventfd");
+  client_ring_drain(client);
+  return;
+}
+
+/*
+ * client_ring_attach
+ *
+ * create a ring for a client connected over a local socket, and pass
+ * the memfd and the two eventfds to it with the OK that acknowledges
+ * the attach.  the memfd is sealed so that the client cannot shrink it
+ * out from under us.  if anything goes wrong, the client is left using
+ * the socket, and the caller sends an ordinary OK.
+ */
+static int client_ring_attach(client_t *client, size_t size)
+{
+  control_ring_hdr_t *hdr;
+  client_ring_t *ring = NULL;
+  struct msghdr msg;
+  struct cmsghdr *cmsg;
+  struct iovec iov;
+  union {
+    struct cmsghdr hdr;
+    uint8_t        buf[CMSG_SPACE(sizeof(int) * 3)];
+  } cbuf;
+  char str[32];
+  int fds[3], memfd = -1, fd;
+  size_t len;
+  ssize_t rc;
+
+  if(client->type != CLIENT_TYPE_SOCKET ||
+     client->un.sock.sa->sa_family != AF_UNIX ||
+     scamper_writebuf_len(client->un.sock.wb) != 0 ||
+     slist_count(client->txt) != 0)
+    return -1;
+
+  if(size < CONTROL_RING_MIN)
+    size = CONTROL_RING_MIN;
+  while((size & (size - 1)) != 0)
+    size = (size | (size - 1)) + 1;
+
+  if((ring = malloc_zero(sizeof(client_ring_t))) == NULL)
+    {
+      printerror(__func__, "could not alloc ring");
+      goto err;
+    }
+  ring->datafd = ring->spacefd = -1;
+  ring->size = size;
+  len = sizeof(control_ring_hdr_t) + size;
+
+#ifdef MFD_ALLOW_SEALING
+  memfd = memfd_create("scamper-ring", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+#else
+  memfd = memfd_create("scamper-ring", MFD_CLOEXEC);
+#endif
+  if(memfd == -1)
+    {
+      printerror(__func__, "could not create memfd");
+      goto err;
+    }
+  if(ftruncate(memfd, (off_t)len) != 0)
+    {
+      printerror(__func__, "could not size memfd");
+      goto err;
+    }
+#ifdef F_ADD_SEALS
+  if(fcntl(memfd, F_ADD_SEALS, F_SEAL_SHRINK|F_SEAL_GROW|F_SEAL_SEAL) != 0)
+    {
+      printerror(__func__, "could not seal memfd");
+      goto err;
+    }
+#endif
+  hdr = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+  if(hdr == MAP_FAILED)
+    {
+      printerror(__func__, "could not mmap memfd");
+      goto err;
+    }
+  ring->hdr = hdr;
+  ring->data = (uint8_t *)hdr + sizeof(control_ring_hdr_t);
+  hdr->magic = CONTROL_RING_MAGIC;
+  hdr->version = CONTROL_RING_VERSION;
+  hdr->size = size;
+
+  if((ring->datafd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) == -1 ||
+     (ring->spacefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) == -1)
+    {
+      printerror(__func__, "could not create eventfd");
+      goto err;
+    }
+  if((ring->fdn = scamper_fd_private(ring->spacefd, client,
+				     (scamper_fd_cb_t)client_ring_space,
+				     NULL)) == NULL)
+    {
+      printerror(__func__, "could not monitor eventfd");
+      goto err;
+    }
+
+  len = snprintf(str, sizeof(str), "OK ring %llu\n", (unsigned long long)size);
+  iov.iov_base = str;
+  iov.iov_len = len;
+  fds[0] = memfd; fds[1] = ring->datafd; fds[2] = ring->spacefd;
+  memset(&cbuf, 0, sizeof(cbuf));
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = cbuf.buf;
+  msg.msg_controllen = sizeof(cbuf.buf);
+  cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+  memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+  fd = scamper_fd_fd_get(client->un.sock.fdn);
+  if((rc = sendmsg(fd, &msg, 0)) <= 0)
+    {
+      printerror(__func__, "could not pass ring to client");
+      goto err;
+    }
+  if((size_t)rc < len)
+    {
+      if(scamper_writebuf_send(client->un.sock.wb, str + rc, len - rc) != 0)
+	goto err;
+      scamper_fd_write_unpause(client->un.sock.fdn);
+    }
+
+  close(memfd);
+  client->ring = ring;
+  client_ring_drain(client);
+  return 0;
+
+ err:
+  if(memfd != -1) close(memfd);
+  if(ring != NULL) client_ring_free(ring);
+  return -1;
+}
+#endif
+
 /*
  * client_data_send
  *
@@ -794,6 +1232,25 @@ static int client_data_send(void *wf_param, const void *vdata, size_t len,
 	client->mode = CLIENT_MODE_FLUSH;
     }
 
+#ifdef CONTROL_RING
+  /*
+   * write the object straight into the ring if nothing is queued ahead
+   * of it.  the socket only needs attention once the client has been
+   * told the source is finished.
+   */
+  if(client->ring != NULL && slist_count(client->sof_objs) == 0 &&
+     client_ring_fits(client->ring, len) != 0 &&
+     client_ring_push(client->ring, data, len, task != NULL ?
+		      scamper_sourcetask_getid(scamper_task_getsourcetask(task))
+		      : 0) == 0)
+    {
+      client->sof_bytes += len;
+      if(client->mode == CLIENT_MODE_FLUSH && client->un.sock.fdn != NULL)
+	scamper_fd_write_unpause(client->un.sock.fdn);
+      return 0;
+    }
+#endif
+
   if((obj = malloc_zero(sizeof(client_obj_t))) == NULL)
     {
       printerror(__func__, "could not alloc obj");
@@ -820,6 +1277,9 @@ static int client_data_send(void *wf_param, const void *vdata, size_t len,
       goto err;
     }
   obj = NULL;
+  client->sof_bytes += len;
+  client->sof_qbytes += len;
+  client_backlog_check(client);
 
   if(client->type == CLIENT_TYPE_SOCKET)
     fdn = client->un.sock.fdn;
@@ -838,6 +1298,17 @@ static int client_data_send(void *wf_param, const void *vdata, size_t len,
 static void client_signalmore(void *param)
 {
   client_t *client = (client_t *)param;
+
+  /*
+   * do not invite more commands while the client is part way through
+   * supplying a batch: the MORE is sent after the batch's OK.
+   */
+  if(client->batch_left > 0)
+    {
+      client->batch_more = 1;
+      return;
+    }
+
   client_send(client, "MORE");
   return;
 }
@@ -874,16 +1345,25 @@ static int command_attach(client_t *client, char *buf)
   long long ll;
   char *cycleid_str = NULL, *descr = NULL, *format = NULL;
   char *listid_str = NULL, *monitor = NULL, *name = NULL, *priority_str = NULL;
-  char *params[14], *next;
+  char *pps_str = NULL, *window_str = NULL, *budget_str = NULL;
+  char *ring_str = NULL;
+  char *params[22], *next;
+#ifdef CONTROL_RING
+  size_t ring = 0;
+#endif
   int i, cnt = sizeof(params) / sizeof(char *);
   param_t handlers[] = {
+    {"budget", &budget_str},
     {"cycle_id", &cycleid_str},
     {"descr", &descr},
     {"format", &format},
     {"list_id", &listid_str},
     {"monitor", &monitor},
     {"name", &name},
+    {"pps", &pps_str},
     {"priority", &priority_str},
+    {"ring", &ring_str},
+    {"window", &window_str},
   };
   int handler_cnt = sizeof(handlers) / sizeof(param_t);
 
@@ -915,6 +1395,17 @@ static int command_attach(client_t *client, char *buf)
   ssp.cycle_id   = 1;
   ssp.priority   = 1;
 
+  client->sof_budget = config->control_budget;
+  if(budget_str != NULL)
+    {
+      if(string_tollong(budget_str, &ll, NULL, 0) != 0 || ll < 0)
+	{
+	  client_send(client, "ERR invalid budget");
+	  return 0;
+	}
+      client->sof_budget = (uint64_t)ll;
+    }
+
   if(cycleid_str != NULL)
     {
       if(string_tollong(cycleid_str, &ll, NULL, 0) != 0 ||
@@ -960,6 +1451,17 @@ static int command_attach(client_t *client, char *buf)
   else
     ssp.name = name;
 
+  if(pps_str != NULL)
+    {
+      if(string_tollong(pps_str, &ll, NULL, 0) != 0 ||
+	 ll < 0 || ll > SCAMPER_OPTION_PPS_MAX)
+	{
+	  client_send(client, "ERR invalid pps");
+	  return 0;
+	}
+      ssp.pps = (uint32_t)ll;
+    }
+
   if(priority_str != NULL)
     {
       if(string_tollong(priority_str, &ll, NULL, 0) != 0 ||
@@ -971,6 +1473,30 @@ static int command_attach(client_t *client, char *buf)
       ssp.priority = (uint32_t)ll;
     }
 
+  if(ring_str != NULL)
+    {
+      if(string_tollong(ring_str, &ll, NULL, 0) != 0 ||
+	 ll < 0 || ll > CONTROL_RING_MAX)
+	{
+	  client_send(client, "ERR invalid ring");
+	  return 0;
+	}
+#ifdef CONTROL_RING
+      ring = (size_t)ll;
+#endif
+    }
+
+  if(window_str != NULL)
+    {
+      if(string_tollong(window_str, &ll, NULL, 0) != 0 ||
+	 ll < 0 || ll > SCAMPER_OPTION_WINDOW_MAX)
+	{
+	  client_send(client, "ERR invalid window");
+	  return 0;
+	}
+      ssp.window = (uint32_t)ll;
+    }
+
   if((client->sof_objs = slist_alloc()) == NULL)
     {
       printerror(__func__, "could not alloc objs list");
@@ -1003,6 +1529,12 @@ static int command_attach(client_t *client, char *buf)
     }
 
   client->mode = CLIENT_MODE_ATTACHED;
+
+#ifdef CONTROL_RING
+  if(ring != 0 && client_ring_attach(client, ring) == 0)
+    return 0;
+#endif
+
   client_send(client, "OK");
   return 0;
 
@@ -1085,6 +1617,13 @@ static int command_get_pps(client_t *client, char *buf)
   return client_send(client, "OK pps %d", pps);
 }
 
+static int command_get_stats(client_t *client, char *buf)
+{
+  char str[8192];
+  return client_send(client, "OK stats %s",
+		     scamper_stats_json(str, sizeof(str)));
+}
+
 static int command_get_version(client_t *client, char *buf)
 {
   return client_send(client, "OK version " SCAMPER_VERSION);
@@ -1104,6 +1643,7 @@ static int command_get(client_t *client, char *buf)
     {"nameserver",  command_get_nameserver},
     {"pid",         command_get_pid},
     {"pps",         command_get_pps},
+    {"stats",       command_get_stats},
     {"version",     command_get_version},
     {"window",      command_get_window},
   };
@@ -1112,8 +1652,8 @@ static int command_get(client_t *client, char *buf)
 
   if(buf == NULL)
     {
-      client_send(client, "ERR usage: get "
-	  "[command | monitorname | nameserver | pid | pps | version | window]");
+      client_send(client, "ERR usage: get [command | monitorname | "
+		  "nameserver | pid | pps | stats | version | window]");
       return 0;
     }
 
@@ -1588,6 +2128,64 @@ static int client_isdone(client_t *client)
   return 1;
 }
 
+/*
+ * client_batch_cb
+ *
+ * handle one command that is part of a batch.  a command that is not
+ * accepted is reported with its index in the batch; once the last
+ * command has arrived, the accepted commands are acknowledged with the
+ * range of ids they were assigned, which are contiguous as the source
+ * assigns ids sequentially.
+ */
+static int client_batch_cb(client_t *client, uint8_t *buf)
+{
+  char errbuf[256];
+  uint32_t id, last;
+
+  assert(client->batch_left > 0);
+
+  if(scamper_source_command2(client->source, (char *)buf, &id,
+			     errbuf, sizeof(errbuf)) != 0)
+    {
+      if(errbuf[0] != '\0')
+	client_send(client, "ERR batch-%u command not accepted: %s",
+		    client->batch_i, errbuf);
+      else
+	client_send(client, "ERR batch-%u command not accepted",
+		    client->batch_i);
+    }
+  else if(client->batch_ok++ == 0)
+    {
+      client->batch_id = id;
+    }
+  client->batch_i++;
+
+  if(--client->batch_left > 0)
+    return 0;
+
+  if(client->batch_ok == 0)
+    {
+      /* no task was queued, so nothing will trigger a MORE */
+      client_send(client, "OK");
+      client->batch_more = 1;
+    }
+  else
+    {
+      last = client->batch_id + client->batch_ok - 1;
+      if(last < client->batch_id)
+	last++;
+      client_send(client, "OK id-%u-%u", client->batch_id, last);
+    }
+
+  if(client->batch_more != 0)
+    {
+      client->batch_more = 0;
+      client_send(client, "MORE");
+    }
+
+  return 0;
+}
+
 /*
  * client_attached_cb
  *
@@ -1598,12 +2196,15 @@ static int client_isdone(client_t *client)
 static int client_attached_cb(client_t *client, uint8_t *buf, size_t len)
 {
   char errbuf[256];
-  char *str;
+  char *str, *name;
   long long ll;
   uint32_t id;
 
   assert(client->source != NULL);
 
+  if(client->batch_left > 0)
+    return client_batch_cb(client, buf);
+
   /* the control socket will not be supplying any more tasks */
   if(len == 4 && strcasecmp((char *)buf, "done") == 0)
     {
@@ -1625,6 +2226,39 @@ static int client_attached_cb(client_t *client, uint8_t *buf, size_t len)
       return client_send(client, "OK halted %u", id);
     }
 
+  /* the control socket will make tasks from a command template */
+  if(len >= 9 && strncasecmp((char *)buf, "template ", 9) == 0)
+    {
+      if((name = string_nextword((char *)buf)) == NULL ||
+	 (str = string_nextword(name)) == NULL)
+	return client_send(client, "ERR usage: template [name] [command]");
+      if(scamper_source_tmpl_add(client->source, name, str,
+				 errbuf, sizeof(errbuf)) != 0)
+	{
+	  if(errbuf[0] != '\0')
+	    return client_send(client, "ERR template not accepted: %s",
+			       errbuf);
+	  return client_send(client, "ERR template not accepted");
+	}
+      return client_send(client, "OK");
+    }
+
+  /* the control socket will supply a block of commands */
+  if(len >= 6 && strncasecmp((char *)buf, "batch ", 6) == 0)
+    {
+      str = string_nextword((char *)buf);
+      if(string_isnumber(str) == 0)
+	return client_send(client, "ERR usage: batch [count]");
+      if(string_tollong(str, &ll, NULL, 0) != 0 || ll <= 0 ||
+	 ll > CLIENT_BATCH_MAX)
+	return client_send(client, "ERR batch count invalid");
+      client->batch_left = (uint32_t)ll;
+      client->batch_i = 0;
+      client->batch_ok = 0;
+      client->batch_more = 0;
+      return 0;
+    }
+
   /* try the command to see if it is valid and acceptable */
   if(scamper_source_command2(client->source, (char *)buf, &id,
 			     errbuf, sizeof(errbuf)) != 0)
@@ -1772,6 +2406,28 @@ static int client_writebuf_send(client_t *client, void *buf, size_t len)
   return scamper_writebuf_send(client->un.sock.wb, buf, len);
 }
 
+/*
+ * client_sock_objs
+ *
+ * is the next queued object to be sent over the client's connection?
+ * while a batch is arriving, results are held back until the batch's
+ * OK has told the client the ids of the tasks in it.
+ */
+static int client_sock_objs(const client_t *client)
+{
+  client_obj_t *o;
+
+  if(client->sof_objs == NULL || client->batch_left > 0 ||
+     (o = slist_head_item(client->sof_objs)) == NULL)
+    return 0;
+#ifdef CONTROL_RING
+  if(client->ring != NULL && client_ring_fits(client->ring, o->len) != 0)
+    return 0;
+#endif
+
+  return 1;
+}
+
 static int client_write_do(client_t *client,
 			   int (*sendfunc)(client_t *, void *, size_t))
 {
@@ -1793,7 +2449,7 @@ static int client_write_do(client_t *client,
 	}
 
       /* check if we should start sending through a completed task */
-      if(client->sof_objs != NULL &&
+      if(client_sock_objs(client) != 0 &&
 	 (o = slist_head_pop(client->sof_objs)) != NULL)
 	{
 	  client->sof_obj = o;
@@ -1837,9 +2493,15 @@ static int client_write_do(client_t *client,
 
       if(client->sof_off == o->len)
 	{
+	  client->sof_qbytes -= o->len;
 	  client_obj_free(o);
 	  client->sof_obj = NULL;
 	  client->sof_off = 0;
+	  client_backlog_check(client);
+#ifdef CONTROL_RING
+	  if(client->ring != NULL)
+	    client_ring_drain(client);
+#endif
 	}
 
       if(sendfunc(client, data, len) != 0)
@@ -1878,7 +2540,7 @@ static void client_write(const int fd, client_t *client)
    */
   if(scamper_writebuf_len(client->un.sock.wb) == 0 &&
      slist_count(client->txt) == 0 && client->sof_off == 0 &&
-     (client->sof_objs == NULL || slist_count(client->sof_objs) == 0))
+     client_sock_objs(client) == 0)
     {
       scamper_fd_write_pause(client->un.sock.fdn);
       if(client->mode == CLIENT_MODE_FLUSH && client_isdone(client) != 0)
@@ -1938,6 +2600,7 @@ static void remote_free(control_remote_t *rm, int mode)
   rm->ssl_wbio = NULL;
   rm->ssl_rbio = NULL;
   rm->ssl_mode = SSL_MODE_HANDSHAKE;
+  rm->ssl_txoff = 0;
 #endif
 
   if(rm->fd != NULL)
@@ -1954,12 +2617,26 @@ static void remote_free(control_remote_t *rm, int mode)
       rm->wb = NULL;
     }
 
+#ifdef HAVE_ZLIB
+  /* each connection begins with a new compression stream */
+  if(rm->zs != NULL)
+    {
+      deflateEnd(rm->zs);
+      free(rm->zs);
+      rm->zs = NULL;
+    }
+#endif
+
   rm->bufoff = 0;
   rm->mode = REMOTE_MODE_CONNECT;
 
   if(mode == REMOTE_FREE_RESUME)
     return;
 
+#ifdef HAVE_ZLIB
+  rm->zlib = 0;
+#endif
+
   if(rm->alias != NULL)
     {
       free(rm->alias);
@@ -2096,8 +2773,70 @@ static int remote_sock_ssl_init(control_remote_t *rm)
 
   return 0;
 }
+
+/*
+ * remote_sock_ssl_flush
+ *
+ * encrypt the messages gathered by remote_sock_write, and move the
+ * ciphertext into the writebuf.
+ */
+static int remote_sock_ssl_flush(control_remote_t *rm)
+{
+  if(rm->ssl == NULL ||
+     tls_gather_flush(rm->ssl, rm->ssl_txbuf, &rm->ssl_txoff) <= 0)
+    return 0;
+  if(remote_sock_ssl_want_read(rm) < 0)
+    return -1;
+  return 0;
+}
 #endif /* HAVE_OPENSSL */
 
+#ifdef HAVE_ZLIB
+/*
+ * remote_sock_deflate
+ *
+ * compress a channel message with the connection's zlib stream.  each
+ * message ends with a sync flush, so that remoted can decompress it
+ * as soon as it arrives, while later messages can still refer back to
+ * content in earlier messages.
+ */
+static int remote_sock_deflate(control_remote_t *rm, void *ptr, size_t len,
+			       uint8_t *out, size_t *outlen)
+{
+  if(rm->zs == NULL)
+    {
+      if((rm->zs = malloc_zero(sizeof(z_stream))) == NULL)
+	{
+	  printerror(__func__, "could not malloc z_stream");
+	  return -1;
+	}
+      if(deflateInit2(rm->zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8,
+		      Z_DEFAULT_STRATEGY) != Z_OK)
+	{
+	  printerror_msg(__func__, "could not init z_stream");
+	  free(rm->zs); rm->zs = NULL;
+	  return -1;
+	}
+    }
+
+  rm->zs->next_in = ptr;
+  rm->zs->avail_in = len;
+  rm->zs->next_out = out;
+  rm->zs->avail_out = *outlen;
+
+  /* the message must compress to something that fits in a message */
+  if(deflate(rm->zs, Z_SYNC_FLUSH) != Z_OK ||
+     rm->zs->avail_in != 0 || rm->zs->avail_out == 0)
+    {
+      printerror_msg(__func__, "could not compress %d bytes", (int)len);
+      return -1;
+    }
+
+  *outlen -= rm->zs->avail_out;
+  return 0;
+}
+#endif
+
 /*
  * remote_sock_write
  *
@@ -2107,6 +2846,19 @@ static int remote_sock_write(control_remote_t *rm, void *ptr, size_t len,
 {
   uint8_t hdr[REMOTE_HDRLEN];
 
+#ifdef HAVE_ZLIB
+  static uint8_t zbuf[65535];
+  size_t zlen = sizeof(zbuf);
+
+  if(channel != 0 && rm->zlib != 0)
+    {
+      if(remote_sock_deflate(rm, ptr, len, zbuf, &zlen) != 0)
+	return -1;
+      ptr = zbuf;
+      len = zlen;
+    }
+#endif
+
   assert(len <= 65535);
 
   bytes_htonl(hdr+0, sequence);
@@ -2116,9 +2868,14 @@ static int remote_sock_write(control_remote_t *rm, void *ptr, size_t len,
 #ifdef HAVE_OPENSSL
   if(rm->ssl != NULL)
     {
-      SSL_write(rm->ssl, hdr, REMOTE_HDRLEN);
-      SSL_write(rm->ssl, ptr, len);
-      remote_sock_ssl_want_read(rm);
+      /*
+       * gather messages until the socket is writable, so that they
+       * are encrypted together in as few TLS records as possible
+       */
+      tls_gather_write(rm->ssl, rm->ssl_txbuf, &rm->ssl_txoff,
+		       hdr, REMOTE_HDRLEN);
+      tls_gather_write(rm->ssl, rm->ssl_txbuf, &rm->ssl_txoff, ptr, len);
+      scamper_fd_write_unpause(rm->fd);
       return 0;
     }
 #endif
@@ -2344,6 +3101,17 @@ static int remote_read_control_master_id(control_remote_t *rm,
       return -1;
     }
   scamper_debug(__func__, "remote alias: %s", rm->alias);
+
+  /* remoted acknowledges the options it agreed to after the alias */
+#ifdef HAVE_ZLIB
+  if(len > id_len && (buf[id_len] & CONTROL_OPT_ZLIB) != 0 &&
+     scamper_option_zlib_remote() != 0)
+    {
+      scamper_debug(__func__, "compressing channel messages");
+      rm->zlib = 1;
+    }
+#endif
+
   rm->resume = 1;
   rm->mode = REMOTE_MODE_GO;
   return 0;
@@ -2377,6 +3145,7 @@ static int remote_read_control_channel_new(control_remote_t *rm,
   client->un.chan.id = channel;
   client->un.chan.rem = rm;
   client->mode = CLIENT_MODE_ATTACHED;
+  client->sof_budget = config->control_budget;
 
   sf = scamper_outfile_getfile(client->sof);
   scamper_file_setwritefunc(sf, client, client_data_send);
@@ -2714,7 +3483,6 @@ static int remote_send_master(control_remote_t *rm)
     }
 
   off = 0;
-  len = 1 + 1 + 8 + 1 + (monitorname != NULL ? strlen(monitorname) + 1 : 0);
   buf[off++] = CONTROL_MASTER_NEW;
   buf[off++] = 8; /* length of magic */
   memcpy(buf+off, rm->magic, 8); off += 8;
@@ -2722,13 +3490,21 @@ static int remote_send_master(control_remote_t *rm)
     {
       tmp = strlen(monitorname) + 1;
       buf[off++] = (uint8_t)tmp; /* we checked strlen(monitorname) <= 254 */
-      memcpy(buf+off, monitorname, tmp);
+      memcpy(buf+off, monitorname, tmp); off += tmp;
     }
   else
     {
       buf[off++] = 0;
     }
 
+  /*
+   * options follow the monitorname.  remoted versions that do not
+   * understand options ignore them, and do not acknowledge them.
+   */
+  if(scamper_option_zlib_remote() != 0)
+    buf[off++] = CONTROL_OPT_ZLIB;
+  len = off;
+
   return remote_sock_write(rm, buf, len, 0, 0);
 }
 
@@ -2936,6 +3712,11 @@ static void remote_write(SOCKET fd, void *param)
   client_t *client;
   uint8_t buf[1+4];
 
+#ifdef HAVE_OPENSSL
+  if(remote_sock_ssl_flush(rm) != 0)
+    goto err;
+#endif
+
   /*
    * if there is nothing buffered in the writebuf, then put some more
    * in there.
@@ -2980,6 +3761,11 @@ static void remote_write(SOCKET fd, void *param)
 	    goto err;
 	}
 
+#ifdef HAVE_OPENSSL
+      if(remote_sock_ssl_flush(rm) != 0)
+	goto err;
+#endif
+
       /* if there is still nothing in the writebuf, then pause for now */
       if(scamper_writebuf_gtzero(rm->wb) == 0)
 	{
@@ -3399,6 +4185,72 @@ int scamper_control_init(void)
   return 0;
 }
 
+/*
+ * scamper_control_stats
+ *
+ * report how much each connected client has waiting to be sent to it.
+ */
+void scamper_control_stats(char *buf, size_t len, size_t *off)
+{
+  client_t *client;
+  dlist_node_t *dn;
+  size_t wb;
+  char id[32], bytes[32], qbytes[32], budget[32], ring[64];
+  int i = 0, objs, paused;
+
+  string_concat(buf, len, off, ", \"clients\":[");
+  if(client_list != NULL)
+    {
+      for(dn=dlist_head_node(client_list); dn != NULL; dn=dlist_node_next(dn))
+	{
+	  /* leave room to close off the JSON object */
+	  if(len - *off < 320)
+	    break;
+	  client = dlist_node_item(dn);
+	  if(client->type == CLIENT_TYPE_SOCKET)
+	    wb = scamper_writebuf_len(client->un.sock.wb);
+	  else if(client->un.chan.rem->wb != NULL)
+	    wb = scamper_writebuf_len(client->un.chan.rem->wb);
+	  else
+	    wb = 0;
+	  if(client->sof_objs != NULL)
+	    objs = slist_count(client->sof_objs);
+	  else
+	    objs = 0;
+	  if(client->source != NULL)
+	    paused = scamper_source_ispaused(client->source);
+	  else
+	    paused = 0;
+	  ring[0] = '\0';
+#ifdef CONTROL_RING
+	  if(client->ring != NULL)
+	    snprintf(ring, sizeof(ring), ", \"ring\":%llu, \"ringused\":%llu",
+		     (unsigned long long)client->ring->size,
+		     (unsigned long long)
+		     (client->ring->hdr->head -
+		      __atomic_load_n(&client->ring->hdr->tail,
+				      __ATOMIC_RELAXED)));
+#endif
+	  string_concaf(buf, len, off,
+			"%s{\"client\":\"%s\", \"wb\":%u, \"txt\":%d"
+			", \"objs\":%d, \"bytes\":%s, \"backlog\":%s"
+			", \"budget\":%s, \"paused\":%s%s}",
+			i++ > 0 ? ", " : "",
+			client_tostr(client, id, sizeof(id)), (uint32_t)wb,
+			slist_count(client->txt), objs,
+			offt_tostr(bytes, sizeof(bytes),
+				   (off_t)client->sof_bytes, 0, 'd'),
+			offt_tostr(qbytes, sizeof(qbytes),
+				   (off_t)client->sof_qbytes, 0, 'd'),
+			offt_tostr(budget, sizeof(budget),
+				   (off_t)client->sof_budget, 0, 'd'),
+			paused != 0 ? "true" : "false", ring);
+	}
+    }
+  string_concatc(buf, len, off, ']');
+  return;
+}
+
 /*
  * scamper_control_cleanup
  *
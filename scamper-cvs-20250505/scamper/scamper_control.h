@@ -30,6 +30,9 @@ int scamper_control_add_inet(const char *addr, uint16_t port);
 int scamper_control_add_unix(const char *name);
 int scamper_control_add_remote(const char *name, uint16_t port, int ssl);
 
+/* append the state of each connected client to a JSON object */
+void scamper_control_stats(char *buf, size_t len, size_t *off);
+
 int scamper_control_init(void);
 void scamper_control_cleanup(void);
 
@@ -278,6 +278,25 @@ void scamper_debug_close()
 }
 #endif
 
+void scamper_debug_line(const char *line)
+{
+  if(isdaemon == 0)
+    {
+      fprintf(stderr, "%s\n", line);
+      fflush(stderr);
+    }
+
+#ifndef WITHOUT_DEBUGFILE
+  if(debugfile != NULL)
+    {
+      fprintf(debugfile, "%s\n", line);
+      fflush(debugfile);
+    }
+#endif
+
+  return;
+}
+
 void scamper_debug_daemon(void)
 {
   isdaemon = 1;
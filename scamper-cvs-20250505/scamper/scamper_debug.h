@@ -64,6 +64,9 @@ int scamper_debug_open(const char *debugfile);
 void scamper_debug_close(void);
 #endif
 
+/* emit a line of text without any prefix, such as a JSON record */
+void scamper_debug_line(const char *line);
+
 void scamper_debug_daemon(void);
 
 #endif /* scamper_debug.h */
@@ -73,6 +73,9 @@ typedef struct sock_fprog  filt_prog_t;
 #include "scamper_task.h"
 #include "scamper_if.h"
 #include "scamper_osinfo.h"
+#if defined(BUILDING_SCAMPER) && defined(ENABLE_SCAMPER_SIMNET)
+#include "scamper_simnet.h"
+#endif
 #include "utils.h"
 
 #if defined(HAVE_BPF) && defined(DLT_APPLE_IP_OVER_IEEE1394)
@@ -2913,6 +2916,12 @@ int scamper_dl_open(int ifindex)
 {
   int fd;
 
+#ifdef ENABLE_SCAMPER_SIMNET
+  /* the simulated network does not have a datalink */
+  printerror_msg(__func__, "no datalink for ifindex %d in simnet", ifindex);
+  return -1;
+#endif
+
   if((fd = scamper_priv_dl(ifindex)) == -1)
     {
       printerror(__func__, "could not open ifindex %d", ifindex);
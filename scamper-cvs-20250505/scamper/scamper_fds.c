@@ -47,6 +47,9 @@
 #ifndef _WIN32 /* windows does not have a routing socket */
 #include "scamper_rtsock.h"
 #endif
+#if defined(BUILDING_SCAMPER) && defined(ENABLE_SCAMPER_SIMNET)
+#include "scamper_simnet.h"
+#endif
 #include "utils.h"
 #include "mjl_list.h"
 #include "mjl_splaytree.h"
@@ -284,6 +287,11 @@ static char *fd_tostr(scamper_fd_t *fdn)
 
 static void fd_close(scamper_fd_t *fdn)
 {
+#if defined(BUILDING_SCAMPER) && defined(ENABLE_SCAMPER_SIMNET)
+  if(scamper_simnet_close(fdn->fd) == 0)
+    return;
+#endif
+
   switch(fdn->type)
     {
     case SCAMPER_FD_TYPE_PRIVATE:
@@ -1329,7 +1337,11 @@ static scamper_fd_t *fd_tcpudp(int type, void *src, uint16_t sport,
       goto err;
     }
 
+#if defined(BUILDING_SCAMPER) && defined(ENABLE_SCAMPER_SIMNET)
+  if(sport == 0 && socket_isvalid(fd) && scamper_simnet_sport(fd, &sport) != 0)
+#else
   if(sport == 0 && socket_isvalid(fd) && socket_sport(fd, &sport) != 0)
+#endif
     {
       printerror(__func__, "could not get sport for socket");
       goto err;
@@ -92,6 +92,7 @@
 #include "udpprobe/scamper_udpprobe_warts.h"
 #include "udpprobe/scamper_udpprobe_json.h"
 #endif
+#include "scamper_file_cols.h"
 
 #include "utils.h"
 
@@ -103,6 +104,7 @@
 #define SCAMPER_FILE_TYPE_WARTS_GZ    5
 #define SCAMPER_FILE_TYPE_WARTS_BZ2   6
 #define SCAMPER_FILE_TYPE_WARTS_XZ    7
+#define SCAMPER_FILE_TYPE_COLS        8
 
 typedef int (*write_obj_func_t)(scamper_file_t *sf, const void *, void *);
 
@@ -326,6 +328,43 @@ static write_handlers_t text_write_handlers =
 #endif
 };
 
+static write_handlers_t cols_write_handlers =
+{
+  NULL,                                   /* cycle_start */
+  NULL,                                   /* cycle_stop */
+#if !defined(BUILDING_SCAMPER) || !defined(DISABLE_SCAMPER_TRACE)
+  scamper_file_cols_trace_write,          /* trace */
+#endif
+#if !defined(BUILDING_SCAMPER) || !defined(DISABLE_SCAMPER_PING)
+  scamper_file_cols_ping_write,           /* ping */
+#endif
+#if !defined(BUILDING_SCAMPER) || !defined(DISABLE_SCAMPER_TRACELB)
+  NULL,                                   /* tracelb */
+#endif
+#if !defined(BUILDING_SCAMPER) || !defined(DISABLE_SCAMPER_DEALIAS)
+  scamper_file_cols_dealias_write,        /* dealias */
+#endif
+  NULL,                                   /* neighbourdisc */
+#if !defined(BUILDING_SCAMPER) || !defined(DISABLE_SCAMPER_TBIT)
+  NULL,                                   /* tbit */
+#endif
+#if !defined(BUILDING_SCAMPER) || !defined(DISABLE_SCAMPER_STING)
+  NULL,                                   /* sting */
+#endif
+#if !defined(BUILDING_SCAMPER) || !defined(DISABLE_SCAMPER_SNIFF)
+  NULL,                                   /* sniff */
+#endif
+#if !defined(BUILDING_SCAMPER) || !defined(DISABLE_SCAMPER_HOST)
+  NULL,                                   /* host */
+#endif
+#if !defined(BUILDING_SCAMPER) || !defined(DISABLE_SCAMPER_HTTP)
+  NULL,                                   /* http */
+#endif
+#if !defined(BUILDING_SCAMPER) || !defined(DISABLE_SCAMPER_UDPPROBE)
+  NULL,                                   /* udpprobe */
+#endif
+};
+
 static write_handlers_t null_write_handlers =
 {
   NULL,                                   /* cycle_start */
@@ -470,6 +509,16 @@ static struct handler handlers[] = {
    &warts_write_handlers,                  /* write */
    scamper_file_warts_free_state,          /* free_state */
   },
+  {"cols",                                 /* type */
+   init_fail,                              /* init_read */
+   scamper_file_cols_init_write,           /* init_write */
+   scamper_file_cols_init_append,          /* init_append */
+#ifndef BUILDING_SCAMPER
+   NULL,                                   /* read */
+#endif
+   &cols_write_handlers,                   /* write */
+   scamper_file_cols_free_state,           /* free_state */
+  },
 };
 
 static size_t handler_cnt = sizeof(handlers) / sizeof(struct handler);
@@ -740,6 +789,47 @@ int scamper_file_read(scamper_file_t *sf,
 }
 #endif
 
+#ifndef BUILDING_SCAMPER
+int scamper_file_read_raw(scamper_file_t *sf,
+			  const scamper_file_filter_t *filter,
+			  uint16_t *type, scamper_file_raw_t **raw)
+{
+  if(sf->type != SCAMPER_FILE_TYPE_WARTS)
+    return -1;
+  return scamper_file_warts_read_raw(sf, filter, type, raw);
+}
+
+int scamper_file_write_raw(scamper_file_t *sf, const scamper_file_raw_t *raw)
+{
+  assert(sf->type < handler_cnt);
+  if(handlers[sf->type].write != &warts_write_handlers)
+    return -1;
+  return scamper_file_warts_write_raw(sf, raw);
+}
+
+const void *scamper_file_raw_decode(scamper_file_raw_t *raw)
+{
+  return scamper_file_warts_raw_decode(raw);
+}
+
+void scamper_file_raw_decode_free(scamper_file_raw_t *raw)
+{
+  scamper_file_warts_raw_decode_free(raw);
+  return;
+}
+
+size_t scamper_file_raw_len(const scamper_file_raw_t *raw)
+{
+  return scamper_file_warts_raw_len(raw);
+}
+
+void scamper_file_raw_free(scamper_file_raw_t *raw)
+{
+  scamper_file_warts_raw_free(raw);
+  return;
+}
+#endif
+
 /*
  * scamper_file_filter_isset
  *
@@ -1671,6 +1761,8 @@ scamper_file_t *scamper_file_opennull(char mode, const char *type)
     file_type = SCAMPER_FILE_TYPE_WARTS;
   else if(strcasecmp(type, "json") == 0)
     file_type = SCAMPER_FILE_TYPE_JSON;
+  else if(strcasecmp(type, "cols") == 0)
+    file_type = SCAMPER_FILE_TYPE_COLS;
   else
     return NULL;
 
@@ -1692,7 +1784,7 @@ scamper_file_t *scamper_file_openfd(int fd, const char *fn, char mode,
  *
  * in 'w' and 'a' mode, the caller must also specify the type of file
  * to write or append to; the valid classes are "warts", "text", "json",
- * "warts.gz"
+ * "warts.gz", "cols"
  *
  */
 scamper_file_t *scamper_file_open(const char *filename, char mode,
@@ -42,6 +42,9 @@ typedef int (*scamper_file_readfunc_t)(void *param,
 /* handle for maintaining a readbuf */
 typedef struct scamper_file_readbuf scamper_file_readbuf_t;
 
+/* handle for a warts record that has been read but not decoded */
+typedef struct scamper_file_raw scamper_file_raw_t;
+
 /* types of objects that scamper understands */
 #define SCAMPER_FILE_OBJ_LIST          1
 #define SCAMPER_FILE_OBJ_CYCLE_START   2
@@ -81,6 +84,24 @@ int scamper_file_read(scamper_file_t *sf,
 
 int scamper_file_write_obj(scamper_file_t *sf,uint16_t type,const void *data);
 
+/*
+ * copy records between warts files without decoding them.  the list
+ * and cycle a record refers to are declared in the output file as
+ * needed.  scamper_file_raw_decode returns the object the record
+ * contains, which is freed with the record, and has to be called
+ * before the next record is read from the file.
+ * scamper_file_raw_decode_free frees the decoded object early, for
+ * callers that only needed to look at it before writing the record.
+ */
+int scamper_file_read_raw(scamper_file_t *sf,
+			  const scamper_file_filter_t *filter,
+			  uint16_t *obj_type, scamper_file_raw_t **raw);
+int scamper_file_write_raw(scamper_file_t *sf, const scamper_file_raw_t *raw);
+const void *scamper_file_raw_decode(scamper_file_raw_t *raw);
+void scamper_file_raw_decode_free(scamper_file_raw_t *raw);
+size_t scamper_file_raw_len(const scamper_file_raw_t *raw);
+void scamper_file_raw_free(scamper_file_raw_t *raw);
+
 struct scamper_cycle;
 int scamper_file_write_cycle_start(scamper_file_t *sf,
 				   struct scamper_cycle *cycle);
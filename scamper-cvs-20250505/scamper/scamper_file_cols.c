@@ -0,0 +1,838 @@
+/*
+ * scamper_file_cols.c
+ *
+ * $Id$
+ *
+ * Copyright (C) 2025 The Regents of the University of California
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * the cols format holds ping replies, trace hops, and dealias probes as
+ * typed columns, so that the results can be scanned without parsing
+ * text.  each table is written in row groups of up to 65536 rows, so
+ * the file is written as results arrive.  each row group holds its own
+ * dictionary of the addresses in it.  the layout is described in cols(5).
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include "internal.h"
+
+#include "scamper_addr.h"
+#include "scamper_addr_int.h"
+#include "scamper_list.h"
+#include "scamper_file.h"
+#if !defined(BUILDING_SCAMPER) || !defined(DISABLE_SCAMPER_TRACE)
+#include "trace/scamper_trace.h"
+#include "trace/scamper_trace_int.h"
+#endif
+#if !defined(BUILDING_SCAMPER) || !defined(DISABLE_SCAMPER_PING)
+#include "ping/scamper_ping.h"
+#include "ping/scamper_ping_int.h"
+#endif
+#if !defined(BUILDING_SCAMPER) || !defined(DISABLE_SCAMPER_DEALIAS)
+#include "dealias/scamper_dealias.h"
+#include "dealias/scamper_dealias_int.h"
+#endif
+#include "scamper_file_cols.h"
+#include "mjl_splaytree.h"
+#include "utils.h"
+
+#define COLS_MAGIC        "SCAMPCOL"
+#define COLS_VERSION      1
+#define COLS_FILEHDR_LEN  16
+#define COLS_BLOCKHDR_LEN 24
+#define COLS_DIRENT_LEN   32
+#define COLS_NAME_LEN     16
+#define COLS_ADDR_NULL    0xFFFFFFFF
+
+typedef struct cols_coldef
+{
+  const char *name;
+  uint8_t     type;
+} cols_coldef_t;
+
+/*
+ * cols_dictaddr
+ *
+ * an address in the dictionary of the row group being built, and its
+ * index in the dictionary.
+ */
+typedef struct cols_dictaddr
+{
+  scamper_addr_t *addr;
+  uint32_t        id;
+} cols_dictaddr_t;
+
+/*
+ * cols_table
+ *
+ * the rows of a table that have not yet been written.  each column is
+ * an array of fixed width values, which grows with the row group.
+ */
+typedef struct cols_table
+{
+  uint16_t             id;
+  const cols_coldef_t *defs;
+  uint16_t             colc;
+  uint8_t            **cols;
+  uint32_t             rowc;
+  uint32_t             rowm;
+  splaytree_t         *dict_tree;
+  cols_dictaddr_t    **dict;
+  uint32_t             dictc;
+  uint32_t             dictm;
+} cols_table_t;
+
+typedef struct cols_state
+{
+  int                  isreg;
+  int                  hdr;
+  cols_table_t        *tables[4];
+} cols_state_t;
+
+#if !defined(BUILDING_SCAMPER) || !defined(DISABLE_SCAMPER_PING)
+#define PING_COL_START        0
+#define PING_COL_USERID       1
+#define PING_COL_SRC          2
+#define PING_COL_DST          3
+#define PING_COL_METHOD       4
+#define PING_COL_PROBE_TX     5
+#define PING_COL_PROBE_ID     6
+#define PING_COL_PROBE_TTL    7
+#define PING_COL_PROBE_SIZE   8
+#define PING_COL_REPLY_FROM   9
+#define PING_COL_RTT          10
+#define PING_COL_REPLY_PROTO  11
+#define PING_COL_REPLY_TTL    12
+#define PING_COL_REPLY_SIZE   13
+#define PING_COL_REPLY_IPID   14
+#define PING_COL_ICMP_TYPE    15
+#define PING_COL_ICMP_CODE    16
+#define PING_COL_TCP_FLAGS    17
+#define PING_COL_REPLY_FLAGS  18
+
+static const cols_coldef_t ping_cols[] = {
+  {"start",       SCAMPER_FILE_COLS_TYPE_I64},
+  {"userid",      SCAMPER_FILE_COLS_TYPE_U32},
+  {"src",         SCAMPER_FILE_COLS_TYPE_ADDR},
+  {"dst",         SCAMPER_FILE_COLS_TYPE_ADDR},
+  {"method",      SCAMPER_FILE_COLS_TYPE_U8},
+  {"probe_tx",    SCAMPER_FILE_COLS_TYPE_I64},
+  {"probe_id",    SCAMPER_FILE_COLS_TYPE_U16},
+  {"probe_ttl",   SCAMPER_FILE_COLS_TYPE_U8},
+  {"probe_size",  SCAMPER_FILE_COLS_TYPE_U16},
+  {"reply_from",  SCAMPER_FILE_COLS_TYPE_ADDR},
+  {"rtt",         SCAMPER_FILE_COLS_TYPE_U32},
+  {"reply_proto", SCAMPER_FILE_COLS_TYPE_U8},
+  {"reply_ttl",   SCAMPER_FILE_COLS_TYPE_U8},
+  {"reply_size",  SCAMPER_FILE_COLS_TYPE_U16},
+  {"reply_ipid",  SCAMPER_FILE_COLS_TYPE_U32},
+  {"icmp_type",   SCAMPER_FILE_COLS_TYPE_U8},
+  {"icmp_code",   SCAMPER_FILE_COLS_TYPE_U8},
+  {"tcp_flags",   SCAMPER_FILE_COLS_TYPE_U8},
+  {"reply_flags", SCAMPER_FILE_COLS_TYPE_U8},
+};
+#endif
+
+#if !defined(BUILDING_SCAMPER) || !defined(DISABLE_SCAMPER_TRACE)
+#define TRACE_COL_START        0
+#define TRACE_COL_USERID       1
+#define TRACE_COL_SRC          2
+#define TRACE_COL_DST          3
+#define TRACE_COL_METHOD       4
+#define TRACE_COL_STOP_REASON  5
+#define TRACE_COL_PROBE_TX     6
+#define TRACE_COL_PROBE_TTL    7
+#define TRACE_COL_PROBE_ID     8
+#define TRACE_COL_PROBE_SIZE   9
+#define TRACE_COL_HOP_ADDR     10
+#define TRACE_COL_RTT          11
+#define TRACE_COL_REPLY_TTL    12
+#define TRACE_COL_REPLY_SIZE   13
+#define TRACE_COL_REPLY_IPID   14
+#define TRACE_COL_REPLY_TOS    15
+#define TRACE_COL_ICMP_TYPE    16
+#define TRACE_COL_ICMP_CODE    17
+#define TRACE_COL_ICMP_Q_TTL   18
+#define TRACE_COL_TCP_FLAGS    19
+#define TRACE_COL_REPLY_FLAGS  20
+
+static const cols_coldef_t trace_cols[] = {
+  {"start",       SCAMPER_FILE_COLS_TYPE_I64},
+  {"userid",      SCAMPER_FILE_COLS_TYPE_U32},
+  {"src",         SCAMPER_FILE_COLS_TYPE_ADDR},
+  {"dst",         SCAMPER_FILE_COLS_TYPE_ADDR},
+  {"method",      SCAMPER_FILE_COLS_TYPE_U8},
+  {"stop_reason", SCAMPER_FILE_COLS_TYPE_U8},
+  {"probe_tx",    SCAMPER_FILE_COLS_TYPE_I64},
+  {"probe_ttl",   SCAMPER_FILE_COLS_TYPE_U8},
+  {"probe_id",    SCAMPER_FILE_COLS_TYPE_U8},
+  {"probe_size",  SCAMPER_FILE_COLS_TYPE_U16},
+  {"hop_addr",    SCAMPER_FILE_COLS_TYPE_ADDR},
+  {"rtt",         SCAMPER_FILE_COLS_TYPE_U32},
+  {"reply_ttl",   SCAMPER_FILE_COLS_TYPE_U8},
+  {"reply_size",  SCAMPER_FILE_COLS_TYPE_U16},
+  {"reply_ipid",  SCAMPER_FILE_COLS_TYPE_U16},
+  {"reply_tos",   SCAMPER_FILE_COLS_TYPE_U8},
+  {"icmp_type",   SCAMPER_FILE_COLS_TYPE_U8},
+  {"icmp_code",   SCAMPER_FILE_COLS_TYPE_U8},
+  {"icmp_q_ttl",  SCAMPER_FILE_COLS_TYPE_U8},
+  {"tcp_flags",   SCAMPER_FILE_COLS_TYPE_U8},
+  {"reply_flags", SCAMPER_FILE_COLS_TYPE_U8},
+};
+#endif
+
+#if !defined(BUILDING_SCAMPER) || !defined(DISABLE_SCAMPER_DEALIAS)
+#define DEALIAS_COL_START         0
+#define DEALIAS_COL_USERID        1
+#define DEALIAS_COL_METHOD        2
+#define DEALIAS_COL_DEF_ID        3
+#define DEALIAS_COL_DEF_METHOD    4
+#define DEALIAS_COL_SRC           5
+#define DEALIAS_COL_DST           6
+#define DEALIAS_COL_PROBE_TTL     7
+#define DEALIAS_COL_SEQ           8
+#define DEALIAS_COL_PROBE_TX      9
+#define DEALIAS_COL_PROBE_IPID    10
+#define DEALIAS_COL_REPLYC        11
+#define DEALIAS_COL_REPLY_FROM    12
+#define DEALIAS_COL_RTT           13
+#define DEALIAS_COL_REPLY_PROTO   14
+#define DEALIAS_COL_REPLY_TTL     15
+#define DEALIAS_COL_REPLY_SIZE    16
+#define DEALIAS_COL_REPLY_IPID    17
+#define DEALIAS_COL_ICMP_TYPE     18
+#define DEALIAS_COL_ICMP_CODE     19
+#define DEALIAS_COL_TCP_FLAGS     20
+
+static const cols_coldef_t dealias_cols[] = {
+  {"start",       SCAMPER_FILE_COLS_TYPE_I64},
+  {"userid",      SCAMPER_FILE_COLS_TYPE_U32},
+  {"method",      SCAMPER_FILE_COLS_TYPE_U8},
+  {"def_id",      SCAMPER_FILE_COLS_TYPE_U32},
+  {"def_method",  SCAMPER_FILE_COLS_TYPE_U8},
+  {"src",         SCAMPER_FILE_COLS_TYPE_ADDR},
+  {"dst",         SCAMPER_FILE_COLS_TYPE_ADDR},
+  {"probe_ttl",   SCAMPER_FILE_COLS_TYPE_U8},
+  {"seq",         SCAMPER_FILE_COLS_TYPE_U32},
+  {"probe_tx",    SCAMPER_FILE_COLS_TYPE_I64},
+  {"probe_ipid",  SCAMPER_FILE_COLS_TYPE_U16},
+  {"replyc",      SCAMPER_FILE_COLS_TYPE_U16},
+  {"reply_from",  SCAMPER_FILE_COLS_TYPE_ADDR},
+  {"rtt",         SCAMPER_FILE_COLS_TYPE_U32},
+  {"reply_proto", SCAMPER_FILE_COLS_TYPE_U8},
+  {"reply_ttl",   SCAMPER_FILE_COLS_TYPE_U8},
+  {"reply_size",  SCAMPER_FILE_COLS_TYPE_U16},
+  {"reply_ipid",  SCAMPER_FILE_COLS_TYPE_U32},
+  {"icmp_type",   SCAMPER_FILE_COLS_TYPE_U8},
+  {"icmp_code",   SCAMPER_FILE_COLS_TYPE_U8},
+  {"tcp_flags",   SCAMPER_FILE_COLS_TYPE_U8},
+};
+#endif
+
+static size_t cols_width(uint8_t type)
+{
+  switch(type)
+    {
+    case SCAMPER_FILE_COLS_TYPE_U8:       return 1;
+    case SCAMPER_FILE_COLS_TYPE_U16:      return 2;
+    case SCAMPER_FILE_COLS_TYPE_U32:      return 4;
+    case SCAMPER_FILE_COLS_TYPE_ADDR:     return 4;
+    case SCAMPER_FILE_COLS_TYPE_U64:      return 8;
+    case SCAMPER_FILE_COLS_TYPE_I64:      return 8;
+    case SCAMPER_FILE_COLS_TYPE_ADDRDICT: return 16;
+    }
+  return 0;
+}
+
+/* values are stored little-endian regardless of the host byte order */
+static void cols_le(uint8_t *buf, uint64_t val, size_t len)
+{
+  size_t i;
+  for(i=0; i<len; i++)
+    {
+      buf[i] = val & 0xFF;
+      val >>= 8;
+    }
+  return;
+}
+
+static size_t cols_align(size_t off)
+{
+  return (off + 7) & ~((size_t)7);
+}
+
+static int64_t cols_tv_us(const struct timeval *tv)
+{
+  return ((int64_t)tv->tv_sec * 1000000) + tv->tv_usec;
+}
+
+static uint32_t cols_rtt_us(const struct timeval *rtt)
+{
+  uint64_t us = ((uint64_t)rtt->tv_sec * 1000000) + rtt->tv_usec;
+  return us > UINT32_MAX ? UINT32_MAX : (uint32_t)us;
+}
+
+static int cols_dictaddr_cmp(const cols_dictaddr_t *a, const cols_dictaddr_t *b)
+{
+  return scamper_addr_cmp(a->addr, b->addr);
+}
+
+static void cols_dictaddr_free(cols_dictaddr_t *da)
+{
+  if(da->addr != NULL) scamper_addr_free(da->addr);
+  free(da);
+  return;
+}
+
+static void cols_table_free(cols_table_t *t)
+{
+  uint16_t i;
+
+  if(t->cols != NULL)
+    {
+      for(i=0; i<t->colc; i++)
+	if(t->cols[i] != NULL)
+	  free(t->cols[i]);
+      free(t->cols);
+    }
+  if(t->dict_tree != NULL)
+    splaytree_free(t->dict_tree, (splaytree_free_t)cols_dictaddr_free);
+  if(t->dict != NULL)
+    free(t->dict);
+  free(t);
+  return;
+}
+
+static cols_table_t *cols_table_get(const scamper_file_t *sf, uint16_t id,
+				    const cols_coldef_t *defs, uint16_t colc)
+{
+  cols_state_t *state = scamper_file_getstate(sf);
+  cols_table_t *t;
+
+  if((t = state->tables[id]) != NULL)
+    return t;
+
+  if((t = malloc_zero(sizeof(cols_table_t))) == NULL ||
+     (t->cols = malloc_zero(sizeof(uint8_t *) * colc)) == NULL ||
+     (t->dict_tree = splaytree_alloc((splaytree_cmp_t)cols_dictaddr_cmp)) == NULL)
+    goto err;
+  t->id = id;
+  t->defs = defs;
+  t->colc = colc;
+
+  state->tables[id] = t;
+  return t;
+
+ err:
+  if(t != NULL) cols_table_free(t);
+  return NULL;
+}
+
+static int cols_write(const scamper_file_t *sf, const void *buf, size_t len)
+{
+  scamper_file_writefunc_t wf;
+  cols_state_t *state = scamper_file_getstate(sf);
+  off_t off = 0;
+  int fd;
+
+  if((wf = scamper_file_getwritefunc(sf)) != NULL)
+    return wf(scamper_file_getwriteparam(sf), buf, len, NULL);
+
+  fd = scamper_file_getfd(sf);
+  if(state->isreg != 0 && (off = lseek(fd, 0, SEEK_CUR)) == (off_t)-1)
+    return -1;
+
+  if(write_wrap(fd, buf, NULL, len) != 0)
+    {
+      /* if we could not write the buf out, then truncate the file */
+      if(state->isreg != 0)
+	{
+	  if(ftruncate(fd, off) != 0)
+	    return -1;
+	}
+      return -1;
+    }
+
+  return 0;
+}
+
+static int cols_hdr_write(const scamper_file_t *sf)
+{
+  cols_state_t *state = scamper_file_getstate(sf);
+  uint8_t buf[COLS_FILEHDR_LEN];
+
+  if(state->hdr != 0)
+    return 0;
+
+  memset(buf, 0, sizeof(buf));
+  memcpy(buf, COLS_MAGIC, 8);
+  cols_le(buf + 8, COLS_VERSION, 4);
+  if(cols_write(sf, buf, sizeof(buf)) != 0)
+    return -1;
+  state->hdr = 1;
+
+  return 0;
+}
+
+static void cols_dirent(uint8_t *buf, uint16_t id, uint8_t type,
+			const char *name, uint32_t count, uint64_t off)
+{
+  cols_le(buf + 0, id, 2);
+  buf[2] = type;
+  buf[3] = 0;
+  cols_le(buf + 4, count, 4);
+  cols_le(buf + 8, off, 8);
+  strncpy((char *)buf + 16, name, COLS_NAME_LEN);
+  return;
+}
+
+/*
+ * cols_table_flush
+ *
+ * write the rows of the table as a row group.  the block begins with a
+ * header, followed by a directory with an entry for the address
+ * dictionary and for each column, followed by the dictionary and the
+ * columns, each aligned on an eight byte boundary.
+ */
+static int cols_table_flush(const scamper_file_t *sf, cols_table_t *t)
+{
+  const scamper_addr_t *sa;
+  uint8_t *buf = NULL, *ptr;
+  size_t len, off, dict_off, w;
+  uint32_t i;
+  uint16_t c;
+  int rc = -1;
+
+  if(t->rowc == 0)
+    return 0;
+
+  /* work out where the dictionary and the columns will go */
+  len = COLS_BLOCKHDR_LEN + (COLS_DIRENT_LEN * (t->colc + 1));
+  dict_off = len = cols_align(len);
+  len = cols_align(len + (16 * (size_t)t->dictc));
+  for(c=0; c<t->colc; c++)
+    len = cols_align(len + (cols_width(t->defs[c].type) * t->rowc));
+
+  if((buf = malloc_zero(len)) == NULL)
+    goto done;
+
+  memcpy(buf, "SCRG", 4);
+  cols_le(buf + 4, t->id, 2);
+  cols_le(buf + 6, t->colc + 1, 2);
+  cols_le(buf + 8, t->rowc, 4);
+  cols_le(buf + 12, t->dictc, 4);
+  cols_le(buf + 16, len - COLS_BLOCKHDR_LEN, 8);
+
+  /* the dictionary holds IPv4 addresses as IPv4-mapped IPv6 addresses */
+  ptr = buf + COLS_BLOCKHDR_LEN;
+  cols_dirent(ptr, 0, SCAMPER_FILE_COLS_TYPE_ADDRDICT, "addr", t->dictc,
+	      dict_off);
+  for(i=0; i<t->dictc; i++)
+    {
+      sa = t->dict[i]->addr;
+      if(SCAMPER_ADDR_TYPE_IS_IPV4(sa))
+	{
+	  buf[dict_off + (16 * i) + 10] = 0xFF;
+	  buf[dict_off + (16 * i) + 11] = 0xFF;
+	  memcpy(buf + dict_off + (16 * i) + 12, sa->addr, 4);
+	}
+      else memcpy(buf + dict_off + (16 * i), sa->addr, 16);
+    }
+
+  off = cols_align(dict_off + (16 * (size_t)t->dictc));
+  for(c=0; c<t->colc; c++)
+    {
+      w = cols_width(t->defs[c].type);
+      ptr += COLS_DIRENT_LEN;
+      cols_dirent(ptr, c + 1, t->defs[c].type, t->defs[c].name, t->rowc, off);
+      memcpy(buf + off, t->cols[c], w * t->rowc);
+      off = cols_align(off + (w * t->rowc));
+    }
+
+  if(cols_hdr_write(sf) != 0 || cols_write(sf, buf, len) != 0)
+    goto done;
+  rc = 0;
+
+ done:
+  /* start a new row group, even if this one could not be written */
+  splaytree_free(t->dict_tree, (splaytree_free_t)cols_dictaddr_free);
+  t->dict_tree = splaytree_alloc((splaytree_cmp_t)cols_dictaddr_cmp);
+  t->dictc = 0;
+  t->rowc = 0;
+  if(buf != NULL) free(buf);
+  if(t->dict_tree == NULL)
+    return -1;
+  return rc;
+}
+
+/*
+ * cols_row_add
+ *
+ * make space for another row in the table.  the columns grow together,
+ * up to the size of a full row group.
+ */
+static int cols_row_add(cols_table_t *t)
+{
+  uint32_t rowm;
+  uint16_t c;
+
+  if(t->rowc < t->rowm)
+    return 0;
+
+  rowm = t->rowm == 0 ? 1024 : t->rowm * 2;
+  if(rowm > SCAMPER_FILE_COLS_ROWGROUP_ROWS)
+    rowm = SCAMPER_FILE_COLS_ROWGROUP_ROWS;
+  for(c=0; c<t->colc; c++)
+    {
+      if(realloc_wrap((void **)&t->cols[c],
+		      cols_width(t->defs[c].type) * rowm) != 0)
+	return -1;
+    }
+  t->rowm = rowm;
+
+  return 0;
+}
+
+/*
+ * cols_row_done
+ *
+ * the row has been filled in.  when the row group is full, write it.
+ */
+static int cols_row_done(const scamper_file_t *sf, cols_table_t *t)
+{
+  t->rowc++;
+  if(t->rowc >= SCAMPER_FILE_COLS_ROWGROUP_ROWS)
+    return cols_table_flush(sf, t);
+  return 0;
+}
+
+static void cols_set(cols_table_t *t, uint16_t c, uint64_t val)
+{
+  size_t w = cols_width(t->defs[c].type);
+  cols_le(t->cols[c] + (w * t->rowc), val, w);
+  return;
+}
+
+static int cols_set_addr(cols_table_t *t, uint16_t c, scamper_addr_t *addr)
+{
+  cols_dictaddr_t fm, *da = NULL;
+
+  if(addr == NULL ||
+     (SCAMPER_ADDR_TYPE_IS_IPV4(addr) == 0 &&
+      SCAMPER_ADDR_TYPE_IS_IPV6(addr) == 0))
+    {
+      cols_set(t, c, COLS_ADDR_NULL);
+      return 0;
+    }
+
+  fm.addr = addr;
+  if((da = splaytree_find(t->dict_tree, &fm)) == NULL)
+    {
+      if(t->dictc == t->dictm &&
+	 realloc_wrap((void **)&t->dict, sizeof(cols_dictaddr_t *) *
+		      (t->dictm + 1024)) != 0)
+	return -1;
+      if((da = malloc_zero(sizeof(cols_dictaddr_t))) == NULL)
+	return -1;
+      da->addr = scamper_addr_use(addr);
+      da->id = t->dictc;
+      if(splaytree_insert(t->dict_tree, da) == NULL)
+	{
+	  cols_dictaddr_free(da);
+	  return -1;
+	}
+      if(t->dictc == t->dictm)
+	t->dictm += 1024;
+      t->dict[t->dictc++] = da;
+    }
+
+  cols_set(t, c, da->id);
+  return 0;
+}
+
+#if !defined(BUILDING_SCAMPER) || !defined(DISABLE_SCAMPER_PING)
+int scamper_file_cols_ping_write(const scamper_file_t *sf,
+				 const scamper_ping_t *ping, void *p)
+{
+  const scamper_ping_probe_t *probe;
+  const scamper_ping_reply_t *reply;
+  cols_table_t *t;
+  uint16_t i, j;
+
+  if((t = cols_table_get(sf, SCAMPER_FILE_COLS_TABLE_PING, ping_cols,
+			 sizeof(ping_cols) / sizeof(cols_coldef_t))) == NULL)
+    return -1;
+
+  for(i=0; i<ping->ping_sent; i++)
+    {
+      if((probe = ping->probes[i]) == NULL)
+	continue;
+      for(j=0; j<probe->replyc; j++)
+	{
+	  reply = probe->replies[j];
+	  if(cols_row_add(t) != 0 ||
+	     cols_set_addr(t, PING_COL_SRC, ping->src) != 0 ||
+	     cols_set_addr(t, PING_COL_DST, ping->dst) != 0 ||
+	     cols_set_addr(t, PING_COL_REPLY_FROM, reply->addr) != 0)
+	    return -1;
+	  cols_set(t, PING_COL_START, cols_tv_us(&ping->start));
+	  cols_set(t, PING_COL_USERID, ping->userid);
+	  cols_set(t, PING_COL_METHOD, ping->method);
+	  cols_set(t, PING_COL_PROBE_TX, cols_tv_us(&probe->tx));
+	  cols_set(t, PING_COL_PROBE_ID, probe->id);
+	  cols_set(t, PING_COL_PROBE_TTL, ping->ttl);
+	  cols_set(t, PING_COL_PROBE_SIZE, ping->size);
+	  cols_set(t, PING_COL_RTT, cols_rtt_us(&reply->rtt));
+	  cols_set(t, PING_COL_REPLY_PROTO, reply->proto);
+	  cols_set(t, PING_COL_REPLY_TTL, reply->ttl);
+	  cols_set(t, PING_COL_REPLY_SIZE, reply->size);
+	  cols_set(t, PING_COL_REPLY_IPID, reply->ipid32);
+	  cols_set(t, PING_COL_ICMP_TYPE,
+		   SCAMPER_PING_REPLY_IS_ICMP(reply) ? reply->icmp_type : 0);
+	  cols_set(t, PING_COL_ICMP_CODE,
+		   SCAMPER_PING_REPLY_IS_ICMP(reply) ? reply->icmp_code : 0);
+	  cols_set(t, PING_COL_TCP_FLAGS,
+		   SCAMPER_PING_REPLY_IS_TCP(reply) ? reply->tcp_flags : 0);
+	  cols_set(t, PING_COL_REPLY_FLAGS, reply->flags);
+	  if(cols_row_done(sf, t) != 0)
+	    return -1;
+	}
+    }
+
+  return 0;
+}
+#endif
+
+#if !defined(BUILDING_SCAMPER) || !defined(DISABLE_SCAMPER_TRACE)
+int scamper_file_cols_trace_write(const scamper_file_t *sf,
+				  const scamper_trace_t *trace, void *p)
+{
+  const scamper_trace_probettl_t *pttl;
+  const scamper_trace_probe_t *probe;
+  const scamper_trace_reply_t *reply;
+  cols_table_t *t;
+  uint16_t i, k;
+  uint8_t j;
+
+  if((t = cols_table_get(sf, SCAMPER_FILE_COLS_TABLE_TRACE, trace_cols,
+			 sizeof(trace_cols) / sizeof(cols_coldef_t))) == NULL)
+    return -1;
+
+  for(i=0; i<trace->hop_count; i++)
+    {
+      if((pttl = trace->hops[i]) == NULL)
+	continue;
+      for(j=0; j<pttl->probec; j++)
+	{
+	  probe = pttl->probes[j];
+	  for(k=0; k<probe->replyc; k++)
+	    {
+	      reply = probe->replies[k];
+	      if(cols_row_add(t) != 0 ||
+		 cols_set_addr(t, TRACE_COL_SRC, trace->src) != 0 ||
+		 cols_set_addr(t, TRACE_COL_DST, trace->dst) != 0 ||
+		 cols_set_addr(t, TRACE_COL_HOP_ADDR, reply->addr) != 0)
+		return -1;
+	      cols_set(t, TRACE_COL_START, cols_tv_us(&trace->start));
+	      cols_set(t, TRACE_COL_USERID, trace->userid);
+	      cols_set(t, TRACE_COL_METHOD, trace->type);
+	      cols_set(t, TRACE_COL_STOP_REASON, trace->stop_reason);
+	      cols_set(t, TRACE_COL_PROBE_TX, cols_tv_us(&probe->tx));
+	      cols_set(t, TRACE_COL_PROBE_TTL, probe->ttl);
+	      cols_set(t, TRACE_COL_PROBE_ID, probe->id);
+	      cols_set(t, TRACE_COL_PROBE_SIZE, probe->size);
+	      cols_set(t, TRACE_COL_RTT, cols_rtt_us(&reply->rtt));
+	      cols_set(t, TRACE_COL_REPLY_TTL, reply->ttl);
+	      cols_set(t, TRACE_COL_REPLY_SIZE, reply->size);
+	      cols_set(t, TRACE_COL_REPLY_IPID, reply->ipid);
+	      cols_set(t, TRACE_COL_REPLY_TOS, reply->tos);
+	      if(SCAMPER_TRACE_REPLY_IS_ICMP(reply))
+		{
+		  cols_set(t, TRACE_COL_ICMP_TYPE, reply->un.icmp.icmp_type);
+		  cols_set(t, TRACE_COL_ICMP_CODE, reply->un.icmp.icmp_code);
+		  cols_set(t, TRACE_COL_ICMP_Q_TTL, reply->un.icmp.icmp_q_ttl);
+		  cols_set(t, TRACE_COL_TCP_FLAGS, 0);
+		}
+	      else
+		{
+		  cols_set(t, TRACE_COL_ICMP_TYPE, 0);
+		  cols_set(t, TRACE_COL_ICMP_CODE, 0);
+		  cols_set(t, TRACE_COL_ICMP_Q_TTL, 0);
+		  cols_set(t, TRACE_COL_TCP_FLAGS,
+			   SCAMPER_TRACE_REPLY_IS_TCP(reply) ?
+			   reply->un.tcp.tcp_flags : 0);
+		}
+	      cols_set(t, TRACE_COL_REPLY_FLAGS, reply->flags);
+	      if(cols_row_done(sf, t) != 0)
+		return -1;
+	    }
+	}
+    }
+
+  return 0;
+}
+#endif
+
+#if !defined(BUILDING_SCAMPER) || !defined(DISABLE_SCAMPER_DEALIAS)
+int scamper_file_cols_dealias_write(const scamper_file_t *sf,
+				    const scamper_dealias_t *dealias, void *p)
+{
+  const scamper_dealias_probedef_t *def;
+  const scamper_dealias_probe_t *probe;
+  const scamper_dealias_reply_t *reply;
+  struct timeval rtt;
+  cols_table_t *t;
+  uint32_t i;
+
+  if((t = cols_table_get(sf, SCAMPER_FILE_COLS_TABLE_DEALIAS, dealias_cols,
+			 sizeof(dealias_cols) / sizeof(cols_coldef_t))) == NULL)
+    return -1;
+
+  for(i=0; i<dealias->probec; i++)
+    {
+      probe = dealias->probes[i];
+      def = probe->def;
+      reply = probe->replyc > 0 ? probe->replies[0] : NULL;
+
+      if(cols_row_add(t) != 0 ||
+	 cols_set_addr(t, DEALIAS_COL_SRC, def->src) != 0 ||
+	 cols_set_addr(t, DEALIAS_COL_DST, def->dst) != 0 ||
+	 cols_set_addr(t, DEALIAS_COL_REPLY_FROM,
+		       reply != NULL ? reply->src : NULL) != 0)
+	return -1;
+      cols_set(t, DEALIAS_COL_START, cols_tv_us(&dealias->start));
+      cols_set(t, DEALIAS_COL_USERID, dealias->userid);
+      cols_set(t, DEALIAS_COL_METHOD, dealias->method);
+      cols_set(t, DEALIAS_COL_DEF_ID, def->id);
+      cols_set(t, DEALIAS_COL_DEF_METHOD, def->method);
+      cols_set(t, DEALIAS_COL_PROBE_TTL, def->ttl);
+      cols_set(t, DEALIAS_COL_SEQ, probe->seq);
+      cols_set(t, DEALIAS_COL_PROBE_TX, cols_tv_us(&probe->tx));
+      cols_set(t, DEALIAS_COL_PROBE_IPID, probe->ipid);
+      cols_set(t, DEALIAS_COL_REPLYC, probe->replyc);
+
+      /* the reply columns describe the first reply to the probe */
+      if(reply != NULL)
+	{
+	  timeval_diff_tv(&rtt, &probe->tx, &reply->rx);
+	  cols_set(t, DEALIAS_COL_RTT, cols_rtt_us(&rtt));
+	  cols_set(t, DEALIAS_COL_REPLY_PROTO, reply->proto);
+	  cols_set(t, DEALIAS_COL_REPLY_TTL, reply->ttl);
+	  cols_set(t, DEALIAS_COL_REPLY_SIZE, reply->size);
+	  if(reply->flags & SCAMPER_DEALIAS_REPLY_FLAG_IPID32)
+	    cols_set(t, DEALIAS_COL_REPLY_IPID, reply->ipid32);
+	  else
+	    cols_set(t, DEALIAS_COL_REPLY_IPID, reply->ipid);
+	  cols_set(t, DEALIAS_COL_ICMP_TYPE,
+		   SCAMPER_DEALIAS_REPLY_IS_ICMP(reply) ? reply->icmp_type : 0);
+	  cols_set(t, DEALIAS_COL_ICMP_CODE,
+		   SCAMPER_DEALIAS_REPLY_IS_ICMP(reply) ? reply->icmp_code : 0);
+	  cols_set(t, DEALIAS_COL_TCP_FLAGS,
+		   SCAMPER_DEALIAS_REPLY_IS_TCP(reply) ? reply->tcp_flags : 0);
+	}
+      else
+	{
+	  cols_set(t, DEALIAS_COL_RTT, 0);
+	  cols_set(t, DEALIAS_COL_REPLY_PROTO, 0);
+	  cols_set(t, DEALIAS_COL_REPLY_TTL, 0);
+	  cols_set(t, DEALIAS_COL_REPLY_SIZE, 0);
+	  cols_set(t, DEALIAS_COL_REPLY_IPID, 0);
+	  cols_set(t, DEALIAS_COL_ICMP_TYPE, 0);
+	  cols_set(t, DEALIAS_COL_ICMP_CODE, 0);
+	  cols_set(t, DEALIAS_COL_TCP_FLAGS, 0);
+	}
+
+      if(cols_row_done(sf, t) != 0)
+	return -1;
+    }
+
+  return 0;
+}
+#endif
+
+static int cols_init(scamper_file_t *sf, int append)
+{
+  cols_state_t *s = NULL;
+  struct stat sb;
+  int fd;
+
+  if((s = malloc_zero(sizeof(cols_state_t))) == NULL)
+    goto err;
+
+  if((fd = scamper_file_getfd(sf)) != -1)
+    {
+      if(fstat(fd, &sb) != 0)
+	goto err;
+      if(S_ISREG(sb.st_mode))
+	{
+	  s->isreg = 1;
+	  /* the file header is only written once */
+	  if(append != 0 && sb.st_size > 0)
+	    s->hdr = 1;
+	}
+    }
+
+  scamper_file_setstate(sf, s);
+  return 0;
+
+ err:
+  if(s != NULL) free(s);
+  return -1;
+}
+
+int scamper_file_cols_init_write(scamper_file_t *sf)
+{
+  return cols_init(sf, 0);
+}
+
+int scamper_file_cols_init_append(scamper_file_t *sf)
+{
+  return cols_init(sf, 1);
+}
+
+/*
+ * scamper_file_cols_free_state
+ *
+ * write out the rows that are held, and a block that marks the end of
+ * the file so that a reader can tell the file is complete.
+ */
+void scamper_file_cols_free_state(scamper_file_t *sf)
+{
+  cols_state_t *state;
+  uint8_t buf[COLS_BLOCKHDR_LEN];
+  size_t i;
+
+  if((state = scamper_file_getstate(sf)) == NULL)
+    return;
+
+  for(i=0; i<sizeof(state->tables) / sizeof(cols_table_t *); i++)
+    {
+      if(state->tables[i] == NULL)
+	continue;
+      cols_table_flush(sf, state->tables[i]);
+      cols_table_free(state->tables[i]);
+    }
+
+  memset(buf, 0, sizeof(buf));
+  memcpy(buf, "SCRG", 4);
+  if(cols_hdr_write(sf) == 0)
+    cols_write(sf, buf, sizeof(buf));
+
+  free(state);
+  return;
+}
@@ -0,0 +1,64 @@
+/*
+ * scamper_file_cols.h
+ *
+ * $Id$
+ *
+ * Copyright (C) 2025 The Regents of the University of California
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef __SCAMPER_FILE_COLS_H
+#define __SCAMPER_FILE_COLS_H
+
+/* the tables that a cols file contains, and the end of file marker */
+#define SCAMPER_FILE_COLS_TABLE_END      0
+#define SCAMPER_FILE_COLS_TABLE_PING     1
+#define SCAMPER_FILE_COLS_TABLE_TRACE    2
+#define SCAMPER_FILE_COLS_TABLE_DEALIAS  3
+
+/* the types of the columns */
+#define SCAMPER_FILE_COLS_TYPE_U8        1
+#define SCAMPER_FILE_COLS_TYPE_U16       2
+#define SCAMPER_FILE_COLS_TYPE_U32       3
+#define SCAMPER_FILE_COLS_TYPE_U64       4
+#define SCAMPER_FILE_COLS_TYPE_I64       5
+#define SCAMPER_FILE_COLS_TYPE_ADDR      6 /* u32 index into dictionary */
+#define SCAMPER_FILE_COLS_TYPE_ADDRDICT  7 /* 16 byte addresses */
+
+/* the number of rows in a full row group */
+#define SCAMPER_FILE_COLS_ROWGROUP_ROWS  65536
+
+#if !defined(BUILDING_SCAMPER) || !defined(DISABLE_SCAMPER_TRACE)
+int scamper_file_cols_trace_write(const scamper_file_t *sf,
+				  const scamper_trace_t *trace, void *p);
+#endif
+
+#if !defined(BUILDING_SCAMPER) || !defined(DISABLE_SCAMPER_PING)
+int scamper_file_cols_ping_write(const scamper_file_t *sf,
+				 const scamper_ping_t *ping, void *p);
+#endif
+
+#if !defined(BUILDING_SCAMPER) || !defined(DISABLE_SCAMPER_DEALIAS)
+int scamper_file_cols_dealias_write(const scamper_file_t *sf,
+				    const scamper_dealias_t *dealias,
+				    void *p);
+#endif
+
+int scamper_file_cols_init_write(scamper_file_t *sf);
+int scamper_file_cols_init_append(scamper_file_t *sf);
+void scamper_file_cols_free_state(scamper_file_t *sf);
+
+#endif /* __SCAMPER_FILE_COLS_H */
@@ -104,6 +104,7 @@ static const warts_var_t cycle_vars[] =
 #define cycle_vars_mfb WARTS_VAR_MFB(cycle_vars)
 
 typedef int (*warts_obj_read_t)(scamper_file_t *,const warts_hdr_t *,void **);
+typedef void (*warts_obj_free_t)(void *);
 
 typedef struct warts_addr
 {
@@ -176,6 +177,31 @@ struct warts_state
   /* address state */
   uint32_t          addr_count;
   scamper_addr_t  **addr_table;
+
+  /* record body for warts_read to return when decoding a raw record */
+  uint8_t          *rawbuf;
+};
+
+/*
+ * scamper_file_raw
+ *
+ * a record read from a warts file without decoding it.  for a
+ * measurement record, the list and cycle that the record refers to are
+ * held so that the ids in the record can be relocated when the record
+ * is written to another warts file.  list and cycle records, and
+ * records that have been decoded, hold the object in data.
+ */
+struct scamper_file_raw
+{
+  scamper_file_t   *sf;
+  uint16_t          type;
+  uint8_t          *buf;
+  uint32_t          len;
+  scamper_list_t   *list;
+  uint32_t          list_off;
+  scamper_cycle_t  *cycle;
+  uint32_t          cycle_off;
+  void             *data;
 };
 
 struct warts_addrtable
@@ -1204,6 +1230,14 @@ int warts_read(scamper_file_t *sf, uint8_t **buf, size_t len)
   if(len == 0)
     return -1;
 
+  /* decoding a record that scamper_file_warts_read_raw already read */
+  if(state->rawbuf != NULL)
+    {
+      *buf = state->rawbuf;
+      state->rawbuf = NULL;
+      return 0;
+    }
+
   if(rf != NULL)
     {
       if((ret = rf(scamper_file_getreadparam(sf), buf, len)) == 0 || ret == -2)
@@ -2323,30 +2357,52 @@ int warts_icmpexts_size(const scamper_icmpexts_t *exts, uint16_t *len)
  *
  */
 #ifndef BUILDING_SCAMPER
+static const warts_obj_read_t objread[] =
+{
+  NULL,
+  (warts_obj_read_t)warts_list_read,
+  (warts_obj_read_t)warts_cycle_read,
+  (warts_obj_read_t)warts_cycle_read,
+  (warts_obj_read_t)warts_cycle_stop_read,
+  (warts_obj_read_t)warts_addr_read,
+  (warts_obj_read_t)scamper_file_warts_trace_read,
+  (warts_obj_read_t)scamper_file_warts_ping_read,
+  (warts_obj_read_t)scamper_file_warts_tracelb_read,
+  (warts_obj_read_t)scamper_file_warts_dealias_read,
+  (warts_obj_read_t)scamper_file_warts_neighbourdisc_read,
+  (warts_obj_read_t)scamper_file_warts_tbit_read,
+  (warts_obj_read_t)scamper_file_warts_sting_read,
+  (warts_obj_read_t)scamper_file_warts_sniff_read,
+  (warts_obj_read_t)scamper_file_warts_host_read,
+  (warts_obj_read_t)scamper_file_warts_http_read,
+  (warts_obj_read_t)scamper_file_warts_udpprobe_read,
+};
+
+static const warts_obj_free_t objfree[] =
+{
+  NULL,
+  (warts_obj_free_t)scamper_list_free,
+  (warts_obj_free_t)scamper_cycle_free,
+  (warts_obj_free_t)scamper_cycle_free,
+  (warts_obj_free_t)scamper_cycle_free,
+  NULL,
+  (warts_obj_free_t)scamper_trace_free,
+  (warts_obj_free_t)scamper_ping_free,
+  (warts_obj_free_t)scamper_tracelb_free,
+  (warts_obj_free_t)scamper_dealias_free,
+  (warts_obj_free_t)scamper_neighbourdisc_free,
+  (warts_obj_free_t)scamper_tbit_free,
+  (warts_obj_free_t)scamper_sting_free,
+  (warts_obj_free_t)scamper_sniff_free,
+  (warts_obj_free_t)scamper_host_free,
+  (warts_obj_free_t)scamper_http_free,
+  (warts_obj_free_t)scamper_udpprobe_free,
+};
+
 int scamper_file_warts_read(scamper_file_t *sf,
 			    const scamper_file_filter_t *filter,
 			    uint16_t *type, void **data)
 {
-  static const warts_obj_read_t objread[] =
-  {
-    NULL,
-    (warts_obj_read_t)warts_list_read,
-    (warts_obj_read_t)warts_cycle_read,
-    (warts_obj_read_t)warts_cycle_read,
-    (warts_obj_read_t)warts_cycle_stop_read,
-    (warts_obj_read_t)warts_addr_read,
-    (warts_obj_read_t)scamper_file_warts_trace_read,
-    (warts_obj_read_t)scamper_file_warts_ping_read,
-    (warts_obj_read_t)scamper_file_warts_tracelb_read,
-    (warts_obj_read_t)scamper_file_warts_dealias_read,
-    (warts_obj_read_t)scamper_file_warts_neighbourdisc_read,
-    (warts_obj_read_t)scamper_file_warts_tbit_read,
-    (warts_obj_read_t)scamper_file_warts_sting_read,
-    (warts_obj_read_t)scamper_file_warts_sniff_read,
-    (warts_obj_read_t)scamper_file_warts_host_read,
-    (warts_obj_read_t)scamper_file_warts_http_read,
-    (warts_obj_read_t)scamper_file_warts_udpprobe_read,
-  };
   warts_state_t   *state = scamper_file_getstate(sf);
   warts_hdr_t      hdr;
   int              isfilter;
@@ -2468,6 +2524,307 @@ int scamper_file_warts_read(scamper_file_t *sf,
 	  hdr.magic, hdr.type, hdr.len);
   return -1;
 }
+
+/*
+ * warts_raw_ids
+ *
+ * every measurement record begins with its parameters, and the first two
+ * parameters are the ids of the list and cycle the measurement belongs
+ * to.  note where the ids are, and get references to the list and cycle.
+ */
+static int warts_raw_ids(const warts_state_t *state, scamper_file_raw_t *raw)
+{
+  const uint8_t *buf = raw->buf;
+  uint32_t off = 0, id;
+
+  /* if there are no flags set at all, there is no list or cycle */
+  if(buf[0] == 0)
+    return 0;
+
+  /* skip over the flags and the length of the parameters */
+  while(off < raw->len && (buf[off] & 0x80) != 0)
+    off++;
+  off += 1 + 2;
+
+  if(buf[0] & 0x01)
+    {
+      raw->list_off = off;
+      if(extract_uint32(buf, &off, raw->len, &id, NULL) != 0 ||
+	 id >= state->list_count)
+	return -1;
+      if(id != 0)
+	raw->list = scamper_list_use(state->list_table[id]->list);
+    }
+
+  if(buf[0] & 0x02)
+    {
+      raw->cycle_off = off;
+      if(extract_uint32(buf, &off, raw->len, &id, NULL) != 0 ||
+	 id >= state->cycle_count || state->cycle_table[id] == NULL)
+	return -1;
+      if(id != 0)
+	raw->cycle = scamper_cycle_use(state->cycle_table[id]->cycle);
+    }
+
+  return 0;
+}
+
+/*
+ * warts_raw_decode
+ *
+ * decode the record with the reader for its type, which gets the record
+ * from warts_read as if it had been read from the file.
+ */
+static int warts_raw_decode(scamper_file_raw_t *raw)
+{
+  warts_state_t *state = scamper_file_getstate(raw->sf);
+  warts_hdr_t hdr;
+
+  if((state->rawbuf = memdup(raw->buf, raw->len)) == NULL)
+    return -1;
+
+  hdr.magic = WARTS_MAGIC;
+  hdr.type  = raw->type;
+  hdr.len   = raw->len;
+  if(objread[raw->type](raw->sf, &hdr, &raw->data) != 0 || raw->data == NULL)
+    {
+      if(state->rawbuf != NULL)
+	{
+	  free(state->rawbuf);
+	  state->rawbuf = NULL;
+	}
+      return -1;
+    }
+
+  return 0;
+}
+
+/*
+ * scamper_file_warts_read_raw
+ *
+ * read the next record from the file without decoding it.  list and
+ * cycle records are processed as scamper_file_warts_read does, and
+ * returned with the object.  if the file declares addresses globally,
+ * as files written before 2010 did, then records are decoded as they
+ * are read, as the addresses they refer to are not in the record.
+ */
+int scamper_file_warts_read_raw(scamper_file_t *sf,
+				const scamper_file_filter_t *filter,
+				uint16_t *type, scamper_file_raw_t **raw_out)
+{
+  warts_state_t      *state = scamper_file_getstate(sf);
+  scamper_file_raw_t *raw = NULL;
+  warts_hdr_t         hdr;
+  uint8_t            *buf = NULL;
+  void               *ptr = NULL;
+  int                 tmp;
+  char                offs[16];
+
+  *raw_out = NULL;
+
+  for(;;)
+    {
+      if(state->hdr.type == 0)
+	{
+	  if((tmp = warts_hdr_read(sf, &hdr)) == 0)
+	    return 0;
+	  if(tmp == -1 || hdr.magic != WARTS_MAGIC || hdr.type == 0)
+	    goto err;
+	}
+      else
+	{
+	  hdr = state->hdr;
+	}
+
+      if(hdr.type == SCAMPER_FILE_OBJ_ADDR        ||
+	 hdr.type == SCAMPER_FILE_OBJ_LIST        ||
+	 hdr.type == SCAMPER_FILE_OBJ_CYCLE_DEF   ||
+	 hdr.type == SCAMPER_FILE_OBJ_CYCLE_START ||
+	 hdr.type == SCAMPER_FILE_OBJ_CYCLE_STOP)
+	{
+	  if(objread[hdr.type](sf, &hdr, &ptr) != 0)
+	    goto err;
+	  if(ptr == NULL)
+	    {
+	      state->hdr = hdr;
+	      return 0;
+	    }
+	  memset(&state->hdr, 0, sizeof(state->hdr));
+
+	  /* addresses are only meaningful within the file they are in */
+	  if(hdr.type == SCAMPER_FILE_OBJ_ADDR ||
+	     scamper_file_filter_isset(filter, hdr.type) == 0)
+	    {
+	      if(hdr.type == SCAMPER_FILE_OBJ_CYCLE_STOP)
+		scamper_cycle_free(ptr);
+	      ptr = NULL;
+	      continue;
+	    }
+
+	  if(hdr.type == SCAMPER_FILE_OBJ_LIST)
+	    ptr = scamper_list_use(ptr);
+	  else if(hdr.type != SCAMPER_FILE_OBJ_CYCLE_STOP)
+	    ptr = scamper_cycle_use(ptr);
+	  if((raw = malloc_zero(sizeof(scamper_file_raw_t))) == NULL)
+	    goto err;
+	  raw->data = ptr; ptr = NULL;
+	  break;
+	}
+
+      if(warts_read(sf, &buf, hdr.len) != 0)
+	goto err;
+      if(buf == NULL)
+	{
+	  state->hdr = hdr;
+	  return 0;
+	}
+      memset(&state->hdr, 0, sizeof(state->hdr));
+
+      if(scamper_file_filter_isset(filter, hdr.type) == 0)
+	{
+	  free(buf); buf = NULL;
+	  continue;
+	}
+
+      if(hdr.type >= sizeof(objread)/sizeof(warts_obj_read_t) ||
+	 objread[hdr.type] == NULL ||
+	 (raw = malloc_zero(sizeof(scamper_file_raw_t))) == NULL)
+	goto err;
+      raw->sf   = sf;
+      raw->type = hdr.type;
+      raw->buf  = buf; buf = NULL;
+      raw->len  = hdr.len;
+
+      if(state->addr_count > 1)
+	{
+	  if(warts_raw_decode(raw) != 0)
+	    goto err;
+	  free(raw->buf); raw->buf = NULL;
+	}
+      else if(warts_raw_ids(state, raw) != 0)
+	goto err;
+      break;
+    }
+
+  raw->sf = sf;
+  raw->type = hdr.type;
+  *type = hdr.type;
+  *raw_out = raw;
+  return 0;
+
+ err:
+  fprintf(stderr,
+	  "off 0x%s magic 0x%04x type 0x%04x len 0x%08x\n",
+	  offt_tostr(offs, sizeof(offs), state->off - hdr.len, 8, 'x'),
+	  hdr.magic, hdr.type, hdr.len);
+  if(raw != NULL) scamper_file_warts_raw_free(raw);
+  if(ptr != NULL) objfree[hdr.type](ptr);
+  if(buf != NULL) free(buf);
+  return -1;
+}
+
+/*
+ * scamper_file_warts_raw_decode
+ *
+ * decode a record read by scamper_file_warts_read_raw.  this has to be
+ * done before the next record is read from the file, as the record is
+ * decoded with the lists and cycles the file has declared so far.
+ */
+const void *scamper_file_warts_raw_decode(scamper_file_raw_t *raw)
+{
+  if(raw->data == NULL && warts_raw_decode(raw) != 0)
+    return NULL;
+  return raw->data;
+}
+
+/*
+ * scamper_file_warts_raw_decode_free
+ *
+ * free the object decoded from a measurement record, which is not needed
+ * to write the record.  the record cannot be decoded again afterwards,
+ * as the file has moved on.
+ */
+void scamper_file_warts_raw_decode_free(scamper_file_raw_t *raw)
+{
+  if(raw->buf == NULL || raw->data == NULL)
+    return;
+  objfree[raw->type](raw->data);
+  raw->data = NULL;
+  return;
+}
+
+size_t scamper_file_warts_raw_len(const scamper_file_raw_t *raw)
+{
+  return raw->len;
+}
+
+/*
+ * scamper_file_warts_write_raw
+ *
+ * write a record read by scamper_file_warts_read_raw, replacing the list
+ * and cycle ids with the ids they have in this file.
+ */
+int scamper_file_warts_write_raw(scamper_file_t *sf,
+				 const scamper_file_raw_t *raw)
+{
+  uint8_t *buf = NULL;
+  uint32_t off = 0, len, id;
+  int rc = -1;
+
+  switch(raw->type)
+    {
+    case SCAMPER_FILE_OBJ_LIST:
+      return warts_list_getid(sf, raw->data, &id);
+    case SCAMPER_FILE_OBJ_CYCLE_DEF:
+      return warts_cycle_getid(sf, raw->data, &id);
+    case SCAMPER_FILE_OBJ_CYCLE_START:
+      return warts_cycle_write(sf, raw->data, raw->type, NULL);
+    case SCAMPER_FILE_OBJ_CYCLE_STOP:
+      return warts_cycle_stop_write(sf, raw->data);
+    }
+
+  /* the record was decoded when read, so write the object out */
+  if(raw->buf == NULL)
+    return scamper_file_write_obj(sf, raw->type, raw->data);
+
+  len = WARTS_HDRLEN + raw->len;
+  if((buf = malloc(len)) == NULL)
+    goto done;
+  insert_wartshdr(buf, &off, len, raw->type);
+  memcpy(buf + off, raw->buf, raw->len);
+
+  if(raw->list != NULL)
+    {
+      if(warts_list_getid(sf, raw->list, &id) != 0)
+	goto done;
+      id = htonl(id);
+      memcpy(buf + off + raw->list_off, &id, 4);
+    }
+
+  if(raw->cycle != NULL)
+    {
+      if(warts_cycle_getid(sf, raw->cycle, &id) != 0)
+	goto done;
+      id = htonl(id);
+      memcpy(buf + off + raw->cycle_off, &id, 4);
+    }
+
+  rc = warts_write(sf, buf, len, NULL);
+
+ done:
+  if(buf != NULL) free(buf);
+  return rc;
+}
+
+void scamper_file_warts_raw_free(scamper_file_raw_t *raw)
+{
+  if(raw->data != NULL) objfree[raw->type](raw->data);
+  if(raw->list != NULL) scamper_list_free(raw->list);
+  if(raw->cycle != NULL) scamper_cycle_free(raw->cycle);
+  if(raw->buf != NULL) free(raw->buf);
+  free(raw);
+  return;
+}
 #endif
 
 int scamper_file_warts_cyclestart_write(const scamper_file_t *sf,
@@ -2726,6 +3083,9 @@ void scamper_file_warts_free_state(scamper_file_t *sf)
       free(state->readbuf);
     }
 
+  if(state->rawbuf != NULL)
+    free(state->rawbuf);
+
   warts_free_state(state->list_tree,
 		   (void **)state->list_table, state->list_count,
 		   (splaytree_free_t)warts_list_free);
@@ -250,6 +250,16 @@ int scamper_file_warts_read(scamper_file_t *sf,
 			    const scamper_file_filter_t *filter,
 			    uint16_t *type, void **data);
 
+int scamper_file_warts_read_raw(scamper_file_t *sf,
+				const scamper_file_filter_t *filter,
+				uint16_t *type, scamper_file_raw_t **raw);
+int scamper_file_warts_write_raw(scamper_file_t *sf,
+				 const scamper_file_raw_t *raw);
+const void *scamper_file_warts_raw_decode(scamper_file_raw_t *raw);
+void scamper_file_warts_raw_decode_free(scamper_file_raw_t *raw);
+size_t scamper_file_warts_raw_len(const scamper_file_raw_t *raw);
+void scamper_file_warts_raw_free(scamper_file_raw_t *raw);
+
 int scamper_file_warts_cyclestart_write(const scamper_file_t *sf,
 					scamper_cycle_t *c);
 int scamper_file_warts_cyclestop_write(const scamper_file_t *sf,
@@ -33,6 +33,9 @@
 #include "scamper_addr_int.h"
 #include "scamper_debug.h"
 #include "scamper_getsrc.h"
+#ifdef ENABLE_SCAMPER_SIMNET
+#include "scamper_simnet.h"
+#endif
 #include "utils.h"
 
 #ifndef _WIN32 /* SOCKET vs int on windows */
@@ -66,6 +69,15 @@ scamper_addr_t *scamper_getsrc(const scamper_addr_t *dst, int ifindex,
   SOCKET sock;
 #endif
 
+#ifdef ENABLE_SCAMPER_SIMNET
+  if(dst->type == SCAMPER_ADDR_TYPE_IPV4)
+    return scamper_addrcache_get(addrcache, dst->type,
+				 scamper_simnet_src(AF_INET));
+  if(dst->type == SCAMPER_ADDR_TYPE_IPV6)
+    return scamper_addrcache_get(addrcache, dst->type,
+				 scamper_simnet_src(AF_INET6));
+#endif
+
   if(dst->type == SCAMPER_ADDR_TYPE_IPV4)
     {
       if(socket_isinvalid(udp4))
@@ -42,6 +42,10 @@
 #include "scamper_ip4.h"
 #include "scamper_icmp4.h"
 #include "scamper_priv.h"
+#include "scamper_tstamp.h"
+#ifdef ENABLE_SCAMPER_SIMNET
+#include "scamper_simnet.h"
+#endif
 #include "utils.h"
 
 static uint8_t *txbuf = NULL;
@@ -80,26 +84,11 @@ static void icmp4_header(scamper_probe_t *probe, uint8_t *buf)
 uint16_t scamper_icmp4_cksum(scamper_probe_t *probe)
 {
   uint8_t hdr[8];
-  uint16_t tmp, *w;
-  int i, sum = 0;
+  uint16_t tmp;
 
   icmp4_header(probe, hdr);
 
-  w = (uint16_t *)hdr;
-  for(i=0; i<8; i+=2)
-    sum += *w++;
-
-  w = (uint16_t *)probe->pr_data;
-  for(i = probe->pr_len; i > 1; i -= 2)
-    sum += *w++;
-  if(i != 0)
-    sum += ((uint8_t *)w)[0];
-
-  /* fold the checksum */
-  sum  = (sum >> 16) + (sum & 0xffff);
-  sum += (sum >> 16);
-
-  if((tmp = ~sum) == 0)
+  if((tmp = ~in_cksum_add(scamper_probe_datasum(probe), hdr, 8)) == 0)
     {
       tmp = 0xffff;
     }
@@ -116,7 +105,7 @@ static void icmp4_build(scamper_probe_t *probe, uint8_t *buf)
   if(probe->pr_len > 0)
     memcpy(buf + 8, probe->pr_data, probe->pr_len);
 
-  csum = in_cksum(buf, (size_t)(probe->pr_len + 8));
+  csum = ~in_cksum_add(scamper_probe_datasum(probe), buf, 8);
   memcpy(buf+2, &csum, 2);
 
   return;
@@ -210,7 +199,12 @@ int scamper_icmp4_probe(scamper_probe_t *probe)
     }
   else
     {
+#ifndef ENABLE_SCAMPER_SIMNET
       if(setsockopt_int(probe->pr_fd,IPPROTO_IP,IP_TTL, probe->pr_ip_ttl) != 0)
+#else
+      if(scamper_simnet_setsockopt_int(probe->pr_fd, IPPROTO_IP, IP_TTL,
+				       probe->pr_ip_ttl) != 0)
+#endif
 	{
 	  printerror(__func__, "could not set IP_TTL");
 	  return -1;
@@ -222,11 +216,23 @@ int scamper_icmp4_probe(scamper_probe_t *probe)
   sockaddr_compose((struct sockaddr *)&sin4, AF_INET,
 		   probe->pr_ip_dst->addr, 0);
 
-  /* get the transmit time immediately before we send the packet */
-  gettimeofday_wrap(&probe->pr_tx);
+  /*
+   * get the transmit time immediately before we send the packet,
+   * unless the kernel will timestamp the packet as it sends it
+   */
+#if !defined(_WIN32) && !defined(ENABLE_SCAMPER_SIMNET)
+  if(scamper_tstamp_tx_isenabled(probe->pr_fd) == 0)
+#endif
+    gettimeofday_wrap(&probe->pr_tx);
 
+#ifndef ENABLE_SCAMPER_SIMNET
   i = sendto(probe->pr_fd, txbuf, len, 0, (struct sockaddr *)&sin4,
 	     sizeof(struct sockaddr_in));
+#else
+  i = scamper_simnet_sendto(probe->pr_fd, txbuf, len,
+			    (struct sockaddr *)&sin4,
+			    sizeof(struct sockaddr_in));
+#endif
 
   if(i < 0)
     {
@@ -246,6 +252,10 @@ int scamper_icmp4_probe(scamper_probe_t *probe)
       return -1;
     }
 
+#if !defined(_WIN32) && !defined(ENABLE_SCAMPER_SIMNET)
+  scamper_tstamp_tx(probe->pr_fd, &probe->pr_tx);
+#endif
+
   return 0;
 }
 
@@ -543,9 +553,8 @@ static void icmp4_recv_ip(SOCKET fd,
       cmsg = (struct cmsghdr *)CMSG_FIRSTHDR(msg);
       while(cmsg != NULL)
 	{
-	  if(cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMP)
+	  if(scamper_tstamp_cmsg(cmsg, &ir->ir_rx) != 0)
 	    {
-	      timeval_cpy(&ir->ir_rx, (struct timeval *)CMSG_DATA(cmsg));
 	      ir->ir_flags |= SCAMPER_ICMP_RESP_FLAG_KERNRX;
 	      goto next;
 	    }
@@ -658,11 +667,8 @@ static int scamper_icmp4_recv_err(int fd, scamper_icmp_resp_t *resp)
   cmsg = (struct cmsghdr *)CMSG_FIRSTHDR(&msg);
   while(cmsg != NULL)
     {
-      if(cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMP)
-	{
-	  timeval_cpy(&resp->ir_rx, (struct timeval *)CMSG_DATA(cmsg));
-	  resp->ir_flags |= SCAMPER_ICMP_RESP_FLAG_KERNRX;
-	}
+      if(scamper_tstamp_cmsg(cmsg, &resp->ir_rx) != 0)
+	resp->ir_flags |= SCAMPER_ICMP_RESP_FLAG_KERNRX;
       else if(cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR)
 	{
 	  ee = (struct sock_extended_err *)CMSG_DATA(cmsg);
@@ -785,8 +791,25 @@ int scamper_icmp4_recv(SOCKET fd, scamper_icmp_resp_t *resp)
   msg.msg_control    = (caddr_t)ctrlbuf;
   msg.msg_controllen = sizeof(ctrlbuf);
 
+#if defined(ENABLE_SCAMPER_SIMNET)
+  if((pbuflen = scamper_simnet_recvmsg(fd, &msg)) == -1)
+#elif defined(HAVE_SO_TIMESTAMPING)
+  if((pbuflen = recvmsg(fd, &msg, MSG_DONTWAIT)) == -1)
+#else
   if((pbuflen = recvmsg(fd, &msg, 0)) == -1)
+#endif
     {
+#if defined(HAVE_SO_TIMESTAMPING) && !defined(ENABLE_SCAMPER_SIMNET)
+      /*
+       * poll reports the socket as readable when a transmit timestamp
+       * arrived after scamper went looking for it.  discard it.
+       */
+      if(errno == EAGAIN || errno == EWOULDBLOCK)
+	{
+	  scamper_tstamp_tx_drain(fd);
+	  return -1;
+	}
+#endif
       printerror(__func__, "could not recvmsg");
       return -1;
     }
@@ -1026,6 +1049,10 @@ SOCKET scamper_icmp4_open_err(const void *addr)
   SOCKET fd;
 #endif
 
+#ifdef ENABLE_SCAMPER_SIMNET
+  return scamper_simnet_open(AF_INET, IPPROTO_ICMP, 0, addr, 0);
+#endif
+
   fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_ICMP);
   if(socket_isinvalid(fd))
     {
@@ -1045,13 +1072,8 @@ SOCKET scamper_icmp4_open_err(const void *addr)
       goto err;
     }
 
-#if defined(SO_TIMESTAMP)
-  if(setsockopt_int(fd, SOL_SOCKET, SO_TIMESTAMP, 1) != 0)
-    {
-      printerror(__func__, "could not set SO_TIMESTAMP");
-      goto err;
-    }
-#endif
+  if(scamper_tstamp_sock(fd, 0) != 0)
+    goto err;
 
   if(setsockopt_int(fd, SOL_IP, IP_RECVERR, 1) != 0)
     {
@@ -1149,6 +1171,10 @@ SOCKET scamper_icmp4_open(const void *addr)
   struct icmp_filter filter;
 #endif
 
+#ifdef ENABLE_SCAMPER_SIMNET
+  return scamper_simnet_open(AF_INET, IPPROTO_ICMP, 1, addr, 0);
+#endif
+
   fd = scamper_priv_icmp4();
   if(socket_isinvalid(fd))
     goto err;
@@ -1165,12 +1191,9 @@ SOCKET scamper_icmp4_open(const void *addr)
       goto err;
     }
 
-#if defined(SO_TIMESTAMP)
-  if(setsockopt_int(fd, SOL_SOCKET, SO_TIMESTAMP, 1) != 0)
-    {
-      printerror(__func__, "could not set SO_TIMESTAMP");
-      goto err;
-    }
+#ifndef _WIN32 /* windows does not have msghdr struct */
+  if(scamper_tstamp_sock(fd, 1) != 0)
+    goto err;
 #endif
 
   /*
@@ -41,6 +41,10 @@
 #include "scamper_ip6.h"
 #include "scamper_icmp6.h"
 #include "scamper_priv.h"
+#include "scamper_tstamp.h"
+#ifdef ENABLE_SCAMPER_SIMNET
+#include "scamper_simnet.h"
+#endif
 #include "utils.h"
 
 static uint8_t *txbuf = NULL;
@@ -101,11 +105,7 @@ uint16_t scamper_icmp6_cksum(scamper_probe_t *probe)
     sum += *w++;
 
   /* payload */
-  w = (uint16_t *)probe->pr_data;
-  for(i = probe->pr_len; i > 1; i -= 2)
-    sum += *w++;
-  if(i != 0)
-    sum += ((uint8_t *)w)[0];
+  sum += scamper_probe_datasum(probe);
 
   /* fold the checksum */
   sum  = (sum >> 16) + (sum & 0xffff);
@@ -192,14 +192,24 @@ int scamper_icmp6_probe(scamper_probe_t *probe)
   icmphdrlen = (1 + 1 + 2 + 2 + 2);
   len = probe->pr_len + icmphdrlen;
 
+#ifndef ENABLE_SCAMPER_SIMNET
   if(setsockopt_int(probe->pr_fd, IPPROTO_IPV6, IPV6_UNICAST_HOPS, probe->pr_ip_ttl) != 0)
+#else
+  if(scamper_simnet_setsockopt_int(probe->pr_fd, IPPROTO_IPV6,
+				   IPV6_UNICAST_HOPS, probe->pr_ip_ttl) != 0)
+#endif
     {
       printerror(__func__, "could not set hlim to %d", probe->pr_ip_ttl);
       return -1;
     }
 
 #ifdef IPV6_TCLASS
+#ifndef ENABLE_SCAMPER_SIMNET
   if(setsockopt_int(probe->pr_fd, IPPROTO_IPV6, IPV6_TCLASS, probe->pr_ip_tos) != 0)
+#else
+  if(scamper_simnet_setsockopt_int(probe->pr_fd, IPPROTO_IPV6,
+				   IPV6_TCLASS, probe->pr_ip_tos) != 0)
+#endif
     {
       printerror(__func__, "could not set tclass to %d", probe->pr_ip_tos);
       return -1;
@@ -232,11 +242,23 @@ int scamper_icmp6_probe(scamper_probe_t *probe)
   sockaddr_compose((struct sockaddr *)&sin6, AF_INET6,
 		   probe->pr_ip_dst->addr, 0);
 
-  /* get the transmit time immediately before we send the packet */
-  gettimeofday_wrap(&probe->pr_tx);
+  /*
+   * get the transmit time immediately before we send the packet,
+   * unless the kernel will timestamp the packet as it sends it
+   */
+#if !defined(_WIN32) && !defined(ENABLE_SCAMPER_SIMNET)
+  if(scamper_tstamp_tx_isenabled(probe->pr_fd) == 0)
+#endif
+    gettimeofday_wrap(&probe->pr_tx);
 
+#ifndef ENABLE_SCAMPER_SIMNET
   i = sendto(probe->pr_fd, txbuf, len, 0, (struct sockaddr *)&sin6,
 	     sizeof(struct sockaddr_in6));
+#else
+  i = scamper_simnet_sendto(probe->pr_fd, txbuf, len,
+			    (struct sockaddr *)&sin6,
+			    sizeof(struct sockaddr_in6));
+#endif
 
   if(i < 0)
     {
@@ -256,6 +278,10 @@ int scamper_icmp6_probe(scamper_probe_t *probe)
       return -1;
     }
 
+#if !defined(_WIN32) && !defined(ENABLE_SCAMPER_SIMNET)
+  scamper_tstamp_tx(probe->pr_fd, &probe->pr_tx);
+#endif
+
   return 0;
 }
 
@@ -323,14 +349,11 @@ static void icmp6_recv_ip_outer(SOCKET fd,
 	    }
 #endif
 
-#if defined(SO_TIMESTAMP)
-	  if(cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_TIMESTAMP)
+	  if(scamper_tstamp_cmsg(cm, &resp->ir_rx) != 0)
 	    {
-	      timeval_cpy(&resp->ir_rx, (struct timeval *)CMSG_DATA(cm));
 	      resp->ir_flags |= SCAMPER_ICMP_RESP_FLAG_KERNRX;
 	      goto next;
 	    }
-#endif
 
 	next:
 	  cm = (struct cmsghdr *)CMSG_NXTHDR(msg, cm);
@@ -407,8 +430,22 @@ int scamper_icmp6_recv(SOCKET fd, scamper_icmp_resp_t *resp)
   msg.msg_control    = (caddr_t)ctrlbuf;
   msg.msg_controllen = sizeof(ctrlbuf);
 
+#if defined(ENABLE_SCAMPER_SIMNET)
+  if((pbuflen = scamper_simnet_recvmsg(fd, &msg)) == -1)
+#elif defined(HAVE_SO_TIMESTAMPING)
+  if((pbuflen = recvmsg(fd, &msg, MSG_DONTWAIT)) == -1)
+#else
   if((pbuflen = recvmsg(fd, &msg, 0)) == -1)
+#endif
     {
+#if defined(HAVE_SO_TIMESTAMPING) && !defined(ENABLE_SCAMPER_SIMNET)
+      /* discard a transmit timestamp that arrived late */
+      if(errno == EAGAIN || errno == EWOULDBLOCK)
+	{
+	  scamper_tstamp_tx_drain(fd);
+	  return -1;
+	}
+#endif
       printerror(__func__, "could not recvmsg");
       return -1;
     }
@@ -610,6 +647,10 @@ SOCKET scamper_icmp6_open(const void *addr)
   struct icmp6_filter filter;
 #endif
 
+#ifdef ENABLE_SCAMPER_SIMNET
+  return scamper_simnet_open(AF_INET6, IPPROTO_ICMPV6, 0, addr, 0);
+#endif
+
   fd = scamper_priv_icmp6();
   if(socket_isinvalid(fd))
     goto err;
@@ -626,12 +667,9 @@ SOCKET scamper_icmp6_open(const void *addr)
       goto err;
     }
 
-#if defined(SO_TIMESTAMP)
-  if(setsockopt_int(fd, SOL_SOCKET, SO_TIMESTAMP, 1) != 0)
-    {
-      printerror(__func__, "could not set SO_TIMESTAMP");
-      goto err;
-    }
+#ifndef _WIN32 /* windows does not have msghdr struct */
+  if(scamper_tstamp_sock(fd, 1) != 0)
+    goto err;
 #endif
 
 #if defined(ICMP6_FILTER)
@@ -38,6 +38,7 @@
 #include "scamper_ip4.h"
 #include "scamper_tcp4.h"
 #include "scamper_priv.h"
+#include "scamper_tstamp.h"
 #include "utils.h"
 
 #ifndef _WIN32 /* SOCKET vs int on windows */
@@ -78,7 +79,24 @@ int scamper_ip4_openraw(void)
 SOCKET scamper_ip4_openraw(void)
 #endif
 {
-  return scamper_priv_ip4raw();
+#ifndef _WIN32 /* SOCKET vs int on windows */
+  int fd;
+#else
+  SOCKET fd;
+#endif
+
+  fd = scamper_priv_ip4raw();
+
+#ifndef _WIN32 /* windows does not have msghdr struct */
+  /* the raw socket is used to send TCP probes; timestamp them */
+  if(socket_isvalid(fd) && scamper_tstamp_sock(fd, 1) != 0)
+    {
+      socket_close(fd);
+      return socket_invalid();
+    }
+#endif
+
+  return fd;
 }
 
 int scamper_ip4_hlen(scamper_probe_t *pr, size_t *hlen)
@@ -43,6 +43,14 @@ struct scamper_outfile
   int             refcnt;
 };
 
+typedef struct outfile_stats
+{
+  char           *buf;
+  size_t          len;
+  size_t         *off;
+  int             i;
+} outfile_stats_t;
+
 static splaytree_t       *outfiles = NULL;
 static scamper_outfile_t *outfile_def = NULL;
 
@@ -221,6 +229,54 @@ scamper_outfile_t *scamper_outfile_opennull(const char *name,
   return sof;
 }
 
+static int outfile_stats(void *param, scamper_outfile_t *sof)
+{
+  outfile_stats_t *os = param;
+  char name[256], bytes[32];
+  off_t off = -1;
+  int fd;
+
+  /* leave room to close off the JSON object */
+  if(os->len - *os->off < 512)
+    return 0;
+
+  /* files written to a control socket do not have a file descriptor */
+  if((fd = scamper_file_getfd(sof->sf)) != -1)
+    off = lseek(fd, 0, SEEK_CUR);
+
+  if(off != -1)
+    offt_tostr(bytes, sizeof(bytes), off, 0, 'd');
+  else
+    snprintf(bytes, sizeof(bytes), "null");
+
+  string_concaf(os->buf, os->len, os->off,
+		"%s{\"name\":\"%s\", \"bytes\":%s}", os->i++ > 0 ? ", " : "",
+		json_esc(sof->name, name, sizeof(name)), bytes);
+  return 0;
+}
+
+/*
+ * scamper_outfiles_stats
+ *
+ * report how many bytes have been written to each output file, where
+ * scamper can tell.
+ */
+void scamper_outfiles_stats(char *buf, size_t len, size_t *off)
+{
+  outfile_stats_t os;
+
+  os.buf = buf;
+  os.len = len;
+  os.off = off;
+  os.i = 0;
+
+  string_concat(buf, len, off, ", \"outfiles\":[");
+  if(outfiles != NULL)
+    splaytree_inorder(outfiles, (splaytree_inorder_t)outfile_stats, &os);
+  string_concatc(buf, len, off, ']');
+  return;
+}
+
 int scamper_outfiles_init(const char *def_filename, const char *def_type)
 {
   if((outfiles = splaytree_alloc((splaytree_cmp_t)outfile_cmp)) == NULL)
@@ -63,6 +63,9 @@ scamper_outfile_t *scamper_outfile_opennull(const char *name,
 					    const char *type);
 #endif
 
+/* append the number of bytes written to each file to a JSON object */
+void scamper_outfiles_stats(char *buf, size_t len, size_t *off);
+
 void scamper_outfiles_cleanup(void);
 
 #endif
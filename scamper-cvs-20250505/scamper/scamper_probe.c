@@ -51,6 +51,7 @@
 #include "scamper_dl.h"
 #include "scamper_dlhdr.h"
 #include "scamper_osinfo.h"
+#include "scamper_stats.h"
 #include "utils.h"
 
 /*
@@ -897,14 +898,14 @@ int scamper_probe_task(scamper_probe_t *pr, scamper_task_t *task)
 }
 
 /*
- * scamper_probe_send
+ * probe_send
  *
  * this meta-function is responsible for
  *  1. sending a probe
  *  2. handling any error condition incurred when sending the probe
  *  3. recording details of the probe with the trace's state
  */
-int scamper_probe(scamper_probe_t *probe)
+static int probe_send(scamper_probe_t *probe)
 {
   int (*send_func)(scamper_probe_t *) = NULL;
   int (*build_func)(scamper_probe_t *, uint8_t *, size_t *) = NULL;
@@ -1041,6 +1042,26 @@ int scamper_probe(scamper_probe_t *probe)
   return 0;
 }
 
+/*
+ * scamper_probe_datasum
+ *
+ * return the one's complement sum of the probe's body, using the sum
+ * the task supplied if there is one.
+ */
+uint16_t scamper_probe_datasum(const scamper_probe_t *probe)
+{
+  if((probe->pr_flags & SCAMPER_PROBE_FLAG_DATASUM) != 0)
+    return probe->pr_data_sum;
+  return in_cksum_add(0, probe->pr_data, probe->pr_len);
+}
+
+int scamper_probe(scamper_probe_t *probe)
+{
+  int rc = probe_send(probe);
+  scamper_stats_probe(probe, rc);
+  return rc;
+}
+
 int scamper_probe_init(void)
 {
   if(scamper_option_planetlab() || scamper_option_rawtcp())
@@ -91,6 +91,7 @@ typedef struct scamper_probe_ipopt
 #define SCAMPER_PROBE_FLAG_SPOOF      0x0004
 #define SCAMPER_PROBE_FLAG_DL         0x0008
 #define SCAMPER_PROBE_FLAG_RXERR      0x0010 /* socket is an rxerr variant */
+#define SCAMPER_PROBE_FLAG_DATASUM    0x0020 /* pr_data_sum is set */
 
 #define SCAMPER_PROBE_TCPOPT_SACK     0x01
 #define SCAMPER_PROBE_TCPOPT_TS       0x02
@@ -177,6 +178,12 @@ typedef struct scamper_probe
   uint8_t               *pr_data;
   uint16_t               pr_len;
 
+  /*
+   * the one's complement sum of pr_data, computed by the task when it
+   * sends many probes with the same body, see in_cksum_add
+   */
+  uint16_t               pr_data_sum;
+
   /* the time immediately before the call to sendto was made */
   struct timeval         pr_tx;
 
@@ -189,6 +196,7 @@ typedef struct scamper_probe
 } scamper_probe_t;
 
 int scamper_probe(scamper_probe_t *probe);
+uint16_t scamper_probe_datasum(const scamper_probe_t *probe);
 
 #ifdef __SCAMPER_TASK_H
 int scamper_probe_task(scamper_probe_t *probe, scamper_task_t *task);
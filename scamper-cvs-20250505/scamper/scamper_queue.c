@@ -407,6 +407,15 @@ int scamper_queue_windowcount()
   return dlist_count(probe_queue) + heap_count(wait_queue);
 }
 
+void scamper_queue_counts(int *probe, int *wait, int *done, int *event)
+{
+  *probe = dlist_count(probe_queue);
+  *wait  = heap_count(wait_queue);
+  *done  = dlist_count(done_queue);
+  *event = heap_count(event_queue);
+  return;
+}
+
 /*
  * scamper_queue_empty
  *
@@ -71,6 +71,9 @@ int scamper_queue_readycount(void);
 /* return the number of tasks in the probe and wait queues */
 int scamper_queue_windowcount(void);
 
+/* return the number of items in each of the queues */
+void scamper_queue_counts(int *probe, int *wait, int *done, int *event);
+
 /* flush the queues of all non-completed tasks */
 void scamper_queue_empty(void);
 
@@ -0,0 +1,1107 @@
+/*
+ * scamper_simnet.c
+ *
+ * $Id$
+ *
+ * Copyright (C) 2025 The Regents of the University of California
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include "internal.h"
+
+#include "scamper_config.h"
+#include "scamper_debug.h"
+#include "scamper_simnet.h"
+#include "mjl_heap.h"
+#include "mjl_splaytree.h"
+#include "utils.h"
+
+/*
+ * the simulated network is a function of the configured seed.  each
+ * destination is given a path length derived from its /24 (or /48),
+ * and the router at each hop is derived from a prefix of the
+ * destination that grows with the hop number, so that paths towards
+ * nearby destinations share routers.  a configurable fraction of hops
+ * are per-flow load balancers.  responses are held in a heap until
+ * they are due, and are then written into one end of a socketpair
+ * whose other end scamper polls as if it were a raw socket.
+ */
+
+typedef struct simnet_sock
+{
+  int               fd;       /* the end scamper reads from */
+  int               peer;     /* the end simnet writes to */
+  int               af;
+  int               proto;
+  int               hdrincl;
+  uint16_t          sport;
+  uint8_t           ttl;
+  uint8_t           tclass;
+  uint8_t           src[16];
+} simnet_sock_t;
+
+typedef struct simnet_router
+{
+  int               af;
+  uint8_t           addr[16];
+  uint16_t          ipid;
+  uint32_t          tokens;
+  struct timeval    refill;
+} simnet_router_t;
+
+typedef struct simnet_resp
+{
+  struct timeval    tv;       /* when the response is due */
+  uint32_t          id;       /* order responses due at the same time */
+  int               af;
+  uint8_t           hlim;
+  uint8_t           from[16];
+  uint8_t          *pkt;
+  size_t            len;
+} simnet_resp_t;
+
+/* written into the socketpair ahead of each response packet */
+typedef struct simnet_hdr
+{
+  struct timeval    rx;
+  int32_t           af;
+  int32_t           hlim;
+  uint8_t           from[16];
+} simnet_hdr_t;
+
+/* the parts of a probe that determine how the network treats it */
+typedef struct simnet_probe
+{
+  int               af;
+  uint8_t           proto;
+  uint8_t           ttl;
+  uint8_t           tclass;
+  uint8_t           src[16];
+  uint8_t           dst[16];
+  const uint8_t    *ip;       /* the IPv4 header, if any */
+  size_t            iplen;
+  const uint8_t    *trans;    /* the transport header */
+  size_t            translen;
+  uint32_t          flowid;
+} simnet_probe_t;
+
+#define SIMNET_SALT_PATH 0x70617468
+#define SIMNET_SALT_LB   0x6c62616c
+#define SIMNET_SALT_RTR  0x72747220
+#define SIMNET_SALT_RESP 0x72657370
+#define SIMNET_SALT_IPID 0x69706964
+#define SIMNET_SALT_FLOW 0x666c6f77
+
+extern scamper_config_t *config;
+
+static simnet_sock_t        **socks = NULL;
+static size_t                 sockc = 0;
+static splaytree_t           *routers = NULL;
+static heap_t                *resps = NULL;
+static uint32_t               resp_id = 0;
+static uint32_t               prng = 1;
+static uint16_t               sport_next = 32768;
+static uint8_t               *txbuf = NULL;
+static size_t                 txbuf_len = 0;
+static struct in_addr         src4;
+static struct in6_addr        src6;
+static scamper_simnet_stats_t stats;
+static struct rusage          ru_start;
+
+static uint32_t simnet_fmix(uint32_t h)
+{
+  h ^= h >> 16;
+  h *= 0x85ebca6b;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35;
+  h ^= h >> 16;
+  return h;
+}
+
+static uint32_t simnet_hash(const void *buf, size_t len)
+{
+  const uint8_t *ptr = buf;
+  uint32_t h = 2166136261U ^ config->simnet_seed;
+  size_t i;
+
+  for(i=0; i<len; i++)
+    {
+      h ^= ptr[i];
+      h *= 16777619U;
+    }
+
+  return simnet_fmix(h);
+}
+
+/*
+ * simnet_hash_addr
+ *
+ * hash the first bits of the address, along with a salt that
+ * identifies what the hash is for, and an extra value.
+ */
+static uint32_t simnet_hash_addr(uint32_t salt, int af, const uint8_t *addr,
+				 int bits, uint32_t x)
+{
+  uint8_t buf[24];
+  int i, bytes = af == AF_INET ? 4 : 16;
+
+  memset(buf, 0, sizeof(buf));
+  bytes_htonl(buf, salt);
+  bytes_htonl(buf+4, x);
+  for(i=0; i<bytes && bits > 0; i++, bits -= 8)
+    buf[8+i] = bits >= 8 ? addr[i] : addr[i] & (0xff << (8 - bits));
+
+  return simnet_hash(buf, sizeof(buf));
+}
+
+static uint32_t simnet_rand(void)
+{
+  prng ^= prng << 13;
+  prng ^= prng >> 17;
+  prng ^= prng << 5;
+  return prng;
+}
+
+static int simnet_router_cmp(const void *va, const void *vb)
+{
+  const simnet_router_t *a = va, *b = vb;
+  if(a->af < b->af) return -1;
+  if(a->af > b->af) return  1;
+  return memcmp(a->addr, b->addr, sizeof(a->addr));
+}
+
+static int simnet_resp_cmp(const void *va, const void *vb)
+{
+  const simnet_resp_t *a = va, *b = vb;
+  int i;
+  if((i = timeval_cmp(&b->tv, &a->tv)) != 0)
+    return i;
+  if(a->id < b->id) return  1;
+  if(a->id > b->id) return -1;
+  return 0;
+}
+
+static simnet_sock_t *simnet_sock_find(int fd)
+{
+  size_t i;
+  for(i=0; i<sockc; i++)
+    if(socks[i]->fd == fd)
+      return socks[i];
+  return NULL;
+}
+
+/*
+ * simnet_sock_icmp
+ *
+ * responses are delivered to the first ICMP socket of the address
+ * family, as they would be on a host with a raw ICMP socket.
+ */
+static simnet_sock_t *simnet_sock_icmp(int af)
+{
+  size_t i;
+  for(i=0; i<sockc; i++)
+    {
+      if(socks[i]->af != af)
+	continue;
+      if((af == AF_INET && socks[i]->proto == IPPROTO_ICMP &&
+	  socks[i]->hdrincl != 0) ||
+	 (af == AF_INET6 && socks[i]->proto == IPPROTO_ICMPV6))
+	return socks[i];
+    }
+  return NULL;
+}
+
+static void simnet_sock_free(simnet_sock_t *ss)
+{
+  if(ss->fd != -1)
+    close(ss->fd);
+  if(ss->peer != -1)
+    close(ss->peer);
+  free(ss);
+  return;
+}
+
+static simnet_router_t *simnet_router_get(int af, const uint8_t *addr,
+					  const struct timeval *now)
+{
+  simnet_router_t fm, *r;
+
+  memset(&fm, 0, sizeof(fm));
+  fm.af = af;
+  memcpy(fm.addr, addr, af == AF_INET ? 4 : 16);
+  if((r = splaytree_find(routers, &fm)) != NULL)
+    return r;
+
+  if((r = memdup(&fm, sizeof(fm))) == NULL)
+    return NULL;
+  r->ipid = simnet_hash_addr(SIMNET_SALT_IPID, af, addr, 128, 0) & 0xffff;
+  r->tokens = config->simnet_ratelimit;
+  timeval_cpy(&r->refill, now);
+  if(splaytree_insert(routers, r) == NULL)
+    {
+      free(r);
+      return NULL;
+    }
+
+  return r;
+}
+
+/*
+ * simnet_router_token
+ *
+ * take a token from the router's bucket, which is refilled at the
+ * configured rate up to a burst of one second's worth of responses.
+ */
+static int simnet_router_token(simnet_router_t *r, const struct timeval *now)
+{
+  uint32_t limit = config->simnet_ratelimit;
+  uint64_t add;
+
+  if(now->tv_sec - r->refill.tv_sec > 1)
+    {
+      r->tokens = limit;
+      timeval_cpy(&r->refill, now);
+    }
+  else if(timeval_cmp(now, &r->refill) > 0)
+    {
+      add = (uint64_t)timeval_diff_us(&r->refill, now) * limit / 1000000;
+      if(add > 0)
+	{
+	  r->tokens = r->tokens + add > limit ? limit : r->tokens + add;
+	  timeval_cpy(&r->refill, now);
+	}
+    }
+
+  if(r->tokens == 0)
+    return -1;
+  r->tokens--;
+  return 0;
+}
+
+/*
+ * simnet_hop_addr
+ *
+ * derive the address of the router at a given hop towards the
+ * destination, taking into account whether the hop load balances.
+ */
+static void simnet_hop_addr(const simnet_probe_t *pr, uint8_t hop,
+			    uint8_t *addr)
+{
+  uint32_t branch = 0, id, id2;
+  int bits;
+
+  if(pr->af == AF_INET)
+    bits = (hop - 1) * 3 > 24 ? 24 : (hop - 1) * 3;
+  else
+    bits = (hop - 1) * 6 > 48 ? 48 : (hop - 1) * 6;
+
+  if(config->simnet_lb_width > 1 &&
+     simnet_hash_addr(SIMNET_SALT_LB, pr->af, pr->dst, bits, hop) % 100 <
+     config->simnet_lb_pct)
+    branch = simnet_fmix(pr->flowid ^ hop) % config->simnet_lb_width;
+
+  id = simnet_hash_addr(SIMNET_SALT_RTR, pr->af, pr->dst, bits,
+			(hop << 8) | branch);
+  if(pr->af == AF_INET)
+    {
+      addr[0] = 10;
+      addr[1] = (id >> 16) & 0xff;
+      addr[2] = (id >> 8) & 0xff;
+      addr[3] = id & 0xff;
+    }
+  else
+    {
+      id2 = simnet_fmix(id ^ SIMNET_SALT_RTR);
+      memset(addr, 0, 16);
+      addr[0] = 0xfd;
+      bytes_htonl(addr+1, id);
+      bytes_htonl(addr+5, id2);
+      addr[15] = 1;
+    }
+
+  return;
+}
+
+static simnet_resp_t *simnet_resp_alloc(int af, const uint8_t *from,
+					size_t len)
+{
+  simnet_resp_t *resp;
+
+  if((resp = malloc_zero(sizeof(simnet_resp_t) + len)) == NULL)
+    return NULL;
+  resp->af = af;
+  memcpy(resp->from, from, af == AF_INET ? 4 : 16);
+  resp->pkt = (uint8_t *)(resp + 1);
+  resp->len = len;
+
+  return resp;
+}
+
+static simnet_resp_t *simnet_resp4(const simnet_probe_t *pr,
+				   simnet_router_t *r, int isdst,
+				   uint8_t hop, const struct timeval *now)
+{
+  simnet_resp_t *resp;
+  uint8_t type, code, *pkt, *icmp, *q;
+  uint32_t ms;
+  uint16_t u16;
+  size_t len, qlen = 0;
+
+  if(isdst == 0)
+    {
+      type = ICMP_TIMXCEED;
+      code = ICMP_TIMXCEED_INTRANS;
+    }
+  else if(pr->proto == IPPROTO_UDP)
+    {
+      type = ICMP_UNREACH;
+      code = ICMP_UNREACH_PORT;
+    }
+  else if(pr->proto == IPPROTO_ICMP && pr->translen >= 8 &&
+	  pr->trans[0] == ICMP_ECHO)
+    {
+      type = ICMP_ECHOREPLY;
+      code = 0;
+    }
+  else if(pr->proto == IPPROTO_ICMP && pr->translen >= 20 &&
+	  pr->trans[0] == ICMP_TSTAMP)
+    {
+      type = ICMP_TSTAMPREPLY;
+      code = 0;
+    }
+  else return NULL;
+
+  if(type == ICMP_TIMXCEED || type == ICMP_UNREACH)
+    {
+      qlen = pr->iplen + (pr->translen < 8 ? pr->translen : 8);
+      len = 20 + 8 + qlen;
+    }
+  else len = 20 + pr->translen;
+
+  if((resp = simnet_resp_alloc(AF_INET, r->addr, len)) == NULL)
+    return NULL;
+  pkt = resp->pkt;
+
+  /* the outer IPv4 header */
+  pkt[0] = 0x45;
+  bytes_htons(pkt+2, len);
+  bytes_htons(pkt+4, r->ipid++);
+  pkt[8] = (isdst != 0 ? 64 : 255) - (hop - 1);
+  pkt[9] = IPPROTO_ICMP;
+  memcpy(pkt+12, r->addr, 4);
+  memcpy(pkt+16, pr->src, 4);
+  u16 = in_cksum(pkt, 20);
+  memcpy(pkt+10, &u16, 2);
+  resp->hlim = pkt[8];
+
+  icmp = pkt + 20;
+  if(qlen == 0)
+    {
+      memcpy(icmp, pr->trans, pr->translen);
+      icmp[0] = type;
+      if(type == ICMP_TSTAMPREPLY)
+	{
+	  ms = ((now->tv_sec % 86400) * 1000) + (now->tv_usec / 1000);
+	  bytes_htonl(icmp+12, ms);
+	  bytes_htonl(icmp+16, ms);
+	}
+    }
+  else
+    {
+      icmp[0] = type;
+      icmp[1] = code;
+      q = icmp + 8;
+      memcpy(q, pr->ip, qlen);
+
+      /* quote the header in network byte order, as a router would */
+#if !defined(IP_HDR_HTONS)
+      memcpy(&u16, q+2, 2); bytes_htons(q+2, u16);
+      memcpy(&u16, q+6, 2); bytes_htons(q+6, u16);
+#endif
+      q[8] = isdst != 0 ? pr->ttl - hop + 1 : 1;
+      q[10] = q[11] = 0;
+      u16 = in_cksum(q, pr->iplen);
+      memcpy(q+10, &u16, 2);
+    }
+  icmp[2] = icmp[3] = 0;
+  u16 = in_cksum(icmp, len - 20);
+  memcpy(icmp+2, &u16, 2);
+
+  return resp;
+}
+
+/*
+ * simnet_cksum6
+ *
+ * compute the checksum over an upper-layer IPv6 packet, including the
+ * pseudo header.
+ */
+static uint16_t simnet_cksum6(const uint8_t *src, const uint8_t *dst,
+			      uint8_t nh, const uint8_t *buf, size_t len)
+{
+  uint32_t sum = 0;
+  uint16_t u16;
+  size_t i;
+
+  for(i=0; i<16; i+=2)
+    {
+      memcpy(&u16, src+i, 2); sum += u16;
+      memcpy(&u16, dst+i, 2); sum += u16;
+    }
+  sum += htons((uint16_t)(len >> 16));
+  sum += htons((uint16_t)(len & 0xffff));
+  sum += htons(nh);
+
+  for(i=0; i+1<len; i+=2)
+    {
+      memcpy(&u16, buf+i, 2);
+      sum += u16;
+    }
+  if(i < len)
+    {
+      u16 = 0;
+      memcpy(&u16, buf+i, 1);
+      sum += u16;
+    }
+
+  while(sum >> 16)
+    sum = (sum & 0xffff) + (sum >> 16);
+  return (uint16_t)~sum;
+}
+
+static simnet_resp_t *simnet_resp6(const simnet_probe_t *pr,
+				   const simnet_router_t *r, int isdst,
+				   uint8_t hop)
+{
+  simnet_resp_t *resp;
+  uint8_t type, code, *pkt, *q;
+  size_t len, qlen = 0;
+  uint16_t u16;
+
+  if(isdst == 0)
+    {
+      type = ICMP6_TIME_EXCEEDED;
+      code = ICMP6_TIME_EXCEED_TRANSIT;
+    }
+  else if(pr->proto == IPPROTO_UDP)
+    {
+      type = ICMP6_DST_UNREACH;
+      code = ICMP6_DST_UNREACH_NOPORT;
+    }
+  else if(pr->proto == IPPROTO_ICMPV6 && pr->translen >= 8 &&
+	  pr->trans[0] == ICMP6_ECHO_REQUEST)
+    {
+      type = ICMP6_ECHO_REPLY;
+      code = 0;
+    }
+  else return NULL;
+
+  /* quote as much of the probe as fits in the minimum MTU */
+  if(type != ICMP6_ECHO_REPLY)
+    {
+      qlen = 40 + pr->translen;
+      if(qlen > 1280 - 40 - 8)
+	qlen = 1280 - 40 - 8;
+      len = 8 + qlen;
+    }
+  else len = pr->translen;
+
+  if((resp = simnet_resp_alloc(AF_INET6, r->addr, len)) == NULL)
+    return NULL;
+  pkt = resp->pkt;
+  resp->hlim = (isdst != 0 ? 64 : 255) - (hop - 1);
+
+  if(qlen == 0)
+    {
+      memcpy(pkt, pr->trans, pr->translen);
+      pkt[0] = type;
+    }
+  else
+    {
+      pkt[0] = type;
+      pkt[1] = code;
+      q = pkt + 8;
+      q[0] = 0x60 | (pr->tclass >> 4);
+      q[1] = (pr->tclass & 0x0f) << 4;
+      bytes_htons(q+4, pr->translen);
+      q[6] = pr->proto;
+      q[7] = isdst != 0 ? pr->ttl - hop + 1 : 1;
+      memcpy(q+8, pr->src, 16);
+      memcpy(q+24, pr->dst, 16);
+      memcpy(q+40, pr->trans, qlen - 40);
+    }
+
+  pkt[2] = pkt[3] = 0;
+  u16 = simnet_cksum6(r->addr, pr->src, IPPROTO_ICMPV6, pkt, len);
+  memcpy(pkt+2, &u16, 2);
+
+  return resp;
+}
+
+/*
+ * simnet_probe
+ *
+ * model what happens to the probe in the network, and queue the
+ * response, if any.
+ */
+static void simnet_probe(simnet_probe_t *pr, const struct timeval *now)
+{
+  simnet_router_t *r;
+  simnet_resp_t *resp;
+  uint8_t addr[16], *rtr, pathlen, hop, buf[37];
+  uint32_t range, resp_pct;
+  int bytes = pr->af == AF_INET ? 4 : 16;
+  int isdst;
+
+  if(config->simnet_loss > 0 && simnet_rand() % 100 < config->simnet_loss)
+    {
+      stats.lost++;
+      return;
+    }
+
+  /* the flow identifier is what a per-flow load balancer hashes on */
+  memcpy(buf, pr->src, 16);
+  memcpy(buf+16, pr->dst, 16);
+  buf[32] = pr->proto;
+  memset(buf+33, 0, 4);
+  memcpy(buf+33, pr->trans, pr->translen < 4 ? pr->translen : 4);
+  pr->flowid = simnet_hash(buf, sizeof(buf)) ^ SIMNET_SALT_FLOW;
+
+  if(config->simnet_hops_max > config->simnet_hops_min)
+    range = config->simnet_hops_max - config->simnet_hops_min + 1;
+  else
+    range = 1;
+  pathlen = config->simnet_hops_min +
+    simnet_hash_addr(SIMNET_SALT_PATH, pr->af, pr->dst,
+		     pr->af == AF_INET ? 24 : 48, 0) % range;
+
+  if(pr->ttl == 0)
+    {
+      stats.unresp++;
+      return;
+    }
+
+  if(pr->ttl < pathlen)
+    {
+      hop = pr->ttl;
+      simnet_hop_addr(pr, hop, addr);
+      rtr = addr;
+      resp_pct = config->simnet_hop_resp;
+      isdst = 0;
+    }
+  else
+    {
+      hop = pathlen;
+      rtr = pr->dst;
+      resp_pct = config->simnet_dst_resp;
+      isdst = 1;
+    }
+
+  if(simnet_hash_addr(SIMNET_SALT_RESP, pr->af, rtr, bytes * 8, 0) % 100 >=
+     resp_pct)
+    {
+      stats.unresp++;
+      return;
+    }
+
+  if((r = simnet_router_get(pr->af, rtr, now)) == NULL)
+    {
+      printerror(__func__, "could not get router");
+      return;
+    }
+  if(config->simnet_ratelimit > 0 && simnet_router_token(r, now) != 0)
+    {
+      stats.ratelimited++;
+      return;
+    }
+
+  if(pr->af == AF_INET)
+    resp = simnet_resp4(pr, r, isdst, hop, now);
+  else
+    resp = simnet_resp6(pr, r, isdst, hop);
+  if(resp == NULL)
+    {
+      stats.unhandled++;
+      return;
+    }
+
+  timeval_add_us(&resp->tv, now, hop * config->simnet_hop_rtt);
+  resp->id = resp_id++;
+  if(heap_insert(resps, resp) == NULL)
+    {
+      printerror(__func__, "could not queue response");
+      free(resp);
+    }
+
+  return;
+}
+
+static int simnet_probe_ip4(simnet_probe_t *pr, const uint8_t *buf,
+			    size_t len)
+{
+  size_t iphl;
+
+  if(len < 20 || (buf[0] >> 4) != 4)
+    return -1;
+  iphl = (buf[0] & 0xf) * 4;
+  if(iphl < 20 || len < iphl + 4)
+    return -1;
+
+  pr->tclass   = buf[1];
+  pr->ttl      = buf[8];
+  pr->proto    = buf[9];
+  memcpy(pr->src, buf+12, 4);
+  memcpy(pr->dst, buf+16, 4);
+  pr->ip       = buf;
+  pr->iplen    = iphl;
+  pr->trans    = buf + iphl;
+  pr->translen = len - iphl;
+
+  return 0;
+}
+
+static int simnet_probe_ip6(simnet_probe_t *pr, const simnet_sock_t *ss,
+			    const void *buf, size_t len,
+			    const struct sockaddr_in6 *sin6)
+{
+  size_t translen = len;
+  uint16_t u16;
+  uint8_t off;
+
+  if(ss->proto == IPPROTO_UDP)
+    translen += 8;
+  else if(ss->proto != IPPROTO_ICMPV6 || len < 4)
+    return -1;
+
+  if(txbuf_len < translen)
+    {
+      if(realloc_wrap((void **)&txbuf, translen) != 0)
+	return -1;
+      txbuf_len = translen;
+    }
+
+  pr->ttl    = ss->ttl;
+  pr->tclass = ss->tclass;
+  pr->proto  = ss->proto;
+  memcpy(pr->src, ss->src, 16);
+  memcpy(pr->dst, &sin6->sin6_addr, 16);
+
+  /*
+   * build the transport header the kernel would have built, with the
+   * checksum the kernel would have computed
+   */
+  if(ss->proto == IPPROTO_UDP)
+    {
+      bytes_htons(txbuf+0, ss->sport);
+      memcpy(txbuf+2, &sin6->sin6_port, 2);
+      bytes_htons(txbuf+4, translen);
+      txbuf[6] = txbuf[7] = 0;
+      memcpy(txbuf+8, buf, len);
+      off = 6;
+    }
+  else
+    {
+      memcpy(txbuf, buf, len);
+      txbuf[2] = txbuf[3] = 0;
+      off = 2;
+    }
+  u16 = simnet_cksum6(pr->src, pr->dst, pr->proto, txbuf, translen);
+  memcpy(txbuf+off, &u16, 2);
+
+  pr->trans    = txbuf;
+  pr->translen = translen;
+  return 0;
+}
+
+ssize_t scamper_simnet_sendto(int fd, const void *buf, size_t len,
+			      const struct sockaddr *to, socklen_t tolen)
+{
+  simnet_probe_t pr;
+  simnet_sock_t *ss;
+  struct timeval now;
+  int rc = -1;
+
+  if((ss = simnet_sock_find(fd)) == NULL)
+    {
+      errno = EBADF;
+      return -1;
+    }
+
+  stats.tx++;
+  memset(&pr, 0, sizeof(pr));
+  pr.af = ss->af;
+
+  if(ss->af == AF_INET && ss->hdrincl != 0)
+    rc = simnet_probe_ip4(&pr, buf, len);
+  else if(ss->af == AF_INET6 && ss->hdrincl == 0 &&
+	  to->sa_family == AF_INET6 && tolen >= sizeof(struct sockaddr_in6))
+    rc = simnet_probe_ip6(&pr, ss, buf, len,
+			  (const struct sockaddr_in6 *)to);
+
+  if(rc != 0)
+    {
+      stats.unhandled++;
+      return len;
+    }
+
+  gettimeofday_wrap(&now);
+  simnet_probe(&pr, &now);
+  return len;
+}
+
+ssize_t scamper_simnet_recvmsg(int fd, struct msghdr *msg)
+{
+  struct sockaddr_storage sas;
+  struct cmsghdr *cmsg;
+  struct msghdr m;
+  struct iovec iov[2];
+  simnet_hdr_t hdr;
+  socklen_t sl;
+  ssize_t rc;
+  size_t off = 0;
+  int hlim;
+
+  if(msg->msg_iovlen < 1)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  iov[0].iov_base = (void *)&hdr;
+  iov[0].iov_len  = sizeof(hdr);
+  iov[1].iov_base = msg->msg_iov[0].iov_base;
+  iov[1].iov_len  = msg->msg_iov[0].iov_len;
+  memset(&m, 0, sizeof(m));
+  m.msg_iov    = iov;
+  m.msg_iovlen = 2;
+
+  if((rc = recvmsg(fd, &m, 0)) == -1)
+    return -1;
+  if((size_t)rc < sizeof(hdr))
+    {
+      errno = EINVAL;
+      return -1;
+    }
+  rc -= sizeof(hdr);
+
+  if(msg->msg_name != NULL)
+    {
+      sockaddr_compose((struct sockaddr *)&sas, hdr.af, hdr.from, 0);
+      sl = hdr.af == AF_INET ?
+	sizeof(struct sockaddr_in) : sizeof(struct sockaddr_in6);
+      if(sl > msg->msg_namelen)
+	sl = msg->msg_namelen;
+      memcpy(msg->msg_name, &sas, sl);
+      msg->msg_namelen = sl;
+    }
+
+  /* supply the receive timestamp and hop limit as the kernel would */
+  if(msg->msg_control != NULL &&
+     msg->msg_controllen >= CMSG_SPACE(sizeof(struct timeval)))
+    {
+      memset(msg->msg_control, 0, msg->msg_controllen);
+      cmsg = (struct cmsghdr *)msg->msg_control;
+      cmsg->cmsg_level = SOL_SOCKET;
+      cmsg->cmsg_type  = SCM_TIMESTAMP;
+      cmsg->cmsg_len   = CMSG_LEN(sizeof(struct timeval));
+      memcpy(CMSG_DATA(cmsg), &hdr.rx, sizeof(struct timeval));
+      off = CMSG_SPACE(sizeof(struct timeval));
+
+#ifdef IPV6_HOPLIMIT
+      if(hdr.af == AF_INET6 &&
+	 msg->msg_controllen >= off + CMSG_SPACE(sizeof(int)))
+	{
+	  cmsg = (struct cmsghdr *)((uint8_t *)msg->msg_control + off);
+	  cmsg->cmsg_level = IPPROTO_IPV6;
+	  cmsg->cmsg_type  = IPV6_HOPLIMIT;
+	  cmsg->cmsg_len   = CMSG_LEN(sizeof(int));
+	  hlim = hdr.hlim;
+	  memcpy(CMSG_DATA(cmsg), &hlim, sizeof(int));
+	  off += CMSG_SPACE(sizeof(int));
+	}
+#endif
+    }
+  msg->msg_controllen = off;
+  msg->msg_flags = m.msg_flags;
+
+  return rc;
+}
+
+int scamper_simnet_setsockopt_int(int fd, int level, int opt, int val)
+{
+  simnet_sock_t *ss;
+
+  if((ss = simnet_sock_find(fd)) == NULL)
+    return setsockopt_int(fd, level, opt, val);
+
+  if((level == IPPROTO_IP && opt == IP_TTL) ||
+     (level == IPPROTO_IPV6 && opt == IPV6_UNICAST_HOPS))
+    ss->ttl = val;
+#ifdef IPV6_TCLASS
+  else if(level == IPPROTO_IPV6 && opt == IPV6_TCLASS)
+    ss->tclass = val;
+#endif
+
+  return 0;
+}
+
+const void *scamper_simnet_src(int af)
+{
+  if(af == AF_INET)
+    return &src4;
+  if(af == AF_INET6)
+    return &src6;
+  return NULL;
+}
+
+int scamper_simnet_open(int af, int proto, int hdrincl,
+			const void *addr, uint16_t sport)
+{
+  simnet_sock_t *ss = NULL;
+  int fds[2];
+
+  if(af != AF_INET && af != AF_INET6)
+    {
+      printerror_msg(__func__, "unsupported address family %d", af);
+      return -1;
+    }
+
+  if(socketpair(AF_UNIX, SOCK_DGRAM, 0, fds) != 0)
+    {
+      printerror(__func__, "could not socketpair");
+      return -1;
+    }
+
+  if((ss = malloc_zero(sizeof(simnet_sock_t))) == NULL)
+    {
+      printerror(__func__, "could not malloc sock");
+      close(fds[0]); close(fds[1]);
+      return -1;
+    }
+  ss->fd = fds[0];
+  ss->peer = fds[1];
+
+  if(setsockopt_raise(ss->fd, SOL_SOCKET, SO_RCVBUF, 1024 * 1024) != 0 ||
+     setsockopt_raise(ss->peer, SOL_SOCKET, SO_SNDBUF, 1024 * 1024) != 0)
+    {
+      printerror(__func__, "could not raise socket buffers");
+      goto err;
+    }
+
+  if(sport == 0)
+    {
+      sport = sport_next++;
+      if(sport_next == 0)
+	sport_next = 32768;
+    }
+
+  ss->af      = af;
+  ss->proto   = proto;
+  ss->hdrincl = hdrincl;
+  ss->sport   = sport;
+  ss->ttl     = 64;
+  if(addr == NULL)
+    addr = scamper_simnet_src(af);
+  memcpy(ss->src, addr, af == AF_INET ? 4 : 16);
+
+  if(realloc_wrap((void **)&socks, sizeof(simnet_sock_t *) * (sockc+1)) != 0)
+    {
+      printerror(__func__, "could not realloc socks");
+      goto err;
+    }
+  socks[sockc++] = ss;
+
+  return ss->fd;
+
+ err:
+  simnet_sock_free(ss);
+  return -1;
+}
+
+int scamper_simnet_sport(int fd, uint16_t *sport)
+{
+  simnet_sock_t *ss;
+  if((ss = simnet_sock_find(fd)) == NULL)
+    return -1;
+  *sport = ss->sport;
+  return 0;
+}
+
+int scamper_simnet_close(int fd)
+{
+  size_t i;
+
+  for(i=0; i<sockc; i++)
+    if(socks[i]->fd == fd)
+      break;
+  if(i == sockc)
+    return -1;
+
+  simnet_sock_free(socks[i]);
+  socks[i] = socks[--sockc];
+  return 0;
+}
+
+static void simnet_deliver(const simnet_resp_t *resp)
+{
+  simnet_sock_t *ss;
+  simnet_hdr_t hdr;
+  struct iovec iov[2];
+  struct msghdr msg;
+
+  if((ss = simnet_sock_icmp(resp->af)) == NULL)
+    {
+      stats.overflow++;
+      return;
+    }
+
+  memset(&hdr, 0, sizeof(hdr));
+  timeval_cpy(&hdr.rx, &resp->tv);
+  hdr.af = resp->af;
+  hdr.hlim = resp->hlim;
+  memcpy(hdr.from, resp->from, sizeof(hdr.from));
+
+  iov[0].iov_base = (void *)&hdr;
+  iov[0].iov_len  = sizeof(hdr);
+  iov[1].iov_base = resp->pkt;
+  iov[1].iov_len  = resp->len;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov    = iov;
+  msg.msg_iovlen = 2;
+
+  if(sendmsg(ss->peer, &msg, MSG_DONTWAIT) == -1)
+    stats.overflow++;
+  else
+    stats.rx++;
+
+  return;
+}
+
+void scamper_simnet_run(const struct timeval *now)
+{
+  simnet_resp_t *resp;
+
+  while((resp = heap_head_item(resps)) != NULL &&
+	timeval_cmp(&resp->tv, now) <= 0)
+    {
+      heap_remove(resps);
+      simnet_deliver(resp);
+      free(resp);
+    }
+
+  return;
+}
+
+int scamper_simnet_waittime(struct timeval *tv)
+{
+  simnet_resp_t *resp;
+  if((resp = heap_head_item(resps)) == NULL)
+    return 0;
+  timeval_cpy(tv, &resp->tv);
+  return 1;
+}
+
+void scamper_simnet_stats_get(scamper_simnet_stats_t *out)
+{
+  memcpy(out, &stats, sizeof(scamper_simnet_stats_t));
+  return;
+}
+
+void scamper_simnet_stats_print(void)
+{
+  struct rusage ru;
+  double us;
+
+  if(stats.tx == 0 || getrusage(RUSAGE_SELF, &ru) != 0)
+    return;
+
+  us = ((ru.ru_utime.tv_sec - ru_start.ru_utime.tv_sec) +
+	(ru.ru_stime.tv_sec - ru_start.ru_stime.tv_sec)) * 1000000.0 +
+    ((ru.ru_utime.tv_usec - ru_start.ru_utime.tv_usec) +
+     (ru.ru_stime.tv_usec - ru_start.ru_stime.tv_usec));
+  fprintf(stderr,
+	  "simnet: tx %u rx %u lost %u unresp %u ratelimited %u"
+	  " overflow %u unhandled %u\n",
+	  stats.tx, stats.rx, stats.lost, stats.unresp,
+	  stats.ratelimited, stats.overflow, stats.unhandled);
+  fprintf(stderr, "simnet: %.2f us cpu per probe, maxrss %ld\n",
+	  us / stats.tx, (long)ru.ru_maxrss);
+  return;
+}
+
+void scamper_simnet_cleanup(void)
+{
+  size_t i;
+
+  if(resps != NULL)
+    {
+      heap_free(resps, free);
+      resps = NULL;
+    }
+  if(routers != NULL)
+    {
+      splaytree_free(routers, free);
+      routers = NULL;
+    }
+  if(socks != NULL)
+    {
+      for(i=0; i<sockc; i++)
+	simnet_sock_free(socks[i]);
+      free(socks);
+      socks = NULL;
+      sockc = 0;
+    }
+  if(txbuf != NULL)
+    {
+      free(txbuf);
+      txbuf = NULL;
+      txbuf_len = 0;
+    }
+
+  return;
+}
+
+int scamper_simnet_init(void)
+{
+  memset(&stats, 0, sizeof(stats));
+  memset(&src6, 0, sizeof(src6));
+
+  /* probes come from the documentation prefixes */
+  src4.s_addr = htonl(0xc0000201);
+  src6.s6_addr[0] = 0x20;
+  src6.s6_addr[1] = 0x01;
+  src6.s6_addr[2] = 0x0d;
+  src6.s6_addr[3] = 0xb8;
+  src6.s6_addr[15] = 1;
+
+  if((prng = config->simnet_seed) == 0)
+    prng = 1;
+  resp_id = 0;
+  sport_next = 32768;
+
+  if((routers = splaytree_alloc(simnet_router_cmp)) == NULL ||
+     (resps = heap_alloc(simnet_resp_cmp)) == NULL)
+    {
+      printerror(__func__, "could not alloc state");
+      return -1;
+    }
+
+  getrusage(RUSAGE_SELF, &ru_start);
+  return 0;
+}
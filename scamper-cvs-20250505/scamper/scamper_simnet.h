@@ -0,0 +1,62 @@
+/*
+ * scamper_simnet.h
+ *
+ * $Id$
+ *
+ * Copyright (C) 2025 The Regents of the University of California
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef __SCAMPER_SIMNET_H
+#define __SCAMPER_SIMNET_H
+
+typedef struct scamper_simnet_stats
+{
+  uint32_t tx;          /* probes sent into the simulated network */
+  uint32_t rx;          /* responses delivered to scamper's sockets */
+  uint32_t lost;        /* probes dropped by random loss */
+  uint32_t unresp;      /* probes reaching an unresponsive node */
+  uint32_t ratelimited; /* responses suppressed by rate limiting */
+  uint32_t overflow;    /* responses that could not be delivered */
+  uint32_t unhandled;   /* probes the simulated network does not model */
+} scamper_simnet_stats_t;
+
+/* open / close a simulated socket in place of a raw or datagram socket */
+int scamper_simnet_open(int af, int proto, int hdrincl,
+			const void *addr, uint16_t sport);
+int scamper_simnet_sport(int fd, uint16_t *sport);
+int scamper_simnet_close(int fd);
+
+/* replacements for the socket calls made by the probe / receive code */
+ssize_t scamper_simnet_sendto(int fd, const void *buf, size_t len,
+			      const struct sockaddr *to, socklen_t tolen);
+ssize_t scamper_simnet_recvmsg(int fd, struct msghdr *msg);
+int scamper_simnet_setsockopt_int(int fd, int level, int opt, int val);
+
+/* the source address that probes into the simulated network come from */
+const void *scamper_simnet_src(int af);
+
+/* when the next response is due, and deliver responses that are due */
+int scamper_simnet_waittime(struct timeval *tv);
+void scamper_simnet_run(const struct timeval *now);
+
+void scamper_simnet_stats_get(scamper_simnet_stats_t *stats);
+void scamper_simnet_stats_print(void);
+
+int scamper_simnet_init(void);
+void scamper_simnet_cleanup(void);
+
+#endif /* __SCAMPER_SIMNET_H */
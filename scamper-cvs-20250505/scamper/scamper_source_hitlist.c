@@ -0,0 +1,749 @@
+/*
+ * scamper_source_hitlist.c
+ *
+ * $Id$
+ *
+ * Copyright (C) 2025 The Regents of the University of California
+ *
+ * a source that walks a large list of addresses and prefixes without
+ * reading the list into memory.  the list is mapped into memory, and
+ * tasks are made from a cursor as the source is asked for more work.
+ * when the list is shuffled, the order is a walk of the cyclic group
+ * of integers modulo a prime larger than the number of addresses in
+ * the list, with a different generator and starting point each cycle.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include "internal.h"
+
+#include "scamper.h"
+#include "scamper_debug.h"
+#include "scamper_outfiles.h"
+#include "scamper_task.h"
+#include "scamper_sources.h"
+#include "scamper_priv.h"
+#include "scamper_source_hitlist.h"
+
+#include "utils.h"
+
+/* the largest prime less than 2^32, so that products fit in 64 bits */
+#define HITLIST_PRIME_MAX 4294967291ULL
+
+/* the longest command that can be combined with an address */
+#define HITLIST_CMD_MAX   448
+
+typedef struct hitlist_ent
+{
+  int              af;
+  uint8_t          addr[16];
+  uint64_t         count;
+} hitlist_ent_t;
+
+/*
+ * hitlist_perm
+ *
+ * p:     a prime larger than the number of addresses in the list
+ * g:     a generator of the multiplicative group of integers modulo p
+ * first: the first element of the walk
+ * cur:   the current element of the walk
+ */
+typedef struct hitlist_perm
+{
+  uint64_t         p;
+  uint64_t         g;
+  uint64_t         first;
+  uint64_t         cur;
+  uint8_t          started;
+} hitlist_perm_t;
+
+typedef struct scamper_source_hitlist
+{
+  /* back-pointer to the parent source */
+  scamper_source_t *source;
+
+  /* parameters for the hitlist */
+  char             *filename;
+  char             *command;
+  uint8_t           flags;
+  uint32_t          cycles;
+
+  /* the list, mapped into memory */
+  uint8_t          *map;
+  size_t            len;
+
+  /*
+   * the number of addresses in the list, when known.  when a text list
+   * is shuffled, the index records the offset of each of the entc
+   * entries in the list, and cum records the cumulative number of
+   * addresses through each entry if the list contains prefixes.
+   */
+  uint64_t          count;
+  uint64_t          entc;
+  uint32_t         *idx;
+  uint64_t         *cum;
+
+  /* run-time state */
+  size_t            off;
+  hitlist_ent_t     ent;
+  uint64_t          sub;
+  uint64_t          k;
+  uint64_t          made;
+  uint32_t          cycle;
+  hitlist_perm_t    perm;
+  uint8_t           tmpl[2];
+  uint8_t           finished;
+} scamper_source_hitlist_t;
+
+static int is_prime(uint64_t n)
+{
+  uint64_t d;
+
+  if(n < 2)
+    return 0;
+  if(n < 4)
+    return 1;
+  if((n & 1) == 0)
+    return 0;
+  for(d=3; d * d <= n; d += 2)
+    if(n % d == 0)
+      return 0;
+  return 1;
+}
+
+static uint64_t powmod(uint64_t b, uint64_t e, uint64_t m)
+{
+  uint64_t r = 1;
+
+  b %= m;
+  while(e > 0)
+    {
+      if(e & 1)
+	r = (r * b) % m;
+      b = (b * b) % m;
+      e >>= 1;
+    }
+  return r;
+}
+
+/*
+ * perm_init
+ *
+ * choose a prime larger than n, and a random generator and starting
+ * point for a walk of the cyclic group modulo that prime.
+ */
+static int perm_init(hitlist_perm_t *perm, uint64_t n)
+{
+  uint64_t p, q, x, f[16];
+  uint32_t r;
+  int i, fc = 0;
+
+  for(p = n + 1; is_prime(p) == 0; p++)
+    ;
+  if(p > HITLIST_PRIME_MAX)
+    return -1;
+
+  /* factor p-1, which has fewer than ten distinct prime factors */
+  x = p - 1;
+  for(q=2; q * q <= x; q++)
+    {
+      if(x % q != 0)
+	continue;
+      f[fc++] = q;
+      while(x % q == 0)
+	x /= q;
+    }
+  if(x > 1)
+    f[fc++] = x;
+
+  /* g is a generator if g^((p-1)/q) != 1 for each prime factor q of p-1 */
+  if(p <= 3)
+    perm->g = p - 1;
+  else
+    {
+      for(;;)
+	{
+	  if(random_u32(&r) != 0)
+	    return -1;
+	  perm->g = 2 + (r % (p - 3));
+	  for(i=0; i<fc; i++)
+	    if(powmod(perm->g, (p - 1) / f[i], p) == 1)
+	      break;
+	  if(i == fc)
+	    break;
+	}
+    }
+
+  if(random_u32(&r) != 0)
+    return -1;
+  perm->p = p;
+  perm->first = 1 + (r % (p - 1));
+  perm->cur = 0;
+  perm->started = 0;
+
+  return 0;
+}
+
+/*
+ * perm_next
+ *
+ * return the next integer in [0, n) in the walk, skipping elements of
+ * the group that are outside the range.  return zero when the walk
+ * has returned to its starting point.
+ */
+static int perm_next(hitlist_perm_t *perm, uint64_t n, uint64_t *k)
+{
+  if(n == 0)
+    return 0;
+
+  for(;;)
+    {
+      if(perm->started == 0)
+	{
+	  perm->cur = perm->first;
+	  perm->started = 1;
+	}
+      else
+	{
+	  perm->cur = (perm->cur * perm->g) % perm->p;
+	  if(perm->cur == perm->first)
+	    return 0;
+	}
+      if(perm->cur - 1 < n)
+	break;
+    }
+
+  *k = perm->cur - 1;
+  return 1;
+}
+
+/*
+ * ssh_entry
+ *
+ * parse a line containing an address or prefix.  return zero if the
+ * line is empty or a comment, one if it contains an entry, and -1 if
+ * the line could not be parsed.
+ */
+static int ssh_entry(const uint8_t *line, size_t len, hitlist_ent_t *ent)
+{
+  char buf[64], *pf;
+  size_t n;
+  long lo;
+  int i, bits;
+
+  n = len < sizeof(buf) - 1 ? len : sizeof(buf) - 1;
+  memcpy(buf, line, n);
+  buf[n] = '\0';
+  string_nullterm(buf, " \r\t#", NULL);
+  if(buf[0] == '\0')
+    return 0;
+  if(len >= sizeof(buf) - 1 && strlen(buf) == n)
+    return -1;
+
+  if((pf = strchr(buf, '/')) != NULL)
+    *pf++ = '\0';
+
+  if(strchr(buf, ':') != NULL)
+    {
+      ent->af = AF_INET6;
+      bits = 128;
+    }
+  else
+    {
+      ent->af = AF_INET;
+      bits = 32;
+    }
+  if(inet_pton(ent->af, buf, ent->addr) != 1)
+    return -1;
+
+  ent->count = 1;
+  if(pf != NULL)
+    {
+      /* prefixes may expand to at most 2^32 addresses */
+      if(string_tolong(pf, &lo) != 0 || lo < bits - 32 || lo > bits)
+	return -1;
+      for(i=(int)lo; i<bits; i++)
+	ent->addr[i/8] &= ~(0x80 >> (i%8));
+      ent->count = (uint64_t)1 << (bits - lo);
+    }
+
+  return 1;
+}
+
+static void ssh_entry_addr(const hitlist_ent_t *ent, uint64_t sub,
+			   uint8_t *addr)
+{
+  size_t al = ent->af == AF_INET ? 4 : 16;
+  memcpy(addr, ent->addr, al);
+  if(sub > 0)
+    bytes_htonl(addr + al - 4, bytes_ntohl(addr + al - 4) + (uint32_t)sub);
+  return;
+}
+
+static size_t ssh_line_len(const scamper_source_hitlist_t *ssh, size_t off)
+{
+  const uint8_t *ptr;
+  if((ptr = memchr(ssh->map + off, '\n', ssh->len - off)) != NULL)
+    return ptr - (ssh->map + off);
+  return ssh->len - off;
+}
+
+static int ssh_line_next(scamper_source_hitlist_t *ssh,
+			 const uint8_t **line, size_t *len)
+{
+  if(ssh->off >= ssh->len)
+    return 0;
+  *line = ssh->map + ssh->off;
+  *len = ssh_line_len(ssh, ssh->off);
+  ssh->off += *len + 1;
+  return 1;
+}
+
+/*
+ * ssh_index
+ *
+ * record where each entry in a text list begins so that the entries
+ * can be visited in any order.
+ */
+static int ssh_index(scamper_source_hitlist_t *ssh)
+{
+  hitlist_ent_t ent;
+  const uint8_t *line;
+  uint64_t entc = 0, e = 0, c = 0;
+  size_t len;
+  int rc, pfx = 0;
+
+  if(ssh->len > UINT32_MAX)
+    {
+      printerror_msg(__func__, "%s too large to shuffle as text",
+		     ssh->filename);
+      return -1;
+    }
+
+  /* count the entries, and determine if any are prefixes */
+  ssh->off = 0;
+  while(ssh_line_next(ssh, &line, &len) != 0)
+    {
+      if((rc = ssh_entry(line, len, &ent)) < 0)
+	printerror_msg(__func__, "invalid entry in %s at offset %u",
+		       ssh->filename, (uint32_t)(line - ssh->map));
+      if(rc <= 0)
+	continue;
+      entc++;
+      if(ent.count > 1)
+	pfx = 1;
+    }
+  if(entc == 0)
+    return 0;
+
+  if((ssh->idx = malloc(sizeof(uint32_t) * entc)) == NULL ||
+     (pfx != 0 && (ssh->cum = malloc(sizeof(uint64_t) * entc)) == NULL))
+    {
+      printerror(__func__, "could not malloc index");
+      return -1;
+    }
+
+  ssh->off = 0;
+  while(ssh_line_next(ssh, &line, &len) != 0)
+    {
+      if(ssh_entry(line, len, &ent) <= 0)
+	continue;
+      ssh->idx[e] = (uint32_t)(line - ssh->map);
+      c += ent.count;
+      if(ssh->cum != NULL)
+	ssh->cum[e] = c;
+      e++;
+    }
+  ssh->entc = entc;
+  ssh->count = c;
+
+  return 0;
+}
+
+/*
+ * ssh_next
+ *
+ * get the next address to probe in this cycle.  return zero when the
+ * cycle is complete.
+ */
+static int ssh_next(scamper_source_hitlist_t *ssh, int *af, uint8_t *addr)
+{
+  hitlist_ent_t ent;
+  const uint8_t *line;
+  uint64_t k, e, lo, hi;
+  size_t len;
+  int rc;
+
+  if(ssh->flags & SCAMPER_SOURCE_HITLIST_FLAG_BINARY)
+    {
+      if(ssh->flags & SCAMPER_SOURCE_HITLIST_FLAG_SHUFFLE)
+	{
+	  if(perm_next(&ssh->perm, ssh->count, &k) == 0)
+	    return 0;
+	}
+      else
+	{
+	  if(ssh->k >= ssh->count)
+	    return 0;
+	  k = ssh->k++;
+	}
+      *af = AF_INET;
+      memcpy(addr, ssh->map + (k * 4), 4);
+      return 1;
+    }
+
+  if(ssh->flags & SCAMPER_SOURCE_HITLIST_FLAG_SHUFFLE)
+    {
+      if(perm_next(&ssh->perm, ssh->count, &k) == 0)
+	return 0;
+
+      /* find the entry containing the k-th address in the list */
+      if(ssh->cum == NULL)
+	{
+	  e = k;
+	  k = 0;
+	}
+      else
+	{
+	  lo = 0; hi = ssh->entc;
+	  while(lo < hi)
+	    {
+	      e = lo + ((hi - lo) / 2);
+	      if(ssh->cum[e] <= k)
+		lo = e + 1;
+	      else
+		hi = e;
+	    }
+	  e = lo;
+	  if(e > 0)
+	    k -= ssh->cum[e-1];
+	}
+
+      len = ssh_line_len(ssh, ssh->idx[e]);
+      rc = ssh_entry(ssh->map + ssh->idx[e], len, &ent);
+      assert(rc == 1);
+      *af = ent.af;
+      ssh_entry_addr(&ent, k, addr);
+      return 1;
+    }
+
+  while(ssh->sub >= ssh->ent.count)
+    {
+      if(ssh_line_next(ssh, &line, &len) == 0)
+	return 0;
+      if((rc = ssh_entry(line, len, &ssh->ent)) < 0)
+	printerror_msg(__func__, "invalid entry in %s at offset %u",
+		       ssh->filename, (uint32_t)(line - ssh->map));
+      if(rc <= 0)
+	{
+	  ssh->ent.count = 0;
+	  continue;
+	}
+      ssh->sub = 0;
+    }
+
+  *af = ssh->ent.af;
+  ssh_entry_addr(&ssh->ent, ssh->sub++, addr);
+  return 1;
+}
+
+/*
+ * ssh_rewind
+ *
+ * reset the cursor to the start of the list for a new cycle.  a
+ * shuffled list gets a new order.
+ */
+static int ssh_rewind(scamper_source_hitlist_t *ssh)
+{
+  ssh->off = 0;
+  ssh->ent.count = 0;
+  ssh->sub = 0;
+  ssh->k = 0;
+  ssh->made = 0;
+
+  if((ssh->flags & SCAMPER_SOURCE_HITLIST_FLAG_SHUFFLE) &&
+     perm_init(&ssh->perm, ssh->count) != 0)
+    {
+      printerror_msg(__func__, "could not shuffle %s", ssh->filename);
+      return -1;
+    }
+
+  return 0;
+}
+
+/*
+ * ssh_target
+ *
+ * add a command for the address to the source.  the command is
+ * parsed once per address family into a template if the command
+ * supports templates.
+ */
+static int ssh_target(scamper_source_hitlist_t *ssh, int af,
+		      const uint8_t *addr)
+{
+  char a[64], name[16], buf[512], errbuf[256];
+  int i = af == AF_INET ? 0 : 1;
+
+  if(addr_tostr(af, addr, a, sizeof(a)) == NULL)
+    return -1;
+  snprintf(name, sizeof(name), "hitlist%d", af == AF_INET ? 4 : 6);
+
+  if(ssh->tmpl[i] == 0)
+    {
+      snprintf(buf, sizeof(buf), "%s %s", ssh->command, a);
+      if(scamper_source_tmpl_add(ssh->source, name, buf,
+				 errbuf, sizeof(errbuf)) == 0)
+	ssh->tmpl[i] = 1;
+      else
+	{
+	  scamper_debug(__func__, "%s", errbuf);
+	  ssh->tmpl[i] = 2;
+	}
+    }
+
+  if(ssh->tmpl[i] == 1)
+    snprintf(buf, sizeof(buf), "@%s %s", name, a);
+  else
+    snprintf(buf, sizeof(buf), "%s %s", ssh->command, a);
+
+  return scamper_source_command(ssh->source, buf);
+}
+
+static void ssh_free(scamper_source_hitlist_t *ssh)
+{
+  if(ssh->map != NULL)
+    {
+#ifdef HAVE_MMAP
+      munmap(ssh->map, ssh->len);
+#else
+      free(ssh->map);
+#endif
+    }
+  if(ssh->idx != NULL) free(ssh->idx);
+  if(ssh->cum != NULL) free(ssh->cum);
+  if(ssh->filename != NULL) free(ssh->filename);
+  if(ssh->command != NULL) free(ssh->command);
+  free(ssh);
+  return;
+}
+
+/*
+ * ssh_take
+ *
+ * add commands to the source from the cursor, so long as the source
+ * does not already have enough queued.
+ */
+static int ssh_take(void *data)
+{
+  scamper_source_hitlist_t *ssh = (scamper_source_hitlist_t *)data;
+  scamper_source_t *source = ssh->source;
+  uint8_t addr[16];
+  int af;
+
+  while(ssh->finished == 0 &&
+	scamper_source_getcommandcount(source) < scamper_option_pps_get())
+    {
+      if(ssh_next(ssh, &af, addr) != 0)
+	{
+	  if(ssh_target(ssh, af, addr) == 0)
+	    ssh->made++;
+	  continue;
+	}
+
+      /*
+       * reached the end of the list.  stop if this was the last cycle,
+       * or if no tasks could be made from the list.
+       */
+      ssh->cycle++;
+      if(ssh->made == 0 || (ssh->cycles != 0 && ssh->cycle >= ssh->cycles) ||
+	 scamper_source_cycle(source) != 0 || ssh_rewind(ssh) != 0)
+	ssh->finished = 1;
+    }
+
+  return 0;
+}
+
+static void ssh_freedata(void *data)
+{
+  ssh_free((scamper_source_hitlist_t *)data);
+  return;
+}
+
+static int ssh_isfinished(void *data)
+{
+  scamper_source_hitlist_t *ssh = (scamper_source_hitlist_t *)data;
+  return ssh->finished;
+}
+
+/*
+ * ssh_tostr
+ *
+ * this function generates a printable representation of the source
+ */
+static char *ssh_tostr(void *data, char *str, size_t len)
+{
+  scamper_source_hitlist_t *ssh = (scamper_source_hitlist_t *)data;
+  size_t off = 0;
+
+  if(len < 1)
+    return NULL;
+
+  string_concat(str, len, &off, "type hitlist");
+  string_concat3(str, len, &off, " file \"", ssh->filename, "\"");
+  string_concat3(str, len, &off, " cmd \"", ssh->command, "\"");
+  string_concaf(str, len, &off, " cycle %u", ssh->cycle + 1);
+  if(ssh->cycles != 0)
+    string_concaf(str, len, &off, "/%u", ssh->cycles);
+  if(ssh->flags & SCAMPER_SOURCE_HITLIST_FLAG_SHUFFLE)
+    string_concat(str, len, &off, " shuffle");
+
+  return str;
+}
+
+const char *scamper_source_hitlist_getfilename(const scamper_source_t *source)
+{
+  scamper_source_hitlist_t *ssh;
+  if((ssh = scamper_source_getdata(source)) != NULL)
+    return ssh->filename;
+  return NULL;
+}
+
+scamper_source_t *scamper_source_hitlist_alloc(scamper_source_params_t *ssp,
+					       const char *filename,
+					       const char *command,
+					       uint8_t flags, uint32_t cycles)
+{
+  scamper_source_hitlist_t *ssh = NULL;
+  struct stat sb;
+  int fd = -1;
+#ifndef HAVE_MMAP
+  size_t off;
+  ssize_t rc;
+#endif
+
+  /* sanity checks */
+  if(ssp == NULL || filename == NULL || command == NULL)
+    goto err;
+  if(string_isdash(filename) != 0)
+    {
+      printerror_msg(__func__, "cannot read a hitlist from stdin");
+      goto err;
+    }
+  if(strlen(command) > HITLIST_CMD_MAX)
+    {
+      printerror_msg(__func__, "command too long");
+      goto err;
+    }
+
+  if((ssh = malloc_zero(sizeof(scamper_source_hitlist_t))) == NULL ||
+     (ssh->filename = strdup(filename)) == NULL ||
+     (ssh->command = strdup(command)) == NULL)
+    {
+      printerror(__func__, "could not alloc hitlist");
+      goto err;
+    }
+  ssh->flags = flags;
+  ssh->cycles = cycles;
+
+  if((fd = scamper_priv_open(filename, O_RDONLY, 0)) == -1)
+    {
+      printerror(__func__, "could not open %s", filename);
+      goto err;
+    }
+  if(fstat(fd, &sb) != 0)
+    {
+      printerror(__func__, "could not fstat %s", filename);
+      goto err;
+    }
+  ssh->len = (size_t)sb.st_size;
+
+  if(ssh->len > 0)
+    {
+#ifdef HAVE_MMAP
+      ssh->map = mmap(NULL, ssh->len, PROT_READ, MAP_PRIVATE, fd, 0);
+      if(ssh->map == MAP_FAILED)
+	{
+	  ssh->map = NULL;
+	  printerror(__func__, "could not mmap %s", filename);
+	  goto err;
+	}
+#if defined(HAVE_MADVISE) && defined(MADV_RANDOM) && defined(MADV_SEQUENTIAL)
+      madvise(ssh->map, ssh->len,
+	      (flags & SCAMPER_SOURCE_HITLIST_FLAG_SHUFFLE) ?
+	      MADV_RANDOM : MADV_SEQUENTIAL);
+#endif
+#else
+      if((ssh->map = malloc(ssh->len)) == NULL)
+	{
+	  printerror(__func__, "could not malloc %s", filename);
+	  goto err;
+	}
+      for(off=0; off < ssh->len; off += (size_t)rc)
+	{
+	  if((rc = read(fd, ssh->map + off, ssh->len - off)) <= 0)
+	    {
+	      printerror(__func__, "could not read %s", filename);
+	      goto err;
+	    }
+	}
+#endif
+    }
+  close(fd); fd = -1;
+
+  if(flags & SCAMPER_SOURCE_HITLIST_FLAG_BINARY)
+    {
+      if(ssh->len % 4 != 0)
+	{
+	  printerror_msg(__func__, "%s is not a list of IPv4 addresses",
+			 filename);
+	  goto err;
+	}
+      ssh->count = ssh->len / 4;
+    }
+  else if((flags & SCAMPER_SOURCE_HITLIST_FLAG_SHUFFLE) &&
+	  ssh_index(ssh) != 0)
+    goto err;
+
+  if(ssh_rewind(ssh) != 0)
+    goto err;
+
+  /*
+   * data and callback functions that scamper_source_alloc needs to know about
+   */
+  ssp->data        = ssh;
+  ssp->take        = ssh_take;
+  ssp->freedata    = ssh_freedata;
+  ssp->isfinished  = ssh_isfinished;
+  ssp->tostr       = ssh_tostr;
+  ssp->type        = SCAMPER_SOURCE_TYPE_HITLIST;
+
+  /* allocate the parent source structure */
+  if((ssh->source = scamper_source_alloc(ssp)) == NULL)
+    goto err;
+
+  return ssh->source;
+
+ err:
+  if(fd != -1) close(fd);
+  if(ssh != NULL)
+    {
+      assert(ssh->source == NULL);
+      ssh_free(ssh);
+    }
+  return NULL;
+}
@@ -0,0 +1,36 @@
+/*
+ * scamper_source_hitlist.h
+ *
+ * $Id$
+ *
+ * Copyright (C) 2025 The Regents of the University of California
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef __SCAMPER_SOURCE_HITLIST_H
+#define __SCAMPER_SOURCE_HITLIST_H
+
+#define SCAMPER_SOURCE_HITLIST_FLAG_BINARY  0x01 /* packed IPv4 addresses */
+#define SCAMPER_SOURCE_HITLIST_FLAG_SHUFFLE 0x02 /* random order per cycle */
+
+scamper_source_t *scamper_source_hitlist_alloc(scamper_source_params_t *ssp,
+					       const char *filename,
+					       const char *command,
+					       uint8_t flags, uint32_t cycles);
+
+const char *scamper_source_hitlist_getfilename(const scamper_source_t *source);
+
+#endif /* __SCAMPER_SOURCE_HITLIST_H */
@@ -88,6 +88,7 @@
 
 #include "utils.h"
 #include "mjl_list.h"
+#include "mjl_heap.h"
 #include "mjl_splaytree.h"
 
 /*
@@ -106,6 +107,9 @@ struct scamper_source
 
   /* properties of the source */
   uint32_t                      priority;
+  uint32_t                      window;
+  uint32_t                      pps;
+  uint8_t                       paused;
   int                           type;
   int                           refcnt;
   scamper_outfile_t            *sof;
@@ -118,16 +122,38 @@ struct scamper_source
    * tasks:        a list of tasks currently active from the source.
    * id:           the next id number to assign
    * idtree:       a tree of id numbers currently in use
+   * tmpls:        a tree of named command templates
    */
   dlist_t                      *commands;
   int                           cycle_points;
   dlist_t                      *tasks;
   uint32_t                      id;
   splaytree_t                  *idtree;
+  splaytree_t                  *tmpls;
 
   /*
-   * nodes to keep track of whether the source is in the active or blocked
-   * lists, and a node to keep track of the source in a splaytree
+   * scheduling state:
+   *
+   * pass:      virtual time of the source; the source with the smallest
+   *            pass is offered the next probe slot.
+   * stride:    how far pass advances for each probe sent.
+   * seq:       order the source joined the active heap, to break ties.
+   * tat:       when the source may next be offered a task under its pps cap.
+   * inflight:  the number of tasks handed to the probing process.
+   * task_cnt:  the number of tasks the source has been given.
+   * probe_cnt: the number of probes sent for the source's tasks.
+   */
+  uint64_t                      pass;
+  uint64_t                      stride;
+  uint32_t                      seq;
+  struct timeval                tat;
+  uint32_t                      inflight;
+  uint64_t                      task_cnt;
+  uint64_t                      probe_cnt;
+
+  /*
+   * nodes to keep track of whether the source is in the active, paced,
+   * or blocked lists, and a node to keep track of the source in a splaytree
    */
   void                         *list_;
   void                         *list_node;
@@ -148,6 +174,7 @@ struct scamper_sourcetask
   dlist_node_t     *node;
   uint32_t          id;
   splaytree_node_t *idnode;
+  uint8_t           started;
 };
 
 /*
@@ -167,8 +194,25 @@ typedef struct command_func
   void            (*freedata)(void *data);
   uint32_t        (*userid)(void *data);
   int             (*enabled)(void);
+  void           *(*tmplalloc)(char *cmd, char *errbuf, size_t errlen);
+  void           *(*tmpldata)(const void *tmpl, const char *addr,
+			      char *errbuf, size_t errlen);
+  void            (*tmplfree)(void *tmpl);
 } command_func_t;
 
+/*
+ * command_tmpl
+ *
+ * a command parsed once and kept by name, so that tasks can be made
+ * from it by supplying only the destination.
+ */
+typedef struct command_tmpl
+{
+  char                 *name;
+  const command_func_t *func;
+  void                 *tmpl;
+} command_tmpl_t;
+
 static const command_func_t command_funcs[] = {
 #ifndef DISABLE_SCAMPER_TRACE
   {
@@ -178,6 +222,9 @@ static const command_func_t command_funcs[] = {
     scamper_do_trace_free,
     scamper_do_trace_userid,
     scamper_do_trace_enabled,
+    NULL,
+    NULL,
+    NULL,
   },
 #endif
 #ifndef DISABLE_SCAMPER_PING
@@ -188,6 +235,9 @@ static const command_func_t command_funcs[] = {
     scamper_do_ping_free,
     scamper_do_ping_userid,
     scamper_do_ping_enabled,
+    scamper_do_ping_tmpl_alloc,
+    scamper_do_ping_tmpl_data,
+    scamper_do_ping_tmpl_free,
   },
 #endif
 #ifndef DISABLE_SCAMPER_TRACELB
@@ -198,6 +248,9 @@ static const command_func_t command_funcs[] = {
     scamper_do_tracelb_free,
     scamper_do_tracelb_userid,
     scamper_do_tracelb_enabled,
+    NULL,
+    NULL,
+    NULL,
   },
 #endif
 #ifndef DISABLE_SCAMPER_DEALIAS
@@ -208,6 +261,9 @@ static const command_func_t command_funcs[] = {
     scamper_do_dealias_free,
     scamper_do_dealias_userid,
     scamper_do_dealias_enabled,
+    NULL,
+    NULL,
+    NULL,
   },
 #endif
   {
@@ -217,6 +273,9 @@ static const command_func_t command_funcs[] = {
     scamper_do_neighbourdisc_free,
     scamper_do_neighbourdisc_userid,
     scamper_do_neighbourdisc_enabled,
+    NULL,
+    NULL,
+    NULL,
   },
 #ifndef DISABLE_SCAMPER_TBIT
   {
@@ -226,6 +285,9 @@ static const command_func_t command_funcs[] = {
     scamper_do_tbit_free,
     scamper_do_tbit_userid,
     scamper_do_tbit_enabled,
+    NULL,
+    NULL,
+    NULL,
   },
 #endif
 #ifndef DISABLE_SCAMPER_STING
@@ -236,6 +298,9 @@ static const command_func_t command_funcs[] = {
     scamper_do_sting_free,
     scamper_do_sting_userid,
     scamper_do_sting_enabled,
+    NULL,
+    NULL,
+    NULL,
   },
 #endif
 #ifndef DISABLE_SCAMPER_SNIFF
@@ -246,6 +311,9 @@ static const command_func_t command_funcs[] = {
     scamper_do_sniff_free,
     scamper_do_sniff_userid,
     scamper_do_sniff_enabled,
+    NULL,
+    NULL,
+    NULL,
   },
 #endif
 #ifndef DISABLE_SCAMPER_HOST
@@ -256,6 +324,9 @@ static const command_func_t command_funcs[] = {
     scamper_do_host_free,
     scamper_do_host_userid,
     scamper_do_host_enabled,
+    NULL,
+    NULL,
+    NULL,
   },
 #endif
 #ifndef DISABLE_SCAMPER_HTTP
@@ -266,6 +337,9 @@ static const command_func_t command_funcs[] = {
     scamper_do_http_free,
     scamper_do_http_userid,
     scamper_do_http_enabled,
+    NULL,
+    NULL,
+    NULL,
   },
 #endif
 #ifndef DISABLE_SCAMPER_UDPPROBE
@@ -276,6 +350,9 @@ static const command_func_t command_funcs[] = {
     scamper_do_udpprobe_free,
     scamper_do_udpprobe_userid,
     scamper_do_udpprobe_enabled,
+    NULL,
+    NULL,
+    NULL,
   },
 #endif
 };
@@ -314,26 +391,36 @@ typedef struct command
 #define COMMAND_TYPE_MIN   0x00
 #define COMMAND_TYPE_MAX   0x02
 
+/*
+ * the stride of a source with priority 1.  a source with priority p
+ * advances its pass by SOURCE_STRIDE1 / p for each probe sent, so over
+ * time each source receives a share of probes proportional to its
+ * priority.
+ */
+#define SOURCE_STRIDE1     (1 << 20)
+
 /*
  * global variables for managing sources:
  *
- * a source is stored in one of two lists depending on its state.  it is
- * either stored in the active list, a round-robin circular list, or in
- * the blocked list.
+ * a source is stored in one of four places depending on its state.  it
+ * is either stored in the active heap, ordered by pass so that the
+ * source furthest behind its share is at the head; in the paced heap,
+ * ordered by the time the source is next allowed to start a task under
+ * its pps cap; in the blocked list; or in the finished list.
  *
- * the source, if any, currently being used (that is, has not used up its
- * priority quantum) is pointed to by source_cur.  the number of tasks that
- * have been read from the current source in this rotation is held in
- * source_cnt.
+ * source_pass is the pass of the source most recently selected, which
+ * a source joining the active heap starts from so that it cannot claim
+ * probe slots for the time it was not active.
  *
  * the sources are stored in a tree that is searchable by name.
  */
-static clist_t          *active      = NULL;
+static heap_t           *active      = NULL;
+static heap_t           *paced       = NULL;
 static dlist_t          *blocked     = NULL;
 static dlist_t          *finished    = NULL;
-static scamper_source_t *source_cur  = NULL;
-static uint32_t          source_cnt  = 0;
 static splaytree_t      *source_tree = NULL;
+static uint64_t          source_pass = 0;
+static uint32_t          source_seq  = 0;
 
 /* forward declare */
 static void source_free(scamper_source_t *source);
@@ -387,7 +474,8 @@ static int source_assert(void *item, void *param)
 
   /* make sure the list pointer makes sense */
   assert(s->list_ != NULL);
-  assert(s->list_ == active || s->list_ == blocked || s->list_ == finished);
+  assert(s->list_ == active || s->list_ == paced ||
+	 s->list_ == blocked || s->list_ == finished);
   assert(s->list_ == param);
 
   /* sanity check queued commands */
@@ -399,10 +487,18 @@ static int source_assert(void *item, void *param)
   return 0;
 }
 
+static void source_assert_heap(void *param, void *item)
+{
+  source_assert(item, param);
+  return;
+}
+
 static void sources_assert(void)
 {
   assert(active != NULL);
-  clist_foreach(active, source_assert, active);
+  heap_foreach(active, active, source_assert_heap);
+  assert(paced != NULL);
+  heap_foreach(paced, paced, source_assert_heap);
   assert(blocked != NULL);
   dlist_foreach(blocked, source_assert, blocked);
   assert(finished != NULL);
@@ -437,6 +533,19 @@ static scamper_sourcetask_t *sourcetask_alloc(scamper_source_t *source,
   return NULL;
 }
 
+static int command_tmpl_cmp(const command_tmpl_t *a, const command_tmpl_t *b)
+{
+  return strcmp(a->name, b->name);
+}
+
+static void command_tmpl_free(command_tmpl_t *ct)
+{
+  if(ct->name != NULL) free(ct->name);
+  if(ct->tmpl != NULL) ct->func->tmplfree(ct->tmpl);
+  free(ct);
+  return;
+}
+
 static int idtree_cmp(const scamper_sourcetask_t *a,
 		      const scamper_sourcetask_t *b)
 {
@@ -495,46 +604,77 @@ static int command_cycle(scamper_source_t *source, scamper_cycle_t *cycle)
 }
 
 /*
- * source_next
+ * source_active_cmp
+ *
+ * order the active heap so that the source with the smallest pass is at
+ * the head.  sources with the same pass are ordered by when they joined.
+ */
+static int source_active_cmp(const scamper_source_t *a,
+			     const scamper_source_t *b)
+{
+  if(a->pass < b->pass) return 1;
+  if(a->pass > b->pass) return -1;
+  if(a->seq != b->seq)
+    return (int32_t)(b->seq - a->seq) > 0 ? 1 : -1;
+  return 0;
+}
+
+/*
+ * source_paced_cmp
  *
- * advance to the next source to read addresses from, and reset the
- * current count of how many addresses have been returned off the list
- * for this source-cycle
+ * order the paced heap so that the source that may start a task
+ * soonest is at the head.
  */
-static scamper_source_t *source_next(void)
+static int source_paced_cmp(const scamper_source_t *a,
+			    const scamper_source_t *b)
 {
-  void *node;
+  return timeval_cmp(&b->tat, &a->tat);
+}
 
-  if((node = clist_node_next(source_cur->list_node)) != source_cur->list_node)
-    source_cur = clist_node_item(node);
+/*
+ * source_stride
+ *
+ * compute how far the source's pass advances for each probe sent.
+ */
+static void source_stride(scamper_source_t *source)
+{
+  if(source->priority > 0)
+    source->stride = SOURCE_STRIDE1 / source->priority;
+  else
+    source->stride = SOURCE_STRIDE1;
+  return;
+}
 
-  source_cnt = 0;
+/*
+ * source_iswindowfull
+ *
+ * return non-zero if the source has as many tasks underway as it is
+ * allowed.  a task that was put on hold and is now ready to resume is
+ * already counted against the window, so it does not wait for another.
+ */
+static int source_iswindowfull(const scamper_source_t *source)
+{
+  command_t *command;
 
-  return source_cur;
+  if(source->window == 0 || source->inflight < source->window)
+    return 0;
+  if((command = dlist_head_item(source->commands)) != NULL &&
+     command->type == COMMAND_TASK && command->un.sourcetask->started != 0)
+    return 0;
+  return 1;
 }
 
 /*
  * source_active_detach
  *
- * detach the source out of the active list.  move to the next source
- * if it is the current source that is being read from.
+ * detach the source out of the active heap.
  */
 static void source_active_detach(scamper_source_t *source)
 {
-  void *node;
-
   assert(source->list_ == active);
 
-  source_cur = NULL;
-  source_cnt = 0;
-
   if(source->list_node != NULL)
-    {
-      if((node = clist_node_next(source->list_node)) != source->list_node)
-	source_cur = clist_node_item(node);
-
-      clist_node_pop(active, source->list_node);
-    }
+    heap_delete(active, source->list_node);
 
   source->list_     = NULL;
   source->list_node = NULL;
@@ -542,6 +682,21 @@ static void source_active_detach(scamper_source_t *source)
   return;
 }
 
+/*
+ * source_paced_detach
+ *
+ * detach the source out of the paced heap.
+ */
+static void source_paced_detach(scamper_source_t *source)
+{
+  assert(source->list_ == paced);
+
+  heap_delete(paced, source->list_node);
+  source->list_     = NULL;
+  source->list_node = NULL;
+  return;
+}
+
 /*
  * source_blocked_detach
  *
@@ -572,21 +727,40 @@ static void source_finished_detach(scamper_source_t *source)
   return;
 }
 
+/*
+ * source_active_insert
+ *
+ * put the source into the active heap.  a source that was not active
+ * starts from the pass of the most recently selected source.
+ */
+static int source_active_insert(scamper_source_t *source)
+{
+  if(source->pass < source_pass)
+    source->pass = source_pass;
+  source->seq = source_seq++;
+  if((source->list_node = heap_insert(active, source)) == NULL)
+    return -1;
+  source->list_ = active;
+  return 0;
+}
+
 /*
  * source_active_attach
  *
  * some condition has changed, which may mean the source can go back onto
- * the active list for use by the probing process.
+ * the active heap for use by the probing process.
  *
  * a caller MUST NOT assume that the source will necessarily end up on the
- * active list after calling this function.  for example, source_active_attach
+ * active heap after calling this function.  for example, source_active_attach
  * may be called when new tasks are added to the command list.  however, the
- * source may have a zero priority, which means probing this source is
- * currently paused.
+ * source may have a zero priority, or have been paused by its owner,
+ * which means probing this source is currently paused; it may have as
+ * many tasks underway as its window allows; or it may be waiting for
+ * its pps cap to allow another task.
  */
 static int source_active_attach(scamper_source_t *source)
 {
-  if(source->list_ == active)
+  if(source->list_ == active || source->list_ == paced)
     return 0;
 
   if(source->list_ == finished)
@@ -594,23 +768,55 @@ static int source_active_attach(scamper_source_t *source)
 
   if(source->list_ == blocked)
     {
-      /* if the source has a zero priority, it must remain blocked */
-      if(source->priority == 0)
+      /*
+       * if the source has a zero priority, a full window, or is paused,
+       * it must remain blocked
+       */
+      if(source->priority == 0 || source->paused != 0 ||
+	 source_iswindowfull(source) != 0)
 	return 0;
       source_blocked_detach(source);
     }
 
-  if((source->list_node = clist_tail_push(active, source)) == NULL)
+  return source_active_insert(source);
+}
+
+/*
+ * source_paced_attach
+ *
+ * the source has reached its pps cap, so put it aside until it may
+ * start another task.  the source is either at the head of the active
+ * heap, or was taken out of the paced heap so that its tat could move.
+ */
+static int source_paced_attach(scamper_source_t *source)
+{
+  if(source->list_ == active)
+    source_active_detach(source);
+  assert(source->list_ == NULL);
+  if((source->list_node = heap_insert(paced, source)) == NULL)
     return -1;
-  source->list_ = active;
+  source->list_ = paced;
+  return 0;
+}
+
+/*
+ * sources_paced_release
+ *
+ * move sources whose pps cap allows them to start a task back into the
+ * active heap.
+ */
+static void sources_paced_release(const struct timeval *now)
+{
+  scamper_source_t *source;
 
-  if(source_cur == NULL)
+  while((source = heap_head_item(paced)) != NULL &&
+	timeval_cmp(&source->tat, now) <= 0)
     {
-      source_cur = source;
-      source_cnt = 0;
+      source_paced_detach(source);
+      source_active_insert(source);
     }
 
-  return 0;
+  return;
 }
 
 /*
@@ -626,8 +832,10 @@ static int source_blocked_attach(scamper_source_t *source)
   if(source->list_ == finished)
     return -1;
 
-  if(source->list_node != NULL)
+  if(source->list_ == active)
     source_active_detach(source);
+  else if(source->list_ == paced)
+    source_paced_detach(source);
 
   if((source->list_node = dlist_tail_push(blocked, source)) == NULL)
     return -1;
@@ -648,6 +856,8 @@ static int source_finished_attach(scamper_source_t *source)
 
   if(source->list_ == active)
     source_active_detach(source);
+  else if(source->list_ == paced)
+    source_paced_detach(source);
   else if(source->list_ == blocked)
     source_blocked_detach(source);
 
@@ -699,6 +909,14 @@ static int source_task_install(scamper_source_t *source,
   scamper_task_t *task = st->task;
   scamper_task_t *blocker;
 
+  /* the task now counts against the source's window */
+  if(st->started == 0)
+    {
+      st->started = 1;
+      source->inflight++;
+      source->task_cnt++;
+    }
+
   scamper_task_sig_prepare(task);
 
   /* nothing blocking the task from running (blocker == NULL); install it */
@@ -985,6 +1203,8 @@ static void source_detach(scamper_source_t *source)
   /* detach the source from whatever list it is in */
   if(source->list_ == active)
     source_active_detach(source);
+  else if(source->list_ == paced)
+    source_paced_detach(source);
   else if(source->list_ == blocked)
     source_blocked_detach(source);
   else if(source->list_ == finished)
@@ -1097,6 +1317,9 @@ static void source_free(scamper_source_t *source)
       splaytree_free(source->idtree, NULL);
     }
 
+  if(source->tmpls != NULL)
+    splaytree_free(source->tmpls, (splaytree_free_t)command_tmpl_free);
+
   /* release this structure's hold on the scamper_outfile */
   if(source->sof != NULL) scamper_outfile_free(source->sof);
 
@@ -1170,6 +1393,26 @@ uint32_t scamper_source_getpriority(const scamper_source_t *source)
   return source->priority;
 }
 
+/*
+ * scamper_source_getwindow
+ *
+ * return the maximum number of tasks the source may have underway
+ */
+uint32_t scamper_source_getwindow(const scamper_source_t *source)
+{
+  return source->window;
+}
+
+/*
+ * scamper_source_getpps
+ *
+ * return the maximum rate the source may send probes at
+ */
+uint32_t scamper_source_getpps(const scamper_source_t *source)
+{
+  return source->pps;
+}
+
 const char *scamper_source_type_tostr(const scamper_source_t *source)
 {
   switch(source->type)
@@ -1177,6 +1420,7 @@ const char *scamper_source_type_tostr(const scamper_source_t *source)
     case SCAMPER_SOURCE_TYPE_FILE:    return "file";
     case SCAMPER_SOURCE_TYPE_CMDLINE: return "cmdline";
     case SCAMPER_SOURCE_TYPE_CONTROL: return "control";
+    case SCAMPER_SOURCE_TYPE_HITLIST: return "hitlist";
     }
 
   return NULL;
@@ -1305,6 +1549,175 @@ int scamper_source_halttask(scamper_source_t *source, uint32_t id)
   return 0;
 }
 
+/*
+ * command_tmpl_data
+ *
+ * the command is the name of a template, followed by the address to
+ * make the task for.
+ */
+static void *command_tmpl_data(scamper_source_t *s, const char *command,
+			       const command_func_t **f,
+			       char *errbuf, size_t errlen)
+{
+  command_tmpl_t fm, *ct;
+  char name[32];
+  size_t i;
+
+  for(i=0; i<sizeof(name)-1; i++)
+    {
+      if(command[i] == '\0' || isspace((unsigned char)command[i]))
+	break;
+      name[i] = command[i];
+    }
+  name[i] = '\0';
+
+  fm.name = name;
+  if(s->tmpls == NULL || (ct = splaytree_find(s->tmpls, &fm)) == NULL)
+    {
+      snprintf(errbuf, errlen, "no template %s", name);
+      return NULL;
+    }
+
+  command += i;
+  while(isspace((unsigned char)*command))
+    command++;
+  if(*command == '\0')
+    {
+      snprintf(errbuf, errlen, "expected address");
+      return NULL;
+    }
+
+  *f = ct->func;
+  return ct->func->tmpldata(ct->tmpl, command, errbuf, errlen);
+}
+
+/*
+ * scamper_source_tmpl_add
+ *
+ * parse and validate a command once, and keep it in the source under
+ * the supplied name.  a template with the same name is replaced.
+ */
+int scamper_source_tmpl_add(scamper_source_t *s, const char *name,
+			    const char *command, char *errbuf, size_t errlen)
+{
+  const command_func_t *f = NULL;
+  command_tmpl_t fm, *ct = NULL, *old;
+  char *opts = NULL;
+  size_t i;
+
+  errbuf[0] = '\0';
+
+  for(i=0; name[i] != '\0'; i++)
+    if(isalnum((unsigned char)name[i]) == 0 && name[i] != '-' &&
+       name[i] != '_')
+      break;
+  if(i == 0 || i >= 32 || name[i] != '\0')
+    {
+      snprintf(errbuf, errlen, "invalid template name");
+      goto err;
+    }
+
+  if((f = command_func_get(command)) == NULL)
+    {
+      snprintf(errbuf, errlen, "could not determine command type");
+      goto err;
+    }
+  if(f->enabled() == 0)
+    {
+      snprintf(errbuf, errlen, "%s disabled", f->command);
+      goto err;
+    }
+  if(f->tmplalloc == NULL)
+    {
+      snprintf(errbuf, errlen, "%s does not support templates", f->command);
+      goto err;
+    }
+
+  if(s->tmpls == NULL &&
+     (s->tmpls = splaytree_alloc((splaytree_cmp_t)command_tmpl_cmp)) == NULL)
+    {
+      snprintf(errbuf, errlen, "could not alloc tmpls");
+      goto err;
+    }
+
+  if((ct = malloc_zero(sizeof(command_tmpl_t))) == NULL ||
+     (ct->name = strdup(name)) == NULL ||
+     (opts = strdup(command + f->len)) == NULL)
+    {
+      snprintf(errbuf, errlen, "could not alloc template");
+      goto err;
+    }
+  ct->func = f;
+  if((ct->tmpl = f->tmplalloc(opts, errbuf, errlen)) == NULL)
+    goto err;
+  free(opts); opts = NULL;
+
+  fm.name = ct->name;
+  if((old = splaytree_find(s->tmpls, &fm)) != NULL)
+    {
+      splaytree_remove_item(s->tmpls, old);
+      command_tmpl_free(old);
+    }
+  if(splaytree_insert(s->tmpls, ct) == NULL)
+    {
+      snprintf(errbuf, errlen, "could not add template");
+      goto err;
+    }
+
+  return 0;
+
+ err:
+  if(opts != NULL) free(opts);
+  if(ct != NULL) command_tmpl_free(ct);
+  return -1;
+}
+
+/*
+ * scamper_source_pause
+ *
+ * stop offering tasks from the source until scamper_source_resume is
+ * called.  tasks already underway are not affected.
+ */
+void scamper_source_pause(scamper_source_t *source)
+{
+  sources_assert();
+  source->paused = 1;
+  if(source->list_ == active || source->list_ == paced)
+    source_blocked_attach(source);
+  sources_assert();
+  return;
+}
+
+/*
+ * scamper_source_resume
+ *
+ * offer tasks from a paused source again.
+ */
+void scamper_source_resume(scamper_source_t *source)
+{
+  sources_assert();
+  source->paused = 0;
+  if(source->list_ == blocked && dlist_count(source->commands) > 0)
+    source_active_attach(source);
+  sources_assert();
+  return;
+}
+
+int scamper_source_ispaused(const scamper_source_t *source)
+{
+  return source->paused;
+}
+
+/*
+ * scamper_source_cycle
+ *
+ * start the next cycle of the source.
+ */
+int scamper_source_cycle(scamper_source_t *source)
+{
+  return source_cycle(source, source->cycle->id + 1);
+}
+
 /*
  * scamper_source_command2
  *
@@ -1331,18 +1744,27 @@ int scamper_source_command2(scamper_source_t *s, const char *command,
       goto err;
     }
 
-  if((f = command_func_get(command)) == NULL)
+  if(command[0] == '@')
     {
-      snprintf(errbuf, errlen, "could not determine command type");
-      goto err;
+      /* make the task from a template, which was checked when added */
+      if((data = command_tmpl_data(s, command+1, &f, errbuf, errlen)) == NULL)
+	goto err;
     }
-  if(f->enabled() == 0)
+  else
     {
-      snprintf(errbuf, errlen, "%s disabled", f->command);
-      goto err;
+      if((f = command_func_get(command)) == NULL)
+	{
+	  snprintf(errbuf, errlen, "could not determine command type");
+	  goto err;
+	}
+      if(f->enabled() == 0)
+	{
+	  snprintf(errbuf, errlen, "%s disabled", f->command);
+	  goto err;
+	}
+      if((data = command_func_allocdata(f, command, errbuf, errlen)) == NULL)
+	goto err;
     }
-  if((data = command_func_allocdata(f, command, errbuf, errlen)) == NULL)
-    goto err;
   if((task = f->alloctask(data, s->list, s->cycle, errbuf, errlen)) == NULL)
     goto err;
   data = NULL;
@@ -1408,17 +1830,25 @@ int scamper_source_command(scamper_source_t *source, const char *command)
 
   sources_assert();
 
-  if((func = command_func_get(command)) == NULL)
+  errbuf[0] = '\0';
+  if(command[0] == '@')
+    {
+      if((data = command_tmpl_data(source, command+1, &func,
+				   errbuf, sizeof(errbuf))) == NULL)
+	{
+	  printerror_msg(__func__, "%s", errbuf);
+	  goto err;
+	}
+    }
+  else if((func = command_func_get(command)) == NULL)
     goto err;
-  if(func->enabled() == 0)
+  else if(func->enabled() == 0)
     {
       printerror_msg(__func__, "%s disabled", func->command);
       goto err;
     }
-
-  errbuf[0] = '\0';
-  if((data = command_func_allocdata(func, command,
-				    errbuf, sizeof(errbuf))) == NULL)
+  else if((data = command_func_allocdata(func, command,
+					 errbuf, sizeof(errbuf))) == NULL)
     {
       if(errbuf[0] != '\0')
 	printerror_msg(__func__, "%s", errbuf);
@@ -1458,6 +1888,49 @@ uint32_t scamper_sourcetask_getid(scamper_sourcetask_t *st)
   return st->id;
 }
 
+/*
+ * scamper_sourcetask_probe
+ *
+ * a probe is about to be sent for the task.  charge it to the source's
+ * share and to its pps cap.
+ */
+void scamper_sourcetask_probe(scamper_sourcetask_t *st)
+{
+  scamper_source_t *source = st->source;
+  struct timeval now;
+  int repace = 0;
+
+  source->probe_cnt++;
+  source->pass += source->stride;
+
+  /* keep the source's place in the active heap consistent with its pass */
+  if(source->list_ == active)
+    {
+      source_active_detach(source);
+      source_active_insert(source);
+    }
+
+  if(source->pps != 0)
+    {
+      /* the paced heap is ordered by tat, so take the source out first */
+      if(source->list_ == paced)
+	{
+	  source_paced_detach(source);
+	  repace = 1;
+	}
+
+      gettimeofday_wrap(&now);
+      if(timeval_cmp(&source->tat, &now) < 0)
+	timeval_cpy(&source->tat, &now);
+      timeval_add_us(&source->tat, &source->tat, 1000000 / source->pps);
+
+      if(repace != 0)
+	source_paced_attach(source);
+    }
+
+  return;
+}
+
 /*
  * scamper_sourcetask_free
  *
@@ -1472,6 +1945,8 @@ void scamper_sourcetask_free(scamper_sourcetask_t *st)
 
   if(st->node != NULL)
     dlist_node_pop(source->tasks, st->node);
+  if(st->started != 0)
+    source->inflight--;
   if(st->idnode != NULL)
     splaytree_remove_node(source->idtree, st->idnode);
   scamper_source_free(st->source);
@@ -1487,6 +1962,11 @@ void scamper_sourcetask_free(scamper_sourcetask_t *st)
 	}
       source_detach(source);
     }
+  else if(source->list_ == blocked && dlist_count(source->commands) > 0)
+    {
+      /* the source may have been blocked on its window */
+      source_active_attach(source);
+    }
 
   sources_assert();
   return;
@@ -1600,7 +2080,10 @@ scamper_source_t *scamper_source_alloc(const scamper_source_params_t *ssp)
 
   source->type     = ssp->type;
   source->priority = ssp->priority;
+  source->window   = ssp->window;
+  source->pps      = ssp->pps;
   source->id       = 1;
+  source_stride(source);
 
   return source;
 
@@ -1646,7 +2129,8 @@ int scamper_sources_isempty()
    * if there are either active or blocked address list sources, the list
    * can't be empty
    */
-  if((active   != NULL && clist_count(active)   > 0) ||
+  if((active   != NULL && heap_count(active)    > 0) ||
+     (paced    != NULL && heap_count(paced)     > 0) ||
      (blocked  != NULL && dlist_count(blocked)  > 0) ||
      (finished != NULL && dlist_count(finished) > 0))
     {
@@ -1663,9 +2147,17 @@ int scamper_sources_isempty()
  */
 int scamper_sources_isready(void)
 {
+  struct timeval now;
+
   sources_assert();
 
-  if(source_cur != NULL || dlist_count(finished) > 0)
+  if(heap_count(paced) > 0)
+    {
+      gettimeofday_wrap(&now);
+      sources_paced_release(&now);
+    }
+
+  if(heap_count(active) > 0 || dlist_count(finished) > 0)
     {
       return 1;
     }
@@ -1694,7 +2186,13 @@ void scamper_sources_empty()
       source_detach(source);
     }
 
-  while((source = clist_tail_item(active)) != NULL)
+  while((source = heap_head_item(paced)) != NULL)
+    {
+      source_flush_commands(source);
+      source_detach(source);
+    }
+
+  while((source = heap_head_item(active)) != NULL)
     {
       source_flush_commands(source);
       source_detach(source);
@@ -1724,31 +2222,51 @@ void scamper_sources_foreach(void *p, int (*func)(void *, scamper_source_t *))
 /*
  * scamper_sources_gettask
  *
- * pick off the next task ready to be probed.
+ * pick off the next task ready to be probed.  the source offered the
+ * task is the active source with the smallest pass; sources that have
+ * reached their pps cap or window are set aside until they may continue.
  */
 int scamper_sources_gettask(scamper_task_t **task)
 {
   scamper_source_t *source;
   command_t *command;
+  struct timeval now;
+  int havenow = 0;
 
   sources_assert();
 
   while((source = dlist_head_item(finished)) != NULL)
     source_detach(source);
 
-  /*
-   * if the priority of the source was changed in between calls to this
-   * function, then make sure the source's priority hasn't been lowered to
-   * below how many tasks it has had allocated in this cycle
-   */
-  if(source_cur != NULL && source_cnt >= source_cur->priority)
-    source_next();
+  if(heap_count(paced) > 0)
+    {
+      gettimeofday_wrap(&now);
+      sources_paced_release(&now);
+      havenow = 1;
+    }
 
-  while((source = source_cur) != NULL)
+  while((source = heap_head_item(active)) != NULL)
     {
       assert(source->priority > 0);
+      source_pass = source->pass;
 
-      while((command = dlist_head_pop(source->commands)) != NULL)
+      /* if the source has reached its pps cap, set it aside for now */
+      if(source->pps != 0)
+	{
+	  if(havenow == 0)
+	    {
+	      gettimeofday_wrap(&now);
+	      havenow = 1;
+	    }
+	  if(timeval_cmp(&source->tat, &now) > 0)
+	    {
+	      source_paced_attach(source);
+	      continue;
+	    }
+	}
+
+      while(source_iswindowfull(source) == 0 &&
+	    (command = dlist_head_pop(source->commands)) != NULL)
 	{
 	  if(source->take != NULL)
 	    source->take(source->data);
@@ -1760,7 +2278,6 @@ int scamper_sources_gettask(scamper_task_t **task)
 		goto err;
 	      if(*task == NULL)
 		continue;
-	      source_cnt++;
 	      goto done;
 
 	    case COMMAND_TASK:
@@ -1768,7 +2285,6 @@ int scamper_sources_gettask(scamper_task_t **task)
 		goto err;
 	      if(*task == NULL)
 		continue;
-	      source_cnt++;
 	      goto done;
 
 	    case COMMAND_CYCLE:
@@ -1780,12 +2296,10 @@ int scamper_sources_gettask(scamper_task_t **task)
 	    }
 	}
 
-      /* the previous source could not supply a command */
-      assert(dlist_count(source->commands) == 0);
-
       /*
-       * if the source is not yet finished, put it on the blocked list;
-       * otherwise, the source is detached.
+       * if the source is not yet finished, put it on the blocked list
+       * until it has more commands or a task completes; otherwise, the
+       * source is detached.
        */
       if(scamper_source_isfinished(source) == 0)
 	source_blocked_attach(source);
@@ -1804,6 +2318,105 @@ int scamper_sources_gettask(scamper_task_t **task)
   return -1;
 }
 
+/*
+ * scamper_sources_waittime
+ *
+ * if a source is waiting on its pps cap before it may start another
+ * task, tell the caller when that will be.
+ */
+int scamper_sources_waittime(struct timeval *tv)
+{
+  scamper_source_t *source;
+
+  if((source = heap_head_item(paced)) != NULL)
+    {
+      timeval_cpy(tv, &source->tat);
+      return 1;
+    }
+
+  return 0;
+}
+
+typedef struct sources_stats
+{
+  char     *buf;
+  size_t    len;
+  size_t   *off;
+  uint64_t  probe_cnt;
+  int       i;
+} sources_stats_t;
+
+static int sources_stats_probes(void *param, void *item)
+{
+  sources_stats_t *ss = param;
+  scamper_source_t *source = item;
+  ss->probe_cnt += source->probe_cnt;
+  return 0;
+}
+
+static int sources_stats_source(void *param, void *item)
+{
+  sources_stats_t *ss = param;
+  scamper_source_t *source = item;
+  char name[256], tasks[32], probes[32];
+  const char *state;
+
+  /* leave room to close off the JSON object */
+  if(ss->len - *ss->off < 512)
+    return 0;
+
+  if(source->list_ == active)
+    state = "active";
+  else if(source->list_ == paced)
+    state = "paced";
+  else if(source->list_ == blocked)
+    state = source->paused != 0 ? "paused" : "blocked";
+  else
+    state = "finished";
+
+  string_concaf(ss->buf, ss->len, ss->off,
+		"%s{\"name\":\"%s\", \"state\":\"%s\", \"priority\":%u"
+		", \"pps\":%u, \"window\":%u, \"inflight\":%u"
+		", \"tasks\":%s, \"probes\":%s, \"share\":%.3f}",
+		ss->i++ > 0 ? ", " : "",
+		json_esc(source->list->name, name, sizeof(name)), state,
+		source->priority, source->pps, source->window,
+		source->inflight,
+		offt_tostr(tasks, sizeof(tasks), (off_t)source->task_cnt,
+			   0, 'd'),
+		offt_tostr(probes, sizeof(probes), (off_t)source->probe_cnt,
+			   0, 'd'),
+		ss->probe_cnt > 0 ?
+		(double)source->probe_cnt / ss->probe_cnt : 0.0);
+
+  return 0;
+}
+
+/*
+ * scamper_sources_stats
+ *
+ * report the share of probes each source has achieved, alongside its
+ * configured priority, pps cap, and window.
+ */
+void scamper_sources_stats(char *buf, size_t len, size_t *off)
+{
+  sources_stats_t ss;
+
+  memset(&ss, 0, sizeof(ss));
+  ss.buf = buf;
+  ss.len = len;
+  ss.off = off;
+
+  string_concat(buf, len, off, ", \"sources\":[");
+  if(source_tree != NULL)
+    {
+      splaytree_inorder(source_tree, sources_stats_probes, &ss);
+      splaytree_inorder(source_tree, sources_stats_source, &ss);
+    }
+  string_concatc(buf, len, off, ']');
+  return;
+}
+
 /*
  * scamper_sources_add
  *
@@ -1843,7 +2456,10 @@ int scamper_sources_add(scamper_source_t *source)
  */
 int scamper_sources_init(void)
 {
-  if((active = clist_alloc()) == NULL)
+  if((active = heap_alloc((heap_cmp_t)source_active_cmp)) == NULL)
+    return -1;
+
+  if((paced = heap_alloc((heap_cmp_t)source_paced_cmp)) == NULL)
     return -1;
 
   if((blocked = dlist_alloc()) == NULL)
@@ -1865,14 +2481,16 @@ int scamper_sources_init(void)
  */
 void scamper_sources_cleanup(void)
 {
-  int f, b, a;
+  int f, b, a, p;
 
   f = finished != NULL ? dlist_count(finished) : 0;
   b = blocked  != NULL ? dlist_count(blocked)  : 0;
-  a = active   != NULL ? clist_count(active)   : 0;
+  a = active   != NULL ? heap_count(active)    : 0;
+  p = paced    != NULL ? heap_count(paced)     : 0;
 
-  if(f != 0 || b != 0 || a != 0)
-    scamper_debug(__func__, "finished %d, blocked %d, active %d", f, b, a);
+  if(f != 0 || b != 0 || a != 0 || p != 0)
+    scamper_debug(__func__, "finished %d, blocked %d, active %d, paced %d",
+		  f, b, a, p);
 
   if(source_tree != NULL)
     {
@@ -1888,10 +2506,16 @@ void scamper_sources_cleanup(void)
 
   if(active != NULL)
     {
-      clist_free(active);
+      heap_free(active, NULL);
       active = NULL;
     }
 
+  if(paced != NULL)
+    {
+      heap_free(paced, NULL);
+      paced = NULL;
+    }
+
   if(finished != NULL)
     {
       dlist_free(finished);
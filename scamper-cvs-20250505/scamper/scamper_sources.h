@@ -32,9 +32,10 @@ typedef struct scamper_source scamper_source_t;
 #define SCAMPER_SOURCE_TYPE_FILE    1
 #define SCAMPER_SOURCE_TYPE_CMDLINE 2
 #define SCAMPER_SOURCE_TYPE_CONTROL 3
+#define SCAMPER_SOURCE_TYPE_HITLIST 4
 
 #define SCAMPER_SOURCE_TYPE_MIN     1
-#define SCAMPER_SOURCE_TYPE_MAX     3
+#define SCAMPER_SOURCE_TYPE_MAX     4
 
 /* a mapping between a task and the source that delivered it */
 typedef struct scamper_sourcetask scamper_sourcetask_t;
@@ -49,6 +50,8 @@ typedef struct scamper_source_params
    *  cycle_id: the initial cycle id to use.
    *  type:     type of the source (file, cmdline, control socket, ...)
    *  priority: the mix priority of this source compared to other sources.
+   *  window:   the maximum number of tasks underway, or zero for no limit.
+   *  pps:      the maximum probe rate for this source, or zero for no limit.
    *  sof:      the output file to direct results to.
    */
   char              *name;
@@ -58,6 +61,8 @@ typedef struct scamper_source_params
   uint32_t           cycle_id;
   int                type;
   uint32_t           priority;
+  uint32_t           window;
+  uint32_t           pps;
   scamper_outfile_t *sof;
 
   /*
@@ -89,6 +94,8 @@ uint32_t scamper_source_getcycleid(const scamper_source_t *source);
 int scamper_source_gettype(const scamper_source_t *source);
 uint32_t scamper_source_getpriority(const scamper_source_t *source);
 void scamper_source_setpriority(scamper_source_t *source, uint32_t priority);
+uint32_t scamper_source_getwindow(const scamper_source_t *source);
+uint32_t scamper_source_getpps(const scamper_source_t *source);
 
 /* functions for getting string representations */
 const char *scamper_source_type_tostr(const scamper_source_t *source);
@@ -111,9 +118,20 @@ int scamper_source_command(scamper_source_t *source, const char *command);
 int scamper_source_command2(scamper_source_t *source, const char *command,
 			    uint32_t *id, char *errbuf, size_t errlen);
 int scamper_source_halttask(scamper_source_t *source, uint32_t id);
+int scamper_source_tmpl_add(scamper_source_t *source, const char *name,
+			    const char *command, char *errbuf, size_t errlen);
+
+/* stop offering the source's tasks for probing, and start again */
+void scamper_source_pause(scamper_source_t *source);
+void scamper_source_resume(scamper_source_t *source);
+int scamper_source_ispaused(const scamper_source_t *source);
+
+/* start a new cycle, which applies to commands added after the call */
+int scamper_source_cycle(scamper_source_t *source);
 
 /* function for advising source that an active task has completed */
 void scamper_sourcetask_free(scamper_sourcetask_t *st);
+void scamper_sourcetask_probe(scamper_sourcetask_t *st);
 scamper_source_t *scamper_sourcetask_getsource(scamper_sourcetask_t *st);
 uint32_t scamper_sourcetask_getid(scamper_sourcetask_t *st);
 
@@ -124,6 +142,8 @@ int scamper_sources_add(scamper_source_t *source);
 int scamper_sources_gettask(struct scamper_task **task);
 scamper_source_t *scamper_sources_get(char *name);
 int scamper_sources_isready(void);
+int scamper_sources_waittime(struct timeval *tv);
+void scamper_sources_stats(char *buf, size_t len, size_t *off);
 int scamper_sources_isempty(void);
 void scamper_sources_foreach(void *p, int (*func)(void *, scamper_source_t *));
 void scamper_sources_empty(void);
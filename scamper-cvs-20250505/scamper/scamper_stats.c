@@ -0,0 +1,376 @@
+/*
+ * scamper_stats.c
+ *
+ * $Id$
+ *
+ * Copyright (C) 2025 The Regents of the University of California
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include "internal.h"
+
+#include "scamper.h"
+#include "scamper_addr.h"
+#include "scamper_addr_int.h"
+#include "scamper_config.h"
+#include "scamper_control.h"
+#include "scamper_debug.h"
+#include "scamper_outfiles.h"
+#include "scamper_task.h"
+#include "scamper_sources.h"
+#include "scamper_queue.h"
+#include "scamper_dl.h"
+#include "scamper_dlhdr.h"
+#include "scamper_probe.h"
+#include "scamper_stats.h"
+#include "utils.h"
+
+#define STATS_TX_ICMP  0
+#define STATS_TX_UDP   1
+#define STATS_TX_TCP   2
+#define STATS_TX_OTHER 3
+#define STATS_TX_MAX   4
+
+extern scamper_config_t *config;
+
+/* bucket 0 is < 1us, bucket i covers [2^(i-1), 2^i) us */
+#define STATS_LOOP_BUCKETS 16
+
+/*
+ * the counters are updated from scamper's main thread only, so they
+ * are plain integers rather than atomics.
+ *
+ * tx4, tx6:      probes sent, by IP version and transport
+ * tx_err:        probes that could not be sent
+ * icmp_rx:       ICMP responses passed to the task code
+ * icmp_handed:   ICMP responses handed to at least one task's handler
+ * udp_rx:        UDP responses passed to the task code
+ * udp_handed:    UDP responses handed to at least one task's handler
+ * loop_count:    iterations of the main loop
+ * loop_hist:     histogram of the time spent outside poll each iteration
+ * loop_max:      longest time spent outside poll, in microseconds
+ * gap_tv:        when the last probe was sent
+ * gap_count:     inter-probe gaps measured against the target rate
+ * gap_sum:       sum of the jitter of those gaps, in microseconds
+ * gap_max:       largest jitter of those gaps, in microseconds
+ * gap_hist:      histogram of the jitter of those gaps
+ * work_tv:       when scamper last returned from poll
+ * win_tv:        when the current one second window started
+ * win_tx:        probes sent when the current window started
+ * win_work:      microseconds spent outside poll in the current window
+ * pps:           probes sent per second, over the last complete window
+ * busy:          percentage of the last complete window spent outside poll
+ * start:         when scamper started
+ * sq:            event to emit the periodic JSON line
+ */
+static uint64_t tx4[STATS_TX_MAX];
+static uint64_t tx6[STATS_TX_MAX];
+static uint64_t tx_err = 0;
+static uint64_t icmp_rx = 0;
+static uint64_t icmp_handed = 0;
+static uint64_t udp_rx = 0;
+static uint64_t udp_handed = 0;
+static uint64_t loop_count = 0;
+static uint64_t loop_hist[STATS_LOOP_BUCKETS];
+static uint32_t loop_max = 0;
+static struct timeval gap_tv;
+static uint64_t gap_count = 0;
+static uint64_t gap_sum = 0;
+static uint32_t gap_max = 0;
+static uint64_t gap_hist[STATS_LOOP_BUCKETS];
+static struct timeval work_tv;
+static struct timeval win_tv;
+static uint64_t win_tx = 0;
+static uint64_t win_work = 0;
+static uint32_t pps = 0;
+static uint32_t busy = 0;
+static struct timeval start;
+static scamper_queue_t *sq = NULL;
+
+static uint64_t stats_tx_total(void)
+{
+  uint64_t total = 0;
+  int i;
+  for(i=0; i<STATS_TX_MAX; i++)
+    total += tx4[i] + tx6[i];
+  return total;
+}
+
+static void stats_hist(uint64_t *hist, uint32_t us)
+{
+  int i = 0;
+  while(i < STATS_LOOP_BUCKETS-1 && (us >> i) != 0)
+    i++;
+  hist[i]++;
+  return;
+}
+
+/*
+ * stats_gap
+ *
+ * measure how far the gap between this probe and the previous one was
+ * from the gap implied by the packets per second rate.  gaps more than
+ * ten times the target are scamper having nothing to probe, rather than
+ * jitter, and are not counted.
+ */
+static void stats_gap(const struct timeval *tx)
+{
+  int target, gap;
+  uint32_t jitter;
+
+  if((target = scamper_option_pps_get()) == 0 || gap_tv.tv_sec == 0 ||
+     timeval_cmp(tx, &gap_tv) < 0)
+    goto done;
+  target = 1000000 / target;
+  if(timeval_inrange_us(tx, &gap_tv, target * 10) == 0)
+    goto done;
+
+  gap = timeval_diff_us(&gap_tv, tx);
+  jitter = (uint32_t)(gap > target ? gap - target : target - gap);
+  stats_hist(gap_hist, jitter);
+  gap_count++;
+  gap_sum += jitter;
+  if(jitter > gap_max)
+    gap_max = jitter;
+
+ done:
+  timeval_cpy(&gap_tv, tx);
+  return;
+}
+
+void scamper_stats_probe(const scamper_probe_t *probe, int rc)
+{
+  uint64_t *tx;
+
+  if(rc != 0)
+    {
+      tx_err++;
+      return;
+    }
+
+  if(SCAMPER_ADDR_TYPE_IS_IPV4(probe->pr_ip_dst))
+    tx = tx4;
+  else
+    tx = tx6;
+
+  if(probe->pr_ip_proto == IPPROTO_ICMP ||
+     probe->pr_ip_proto == IPPROTO_ICMPV6)
+    tx[STATS_TX_ICMP]++;
+  else if(probe->pr_ip_proto == IPPROTO_UDP)
+    tx[STATS_TX_UDP]++;
+  else if(probe->pr_ip_proto == IPPROTO_TCP)
+    tx[STATS_TX_TCP]++;
+  else
+    tx[STATS_TX_OTHER]++;
+
+  stats_gap(&probe->pr_tx);
+  return;
+}
+
+void scamper_stats_icmp(int handed)
+{
+  icmp_rx++;
+  if(handed != 0)
+    icmp_handed++;
+  return;
+}
+
+void scamper_stats_udp(int handed)
+{
+  udp_rx++;
+  if(handed != 0)
+    udp_handed++;
+  return;
+}
+
+/*
+ * scamper_stats_poll_enter
+ *
+ * record how long scamper spent processing since it last returned from
+ * poll.
+ */
+void scamper_stats_poll_enter(void)
+{
+  struct timeval now;
+  uint32_t us;
+
+  gettimeofday_wrap(&now);
+  if(work_tv.tv_sec == 0 || timeval_cmp(&now, &work_tv) < 0)
+    return;
+
+  us = (uint32_t)timeval_diff_us(&work_tv, &now);
+  stats_hist(loop_hist, us);
+  loop_count++;
+  if(us > loop_max)
+    loop_max = us;
+  win_work += us;
+
+  return;
+}
+
+static int stats_event(void *param)
+{
+  struct timeval tv;
+  char buf[8192];
+
+  if(config->stats_interval == 0)
+    {
+      scamper_queue_free(sq);
+      sq = NULL;
+      return 0;
+    }
+
+  scamper_debug_line(scamper_stats_json(buf, sizeof(buf)));
+  gettimeofday_wrap(&tv);
+  timeval_add_s(&tv, &tv, config->stats_interval);
+  if(scamper_queue_event_update_time(sq, &tv) != 0)
+    return -1;
+
+  return 0;
+}
+
+/*
+ * scamper_stats_poll_exit
+ *
+ * note when scamper returned from poll, and once a second compute the
+ * probing rate that scamper achieved.
+ */
+void scamper_stats_poll_exit(const struct timeval *now)
+{
+  struct timeval tv;
+  uint64_t tx;
+  int ms;
+
+  timeval_cpy(&work_tv, now);
+  if((ms = timeval_diff_ms(&win_tv, now)) < 1000)
+    return;
+
+  tx = stats_tx_total();
+  pps = (uint32_t)(((tx - win_tx) * 1000) / ms);
+  busy = (uint32_t)((win_work / 10) / ms);
+  if(busy > 100)
+    busy = 100;
+  win_tx = tx;
+  win_work = 0;
+  timeval_cpy(&win_tv, now);
+
+  /* the interval might have been enabled by re-reading the config */
+  if(sq == NULL && config->stats_interval != 0)
+    {
+      timeval_add_s(&tv, now, config->stats_interval);
+      sq = scamper_queue_event(&tv, stats_event, NULL);
+    }
+
+  return;
+}
+
+char *scamper_stats_json(char *buf, size_t len)
+{
+  int qp, qw, qd, qe, i;
+  struct timeval now;
+  size_t off = 0;
+
+  gettimeofday_wrap(&now);
+  scamper_queue_counts(&qp, &qw, &qd, &qe);
+
+  string_concaf(buf, len, &off,
+		"{\"type\":\"stats\", \"time\":%ld, \"uptime\":%ld",
+		(long)now.tv_sec, (long)(now.tv_sec - start.tv_sec));
+  string_concaf(buf, len, &off,
+		", \"pps\":{\"target\":%d, \"achieved\":%u}",
+		scamper_option_pps_get(), pps);
+  string_concaf(buf, len, &off,
+		", \"window\":{\"target\":%d, \"count\":%d}",
+		scamper_option_window_get(), qp + qw);
+  string_concaf(buf, len, &off,
+		", \"queue\":{\"probe\":%d, \"wait\":%d, \"done\":%d"
+		", \"event\":%d}", qp, qw, qd, qe);
+  string_concaf(buf, len, &off,
+		", \"tx\":{\"ipv4\":{\"icmp\":%llu, \"udp\":%llu, \"tcp\":%llu"
+		", \"other\":%llu}",
+		(unsigned long long)tx4[STATS_TX_ICMP],
+		(unsigned long long)tx4[STATS_TX_UDP],
+		(unsigned long long)tx4[STATS_TX_TCP],
+		(unsigned long long)tx4[STATS_TX_OTHER]);
+  string_concaf(buf, len, &off,
+		", \"ipv6\":{\"icmp\":%llu, \"udp\":%llu, \"tcp\":%llu"
+		", \"other\":%llu}, \"err\":%llu}",
+		(unsigned long long)tx6[STATS_TX_ICMP],
+		(unsigned long long)tx6[STATS_TX_UDP],
+		(unsigned long long)tx6[STATS_TX_TCP],
+		(unsigned long long)tx6[STATS_TX_OTHER],
+		(unsigned long long)tx_err);
+  string_concaf(buf, len, &off,
+		", \"rx\":{\"icmp\":{\"to_task\":%llu, \"no_task\":%llu}"
+		", \"udp\":{\"to_task\":%llu, \"no_task\":%llu}}",
+		(unsigned long long)icmp_handed,
+		(unsigned long long)(icmp_rx - icmp_handed),
+		(unsigned long long)udp_handed,
+		(unsigned long long)(udp_rx - udp_handed));
+  string_concaf(buf, len, &off,
+		", \"loop\":{\"count\":%llu, \"busy\":%u, \"max_us\":%u"
+		", \"hist_us\":[", (unsigned long long)loop_count, busy, loop_max);
+  for(i=0; i<STATS_LOOP_BUCKETS; i++)
+    string_concaf(buf, len, &off, "%s%llu", i > 0 ? "," : "",
+		  (unsigned long long)loop_hist[i]);
+  string_concat(buf, len, &off, "]}");
+  string_concaf(buf, len, &off,
+		", \"gap\":{\"count\":%llu, \"jitter_mean_us\":%u"
+		", \"jitter_max_us\":%u, \"hist_us\":[",
+		(unsigned long long)gap_count,
+		gap_count > 0 ? (uint32_t)(gap_sum / gap_count) : 0, gap_max);
+  for(i=0; i<STATS_LOOP_BUCKETS; i++)
+    string_concaf(buf, len, &off, "%s%llu", i > 0 ? "," : "",
+		  (unsigned long long)gap_hist[i]);
+  string_concat(buf, len, &off, "]}");
+
+  scamper_control_stats(buf, len, &off);
+  scamper_sources_stats(buf, len, &off);
+  scamper_outfiles_stats(buf, len, &off);
+  string_concatc(buf, len, &off, '}');
+
+  return buf;
+}
+
+int scamper_stats_init(void)
+{
+  struct timeval tv;
+
+  gettimeofday_wrap(&start);
+  timeval_cpy(&win_tv, &start);
+
+  if(config->stats_interval == 0)
+    return 0;
+
+  timeval_add_s(&tv, &start, config->stats_interval);
+  if((sq = scamper_queue_event(&tv, stats_event, NULL)) == NULL)
+    return -1;
+
+  return 0;
+}
+
+void scamper_stats_cleanup(void)
+{
+  if(sq != NULL)
+    {
+      scamper_queue_free(sq);
+      sq = NULL;
+    }
+  return;
+}
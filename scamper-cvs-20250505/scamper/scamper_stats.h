@@ -0,0 +1,43 @@
+/*
+ * scamper_stats.h
+ *
+ * $Id$
+ *
+ * Copyright (C) 2025 The Regents of the University of California
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef __SCAMPER_STATS_H
+#define __SCAMPER_STATS_H
+
+/* record a probe sent, or an attempt to, and responses received */
+#ifdef __SCAMPER_PROBE_H
+void scamper_stats_probe(const scamper_probe_t *probe, int rc);
+#endif
+void scamper_stats_icmp(int handed);
+void scamper_stats_udp(int handed);
+
+/* called either side of the poll in scamper's main loop */
+void scamper_stats_poll_enter(void);
+void scamper_stats_poll_exit(const struct timeval *now);
+
+/* format the current statistics as a single line of JSON */
+char *scamper_stats_json(char *buf, size_t len);
+
+int scamper_stats_init(void);
+void scamper_stats_cleanup(void);
+
+#endif /* __SCAMPER_STATS_H */
@@ -46,6 +46,7 @@
 #include "scamper_sources.h"
 #include "scamper_rtsock.h"
 #include "scamper_dl.h"
+#include "scamper_stats.h"
 #include "mjl_list.h"
 #include "mjl_splaytree.h"
 #include "mjl_patricia.h"
@@ -1207,6 +1208,8 @@ void scamper_task_write(scamper_task_t *task, scamper_file_t *file)
 
 void scamper_task_probe(scamper_task_t *task)
 {
+  if(task->sourcetask != NULL)
+    scamper_sourcetask_probe(task->sourcetask);
   task->funcs->probe(task);
   return;
 }
@@ -1233,24 +1236,24 @@ void scamper_task_handleicmp(scamper_icmp_resp_t *resp)
     {
       /* the probe signature is embedded in the response */
       if(!SCAMPER_ICMP_RESP_INNER_IS_SET(resp))
-	return;
+	goto done;
       if(scamper_icmp_resp_inner_dst(resp, &addr) != 0)
-	return;
+	goto done;
     }
   else if(SCAMPER_ICMP_RESP_IS_ECHO_REPLY(resp) ||
 	  SCAMPER_ICMP_RESP_IS_TIME_REPLY(resp))
     {
       /* the probe signature is an ICMP echo/ts request */
       if(scamper_icmp_resp_src(resp, &addr) != 0)
-	return;
+	goto done;
     }
   else
     {
-      return;
+      goto done;
     }
 
   if((ta = trie_addr_find(&addr)) == NULL)
-    return;
+    goto done;
 
   for(dn=dlist_head_node(ta->s2t_list); dn != NULL; dn=dlist_node_next(dn))
     {
@@ -1268,6 +1271,9 @@ void scamper_task_handleicmp(scamper_icmp_resp_t *resp)
 	  s2t->task->funcs->handle_icmp(s2t->task, resp);
 	}
     }
+
+ done:
+  scamper_stats_icmp(print);
   return;
 }
 
@@ -1289,6 +1295,7 @@ void scamper_task_handleudp(scamper_udp_resp_t *ur)
   dlist_node_t *dn;
   patricia_t *pt;
   s2t_t *s2t;
+  int handed = 0;
 
   fm.addr = &addr;
   addr.addr = ur->addr;
@@ -1303,7 +1310,7 @@ void scamper_task_handleudp(scamper_udp_resp_t *ur)
       pt = tx_ip6;
     }
   if((ta = patricia_find(pt, &fm)) == NULL)
-    return;
+    goto done;
 
   for(dn=dlist_head_node(ta->s2t_list); dn != NULL; dn=dlist_node_next(dn))
     {
@@ -1314,8 +1321,12 @@ void scamper_task_handleudp(scamper_udp_resp_t *ur)
       if(s2t->task->funcs->handle_udp != NULL)
 	{
 	  s2t->task->funcs->handle_udp(s2t->task, ur);
+	  handed = 1;
 	}
     }
+
+ done:
+  scamper_stats_udp(handed);
   return;
 }
 
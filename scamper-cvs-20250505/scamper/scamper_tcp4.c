@@ -37,6 +37,7 @@
 #include "scamper_probe.h"
 #include "scamper_ip4.h"
 #include "scamper_tcp4.h"
+#include "scamper_tstamp.h"
 #include "utils.h"
 
 /*
@@ -145,16 +146,9 @@ static void tcp_cksum(scamper_probe_t *probe, struct tcphdr *tcp, size_t len)
   sum += htons(len);
   sum += htons(IPPROTO_TCP);
 
-  /* compute the checksum over the body of the TCP message */
-  w = (uint16_t *)tcp;
-  while(len > 1)
-    {
-      sum += *w++;
-      len -= 2;
-    }
-
-  if(len != 0)
-    sum += ((uint8_t *)w)[0];
+  /* compute the checksum over the header and payload of the TCP message */
+  sum += in_cksum_add(0, tcp, len - probe->pr_len);
+  sum += scamper_probe_datasum(probe);
 
   /* fold the checksum */
   sum  = (sum >> 16) + (sum & 0xffff);
@@ -318,8 +312,14 @@ int scamper_tcp4_probe(scamper_probe_t *pr)
 
   sockaddr_compose((struct sockaddr *)&sin4, AF_INET, pr->pr_ip_dst->addr, 0);
 
-  /* get the transmit time immediately before we send the packet */
-  gettimeofday_wrap(&pr->pr_tx);
+  /*
+   * get the transmit time immediately before we send the packet,
+   * unless the kernel will timestamp the packet as it sends it
+   */
+#ifndef _WIN32 /* windows does not have msghdr struct */
+  if(scamper_tstamp_tx_isenabled(pr->pr_fd) == 0)
+#endif
+    gettimeofday_wrap(&pr->pr_tx);
 
   i = sendto(pr->pr_fd, pktbuf, len, 0, (struct sockaddr *)&sin4,
 	     sizeof(struct sockaddr_in));
@@ -342,6 +342,10 @@ int scamper_tcp4_probe(scamper_probe_t *pr)
       return -1;
     }
 
+#ifndef _WIN32 /* windows does not have msghdr struct */
+  scamper_tstamp_tx(pr->pr_fd, &pr->pr_tx);
+#endif
+
   return 0;
 }
 
@@ -118,7 +118,8 @@ static size_t tcp_ts(uint8_t *buf, const scamper_probe_t *probe)
   return 10;
 }
 
-static void tcp_cksum(struct ip6_hdr *ip6, struct tcphdr *tcp, size_t len)
+static void tcp_cksum(scamper_probe_t *probe, struct ip6_hdr *ip6,
+		      struct tcphdr *tcp, size_t len)
 {
   struct in6_addr a;
   uint16_t *w;
@@ -140,18 +141,9 @@ static void tcp_cksum(struct ip6_hdr *ip6, struct tcphdr *tcp, size_t len)
   sum += htons(len);
   sum += htons(IPPROTO_TCP);
 
-  /* compute the checksum over the body of the TCP message */
-  w = (uint16_t *)tcp;
-  while(len > 1)
-    {
-      sum += *w++;
-      len -= 2;
-    }
-
-  if(len != 0)
-    {
-      sum += ((uint8_t *)w)[0];
-    }
+  /* compute the checksum over the header and payload of the TCP message */
+  sum += in_cksum_add(0, tcp, len - probe->pr_len);
+  sum += scamper_probe_datasum(probe);
 
   /* fold the checksum */
   sum  = (sum >> 16) + (sum & 0xffff);
@@ -271,7 +263,7 @@ int scamper_tcp6_build(scamper_probe_t *probe, uint8_t *buf, size_t *len)
 	}
 
       /* compute the checksum over the tcp portion of the probe */
-      tcp_cksum(ip6, tcp, tcphlen + probe->pr_len);
+      tcp_cksum(probe, ip6, tcp, tcphlen + probe->pr_len);
 
       *len = req;
       return 0;
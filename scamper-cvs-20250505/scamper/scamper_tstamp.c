@@ -0,0 +1,366 @@
+/*
+ * scamper_tstamp.c
+ *
+ * $Id$
+ *
+ * Copyright (C) 2025 The Regents of the University of California
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include "internal.h"
+
+#include "scamper.h"
+#include "scamper_debug.h"
+#include "scamper_tstamp.h"
+#include "utils.h"
+
+#ifndef _WIN32 /* windows does not have msghdr struct */
+
+#ifdef HAVE_SO_TIMESTAMPING
+/*
+ * tstamp_tx
+ *
+ * state kept for a socket whose transmit timestamps scamper reads.
+ * with SOF_TIMESTAMPING_OPT_ID, the kernel numbers the packets sent on
+ * the socket from zero, and reports the number in ee_data alongside
+ * the timestamp.
+ *
+ * next:  the number the kernel will give the next packet sent
+ * last:  the number of the last timestamp read
+ * flags: whether the socket timestamps packets sent, and whether a
+ *        timestamp has been read
+ */
+typedef struct tstamp_tx
+{
+  uint32_t next;
+  uint32_t last;
+  uint8_t  flags;
+} tstamp_tx_t;
+
+#define TSTAMP_TX_FLAG_ON   0x01
+#define TSTAMP_TX_FLAG_LAST 0x02
+
+static tstamp_tx_t *tx_fds = NULL;
+static size_t       tx_fdc = 0;
+
+static int tstamp_opt(int tx)
+{
+  int opt = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+
+  if(tx != 0)
+    opt |= SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_OPT_TSONLY |
+      SOF_TIMESTAMPING_OPT_ID;
+  if(scamper_option_tstamp_hw() != 0)
+    {
+      opt |= SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE;
+      if(tx != 0)
+	opt |= SOF_TIMESTAMPING_TX_HARDWARE;
+    }
+
+  return opt;
+}
+
+static tstamp_tx_t *tstamp_tx_get(int fd)
+{
+  if(fd < 0 || (size_t)fd >= tx_fdc ||
+     (tx_fds[fd].flags & TSTAMP_TX_FLAG_ON) == 0)
+    return NULL;
+  return &tx_fds[fd];
+}
+
+/*
+ * tstamp_tx_set
+ *
+ * record whether the socket timestamps the packets sent on it.  the
+ * kernel restarts its numbering when the option is set.
+ */
+static int tstamp_tx_set(int fd, int tx)
+{
+  size_t len;
+
+  if(fd < 0)
+    return -1;
+
+  if((size_t)fd >= tx_fdc)
+    {
+      if(tx == 0)
+	return 0;
+      len = (fd + 1) * sizeof(tstamp_tx_t);
+      if(realloc_wrap((void **)&tx_fds, len) != 0)
+	return -1;
+      memset(tx_fds + tx_fdc, 0, (fd + 1 - tx_fdc) * sizeof(tstamp_tx_t));
+      tx_fdc = fd + 1;
+    }
+
+  memset(&tx_fds[fd], 0, sizeof(tstamp_tx_t));
+  if(tx != 0)
+    tx_fds[fd].flags = TSTAMP_TX_FLAG_ON;
+
+  return 0;
+}
+
+/*
+ * tstamp_tx_id
+ *
+ * return one if the control message carries the number the kernel gave
+ * to the packet that a transmit timestamp belongs to.
+ */
+static int tstamp_tx_id(const struct cmsghdr *cmsg, uint32_t *id)
+{
+  const struct sock_extended_err *ee;
+
+  if((cmsg->cmsg_level == IPPROTO_IP && cmsg->cmsg_type == IP_RECVERR) ||
+     (cmsg->cmsg_level == IPPROTO_IPV6 && cmsg->cmsg_type == IPV6_RECVERR))
+    {
+      ee = (const struct sock_extended_err *)CMSG_DATA(cmsg);
+      if(ee->ee_origin == SO_EE_ORIGIN_TIMESTAMPING)
+	{
+	  *id = ee->ee_data;
+	  return 1;
+	}
+    }
+
+  return 0;
+}
+
+/*
+ * tstamp_tx_read
+ *
+ * read transmit timestamps from the socket's error queue.  if tv is
+ * not NULL, stop at the timestamp for the packet numbered want, which
+ * is the packet just sent, and return one.  timestamps for packets
+ * sent before that one are discarded.
+ *
+ * the numbers have to increase.  if they do not, the kernel does not
+ * support SOF_TIMESTAMPING_OPT_ID for this type of socket, and a
+ * timestamp cannot be matched to its packet, so stop timestamping the
+ * packets sent on the socket.
+ */
+static int tstamp_tx_read(int fd, tstamp_tx_t *tx, uint32_t want,
+			  struct timeval *tv)
+{
+  struct timeval ts;
+  struct cmsghdr *cmsg;
+  struct msghdr msg;
+  uint8_t ctrlbuf[256];
+  uint32_t id = 0;
+  int have_ts, have_id;
+
+  for(;;)
+    {
+      memset(&msg, 0, sizeof(msg));
+      msg.msg_control    = (caddr_t)ctrlbuf;
+      msg.msg_controllen = sizeof(ctrlbuf);
+      if(recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) == -1)
+	break;
+      if(msg.msg_controllen < sizeof(struct cmsghdr))
+	continue;
+
+      have_ts = have_id = 0;
+      cmsg = (struct cmsghdr *)CMSG_FIRSTHDR(&msg);
+      while(cmsg != NULL)
+	{
+	  if(scamper_tstamp_cmsg(cmsg, &ts) != 0)
+	    have_ts = 1;
+	  else if(tstamp_tx_id(cmsg, &id) != 0)
+	    have_id = 1;
+	  cmsg = (struct cmsghdr *)CMSG_NXTHDR(&msg, cmsg);
+	}
+      if(have_ts == 0 || have_id == 0)
+	continue;
+
+      if((tx->flags & TSTAMP_TX_FLAG_LAST) != 0 &&
+	 (int32_t)(id - tx->last) <= 0)
+	{
+	  scamper_debug(__func__, "fd %d: timestamp %u after %u, disabling",
+			fd, id, tx->last);
+	  setsockopt_int(fd, SOL_SOCKET, SO_TIMESTAMPING, tstamp_opt(0));
+	  tx->flags = 0;
+	  return 0;
+	}
+      tx->last = id;
+      tx->flags |= TSTAMP_TX_FLAG_LAST;
+
+      /*
+       * a number past the one expected means the kernel counted a
+       * packet that scamper did not see sent, such as one where sendto
+       * failed.  that packet did not get a timestamp, so this one
+       * belongs to the packet just sent.
+       */
+      if(tv != NULL && (int32_t)(id - want) >= 0)
+	{
+	  timeval_cpy(tv, &ts);
+	  tx->next = id + 1;
+	  return 1;
+	}
+    }
+
+  return 0;
+}
+#endif /* HAVE_SO_TIMESTAMPING */
+
+/*
+ * scamper_tstamp_sock
+ *
+ * on Linux, use SO_TIMESTAMPING so that the kernel records when it
+ * received each packet, and if tx is set, when it sent each packet.
+ * hardware timestamps are only requested if the user asked for them,
+ * as they are only meaningful if the NIC's clock is synchronised to
+ * the system clock.  elsewhere, fall back to SO_TIMESTAMP.
+ */
+int scamper_tstamp_sock(int fd, int tx)
+{
+#ifdef HAVE_SO_TIMESTAMPING
+  if(tx != 0)
+    {
+      if(setsockopt_int(fd, SOL_SOCKET, SO_TIMESTAMPING, tstamp_opt(1)) == 0)
+	return tstamp_tx_set(fd, 1);
+      scamper_debug(__func__, "could not set SO_TIMESTAMPING tx: %s",
+		    strerror(errno));
+    }
+
+  tstamp_tx_set(fd, 0);
+  if(setsockopt_int(fd, SOL_SOCKET, SO_TIMESTAMPING, tstamp_opt(0)) == 0)
+    return 0;
+  scamper_debug(__func__, "could not set SO_TIMESTAMPING: %s",
+		strerror(errno));
+#endif
+
+#if defined(SO_TIMESTAMP)
+  if(setsockopt_int(fd, SOL_SOCKET, SO_TIMESTAMP, 1) != 0)
+    {
+      printerror(__func__, "could not set SO_TIMESTAMP");
+      return -1;
+    }
+#endif
+
+  return 0;
+}
+
+/*
+ * scamper_tstamp_cmsg
+ *
+ * return one if the control message contained a timestamp, preferring
+ * the hardware timestamp when the kernel supplied one.
+ */
+int scamper_tstamp_cmsg(const struct cmsghdr *cmsg, struct timeval *tv)
+{
+#ifdef HAVE_SO_TIMESTAMPING
+  const struct scm_timestamping *ts;
+  int i;
+#endif
+
+  if(cmsg->cmsg_level != SOL_SOCKET)
+    return 0;
+
+#if defined(SO_TIMESTAMP)
+  if(cmsg->cmsg_type == SCM_TIMESTAMP)
+    {
+      timeval_cpy(tv, (const struct timeval *)CMSG_DATA(cmsg));
+      return 1;
+    }
+#endif
+
+#ifdef HAVE_SO_TIMESTAMPING
+  if(cmsg->cmsg_type == SCM_TIMESTAMPING)
+    {
+      /* ts[0] is the software timestamp, ts[2] the raw hardware one */
+      ts = (const struct scm_timestamping *)CMSG_DATA(cmsg);
+      if(ts->ts[2].tv_sec != 0 || ts->ts[2].tv_nsec != 0)
+	i = 2;
+      else if(ts->ts[0].tv_sec != 0 || ts->ts[0].tv_nsec != 0)
+	i = 0;
+      else
+	return 0;
+      tv->tv_sec  = ts->ts[i].tv_sec;
+      tv->tv_usec = ts->ts[i].tv_nsec / 1000;
+      return 1;
+    }
+#endif
+
+  return 0;
+}
+
+/*
+ * scamper_tstamp_tx_isenabled
+ *
+ * return one if the kernel timestamps the packets sent on the socket,
+ * so the caller does not need to take the time before sending.
+ */
+int scamper_tstamp_tx_isenabled(int fd)
+{
+#ifdef HAVE_SO_TIMESTAMPING
+  if(tstamp_tx_get(fd) != NULL)
+    return 1;
+#endif
+  return 0;
+}
+
+/*
+ * scamper_tstamp_tx
+ *
+ * a packet was just sent on the socket.  if the kernel timestamps the
+ * packets sent on the socket, set tv to the timestamp it gave this
+ * packet.  the kernel normally queues the timestamp before sendto
+ * returns; if it has not, use the current time.
+ */
+void scamper_tstamp_tx(int fd, struct timeval *tv)
+{
+#ifdef HAVE_SO_TIMESTAMPING
+  tstamp_tx_t *tx;
+
+  if((tx = tstamp_tx_get(fd)) == NULL)
+    return;
+  if(tstamp_tx_read(fd, tx, tx->next++, tv) == 0)
+    gettimeofday_wrap(tv);
+#endif
+  return;
+}
+
+/*
+ * scamper_tstamp_tx_drain
+ *
+ * a transmit timestamp that arrives after scamper looked for it makes
+ * poll report the socket as readable.  read and discard it.
+ */
+void scamper_tstamp_tx_drain(int fd)
+{
+#ifdef HAVE_SO_TIMESTAMPING
+  tstamp_tx_t *tx;
+
+  if((tx = tstamp_tx_get(fd)) != NULL)
+    tstamp_tx_read(fd, tx, 0, NULL);
+#endif
+  return;
+}
+
+void scamper_tstamp_cleanup(void)
+{
+#ifdef HAVE_SO_TIMESTAMPING
+  if(tx_fds != NULL)
+    {
+      free(tx_fds);
+      tx_fds = NULL;
+    }
+  tx_fdc = 0;
+#endif
+  return;
+}
+
+#endif /* _WIN32 */
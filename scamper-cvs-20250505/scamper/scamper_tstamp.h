@@ -0,0 +1,47 @@
+/*
+ * scamper_tstamp.h
+ *
+ * $Id$
+ *
+ * Copyright (C) 2025 The Regents of the University of California
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef __SCAMPER_TSTAMP_H
+#define __SCAMPER_TSTAMP_H
+
+#ifndef _WIN32 /* windows does not have msghdr struct */
+
+/* ask the kernel to timestamp packets received, and optionally sent */
+int scamper_tstamp_sock(int fd, int tx);
+
+/* if the control message carries a timestamp, copy it into tv */
+int scamper_tstamp_cmsg(const struct cmsghdr *cmsg, struct timeval *tv);
+
+/* does the kernel timestamp packets sent on fd */
+int scamper_tstamp_tx_isenabled(int fd);
+
+/* set tv to the time the kernel sent the packet just sent on fd */
+void scamper_tstamp_tx(int fd, struct timeval *tv);
+
+/* discard transmit timestamps that arrived late */
+void scamper_tstamp_tx_drain(int fd);
+
+void scamper_tstamp_cleanup(void);
+
+#endif /* _WIN32 */
+
+#endif /* __SCAMPER_TSTAMP_H */
@@ -41,6 +41,10 @@
 #include "scamper_udp4.h"
 #include "scamper_priv.h"
 #include "scamper_udp_resp.h"
+#include "scamper_tstamp.h"
+#ifdef ENABLE_SCAMPER_SIMNET
+#include "scamper_simnet.h"
+#endif
 #include "utils.h"
 
 /*
@@ -54,7 +58,7 @@ static size_t   pktbuf_len = 0;
 uint16_t scamper_udp4_cksum(scamper_probe_t *probe)
 {
   uint16_t tmp, *w;
-  int i, sum = 0;
+  int sum = 0;
 
   /* compute the checksum over the psuedo header */
   w = (uint16_t *)probe->pr_ip_src->addr;
@@ -70,15 +74,7 @@ uint16_t scamper_udp4_cksum(scamper_probe_t *probe)
   sum += htons(probe->pr_len + 8);
 
   /* compute the checksum over the payload of the UDP message */
-  w = (uint16_t *)probe->pr_data;
-  for(i = probe->pr_len; i > 1; i -= 2)
-    {
-      sum += *w++;
-    }
-  if(i != 0)
-    {
-      sum += ((uint8_t *)w)[0];
-    }
+  sum += scamper_probe_datasum(probe);
 
   /* fold the checksum */
   sum  = (sum >> 16) + (sum & 0xffff);
@@ -176,11 +172,23 @@ int scamper_udp4_probe(scamper_probe_t *probe)
   sockaddr_compose((struct sockaddr *)&sin4, AF_INET,
 		   probe->pr_ip_dst->addr, probe->pr_udp_dport);
 
-  /* get the transmit time immediately before we send the packet */
-  gettimeofday_wrap(&probe->pr_tx);
+  /*
+   * get the transmit time immediately before we send the packet,
+   * unless the kernel will timestamp the packet as it sends it
+   */
+#if !defined(_WIN32) && !defined(ENABLE_SCAMPER_SIMNET)
+  if(scamper_tstamp_tx_isenabled(probe->pr_fd) == 0)
+#endif
+    gettimeofday_wrap(&probe->pr_tx);
 
+#ifndef ENABLE_SCAMPER_SIMNET
   i = sendto(probe->pr_fd, pktbuf, len, 0, (struct sockaddr *)&sin4,
 	     sizeof(struct sockaddr_in));
+#else
+  i = scamper_simnet_sendto(probe->pr_fd, pktbuf, len,
+			    (struct sockaddr *)&sin4,
+			    sizeof(struct sockaddr_in));
+#endif
 
   if(i < 0)
     {
@@ -200,6 +208,10 @@ int scamper_udp4_probe(scamper_probe_t *probe)
       return -1;
     }
 
+#if !defined(_WIN32) && !defined(ENABLE_SCAMPER_SIMNET)
+  scamper_tstamp_tx(probe->pr_fd, &probe->pr_tx);
+#endif
+
   return 0;
 }
 
@@ -245,11 +257,8 @@ void scamper_udp4_read_cb(SOCKET fd, void *param)
       cmsg = (struct cmsghdr *)CMSG_FIRSTHDR(&msg);
       while(cmsg != NULL)
 	{
-	  if(cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMP)
-	    {
-	      timeval_cpy(&ur.rx, (struct timeval *)CMSG_DATA(cmsg));
-	      goto next;
-	    }
+	  if(scamper_tstamp_cmsg(cmsg, &ur.rx) != 0)
+	    goto next;
 
 	  if(cmsg->cmsg_level == IPPROTO_IP && cmsg->cmsg_type == IP_TTL)
 	    {
@@ -318,6 +327,10 @@ SOCKET scamper_udp4_opendgram(const void *addr, int sport)
   SOCKET fd;
 #endif
 
+#ifdef ENABLE_SCAMPER_SIMNET
+  return scamper_simnet_open(AF_INET, IPPROTO_UDP, 0, addr, sport);
+#endif
+
   fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
   if(socket_isinvalid(fd))
     {
@@ -331,9 +344,8 @@ SOCKET scamper_udp4_opendgram(const void *addr, int sport)
       goto err;
     }
 
-#if defined(SO_TIMESTAMP)
-  if(setsockopt_int(fd, SOL_SOCKET, SO_TIMESTAMP, 1) != 0)
-    printerror(__func__, "could not set SO_TIMESTAMP");
+#ifndef _WIN32 /* windows does not have msghdr struct */
+  scamper_tstamp_sock(fd, 0);
 #endif
 
   if(setsockopt_int(fd, IPPROTO_IP, IP_RECVTTL, 1) != 0)
@@ -424,6 +436,10 @@ SOCKET scamper_udp4_openraw(const void *addr)
   SOCKET fd;
 #endif
 
+#ifdef ENABLE_SCAMPER_SIMNET
+  return scamper_simnet_open(AF_INET, IPPROTO_UDP, 1, addr, 0);
+#endif
+
   fd = scamper_priv_udp4raw(addr);
   if(socket_isinvalid(fd))
     goto err;
@@ -433,6 +449,12 @@ SOCKET scamper_udp4_openraw(const void *addr)
       printerror(__func__, "could not set SO_SNDBUF");
       goto err;
     }
+
+#ifndef _WIN32 /* windows does not have msghdr struct */
+  if(scamper_tstamp_sock(fd, 1) != 0)
+    goto err;
+#endif
+
   return fd;
 
  err:
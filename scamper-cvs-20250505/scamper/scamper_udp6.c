@@ -41,6 +41,10 @@
 #include "scamper_icmp_resp.h"
 #include "scamper_udp_resp.h"
 #include "scamper_fds.h"
+#include "scamper_tstamp.h"
+#ifdef ENABLE_SCAMPER_SIMNET
+#include "scamper_simnet.h"
+#endif
 #include "utils.h"
 
 #if defined(IPV6_RECVERR)
@@ -50,7 +54,7 @@ static uint8_t rxbuf[65536];
 uint16_t scamper_udp6_cksum(scamper_probe_t *probe)
 {
   uint16_t *w, tmp;
-  int i, sum = 0;
+  int sum = 0;
 
   /* compute the checksum over the psuedo header */
   w = (uint16_t *)probe->pr_ip_src->addr;
@@ -68,15 +72,7 @@ uint16_t scamper_udp6_cksum(scamper_probe_t *probe)
   sum += htons(probe->pr_len + 8);
 
   /* compute the checksum over the payload of the UDP message */
-  w = (uint16_t *)probe->pr_data;
-  for(i = probe->pr_len; i > 1; i -= 2)
-    {
-      sum += *w++;
-    }
-  if(i != 0)
-    {
-      sum += ((uint8_t *)w)[0];
-    }
+  sum += scamper_probe_datasum(probe);
 
   /* fold the checksum */
   sum  = (sum >> 16) + (sum & 0xffff);
@@ -152,16 +148,26 @@ int scamper_udp6_probe(scamper_probe_t *probe)
   assert(probe->pr_ip_src != NULL);
   assert(probe->pr_len != 0 || probe->pr_data == NULL);
 
+#ifndef ENABLE_SCAMPER_SIMNET
   if(setsockopt_int(probe->pr_fd,
 		    IPPROTO_IPV6, IPV6_UNICAST_HOPS, probe->pr_ip_ttl) != 0)
+#else
+  if(scamper_simnet_setsockopt_int(probe->pr_fd,
+		    IPPROTO_IPV6, IPV6_UNICAST_HOPS, probe->pr_ip_ttl) != 0)
+#endif
     {
       printerror(__func__, "could not set hlim to %d", probe->pr_ip_ttl);
       return -1;
     }
 
 #ifdef IPV6_TCLASS
+#ifndef ENABLE_SCAMPER_SIMNET
   if(setsockopt_int(probe->pr_fd,
 		    IPPROTO_IPV6, IPV6_TCLASS, probe->pr_ip_tos) != 0)
+#else
+  if(scamper_simnet_setsockopt_int(probe->pr_fd,
+		    IPPROTO_IPV6, IPV6_TCLASS, probe->pr_ip_tos) != 0)
+#endif
     {
       printerror(__func__, "could not set tclass to %d", probe->pr_ip_tos);
       return -1;
@@ -171,8 +177,14 @@ int scamper_udp6_probe(scamper_probe_t *probe)
   sockaddr_compose((struct sockaddr *)&sin6, AF_INET6,
 		   probe->pr_ip_dst->addr, probe->pr_udp_dport);
 
-  /* get the transmit time immediately before we send the packet */
-  gettimeofday_wrap(&probe->pr_tx);
+  /*
+   * get the transmit time immediately before we send the packet,
+   * unless the kernel will timestamp the packet as it sends it
+   */
+#if !defined(_WIN32) && !defined(ENABLE_SCAMPER_SIMNET)
+  if(scamper_tstamp_tx_isenabled(probe->pr_fd) == 0)
+#endif
+    gettimeofday_wrap(&probe->pr_tx);
 
   /*
    * if we are using RECVERR socket, then we might need to try probing
@@ -185,15 +197,25 @@ int scamper_udp6_probe(scamper_probe_t *probe)
 
   for(j=0; j<k; j++)
     {
+#ifndef ENABLE_SCAMPER_SIMNET
       i = sendto(probe->pr_fd, probe->pr_data, probe->pr_len, 0,
 		 (struct sockaddr *)&sin6, sizeof(struct sockaddr_in6));
+#else
+      i = scamper_simnet_sendto(probe->pr_fd, probe->pr_data, probe->pr_len,
+		 (struct sockaddr *)&sin6, sizeof(struct sockaddr_in6));
+#endif
 
       /*
        * if we sent the probe successfully, there is nothing more to
        * do here
        */
       if(i == probe->pr_len)
-	return 0;
+	{
+#if !defined(_WIN32) && !defined(ENABLE_SCAMPER_SIMNET)
+	  scamper_tstamp_tx(probe->pr_fd, &probe->pr_tx);
+#endif
+	  return 0;
+	}
       else if(i != -1)
 	break;
     }
@@ -249,8 +271,18 @@ void scamper_udp6_read_cb(SOCKET fd, void *param)
   msg.msg_control    = (caddr_t)ctrlbuf;
   msg.msg_controllen = sizeof(ctrlbuf);
 
+#ifdef HAVE_SO_TIMESTAMPING
+  if((rrc = recvmsg(fd, &msg, MSG_DONTWAIT)) <= 0)
+    {
+      /* discard a transmit timestamp that arrived late */
+      if(rrc == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+	scamper_tstamp_tx_drain(fd);
+      return;
+    }
+#else
   if((rrc = recvmsg(fd, &msg, 0)) <= 0)
     return;
+#endif
 
   memset(&ur, 0, sizeof(ur));
   ur.ttl = -1;
@@ -260,8 +292,8 @@ void scamper_udp6_read_cb(SOCKET fd, void *param)
       cmsg = (struct cmsghdr *)CMSG_FIRSTHDR(&msg);
       while(cmsg != NULL)
 	{
-	  if(cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMP)
-	    timeval_cpy(&ur.rx, (struct timeval *)CMSG_DATA(cmsg));
+	  if(cmsg->cmsg_level == SOL_SOCKET)
+	    scamper_tstamp_cmsg(cmsg, &ur.rx);
 #if defined(IPV6_HOPLIMIT)
 	  else if(cmsg->cmsg_level == IPPROTO_IPV6 &&
 		  cmsg->cmsg_type == IPV6_HOPLIMIT)
@@ -334,11 +366,8 @@ static int scamper_udp6_read_err(int fd, scamper_icmp_resp_t *resp)
   cm = (struct cmsghdr *)CMSG_FIRSTHDR(&msg);
   while(cm != NULL)
     {
-      if(cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_TIMESTAMP)
-	{
-	  timeval_cpy(&resp->ir_rx, (struct timeval *)CMSG_DATA(cm));
-	  resp->ir_flags |= SCAMPER_ICMP_RESP_FLAG_KERNRX;
-	}
+      if(scamper_tstamp_cmsg(cm, &resp->ir_rx) != 0)
+	resp->ir_flags |= SCAMPER_ICMP_RESP_FLAG_KERNRX;
       else if(cm->cmsg_level == IPPROTO_IPV6 && cm->cmsg_type == IPV6_RECVERR)
 	{
 	  ee = (struct sock_extended_err *)CMSG_DATA(cm);
@@ -425,6 +454,10 @@ SOCKET scamper_udp6_open(const void *addr, int sport)
   SOCKET fd = INVALID_SOCKET;
 #endif
 
+#ifdef ENABLE_SCAMPER_SIMNET
+  return scamper_simnet_open(AF_INET6, IPPROTO_UDP, 0, addr, sport);
+#endif
+
   fd = socket(AF_INET6, SOCK_DGRAM, IPPROTO_UDP);
   if(socket_isinvalid(fd))
     {
@@ -472,9 +505,8 @@ SOCKET scamper_udp6_open(const void *addr, int sport)
     printerror(__func__, "could not set IPV6_HOPLIMIT");
 #endif
 
-#if defined(SO_TIMESTAMP)
-  if(setsockopt_int(fd, SOL_SOCKET, SO_TIMESTAMP, 1) != 0)
-    printerror(__func__, "could not set SO_TIMESTAMP");
+#ifndef _WIN32 /* windows does not have msghdr struct */
+  scamper_tstamp_sock(fd, 1);
 #endif
 
   /*
@@ -511,6 +543,10 @@ SOCKET scamper_udp6_open_err(const void *addr, int sport)
   SOCKET fd;
 #endif
 
+#ifdef ENABLE_SCAMPER_SIMNET
+  return scamper_simnet_open(AF_INET6, IPPROTO_UDP, 0, addr, sport);
+#endif
+
   fd = scamper_udp6_open(addr, sport);
   if(socket_isinvalid(fd))
     return socket_invalid();
@@ -521,6 +557,13 @@ SOCKET scamper_udp6_open_err(const void *addr, int sport)
       goto err;
     }
 
+  /*
+   * ICMP messages are read from the error queue, so do not put transmit
+   * timestamps there as well.
+   */
+  if(scamper_tstamp_sock(fd, 0) != 0)
+    goto err;
+
   if(setsockopt_int(fd, IPPROTO_IPV6, IPV6_RECVERR, 1) != 0)
     {
       printerror(__func__, "could not set IPV6_RECVERR");
@@ -238,6 +238,7 @@ typedef struct trace_state
   uint16_t             alloc_hops;    /* number of trace->hops allocated */
   uint16_t             payload_size;  /* how much payload to include */
   uint16_t             header_size;   /* size of headers */
+  uint16_t             payload_sum;   /* sum of payload after 4 bytes */
   struct timeval       last_tx;       /* when the last probe was */
 
 #ifndef DISABLE_SCAMPER_HOST
@@ -3994,6 +3995,10 @@ static int trace_state_alloc(scamper_task_t *task)
   state->payload_size = trace->probe_size - state->header_size;
   state->id_max       = id_max;
 
+  if(trace->payload_len > 4)
+    state->payload_sum = in_cksum_add(0, trace->payload + 4,
+				      trace->payload_len - 4);
+
   /* if scamper has to get the ifindex, then start in the rtsock mode */
   if(SCAMPER_TRACE_FLAG_IS_PMTUD(trace) || SCAMPER_TRACE_FLAG_IS_DL(trace) ||
      SCAMPER_TRACE_TYPE_IS_TCP(trace) || trace->offset != 0 ||
@@ -4076,6 +4081,38 @@ static void do_trace_free(scamper_task_t *task)
  *
  * time to probe, so send the packet.
  */
+/*
+ * trace_probe_datasum
+ *
+ * apart from its first four bytes, which carry the probe's id or the
+ * value that fixes its checksum, the body of a probe is either zero or
+ * the trace's payload.  the sum of the rest of the body was computed
+ * when the trace started, so only the first four bytes are summed for
+ * each probe.  the body of a fragment is not covered by a checksum.
+ */
+static void trace_probe_datasum(const scamper_trace_t *trace,
+				const trace_state_t *state,
+				scamper_probe_t *probe)
+{
+  uint16_t sum = 0;
+  size_t len;
+
+  if(trace->offset != 0 || probe->pr_len == 0)
+    return;
+
+  if(trace->payload_len != 0 && MODE_IS_PMTUD(state->mode) == 0)
+    {
+      if(trace->payload_len != probe->pr_len)
+	return;
+      sum = state->payload_sum;
+    }
+
+  len = probe->pr_len < 4 ? probe->pr_len : 4;
+  probe->pr_data_sum = in_cksum_add(sum, probe->pr_data, len);
+  probe->pr_flags |= SCAMPER_PROBE_FLAG_DATASUM;
+  return;
+}
+
 static void do_trace_probe(scamper_task_t *task)
 {
   scamper_probe_ipopt_t opt;
@@ -4273,6 +4310,7 @@ static void do_trace_probe(scamper_task_t *task)
     {
       memcpy(probe.pr_data, trace->payload, trace->payload_len);
     }
+  trace_probe_datasum(trace, state, &probe);
 
   if(trace->offset != 0)
     {
@@ -4313,11 +4351,13 @@ static void do_trace_probe(scamper_task_t *task)
 	   * 16 bit quantities in the packet
 	   */
 	  bytes_htons(probe.pr_data, state->id_next + 1);
+	  trace_probe_datasum(trace, state, &probe);
 	  if(trace->dst->type == SCAMPER_ADDR_TYPE_IPV4)
 	    u16 = scamper_udp4_cksum(&probe);
 	  else
 	    u16 = scamper_udp6_cksum(&probe);
 	  memcpy(probe.pr_data, &u16, 2);
+	  trace_probe_datasum(trace, state, &probe);
 	}
       else if(trace->dst->type == SCAMPER_ADDR_TYPE_IPV6)
 	probe.pr_ip_flow = state->id_next + 1;
@@ -4339,11 +4379,13 @@ static void do_trace_probe(scamper_task_t *task)
 	  probe.pr_icmp_sum = htons(trace->dport);
 	  u16 = htons(trace->dport);
 	  memcpy(probe.pr_data, &u16, 2);
+	  trace_probe_datasum(trace, state, &probe);
 	  if(trace->dst->type == SCAMPER_ADDR_TYPE_IPV4)
 	    u16 = scamper_icmp4_cksum(&probe);
 	  else
 	    u16 = scamper_icmp6_cksum(&probe);
 	  memcpy(probe.pr_data, &u16, 2);
+	  trace_probe_datasum(trace, state, &probe);
 	}
     }
   else
@@ -202,6 +202,7 @@ static char *header_tostr(const scamper_trace_t *trace)
   char buf[512], tmp[128];
   size_t off = 0;
   time_t tt = trace->start.tv_sec;
+  struct tm tm;
   uint32_t cs;
 
   string_concat(buf,sizeof(buf),&off,"\"type\":\"trace\",\"version\":\"0.1\"");
@@ -232,7 +233,13 @@ static char *header_tostr(const scamper_trace_t *trace)
 		    (uint32_t)trace->start.tv_sec);
   string_concat_u32(buf, sizeof(buf), &off, ", \"usec\":",
 		    (uint32_t)trace->start.tv_usec);
-  strftime(tmp, sizeof(tmp), "%Y-%m-%d %H:%M:%S", localtime(&tt));
+  /* localtime_r, as this may run on more than one thread at once */
+#ifndef _WIN32 /* windows does not have localtime_r */
+  localtime_r(&tt, &tm);
+#else
+  localtime_s(&tm, &tt);
+#endif
+  strftime(tmp, sizeof(tmp), "%Y-%m-%d %H:%M:%S", &tm);
   string_concat2(buf, sizeof(buf), &off, ", \"ftime\":\"", tmp);
   string_concat_u16(buf, sizeof(buf), &off, "\"}, \"hop_count\":",
 		    trace->stop_hop == 0 ? trace->hop_count : trace->stop_hop);
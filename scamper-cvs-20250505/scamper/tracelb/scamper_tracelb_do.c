@@ -4272,8 +4272,12 @@ static void do_tracelb_probe(scamper_task_t *task)
   if(trace->dst->type == SCAMPER_ADDR_TYPE_IPV4)
     probe.pr_ip_off  = IP_DF;
 
-  /* reset the payload of the packet */
+  /*
+   * reset the payload of the packet.  only the first two bytes of the
+   * payload are set below, so the sum of the payload is those two bytes
+   */
   memset(probe.pr_data, 0, probe.pr_len);
+  probe.pr_flags |= SCAMPER_PROBE_FLAG_DATASUM;
 
   if(SCAMPER_TRACELB_TYPE_IS_UDP(trace))
     {
@@ -4299,6 +4303,7 @@ static void do_tracelb_probe(scamper_task_t *task)
        */
       u16 = htons(state->id_next + 1);
       memcpy(probe.pr_data, &u16, 2);
+      probe.pr_data_sum = u16;
       if(trace->dst->type == SCAMPER_ADDR_TYPE_IPV4)
 	{
 	  probe.pr_ip_id = state->id_next + 1;
@@ -4309,6 +4314,7 @@ static void do_tracelb_probe(scamper_task_t *task)
 	  u16 = scamper_udp6_cksum(&probe);
 	}
       memcpy(probe.pr_data, &u16, 2);
+      probe.pr_data_sum = u16;
     }
   else if(SCAMPER_TRACELB_TYPE_IS_ICMP(trace))
     {
@@ -4321,11 +4327,13 @@ static void do_tracelb_probe(scamper_task_t *task)
 
       /* fudge the checksum field so it is used as the flow id */
       memcpy(probe.pr_data, &u16, 2);
+      probe.pr_data_sum = u16;
       if(trace->dst->type == SCAMPER_ADDR_TYPE_IPV4)
 	u16 = scamper_icmp4_cksum(&probe);
       else
 	u16 = scamper_icmp6_cksum(&probe);
       memcpy(probe.pr_data, &u16, 2);
+      probe.pr_data_sum = u16;
     }
   else
     {
@@ -49,6 +49,7 @@ static char *header_tostr(const scamper_tracelb_t *trace)
   char buf[512], tmp[128];
   size_t off = 0;
   time_t tt = trace->start.tv_sec;
+  struct tm tm;
   uint32_t cs;
 
   string_concat(buf, sizeof(buf), &off,
@@ -68,7 +69,13 @@ static char *header_tostr(const scamper_tracelb_t *trace)
   if(SCAMPER_TRACELB_TYPE_IS_UDP(trace) || SCAMPER_TRACELB_TYPE_IS_TCP(trace))
     string_concaf(buf, sizeof(buf), &off, ", \"sport\":%u, \"dport\":%u",
 		  trace->sport, trace->dport);
-  strftime(tmp, sizeof(tmp), "%Y-%m-%d %H:%M:%S", localtime(&tt));
+  /* localtime_r, as this may run on more than one thread at once */
+#ifndef _WIN32 /* windows does not have localtime_r */
+  localtime_r(&tt, &tm);
+#else
+  localtime_s(&tm, &tt);
+#endif
+  strftime(tmp, sizeof(tmp), "%Y-%m-%d %H:%M:%S", &tm);
   string_concaf(buf, sizeof(buf), &off,
 		", \"start\":{\"sec\":%ld, \"usec\":%d, \"ftime\":\"%s\"}",
 		(long)trace->start.tv_sec, (int)trace->start.tv_usec, tmp);
@@ -7,6 +7,10 @@ my $rc = 0;
 
 my @tests = (
     ["unit_addr"],
+    ["unit_analysis_dump.pl"],
+    ["unit_cksum"],
+    ["unit_cols", "check ."],
+    ["unit_ctrl"],
     ["unit_cmd_dealias"],
     ["unit_cmd_host"],
     ["unit_cmd_http"],
@@ -30,9 +34,13 @@ my @tests = (
     ["unit_ping_dup"],
     ["unit_ping_lib"],
     ["unit_prefixtree"],
+    ["unit_relit"],
+    ["unit_simnet"],
+    ["unit_sources"],
     ["unit_splaytree"],
     ["unit_string"],
     ["unit_timeval"],
+    ["unit_tls"],
     ["unit_trace_dup"],
     ["unit_warts", "check ."],
     );
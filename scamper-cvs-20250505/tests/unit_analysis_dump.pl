@@ -0,0 +1,82 @@
+#!/usr/bin/env perl
+#
+# unit_analysis_dump.pl : check that sc_analysis_dump output does not
+#                         change
+#
+# $Id$
+#
+# the expected output in analysis_dump/ was made by sc_analysis_dump
+# before it built its lines in a buffer and formatted traces in threads.
+# trace-sim.warts was collected with scamper in simnet mode, and the
+# other warts files are the traceroutes in common_trace.c.
+#
+
+use strict;
+use warnings;
+
+my $bin = "../utils/sc_analysis_dump/sc_analysis_dump";
+my $dir = "analysis_dump";
+my @in = ("trace-sim.warts",
+	  "trace-000.warts", "trace-001.warts", "trace-002.warts",
+	  "trace-003.warts", "trace-004.warts");
+
+my @tests = (
+    ["default"],
+    ["o",       "-o"],
+    ["oe",      "-o", "-e"],
+    ["CeUQMT",  "-C", "-e", "-U", "-Q", "-M", "-T"],
+    ["sdlctrH", "-s", "-d", "-l", "-c", "-t", "-r", "-H"],
+    ["ie",      "-i", "-e"],
+    ["p",       "-p"],
+    ["S3D10",   "-S", "3", "-D", "10"],
+    );
+
+sub slurp($)
+{
+    my ($cmd) = @_;
+    local $/;
+    open(CMD, $cmd) or return undef;
+    my $out = <CMD>;
+    close CMD;
+    return defined($out) ? $out : "";
+}
+
+# nothing to check if the utilities were not built
+if(! -x $bin)
+{
+    print "OK\n";
+    exit 0;
+}
+
+# -j is only available when built with threads
+my @threads = ([]);
+my $config = slurp("< ../config.h");
+push @threads, ["-j", "4"]
+    if(defined($config) && $config =~ /^#define HAVE_PTHREAD 1$/m);
+
+my $rc = 0;
+foreach my $test (@tests)
+{
+    my ($name, @opts) = @{$test};
+    my $exp = slurp("< $dir/$name.txt");
+    if(!defined($exp))
+    {
+	print "could not read $dir/$name.txt\n";
+	$rc = -1;
+	next;
+    }
+
+    foreach my $j (@threads)
+    {
+	my $cmd = join(' ', "cd $dir && ../$bin", @opts, @{$j}, @in);
+	my $out = slurp("$cmd |");
+	if(!defined($out) || $out ne $exp)
+	{
+	    print "fail $name " . join(' ', @opts, @{$j}) . "\n";
+	    $rc = -1;
+	}
+    }
+}
+
+print "OK\n" if($rc == 0);
+exit $rc;
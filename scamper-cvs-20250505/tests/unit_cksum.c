@@ -0,0 +1,261 @@
+/*
+ * unit_cksum: unit tests for the Internet checksum functions in utils.c
+ *
+ * $Id$
+ *
+ * Copyright (C) 2025 The Regents of the University of California
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include "internal.h"
+
+#include "utils.h"
+
+/* the buffer is large enough for any IP packet, plus an offset */
+static uint8_t buf[65536 + 64];
+static uint32_t rnd = 0x2545f491;
+
+/*
+ * ref_cksum
+ *
+ * the scalar checksum that scamper used before in_cksum was vectorised,
+ * which the current implementation must agree with.
+ */
+static uint16_t ref_cksum(const void *data, size_t len)
+{
+  const uint8_t *ptr = data;
+  uint16_t w;
+  size_t l = len;
+  int sum = 0;
+
+  while(l > 1)
+    {
+      memcpy(&w, ptr, 2);
+      sum += w;
+      ptr += 2;
+      l   -= 2;
+    }
+
+  if(l != 0)
+    sum += ptr[0];
+
+  sum  = (sum >> 16) + (sum & 0xffff);
+  sum += (sum >> 16);
+
+  return ~sum;
+}
+
+/* xorshift, so that any failure can be reproduced */
+static uint32_t rnd_u32(void)
+{
+  rnd ^= rnd << 13;
+  rnd ^= rnd >> 17;
+  rnd ^= rnd << 5;
+  return rnd;
+}
+
+static void rnd_fill(uint8_t *ptr, size_t len)
+{
+  size_t i;
+  for(i=0; i<len; i++)
+    ptr[i] = rnd_u32() & 0xff;
+  return;
+}
+
+/*
+ * check_fixed
+ *
+ * check the checksum of buffers whose sums are known, including the
+ * all-ones buffer that exercises the carries, and the largest buffer
+ * that in_cksum is given.
+ */
+static int check_fixed(void)
+{
+  static const uint8_t hdr[] = {
+    0x45, 0x00, 0x00, 0x73, 0x00, 0x00, 0x40, 0x00, 0x40, 0x11,
+    0x00, 0x00, 0xc0, 0xa8, 0x00, 0x01, 0xc0, 0xa8, 0x00, 0xc7};
+  uint16_t u16;
+  size_t len;
+
+  /* the example IPv4 header has a checksum of 0xb861 */
+  u16 = in_cksum(hdr, sizeof(hdr));
+  if(ntohs(u16) != 0xb861)
+    {
+      printf("fixed: ipv4 header %04x\n", ntohs(u16));
+      return -1;
+    }
+
+  memset(buf, 0xff, sizeof(buf));
+  for(len=0; len<=65535; len += (len < 1024 ? 1 : 4093))
+    {
+      if(in_cksum(buf, len) != ref_cksum(buf, len))
+	{
+	  printf("fixed: ones %d\n", (int)len);
+	  return -1;
+	}
+    }
+  if(in_cksum(buf, 65535) != ref_cksum(buf, 65535))
+    {
+      printf("fixed: ones 65535\n");
+      return -1;
+    }
+
+  memset(buf, 0, sizeof(buf));
+  if(in_cksum(buf, 1500) != 0xffff)
+    {
+      printf("fixed: zeros\n");
+      return -1;
+    }
+
+  return 0;
+}
+
+/*
+ * check_fuzz
+ *
+ * compare in_cksum against the reference over random buffers, lengths,
+ * and alignments, and check that in_cksum_add gives the same checksum
+ * when the buffer is summed in two parts.
+ */
+static int check_fuzz(void)
+{
+  size_t len, off, split;
+  uint16_t a, b;
+  int i;
+
+  for(i=0; i<20000; i++)
+    {
+      off = rnd_u32() % 64;
+      if((i % 10) == 0)
+	len = rnd_u32() % 65536;
+      else
+	len = rnd_u32() % 2048;
+      rnd_fill(buf + off, len);
+
+      a = in_cksum(buf + off, len);
+      b = ref_cksum(buf + off, len);
+      if(a != b)
+	{
+	  printf("fuzz: %d off %d len %d %04x != %04x\n",
+		 i, (int)off, (int)len, a, b);
+	  return -1;
+	}
+
+      split = len > 0 ? (rnd_u32() % len) & ~((size_t)1) : 0;
+      a = in_cksum_add(0, buf + off, split);
+      a = ~in_cksum_add(a, buf + off + split, len - split);
+      if(a != b)
+	{
+	  printf("fuzz: %d off %d len %d split %d %04x != %04x\n",
+		 i, (int)off, (int)len, (int)split, a, b);
+	  return -1;
+	}
+    }
+
+  return 0;
+}
+
+/*
+ * check_update
+ *
+ * change a word in a random buffer, as if the TTL, ID, or sequence
+ * number of a probe had changed, and check that the incrementally
+ * updated checksum matches the recomputed checksum.
+ */
+static int check_update(void)
+{
+  uint16_t cksum, from, to, a, b;
+  size_t len, off;
+  int i;
+
+  for(i=0; i<20000; i++)
+    {
+      len = 4 + ((rnd_u32() % 1500) & ~((size_t)1));
+      rnd_fill(buf, len);
+      buf[0] = 0x45;
+      cksum = in_cksum(buf, len);
+
+      /* the first word is never changed, so the buffer is not all zero */
+      off = 2 + (2 * (rnd_u32() % ((len - 2) / 2)));
+      memcpy(&from, buf + off, 2);
+      if((i % 4) == 0)
+	to = 0;
+      else
+	to = rnd_u32() & 0xffff;
+      memcpy(buf + off, &to, 2);
+
+      a = in_cksum_update(cksum, from, to);
+      b = in_cksum(buf, len);
+      if(a != b)
+	{
+	  printf("update: %d len %d off %d %04x != %04x\n",
+		 i, (int)len, (int)off, a, b);
+	  return -1;
+	}
+    }
+
+  return 0;
+}
+
+static int bench(void)
+{
+  static const size_t lens[] = {20, 64, 576, 1500, 9000, 65535};
+  struct timeval start, finish;
+  uint32_t x = 0;
+  size_t i, j, n;
+  uint64_t us;
+
+  rnd_fill(buf, sizeof(buf));
+  for(i=0; i<sizeof(lens) / sizeof(size_t); i++)
+    {
+      n = (256 * 1024 * 1024) / lens[i];
+
+      gettimeofday_wrap(&start);
+      for(j=0; j<n; j++)
+	x += ref_cksum(buf + (j & 1), lens[i]);
+      gettimeofday_wrap(&finish);
+      us = timeval_diff_us(&start, &finish);
+      printf("%5d bytes: reference %8.1f ns %7.1f MB/s",
+	     (int)lens[i], (double)us * 1000 / n,
+	     (double)n * lens[i] / (us > 0 ? us : 1));
+
+      gettimeofday_wrap(&start);
+      for(j=0; j<n; j++)
+	x += in_cksum(buf + (j & 1), lens[i]);
+      gettimeofday_wrap(&finish);
+      us = timeval_diff_us(&start, &finish);
+      printf(", in_cksum %8.1f ns %7.1f MB/s\n",
+	     (double)us * 1000 / n, (double)n * lens[i] / (us > 0 ? us : 1));
+    }
+
+  /* use the result so that the loops are not optimised away */
+  return x == 0 ? 1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+  if(argc == 2 && strcmp(argv[1], "bench") == 0)
+    return bench();
+
+  if(check_fixed() != 0 || check_fuzz() != 0 || check_update() != 0)
+    return -1;
+
+  printf("OK\n");
+  return 0;
+}
@@ -381,6 +381,122 @@ static int check(const char *cmd, int (*func)(const scamper_ping_t *in))
   return rc;
 }
 
+static int check_tmpl(void)
+{
+  scamper_ping_t *a = NULL, *b = NULL;
+  void *tmpl = NULL;
+  char cmd[128], errbuf[256];
+  int rc = -1;
+
+  /* a template cannot be made from an invalid command */
+  snprintf(cmd, sizeof(cmd), "-P udp -C 2323 192.0.2.1");
+  if((tmpl = scamper_do_ping_tmpl_alloc(cmd, errbuf, sizeof(errbuf))) != NULL)
+    goto done;
+
+  snprintf(cmd, sizeof(cmd), "-P tcp-syn -d 2323 -c 3 192.0.2.1");
+  if((tmpl = scamper_do_ping_tmpl_alloc(cmd, errbuf, sizeof(errbuf))) == NULL)
+    goto done;
+
+  /* the address must be valid, and of the same family as the template */
+  if((a = scamper_do_ping_tmpl_data(tmpl, "2001:db8::1",
+				    errbuf, sizeof(errbuf))) != NULL ||
+     (a = scamper_do_ping_tmpl_data(tmpl, "foo",
+				    errbuf, sizeof(errbuf))) != NULL)
+    goto done;
+
+  if((a = scamper_do_ping_tmpl_data(tmpl, "192.0.2.5",
+				    errbuf, sizeof(errbuf))) == NULL ||
+     (b = scamper_do_ping_tmpl_data(tmpl, "192.0.2.6",
+				    errbuf, sizeof(errbuf))) == NULL ||
+     check_addr(scamper_ping_dst_get(a), "192.0.2.5") != 0 ||
+     check_addr(scamper_ping_dst_get(b), "192.0.2.6") != 0 ||
+     scamper_ping_method_get(a) != SCAMPER_PING_METHOD_TCP_SYN ||
+     scamper_ping_method_get(b) != SCAMPER_PING_METHOD_TCP_SYN ||
+     scamper_ping_dport_get(a) != 2323 ||
+     scamper_ping_dport_get(b) != 2323 ||
+     scamper_ping_attempts_get(a) != 3 ||
+     scamper_ping_attempts_get(b) != 3 ||
+     scamper_ping_tcpack_get(a) != 0 ||
+     scamper_ping_tcpseq_get(a) == scamper_ping_tcpseq_get(b))
+    goto done;
+
+  rc = 0;
+
+ done:
+  if(rc != 0) printf("fail: template\n");
+  if(a != NULL) scamper_ping_free(a);
+  if(b != NULL) scamper_ping_free(b);
+  if(tmpl != NULL) scamper_do_ping_tmpl_free(tmpl);
+  return rc;
+}
+
+/*
+ * bench
+ *
+ * compare the rate at which ping tasks can be made by parsing a command
+ * for each destination, and by cloning a template.
+ */
+static int bench(const char *cmd, long count)
+{
+  struct timeval start, finish;
+  scamper_ping_t *ping;
+  void *tmpl;
+  char *dup, addr[32], errbuf[256];
+  double sec;
+  long i;
+
+  gettimeofday_wrap(&start);
+  for(i=0; i<count; i++)
+    {
+      if((dup = strdup(cmd)) == NULL)
+	return -1;
+      ping = scamper_do_ping_alloc(dup, errbuf, sizeof(errbuf));
+      free(dup);
+      if(ping == NULL)
+	{
+	  printf("%s: %s\n", cmd, errbuf);
+	  return -1;
+	}
+      scamper_ping_free(ping);
+    }
+  gettimeofday_wrap(&finish);
+  sec = (double)timeval_diff_us(&start, &finish) / 1000000;
+  printf("parse: %ld tasks in %.3fs, %.0f tasks/sec\n",
+	 count, sec, sec > 0 ? count / sec : 0);
+
+  if((dup = strdup(cmd)) == NULL)
+    return -1;
+  tmpl = scamper_do_ping_tmpl_alloc(dup, errbuf, sizeof(errbuf));
+  free(dup);
+  if(tmpl == NULL)
+    {
+      printf("%s: %s\n", cmd, errbuf);
+      return -1;
+    }
+
+  gettimeofday_wrap(&start);
+  for(i=0; i<count; i++)
+    {
+      snprintf(addr, sizeof(addr), "192.0.%d.%d",
+	       (int)((i >> 8) & 0xff), (int)(i & 0xff));
+      if((ping = scamper_do_ping_tmpl_data(tmpl, addr,
+					   errbuf, sizeof(errbuf))) == NULL)
+	{
+	  printf("%s: %s\n", addr, errbuf);
+	  scamper_do_ping_tmpl_free(tmpl);
+	  return -1;
+	}
+      scamper_ping_free(ping);
+    }
+  gettimeofday_wrap(&finish);
+  scamper_do_ping_tmpl_free(tmpl);
+  sec = (double)timeval_diff_us(&start, &finish) / 1000000;
+  printf("template: %ld tasks in %.3fs, %.0f tasks/sec\n",
+	 count, sec, sec > 0 ? count / sec : 0);
+
+  return 0;
+}
+
 int main(int argc, char *argv[])
 {
   sc_test_t tests[] = {
@@ -447,11 +563,20 @@ int main(int argc, char *argv[])
 	    break;
 	}
     }
+  else if(argc == 3 && strcasecmp(argv[1], "bench") == 0)
+    {
+      if(bench("-P tcp-syn -d 80 -c 3 -i 1 -O dl 192.0.2.1",
+	       strtol(argv[2], NULL, 10)) != 0)
+	return -1;
+      return 0;
+    }
   else if(argc == 1)
     {
       for(i=0; i<testc; i++)
 	if(check(tests[i].cmd, tests[i].func) != 0)
 	  break;
+      if(i == testc && check_tmpl() != 0)
+	return -1;
     }
   else
     {
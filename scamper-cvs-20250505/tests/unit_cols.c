@@ -0,0 +1,661 @@
+/*
+ * unit_cols : unit tests for cols storage
+ *
+ * $Id$
+ *
+ * Copyright (C) 2025 The Regents of the University of California
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include "internal.h"
+
+#include "scamper_list.h"
+#include "scamper_addr.h"
+#include "scamper_file.h"
+
+#include "scamper_dealias.h"
+
+#include "scamper_ping.h"
+#include "common_ping.h"
+
+#include "scamper_trace.h"
+#include "common_trace.h"
+
+#include "scamper_file_cols.h"
+
+#include "utils.h"
+
+#define COLS_ADDR_NULL 0xffffffff
+#define COLS_MAX       24
+
+/*
+ * the columns of each table, as described in cols(5).  the test checks
+ * the file against these rather than against the writer's own tables.
+ */
+typedef struct cols_def
+{
+  const char *name;
+  uint8_t     type;
+} cols_def_t;
+
+static const cols_def_t ping_defs[] = {
+  {"start",       SCAMPER_FILE_COLS_TYPE_I64},
+  {"userid",      SCAMPER_FILE_COLS_TYPE_U32},
+  {"src",         SCAMPER_FILE_COLS_TYPE_ADDR},
+  {"dst",         SCAMPER_FILE_COLS_TYPE_ADDR},
+  {"method",      SCAMPER_FILE_COLS_TYPE_U8},
+  {"probe_tx",    SCAMPER_FILE_COLS_TYPE_I64},
+  {"probe_id",    SCAMPER_FILE_COLS_TYPE_U16},
+  {"probe_ttl",   SCAMPER_FILE_COLS_TYPE_U8},
+  {"probe_size",  SCAMPER_FILE_COLS_TYPE_U16},
+  {"reply_from",  SCAMPER_FILE_COLS_TYPE_ADDR},
+  {"rtt",         SCAMPER_FILE_COLS_TYPE_U32},
+  {"reply_proto", SCAMPER_FILE_COLS_TYPE_U8},
+  {"reply_ttl",   SCAMPER_FILE_COLS_TYPE_U8},
+  {"reply_size",  SCAMPER_FILE_COLS_TYPE_U16},
+  {"reply_ipid",  SCAMPER_FILE_COLS_TYPE_U32},
+  {"icmp_type",   SCAMPER_FILE_COLS_TYPE_U8},
+  {"icmp_code",   SCAMPER_FILE_COLS_TYPE_U8},
+  {"tcp_flags",   SCAMPER_FILE_COLS_TYPE_U8},
+  {"reply_flags", SCAMPER_FILE_COLS_TYPE_U8},
+};
+
+static const cols_def_t trace_defs[] = {
+  {"start",       SCAMPER_FILE_COLS_TYPE_I64},
+  {"userid",      SCAMPER_FILE_COLS_TYPE_U32},
+  {"src",         SCAMPER_FILE_COLS_TYPE_ADDR},
+  {"dst",         SCAMPER_FILE_COLS_TYPE_ADDR},
+  {"method",      SCAMPER_FILE_COLS_TYPE_U8},
+  {"stop_reason", SCAMPER_FILE_COLS_TYPE_U8},
+  {"probe_tx",    SCAMPER_FILE_COLS_TYPE_I64},
+  {"probe_ttl",   SCAMPER_FILE_COLS_TYPE_U8},
+  {"probe_id",    SCAMPER_FILE_COLS_TYPE_U8},
+  {"probe_size",  SCAMPER_FILE_COLS_TYPE_U16},
+  {"hop_addr",    SCAMPER_FILE_COLS_TYPE_ADDR},
+  {"rtt",         SCAMPER_FILE_COLS_TYPE_U32},
+  {"reply_ttl",   SCAMPER_FILE_COLS_TYPE_U8},
+  {"reply_size",  SCAMPER_FILE_COLS_TYPE_U16},
+  {"reply_ipid",  SCAMPER_FILE_COLS_TYPE_U16},
+  {"reply_tos",   SCAMPER_FILE_COLS_TYPE_U8},
+  {"icmp_type",   SCAMPER_FILE_COLS_TYPE_U8},
+  {"icmp_code",   SCAMPER_FILE_COLS_TYPE_U8},
+  {"icmp_q_ttl",  SCAMPER_FILE_COLS_TYPE_U8},
+  {"tcp_flags",   SCAMPER_FILE_COLS_TYPE_U8},
+  {"reply_flags", SCAMPER_FILE_COLS_TYPE_U8},
+};
+
+/* the values expected in a row, in the order of the table's columns */
+typedef struct cols_row
+{
+  uint64_t              val[COLS_MAX];
+  uint8_t               addr[COLS_MAX][17];
+} cols_row_t;
+
+typedef struct cols_rows
+{
+  cols_row_t           *rows;
+  size_t                rowc;
+  size_t                rowm;
+  size_t                repeat; /* the rows were written this many times */
+} cols_rows_t;
+
+/* a row group that has been located in a file */
+typedef struct cols_rg
+{
+  uint16_t              table;
+  uint16_t              colc;
+  uint32_t              rowc;
+  uint32_t              dictc;
+  const uint8_t        *base;
+  const uint8_t        *dir;
+  const uint8_t        *dict;
+} cols_rg_t;
+
+static uint64_t le_get(const uint8_t *buf, size_t len)
+{
+  uint64_t val = 0;
+  size_t i;
+  for(i=0; i<len; i++)
+    val |= ((uint64_t)buf[i]) << (i * 8);
+  return val;
+}
+
+static size_t cols_width(uint8_t type)
+{
+  switch(type)
+    {
+    case SCAMPER_FILE_COLS_TYPE_U8:       return 1;
+    case SCAMPER_FILE_COLS_TYPE_U16:      return 2;
+    case SCAMPER_FILE_COLS_TYPE_U32:      return 4;
+    case SCAMPER_FILE_COLS_TYPE_U64:      return 8;
+    case SCAMPER_FILE_COLS_TYPE_I64:      return 8;
+    case SCAMPER_FILE_COLS_TYPE_ADDR:     return 4;
+    case SCAMPER_FILE_COLS_TYPE_ADDRDICT: return 16;
+    }
+  return 0;
+}
+
+static int64_t tv_us(const struct timeval *tv)
+{
+  return ((int64_t)tv->tv_sec * 1000000) + tv->tv_usec;
+}
+
+static uint32_t rtt_us(const struct timeval *rtt)
+{
+  uint64_t us = ((uint64_t)rtt->tv_sec * 1000000) + rtt->tv_usec;
+  return us > UINT32_MAX ? UINT32_MAX : (uint32_t)us;
+}
+
+static cols_row_t *row_add(cols_rows_t *rows)
+{
+  cols_row_t *row;
+  if(rows->rowc == rows->rowm)
+    {
+      if(realloc_wrap((void **)&rows->rows,
+		      sizeof(cols_row_t) * (rows->rowm + 256)) != 0)
+	return NULL;
+      rows->rowm += 256;
+    }
+  row = &rows->rows[rows->rowc++];
+  memset(row, 0, sizeof(cols_row_t));
+  return row;
+}
+
+/*
+ * row_addr
+ *
+ * record the address as the dictionary should hold it: IPv4 addresses
+ * are stored IPv4-mapped.  the last byte says if there is an address.
+ */
+static void row_addr(cols_row_t *row, size_t c, const scamper_addr_t *addr)
+{
+  uint8_t *raw = row->addr[c];
+
+  if(addr == NULL)
+    return;
+  if(scamper_addr_isipv4(addr))
+    {
+      raw[10] = 0xff; raw[11] = 0xff;
+      memcpy(raw + 12, scamper_addr_addr_get(addr), 4);
+      raw[16] = 1;
+    }
+  else if(scamper_addr_isipv6(addr))
+    {
+      memcpy(raw, scamper_addr_addr_get(addr), 16);
+      raw[16] = 1;
+    }
+  return;
+}
+
+/*
+ * ping_rows
+ *
+ * compute the row for each reply to the ping, using the public accessor
+ * functions rather than the structures that the writer uses.
+ */
+static int ping_rows(const scamper_ping_t *ping, cols_rows_t *rows)
+{
+  const scamper_ping_probe_t *probe;
+  const scamper_ping_reply_t *reply;
+  cols_row_t *row;
+  uint16_t i, j, replyc;
+
+  for(i=0; i<scamper_ping_sent_get(ping); i++)
+    {
+      if((probe = scamper_ping_probe_get(ping, i)) == NULL)
+	continue;
+      replyc = scamper_ping_probe_replyc_get(probe);
+      for(j=0; j<replyc; j++)
+	{
+	  reply = scamper_ping_probe_reply_get(probe, j);
+	  if((row = row_add(rows)) == NULL)
+	    return -1;
+	  row->val[0]   = tv_us(scamper_ping_start_get(ping));
+	  row->val[1]   = scamper_ping_userid_get(ping);
+	  row_addr(row, 2, scamper_ping_src_get(ping));
+	  row_addr(row, 3, scamper_ping_dst_get(ping));
+	  row->val[4]   = scamper_ping_method_get(ping);
+	  row->val[5]   = tv_us(scamper_ping_probe_tx_get(probe));
+	  row->val[6]   = scamper_ping_probe_id_get(probe);
+	  row->val[7]   = scamper_ping_ttl_get(ping);
+	  row->val[8]   = scamper_ping_pktsize_get(ping);
+	  row_addr(row, 9, scamper_ping_reply_addr_get(reply));
+	  row->val[10]  = rtt_us(scamper_ping_reply_rtt_get(reply));
+	  row->val[11]  = scamper_ping_reply_proto_get(reply);
+	  row->val[12]  = scamper_ping_reply_ttl_get(reply);
+	  row->val[13]  = scamper_ping_reply_size_get(reply);
+	  row->val[14]  = scamper_ping_reply_ipid32_get(reply);
+	  if(scamper_ping_reply_is_icmp(reply))
+	    {
+	      row->val[15] = scamper_ping_reply_icmp_type_get(reply);
+	      row->val[16] = scamper_ping_reply_icmp_code_get(reply);
+	    }
+	  if(scamper_ping_reply_is_tcp(reply))
+	    row->val[17] = scamper_ping_reply_tcp_flags_get(reply);
+	  row->val[18]  = (uint8_t)scamper_ping_reply_flags_get(reply);
+	}
+    }
+
+  return 0;
+}
+
+static int trace_rows(const scamper_trace_t *trace, cols_rows_t *rows)
+{
+  const scamper_trace_probettl_t *pttl;
+  const scamper_trace_probe_t *probe;
+  const scamper_trace_reply_t *reply;
+  cols_row_t *row;
+  uint16_t i, k, replyc;
+  uint8_t j, probec;
+
+  /* the probes are held by ttl, starting at one */
+  for(i=1; i<=scamper_trace_hop_count_get(trace); i++)
+    {
+      if((pttl = scamper_trace_probettl_get(trace, i)) == NULL)
+	continue;
+      probec = scamper_trace_probettl_probec_get(pttl);
+      for(j=0; j<probec; j++)
+	{
+	  probe = scamper_trace_probettl_probe_get(pttl, j);
+	  replyc = scamper_trace_probe_replyc_get(probe);
+	  for(k=0; k<replyc; k++)
+	    {
+	      reply = scamper_trace_probe_reply_get(probe, k);
+	      if((row = row_add(rows)) == NULL)
+		return -1;
+	      row->val[0]  = tv_us(scamper_trace_start_get(trace));
+	      row->val[1]  = scamper_trace_userid_get(trace);
+	      row_addr(row, 2, scamper_trace_src_get(trace));
+	      row_addr(row, 3, scamper_trace_dst_get(trace));
+	      row->val[4]  = scamper_trace_type_get(trace);
+	      row->val[5]  = scamper_trace_stop_reason_get(trace);
+	      row->val[6]  = tv_us(scamper_trace_probe_tx_get(probe));
+	      row->val[7]  = scamper_trace_probe_ttl_get(probe);
+	      row->val[8]  = scamper_trace_probe_id_get(probe);
+	      row->val[9]  = scamper_trace_probe_size_get(probe);
+	      row_addr(row, 10, scamper_trace_reply_addr_get(reply));
+	      row->val[11] = rtt_us(scamper_trace_reply_rtt_get(reply));
+	      row->val[12] = scamper_trace_reply_ttl_get(reply);
+	      row->val[13] = scamper_trace_reply_size_get(reply);
+	      row->val[14] = scamper_trace_reply_ipid_get(reply);
+	      row->val[15] = scamper_trace_reply_tos_get(reply);
+	      if(scamper_trace_reply_is_icmp(reply))
+		{
+		  row->val[16] = scamper_trace_reply_icmp_type_get(reply);
+		  row->val[17] = scamper_trace_reply_icmp_code_get(reply);
+		  row->val[18] = scamper_trace_reply_icmp_q_ttl_get(reply);
+		}
+	      else if(scamper_trace_reply_is_tcp(reply))
+		{
+		  row->val[19] = scamper_trace_reply_tcp_flags_get(reply);
+		}
+	      row->val[20] = (uint8_t)scamper_trace_reply_flags_get(reply);
+	    }
+	}
+    }
+
+  return 0;
+}
+
+/*
+ * rg_parse
+ *
+ * parse the row group at *off, checking that the directory and each
+ * column lie within the row group and are aligned.
+ */
+static int rg_parse(const uint8_t *buf, size_t len, size_t *off, cols_rg_t *rg)
+{
+  const uint8_t *ent;
+  uint64_t rglen, coff;
+  uint32_t count;
+  size_t w;
+  uint16_t i;
+  uint8_t type;
+
+  if(len - *off < 24 || memcmp(buf + *off, "SCRG", 4) != 0)
+    return -1;
+
+  rg->base  = buf + *off;
+  rg->table = (uint16_t)le_get(rg->base + 4, 2);
+  rg->colc  = (uint16_t)le_get(rg->base + 6, 2);
+  rg->rowc  = (uint32_t)le_get(rg->base + 8, 4);
+  rg->dictc = (uint32_t)le_get(rg->base + 12, 4);
+  rglen     = le_get(rg->base + 16, 8);
+  rg->dir   = rg->base + 24;
+  rg->dict  = NULL;
+
+  if(rglen > len - *off - 24 || (uint64_t)rg->colc * 32 > rglen)
+    return -1;
+
+  for(i=0; i<rg->colc; i++)
+    {
+      ent   = rg->dir + (i * 32);
+      type  = ent[2];
+      count = (uint32_t)le_get(ent + 4, 4);
+      coff  = le_get(ent + 8, 8);
+      if((w = cols_width(type)) == 0 || (coff % 8) != 0 ||
+	 le_get(ent, 2) != i || coff < 24 + ((uint64_t)rg->colc * 32) ||
+	 coff + ((uint64_t)w * count) > rglen + 24)
+	return -1;
+      if(i == 0)
+	{
+	  if(type != SCAMPER_FILE_COLS_TYPE_ADDRDICT || count != rg->dictc)
+	    return -1;
+	  rg->dict = rg->base + coff;
+	}
+      else if(count != rg->rowc)
+	return -1;
+    }
+
+  *off += 24 + rglen;
+  return 0;
+}
+
+static const uint8_t *rg_col(const cols_rg_t *rg, const char *name,
+			     uint8_t type)
+{
+  const uint8_t *ent;
+  char buf[17];
+  uint16_t i;
+
+  for(i=1; i<rg->colc; i++)
+    {
+      ent = rg->dir + (i * 32);
+      memcpy(buf, ent + 16, 16); buf[16] = '\0';
+      if(strcmp(buf, name) != 0)
+	continue;
+      if(ent[2] != type)
+	return NULL;
+      return rg->base + le_get(ent + 8, 8);
+    }
+
+  return NULL;
+}
+
+/*
+ * addr_check
+ *
+ * check that the address at index id in the dictionary is the expected
+ * address.
+ */
+static int addr_check(const cols_rg_t *rg, uint32_t id, const uint8_t *raw)
+{
+  if(raw[16] == 0)
+    return id == COLS_ADDR_NULL ? 0 : -1;
+  if(id >= rg->dictc)
+    return -1;
+  return memcmp(rg->dict + (id * 16), raw, 16) == 0 ? 0 : -1;
+}
+
+/*
+ * cols_check
+ *
+ * check that the tables in the file hold the expected rows, in order,
+ * and that the file is properly terminated.
+ */
+static int cols_check(const char *filename, uint16_t table,
+		      const cols_def_t *defs, size_t defc,
+		      const cols_rows_t *rows, uint32_t *rgc)
+{
+  const uint8_t *cols[COLS_MAX];
+  const cols_row_t *row;
+  uint8_t *buf = NULL;
+  cols_rg_t rg;
+  off_t flen;
+  size_t len, off, r = 0;
+  uint32_t i;
+  uint64_t val;
+  size_t c;
+  int fd = -1, rc = -1;
+
+  *rgc = 0;
+
+  if((fd = open(filename, O_RDONLY)) == -1 ||
+     (flen = lseek(fd, 0, SEEK_END)) == (off_t)-1 ||
+     lseek(fd, 0, SEEK_SET) != 0 ||
+     (buf = malloc((size_t)flen)) == NULL ||
+     read_wrap(fd, buf, NULL, (size_t)flen) != 0)
+    {
+      printf("could not read %s\n", filename);
+      goto done;
+    }
+  len = (size_t)flen;
+
+  /* the file header */
+  if(len < 16 || memcmp(buf, "SCAMPCOL", 8) != 0 || le_get(buf+8, 4) != 1)
+    {
+      printf("%s: bad file header\n", filename);
+      goto done;
+    }
+
+  off = 16;
+  for(;;)
+    {
+      if(rg_parse(buf, len, &off, &rg) != 0)
+	{
+	  printf("%s: bad row group\n", filename);
+	  goto done;
+	}
+      if(rg.table == SCAMPER_FILE_COLS_TABLE_END && rg.rowc == 0)
+	break;
+      if(rg.table != table)
+	continue;
+      (*rgc)++;
+
+      for(c=0; c<defc; c++)
+	{
+	  if((cols[c] = rg_col(&rg, defs[c].name, defs[c].type)) == NULL)
+	    {
+	      printf("%s: no %s column\n", filename, defs[c].name);
+	      goto done;
+	    }
+	}
+
+      for(i=0; i<rg.rowc; i++)
+	{
+	  if(r >= rows->rowc * rows->repeat)
+	    {
+	      printf("%s: too many rows\n", filename);
+	      goto done;
+	    }
+	  row = &rows->rows[r++ % rows->rowc];
+	  for(c=0; c<defc; c++)
+	    {
+	      val = le_get(cols[c] + (i * cols_width(defs[c].type)),
+			   cols_width(defs[c].type));
+	      if(defs[c].type == SCAMPER_FILE_COLS_TYPE_ADDR)
+		{
+		  if(addr_check(&rg, (uint32_t)val, row->addr[c]) == 0)
+		    continue;
+		}
+	      else if(val == row->val[c])
+		continue;
+	      printf("%s: row %d column %s\n", filename, (int)(r-1),
+		     defs[c].name);
+	      goto done;
+	    }
+	}
+    }
+
+  /* nothing may follow the end of the file */
+  if(off != len || r != rows->rowc * rows->repeat)
+    {
+      printf("%s: %d of %d rows, %d bytes left\n", filename, (int)r,
+	     (int)(rows->rowc * rows->repeat), (int)(len - off));
+      goto done;
+    }
+
+  rc = 0;
+
+ done:
+  if(buf != NULL) free(buf);
+  if(fd != -1) close(fd);
+  return rc;
+}
+
+/*
+ * test_ping
+ *
+ * write the sample pings, and check the columns.  when rg is set, keep
+ * writing the samples until they need more than one row group, each of
+ * which must have its own dictionary.
+ */
+static int test_ping(const char *dir, int rg)
+{
+  scamper_file_t *file = NULL;
+  scamper_ping_t *ping;
+  cols_rows_t rows;
+  char filename[128];
+  size_t i, j, makerc = ping_makerc();
+  uint32_t rgc, rgx;
+  int rc = -1;
+
+  memset(&rows, 0, sizeof(rows));
+  snprintf(filename, sizeof(filename), "%s/ping%s.cols", dir, rg ? "-rg" : "");
+  if((file = scamper_file_open(filename, 'w', "cols")) == NULL)
+    goto done;
+
+  rows.repeat = 1;
+  for(j=0; j<rows.repeat; j++)
+    {
+      for(i=0; i<makerc; i++)
+	{
+	  if((ping = ping_makers(i)) == NULL)
+	    goto done;
+	  if((j == 0 && ping_rows(ping, &rows) != 0) ||
+	     scamper_file_write_ping(file, ping, NULL) != 0)
+	    {
+	      scamper_ping_free(ping);
+	      goto done;
+	    }
+	  scamper_ping_free(ping);
+	}
+      if(j == 0 && rg != 0 && rows.rowc > 0)
+	rows.repeat = (SCAMPER_FILE_COLS_ROWGROUP_ROWS / rows.rowc) + 2;
+    }
+  scamper_file_close(file); file = NULL;
+
+  if(cols_check(filename, SCAMPER_FILE_COLS_TABLE_PING,
+		ping_defs, sizeof(ping_defs) / sizeof(cols_def_t),
+		&rows, &rgc) != 0)
+    goto done;
+
+  /* full row groups are written as soon as they fill */
+  rgx = (uint32_t)((rows.rowc * rows.repeat +
+		    SCAMPER_FILE_COLS_ROWGROUP_ROWS - 1) /
+		   SCAMPER_FILE_COLS_ROWGROUP_ROWS);
+  if(rows.rowc == 0 || rgc != rgx || (rg != 0 && rgc < 2))
+    {
+      printf("%s: %d rows in %d row groups\n", filename,
+	     (int)(rows.rowc * rows.repeat), (int)rgc);
+      goto done;
+    }
+
+  rc = 0;
+
+ done:
+  if(file != NULL) scamper_file_close(file);
+  if(rows.rows != NULL) free(rows.rows);
+  return rc;
+}
+
+static int test_trace(const char *dir)
+{
+  scamper_file_t *file = NULL;
+  scamper_trace_t *trace;
+  cols_rows_t rows;
+  char filename[128];
+  size_t i, makerc = trace_makerc();
+  uint32_t rgc;
+  int rc = -1;
+
+  memset(&rows, 0, sizeof(rows));
+  rows.repeat = 1;
+  snprintf(filename, sizeof(filename), "%s/trace.cols", dir);
+  if((file = scamper_file_open(filename, 'w', "cols")) == NULL)
+    goto done;
+
+  for(i=0; i<makerc; i++)
+    {
+      if((trace = trace_makers(i)) == NULL)
+	goto done;
+      if(trace_rows(trace, &rows) != 0 ||
+	 scamper_file_write_trace(file, trace, NULL) != 0)
+	{
+	  scamper_trace_free(trace);
+	  goto done;
+	}
+      scamper_trace_free(trace);
+    }
+  scamper_file_close(file); file = NULL;
+
+  if(cols_check(filename, SCAMPER_FILE_COLS_TABLE_TRACE,
+		trace_defs, sizeof(trace_defs) / sizeof(cols_def_t),
+		&rows, &rgc) != 0)
+    goto done;
+  if(rows.rowc == 0 || rgc != 1)
+    {
+      printf("%s: %d rows in %d row groups\n", filename,
+	     (int)rows.rowc, (int)rgc);
+      goto done;
+    }
+
+  rc = 0;
+
+ done:
+  if(file != NULL) scamper_file_close(file);
+  if(rows.rows != NULL) free(rows.rows);
+  return rc;
+}
+
+int main(int argc, char *argv[])
+{
+#ifdef DMALLOC
+  unsigned long start_mem, stop_mem;
+#endif
+
+  if(argc != 3 || strcasecmp(argv[1], "check") != 0)
+    {
+      fprintf(stderr, "usage: unit_cols check dir\n");
+      return -1;
+    }
+
+#ifdef DMALLOC
+  dmalloc_get_stats(NULL, NULL, NULL, NULL, &start_mem, NULL, NULL, NULL, NULL);
+#endif
+
+  if(test_ping(argv[2], 0) != 0 || test_ping(argv[2], 1) != 0 ||
+     test_trace(argv[2]) != 0)
+    {
+      printf("fail\n");
+      return -1;
+    }
+
+#ifdef DMALLOC
+  dmalloc_get_stats(NULL, NULL, NULL, NULL, &stop_mem, NULL, NULL, NULL, NULL);
+  if(start_mem != stop_mem)
+    {
+      printf("memory leak\n");
+      return -1;
+    }
+#endif
+
+  printf("OK\n");
+  return 0;
+}
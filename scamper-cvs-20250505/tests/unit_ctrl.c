@@ -0,0 +1,1210 @@
+/*
+ * unit_ctrl: unit tests for dispatching events in libscamperctrl
+ *
+ * $Id$
+ *
+ * Copyright (C) 2025 The Regents of the University of California
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include "internal.h"
+
+#include "lib/libscamperctrl/libscamperctrl.h"
+
+/*
+ * each instance connects to a unix domain socket that the test holds
+ * the other end of, so that the test can play the part of scamper.
+ */
+typedef struct peer
+{
+  int             fd;
+  scamper_inst_t *inst;
+  uint32_t        more;
+  uint8_t         cmd;
+  uint8_t         eof;
+} peer_t;
+
+static char       path[64];
+static int        listen_fd = -1;
+static peer_t    *peers = NULL;
+static int        peerc = 0;
+static uint32_t   morec = 0;
+static uint32_t   eofc = 0;
+static uint32_t   errc = 0;
+static void      *errp = NULL;
+static uint32_t   datac = 0;
+static void      *datap = NULL;
+static char       data[8192];
+static size_t     data_off = 0;
+static int        fatal = 0;
+static uint32_t   rnd = 0x2545f491;
+
+static uint32_t rnd_next(void)
+{
+  rnd ^= rnd << 13;
+  rnd ^= rnd >> 17;
+  rnd ^= rnd << 5;
+  return rnd;
+}
+
+static double elapsed_us(const struct timeval *start,
+			 const struct timeval *finish)
+{
+  return ((double)(finish->tv_sec - start->tv_sec) * 1000000) +
+    (finish->tv_usec - start->tv_usec);
+}
+
+static void ctrl_cb(scamper_inst_t *inst, uint8_t type, scamper_task_t *task,
+		    const void *data_in, size_t len)
+{
+  peer_t *peer = scamper_inst_param_get(inst);
+
+  if(type == SCAMPER_CTRL_TYPE_MORE)
+    {
+      peer->more++;
+      morec++;
+    }
+  else if(type == SCAMPER_CTRL_TYPE_ERR)
+    {
+      errp = scamper_task_param_get(task);
+      errc++;
+    }
+  else if(type == SCAMPER_CTRL_TYPE_DATA)
+    {
+      /* record each result, followed by a semicolon */
+      datap = task != NULL ? scamper_task_param_get(task) : NULL;
+      if(data_off + len + 1 < sizeof(data))
+	{
+	  memcpy(data + data_off, data_in, len);
+	  data_off += len;
+	  data[data_off++] = ';';
+	  data[data_off] = '\0';
+	}
+      datac++;
+    }
+  else if(type == SCAMPER_CTRL_TYPE_EOF)
+    {
+      peer->eof = 1;
+      peer->inst = NULL;
+      eofc++;
+      scamper_inst_free(inst);
+    }
+  else
+    {
+      fatal = 1;
+    }
+
+  return;
+}
+
+static int listen_open(void)
+{
+  struct sockaddr_un sun;
+
+  snprintf(path, sizeof(path), "/tmp/unit_ctrl.%d", (int)getpid());
+  unlink(path);
+
+  memset(&sun, 0, sizeof(sun));
+  sun.sun_family = AF_UNIX;
+  snprintf(sun.sun_path, sizeof(sun.sun_path), "%s", path);
+
+  if((listen_fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1 ||
+     bind(listen_fd, (struct sockaddr *)&sun, sizeof(sun)) != 0 ||
+     listen(listen_fd, 16) != 0)
+    {
+      printf("could not listen on %s: %s\n", path, strerror(errno));
+      return -1;
+    }
+
+  return 0;
+}
+
+static void listen_close(void)
+{
+  if(listen_fd != -1)
+    {
+      close(listen_fd);
+      listen_fd = -1;
+      unlink(path);
+    }
+  return;
+}
+
+/*
+ * peers_open
+ *
+ * connect n instances, accepting the other end of each connection.
+ * the instances attach as local clients if there are attach
+ * parameters, otherwise as remote clients.
+ */
+static int peers_open(scamper_ctrl_t *ctrl, int n, const scamper_attp_t *attp)
+{
+  scamper_inst_t *inst;
+  int i;
+
+  if((peers = calloc(n, sizeof(peer_t))) == NULL)
+    return -1;
+  peerc = n;
+  morec = eofc = errc = datac = 0;
+  errp = datap = NULL;
+  data_off = 0;
+  data[0] = '\0';
+
+  for(i=0; i<n; i++)
+    peers[i].fd = -1;
+
+  for(i=0; i<n; i++)
+    {
+      if(attp != NULL)
+	inst = scamper_inst_unix(ctrl, attp, path);
+      else
+	inst = scamper_inst_remote(ctrl, path);
+      if((peers[i].inst = inst) == NULL)
+	{
+	  printf("could not connect instance %d: %s\n", i,
+		 scamper_ctrl_strerror(ctrl));
+	  return -1;
+	}
+      scamper_inst_param_set(peers[i].inst, &peers[i]);
+      if((peers[i].fd = accept(listen_fd, NULL, NULL)) == -1)
+	{
+	  printf("could not accept %d: %s\n", i, strerror(errno));
+	  return -1;
+	}
+    }
+
+  return 0;
+}
+
+/*
+ * peers_close
+ *
+ * close the test's end of each connection, and wait for the EOF to be
+ * signalled on each instance.
+ */
+static int peers_close(scamper_ctrl_t *ctrl)
+{
+  struct timeval tv;
+  int i, rc = 0;
+
+  for(i=0; i<peerc; i++)
+    if(peers[i].fd != -1)
+      close(peers[i].fd);
+
+  for(i=0; i<1000 && eofc < (uint32_t)peerc && fatal == 0; i++)
+    {
+      tv.tv_sec = 0; tv.tv_usec = 100000;
+      if(scamper_ctrl_wait(ctrl, &tv) != 0)
+	break;
+    }
+  if(eofc != (uint32_t)peerc)
+    {
+      printf("got %u EOF for %d instances\n", eofc, peerc);
+      rc = -1;
+    }
+
+  for(i=0; i<peerc; i++)
+    if(peers[i].inst != NULL)
+      scamper_inst_free(peers[i].inst);
+  free(peers); peers = NULL;
+  peerc = 0;
+
+  return rc;
+}
+
+static int peer_write(peer_t *peer, const char *str)
+{
+  size_t len = strlen(str);
+  if(write(peer->fd, str, len) != (ssize_t)len)
+    {
+      printf("could not write to peer: %s\n", strerror(errno));
+      return -1;
+    }
+  return 0;
+}
+
+/*
+ * peer_expect
+ *
+ * call scamper_ctrl_wait until the peer has received the expected
+ * string.
+ */
+static int peer_expect(scamper_ctrl_t *ctrl, peer_t *peer, const char *str)
+{
+  struct timeval tv;
+  size_t off = 0, len = strlen(str);
+  char buf[256];
+  ssize_t rc;
+  int i;
+
+  assert(len < sizeof(buf));
+  for(i=0; i<100 && off < len && fatal == 0; i++)
+    {
+      tv.tv_sec = 0; tv.tv_usec = 100000;
+      if(scamper_ctrl_wait(ctrl, &tv) != 0)
+	return -1;
+      if((rc = read(peer->fd, buf + off, sizeof(buf) - off - 1)) > 0)
+	off += rc;
+    }
+
+  buf[off] = '\0';
+  if(off != len || strcmp(buf, str) != 0)
+    {
+      printf("expected '%s' got '%s'\n", str, buf);
+      return -1;
+    }
+
+  return 0;
+}
+
+/*
+ * wait_more
+ *
+ * call scamper_ctrl_wait until there have been x MORE callbacks.
+ */
+static int wait_more(scamper_ctrl_t *ctrl, uint32_t x)
+{
+  struct timeval tv;
+  int i;
+
+  for(i=0; i<1000 && morec < x && fatal == 0; i++)
+    {
+      tv.tv_sec = 1; tv.tv_usec = 0;
+      if(scamper_ctrl_wait(ctrl, &tv) != 0)
+	{
+	  printf("wait failed: %s\n", scamper_ctrl_strerror(ctrl));
+	  return -1;
+	}
+    }
+
+  if(morec != x || fatal != 0)
+    {
+      printf("got %u MORE, expected %u\n", morec, x);
+      return -1;
+    }
+
+  return 0;
+}
+
+/*
+ * check_dispatch
+ *
+ * issue a command on each instance, check that the command reaches the
+ * other end of the connection, and that the replies are passed to the
+ * right instance.
+ */
+static int check_dispatch(int n)
+{
+  static const char *cmd = "ping 192.0.2.1\n";
+  scamper_ctrl_t *ctrl = NULL;
+  struct timeval tv;
+  char buf[128];
+  size_t len = strlen(cmd);
+  ssize_t rc;
+  int i, j, got, x = -1;
+
+  if(listen_open() != 0 ||
+     (ctrl = scamper_ctrl_alloc(ctrl_cb)) == NULL ||
+     peers_open(ctrl, n, NULL) != 0)
+    goto done;
+
+  /* commands are written when the socket is writable */
+  for(i=0; i<n; i++)
+    {
+      if(scamper_inst_do(peers[i].inst, "ping 192.0.2.1", NULL) == NULL)
+	goto done;
+      if(fcntl(peers[i].fd, F_SETFL, O_NONBLOCK) != 0)
+	goto done;
+    }
+  for(i=0, got=0; i<100 && got < n; i++)
+    {
+      tv.tv_sec = 0; tv.tv_usec = 100000;
+      if(scamper_ctrl_wait(ctrl, &tv) != 0)
+	goto done;
+      for(j=0; j<n; j++)
+	{
+	  if(peers[j].cmd != 0)
+	    continue;
+	  if((rc = read(peers[j].fd, buf, sizeof(buf))) <= 0)
+	    continue;
+	  if((size_t)rc != len || memcmp(buf, cmd, len) != 0)
+	    {
+	      printf("unexpected command on %d\n", j);
+	      goto done;
+	    }
+	  if(peer_write(&peers[j], "OK id-1\nMORE\n") != 0)
+	    goto done;
+	  peers[j].cmd = 1;
+	  got++;
+	}
+    }
+  if(got != n)
+    {
+      printf("%d of %d commands received\n", got, n);
+      goto done;
+    }
+  if(wait_more(ctrl, n) != 0)
+    goto done;
+  for(i=0; i<n; i++)
+    {
+      if(peers[i].more != 1)
+	{
+	  printf("instance %d got %u MORE\n", i, peers[i].more);
+	  goto done;
+	}
+    }
+
+  /* signal MORE on every third instance */
+  for(i=0; i<n; i+=3)
+    if(peer_write(&peers[i], "MORE\n") != 0)
+      goto done;
+  if(wait_more(ctrl, n + ((n + 2) / 3)) != 0)
+    goto done;
+  for(i=0; i<n; i++)
+    {
+      if(peers[i].more != ((i % 3) == 0 ? 2 : 1))
+	{
+	  printf("instance %d got %u MORE\n", i, peers[i].more);
+	  goto done;
+	}
+    }
+
+  if(peers_close(ctrl) != 0 || scamper_ctrl_isdone(ctrl) == 0)
+    goto done;
+  x = 0;
+
+ done:
+  if(peers != NULL) peers_close(ctrl);
+  if(ctrl != NULL) scamper_ctrl_free(ctrl);
+  listen_close();
+  return x;
+}
+
+/*
+ * check_batch
+ *
+ * issue a batch of commands, and check that the IDs, errors, and
+ * results that scamper returns are attributed to the right tasks, both
+ * when scamper understands the batch and when it replies to each
+ * command separately.
+ */
+static int check_batch(void)
+{
+  static const char *cmds[] = {
+    "ping 192.0.2.1", "ping 192.0.2.2", "ping 192.0.2.3",
+  };
+  static int vals[3];
+  void *params[3] = {&vals[0], &vals[1], &vals[2]};
+  scamper_task_t *tasks[3];
+  scamper_ctrl_t *ctrl = NULL;
+  struct timeval tv;
+  int i, x = -1;
+
+  if(listen_open() != 0 ||
+     (ctrl = scamper_ctrl_alloc(ctrl_cb)) == NULL ||
+     peers_open(ctrl, 1, NULL) != 0 ||
+     fcntl(peers[0].fd, F_SETFL, O_NONBLOCK) != 0)
+    goto done;
+
+  /* halting a task in a batch waits until the task has an ID */
+  if(scamper_inst_do_batch(peers[0].inst, cmds, 3, params, tasks) != 0 ||
+     scamper_task_halt(tasks[2]) != 0)
+    goto done;
+  if(peer_expect(ctrl, &peers[0], "batch 3\nping 192.0.2.1\n"
+		 "ping 192.0.2.2\nping 192.0.2.3\n") != 0 ||
+     peer_write(&peers[0], "ERR batch-1 command not accepted\n"
+		"OK id-7-8\nMORE\n") != 0 ||
+     wait_more(ctrl, 1) != 0)
+    goto done;
+  if(errc != 1 || errp != &vals[1])
+    {
+      printf("batch error not attributed to task 1\n");
+      goto done;
+    }
+  if(peer_expect(ctrl, &peers[0], "halt 8\n") != 0 ||
+     peer_write(&peers[0], "OK halted 8\n") != 0 ||
+     scamper_task_halt(tasks[0]) != 0 ||
+     peer_expect(ctrl, &peers[0], "halt 7\n") != 0 ||
+     peer_write(&peers[0], "OK halted 7\n") != 0)
+    goto done;
+
+  /* a scamper that does not understand batch replies to each command */
+  if(scamper_inst_do_batch(peers[0].inst, cmds, 2, params, tasks) != 0 ||
+     peer_expect(ctrl, &peers[0], "batch 2\nping 192.0.2.1\n"
+		 "ping 192.0.2.2\n") != 0 ||
+     peer_write(&peers[0], "ERR command not accepted\n"
+		"ERR command not accepted\nOK id-9\nMORE\n") != 0 ||
+     wait_more(ctrl, 3) != 0)
+    goto done;
+  if(errc != 2 || errp != &vals[0])
+    {
+      printf("batch error not attributed to task 0\n");
+      goto done;
+    }
+  if(scamper_task_halt(tasks[1]) != 0 ||
+     peer_expect(ctrl, &peers[0], "halt 9\n") != 0 ||
+     peer_write(&peers[0], "OK halted 9\n") != 0)
+    goto done;
+
+  /*
+   * scamper can start the tasks in a batch, and send their results,
+   * before the OK that says which IDs it assigned them.  the result
+   * is held until the OK arrives, even when both are split across
+   * reads.
+   */
+  if(scamper_inst_do_batch(peers[0].inst, cmds, 3, params, tasks) != 0 ||
+     peer_expect(ctrl, &peers[0], "batch 3\nping 192.0.2.1\n"
+		 "ping 192.0.2.2\nping 192.0.2.3\n") != 0 ||
+     peer_write(&peers[0], "DATA 8 id-11\n#86") != 0)
+    goto done;
+  for(i=0; i<3; i++)
+    {
+      tv.tv_sec = 0; tv.tv_usec = 10000;
+      if(scamper_ctrl_wait(ctrl, &tv) != 0)
+	goto done;
+    }
+  if(peer_write(&peers[0], ")C\n`\nOK id-1") != 0)
+    goto done;
+  for(i=0; i<3; i++)
+    {
+      tv.tv_sec = 0; tv.tv_usec = 10000;
+      if(scamper_ctrl_wait(ctrl, &tv) != 0)
+	goto done;
+    }
+  if(datac != 0 || fatal != 0)
+    {
+      printf("batch result passed on before its OK\n");
+      goto done;
+    }
+  if(peer_write(&peers[0], "0-12\nMORE\n") != 0 ||
+     wait_more(ctrl, 4) != 0)
+    goto done;
+  if(datac != 1 || datap != &vals[1] || strcmp(data, "abc;") != 0)
+    {
+      printf("batch result not attributed to task 1\n");
+      goto done;
+    }
+
+  if(peers_close(ctrl) != 0 || scamper_ctrl_isdone(ctrl) == 0)
+    goto done;
+  x = 0;
+
+ done:
+  if(peers != NULL) peers_close(ctrl);
+  if(ctrl != NULL) scamper_ctrl_free(ctrl);
+  listen_close();
+  return x;
+}
+
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP) && defined(SCM_RIGHTS)
+/*
+ * ring_hdr_t
+ *
+ * the header at the start of a result ring, which must match
+ * sc_ring_hdr_t in libscamperctrl.c.  the test writes records into the
+ * ring as scamper would, with pipes standing in for the eventfds.
+ */
+typedef struct ring_hdr
+{
+  uint32_t        magic;
+  uint32_t        version;
+  uint64_t        size;
+  uint8_t         pad0[48];
+  uint64_t        head;
+  uint8_t         pad1[56];
+  uint64_t        tail;
+  uint8_t         pad2[56];
+  uint32_t        rwait;
+  uint32_t        wwait;
+  uint8_t         pad3[56];
+} ring_hdr_t;
+
+typedef struct ring
+{
+  ring_hdr_t     *hdr;
+  uint8_t        *data;
+  uint64_t        size;
+  int             fds[3];   /* ring, data, and space fds to pass on */
+  int             datafd;   /* our end of the data pipe */
+  int             spacefd;  /* our end of the space pipe */
+} ring_t;
+
+#define RING_SIZE        4096
+#define RING_BENCH_SIZE  (1024 * 1024)
+#define RING_WRAP        0xFFFFFFFF
+#define RING_RECLEN(len) ((8 + (uint64_t)(len) + 7) & ~((uint64_t)7))
+#define UU(c)            ((c) == 0 ? '`' : (c) + 32)
+
+static void ring_fds_close(ring_t *ring)
+{
+  int i;
+  for(i=0; i<3; i++)
+    {
+      if(ring->fds[i] != -1)
+	{
+	  close(ring->fds[i]);
+	  ring->fds[i] = -1;
+	}
+    }
+  return;
+}
+
+static void ring_close(ring_t *ring)
+{
+  ring_fds_close(ring);
+  if(ring->hdr != NULL)
+    munmap(ring->hdr, sizeof(ring_hdr_t) + ring->size);
+  if(ring->datafd != -1)
+    close(ring->datafd);
+  if(ring->spacefd != -1)
+    close(ring->spacefd);
+  return;
+}
+
+/*
+ * ring_open
+ *
+ * make a ring whose head and tail begin at the supplied offset, so
+ * that a test can start close to where the ring wraps.
+ */
+static int ring_open(ring_t *ring, uint64_t size, uint64_t start)
+{
+  char name[64];
+  void *map;
+  int p[2];
+
+  memset(ring, 0, sizeof(ring_t));
+  ring->fds[0] = ring->fds[1] = ring->fds[2] = -1;
+  ring->datafd = ring->spacefd = -1;
+  ring->size = size;
+
+  snprintf(name, sizeof(name), "/tmp/unit_ctrl.ring.XXXXXX");
+  if((ring->fds[0] = mkstemp(name)) == -1)
+    return -1;
+  unlink(name);
+  if(ftruncate(ring->fds[0], sizeof(ring_hdr_t) + size) != 0)
+    return -1;
+  map = mmap(NULL, sizeof(ring_hdr_t) + size, PROT_READ | PROT_WRITE,
+	     MAP_SHARED, ring->fds[0], 0);
+  if(map == MAP_FAILED)
+    return -1;
+  ring->hdr = map;
+  ring->data = (uint8_t *)map + sizeof(ring_hdr_t);
+  ring->hdr->magic = 0x53435247;
+  ring->hdr->version = 1;
+  ring->hdr->size = size;
+  ring->hdr->head = ring->hdr->tail = start;
+
+  if(pipe(p) != 0)
+    return -1;
+  ring->fds[1] = p[0]; ring->datafd = p[1];
+  if(pipe(p) != 0)
+    return -1;
+  ring->spacefd = p[0]; ring->fds[2] = p[1];
+  if(fcntl(ring->spacefd, F_SETFL, O_NONBLOCK) != 0)
+    return -1;
+
+  return 0;
+}
+
+/*
+ * ring_put
+ *
+ * write a record into the ring, wrapping to the start of the ring if
+ * the record does not fit before the end.  returns -1 if the ring is
+ * full.
+ */
+static int ring_put(ring_t *ring, uint32_t id, const void *buf, uint32_t len)
+{
+  ring_hdr_t *hdr = ring->hdr;
+  uint64_t off, reclen = RING_RECLEN(len), need = reclen;
+  uint32_t *rec;
+
+  off = hdr->head & (ring->size - 1);
+  if(ring->size - off < reclen)
+    need += ring->size - off;
+  if(hdr->head + need - hdr->tail > ring->size)
+    return -1;
+
+  if(ring->size - off < reclen)
+    {
+      rec = (uint32_t *)(ring->data + off);
+      rec[0] = RING_WRAP;
+      off = 0;
+    }
+  rec = (uint32_t *)(ring->data + off);
+  rec[0] = len;
+  rec[1] = id;
+  memcpy(rec + 2, buf, len);
+  hdr->head += need;
+
+  return 0;
+}
+
+static int ring_signal(ring_t *ring)
+{
+  uint64_t one = 1;
+  if(write(ring->datafd, &one, sizeof(one)) != sizeof(one))
+    return -1;
+  return 0;
+}
+
+/*
+ * peer_ring_ok
+ *
+ * tell the instance that it has a ring, passing the descriptors with
+ * the OK as scamper does.
+ */
+static int peer_ring_ok(peer_t *peer, ring_t *ring)
+{
+  char ok[48];
+  struct msghdr msg;
+  struct cmsghdr *cmsg;
+  struct iovec iov;
+  union {
+    struct cmsghdr hdr;
+    uint8_t        buf[CMSG_SPACE(sizeof(int) * 3)];
+  } cbuf;
+
+  snprintf(ok, sizeof(ok), "OK ring %llu\n", (unsigned long long)ring->size);
+  iov.iov_base = ok;
+  iov.iov_len = strlen(ok);
+  memset(&msg, 0, sizeof(msg));
+  memset(&cbuf, 0, sizeof(cbuf));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = cbuf.buf;
+  msg.msg_controllen = sizeof(cbuf.buf);
+  cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int) * 3);
+  memcpy(CMSG_DATA(cmsg), ring->fds, sizeof(int) * 3);
+
+  if(sendmsg(peer->fd, &msg, 0) != (ssize_t)iov.iov_len)
+    {
+      printf("could not send ring: %s\n", strerror(errno));
+      return -1;
+    }
+  ring_fds_close(ring);
+
+  return 0;
+}
+
+/*
+ * wait_data
+ *
+ * call scamper_ctrl_wait until there have been x DATA callbacks.
+ */
+static int wait_data(scamper_ctrl_t *ctrl, uint32_t x)
+{
+  struct timeval tv;
+  int i;
+
+  for(i=0; i<100 && datac < x && fatal == 0; i++)
+    {
+      tv.tv_sec = 0; tv.tv_usec = 100000;
+      if(scamper_ctrl_wait(ctrl, &tv) != 0)
+	return -1;
+    }
+
+  if(datac != x || fatal != 0)
+    {
+      printf("got %u DATA, expected %u\n", datac, x);
+      return -1;
+    }
+
+  return 0;
+}
+
+/*
+ * check_ring
+ *
+ * attach two local instances that ask for a result ring.  the first
+ * gets one, and is passed records in order as they wrap around the
+ * end of the ring and when the ring is full, with scamper woken as the
+ * records are consumed.  the second does not, and receives results
+ * over the socket.
+ */
+static int check_ring(void)
+{
+  static const char *wrap[] = {
+    "the first record ends at the end of ring",
+    "the second record starts at the start",
+    "the third",
+  };
+  static int val;
+  scamper_attp_t *attp = NULL;
+  ring_t ring;
+  scamper_ctrl_t *ctrl = NULL;
+  struct timeval tv;
+  char buf[16], exp[sizeof(data)];
+  uint64_t u64;
+  size_t off;
+  uint32_t c;
+  int i, x = -1;
+
+  if(ring_open(&ring, RING_SIZE, RING_SIZE - 64) != 0 ||
+     (attp = scamper_attp_alloc()) == NULL)
+    {
+      printf("could not make ring\n");
+      goto done;
+    }
+  scamper_attp_ring_set(attp, RING_SIZE);
+
+  snprintf(exp, sizeof(exp), "attach ring %d\n", RING_SIZE);
+  if(listen_open() != 0 ||
+     (ctrl = scamper_ctrl_alloc(ctrl_cb)) == NULL ||
+     peers_open(ctrl, 2, attp) != 0 ||
+     fcntl(peers[0].fd, F_SETFL, O_NONBLOCK) != 0 ||
+     fcntl(peers[1].fd, F_SETFL, O_NONBLOCK) != 0 ||
+     peer_expect(ctrl, &peers[0], exp) != 0 ||
+     peer_expect(ctrl, &peers[1], exp) != 0 ||
+     peer_ring_ok(&peers[0], &ring) != 0 ||
+     peer_write(&peers[1], "OK\n") != 0)
+    goto done;
+
+  /* records are passed on in order as they wrap around the ring */
+  for(i=0; i<3; i++)
+    if(ring_put(&ring, 0, wrap[i], strlen(wrap[i])) != 0)
+      goto done;
+  if((ring.hdr->head & (RING_SIZE - 1)) >= RING_SIZE - 64)
+    {
+      printf("records did not wrap\n");
+      goto done;
+    }
+  if(ring_signal(&ring) != 0 || wait_data(ctrl, 3) != 0)
+    goto done;
+  if(strcmp(data, "the first record ends at the end of ring;"
+	    "the second record starts at the start;the third;") != 0)
+    {
+      printf("unexpected ring records: %s\n", data);
+      goto done;
+    }
+
+  /* a record for a task is held until the task has its ID */
+  data_off = 0;
+  if(scamper_inst_do(peers[0].inst, "ping 192.0.2.1", &val) == NULL ||
+     peer_expect(ctrl, &peers[0], "ping 192.0.2.1\n") != 0 ||
+     ring_put(&ring, 5, "ping", 4) != 0 || ring_signal(&ring) != 0)
+    goto done;
+  for(i=0; i<3; i++)
+    {
+      tv.tv_sec = 0; tv.tv_usec = 10000;
+      if(scamper_ctrl_wait(ctrl, &tv) != 0)
+	goto done;
+    }
+  if(datac != 3)
+    {
+      printf("ring record passed on before its ID\n");
+      goto done;
+    }
+  if(peer_write(&peers[0], "OK id-5\n") != 0 || wait_data(ctrl, 4) != 0)
+    goto done;
+  if(datap != &val || strcmp(data, "ping;") != 0)
+    {
+      printf("ring record not attributed to task\n");
+      goto done;
+    }
+
+  /*
+   * fill the ring and say that scamper is waiting for space.  all of
+   * the records are passed on, and scamper is woken.
+   */
+  data_off = 0; off = 0;
+  for(c=0; ; c++)
+    {
+      snprintf(buf, sizeof(buf), "full-%03u", c);
+      if(ring_put(&ring, 0, buf, strlen(buf)) != 0)
+	break;
+      off += snprintf(exp + off, sizeof(exp) - off, "%s;", buf);
+    }
+  if(ring.hdr->head - ring.hdr->tail <= RING_SIZE - RING_RECLEN(8))
+    {
+      printf("ring not full\n");
+      goto done;
+    }
+  ring.hdr->wwait = 1;
+  if(ring_signal(&ring) != 0 || wait_data(ctrl, 4 + c) != 0)
+    goto done;
+  if(strcmp(data, exp) != 0 || ring.hdr->tail != ring.hdr->head ||
+     ring.hdr->wwait != 0 ||
+     read(ring.spacefd, &u64, sizeof(u64)) != sizeof(u64))
+    {
+      printf("full ring not drained\n");
+      goto done;
+    }
+
+  /* results can still come over the socket, and do without a ring */
+  data_off = 0;
+  if(peer_write(&peers[0], "DATA 8\n#86)C\n`\n") != 0 ||
+     wait_data(ctrl, 5 + c) != 0 ||
+     peer_write(&peers[1], "DATA 8\n#86)C\n`\n") != 0 ||
+     wait_data(ctrl, 6 + c) != 0)
+    goto done;
+  if(strcmp(data, "abc;abc;") != 0)
+    {
+      printf("unexpected socket data: %s\n", data);
+      goto done;
+    }
+
+  if(peers_close(ctrl) != 0 || scamper_ctrl_isdone(ctrl) == 0)
+    goto done;
+  x = 0;
+
+ done:
+  if(peers != NULL) peers_close(ctrl);
+  if(ctrl != NULL) scamper_ctrl_free(ctrl);
+  if(attp != NULL) scamper_attp_free(attp);
+  ring_close(&ring);
+  listen_close();
+  return x;
+}
+
+/*
+ * bench_uuencode
+ *
+ * uuencode len bytes into a DATA message, in the form that scamper
+ * sends results over the socket.  libscamperctrl has its own
+ * definitions of functions in utils.c, so the test cannot use
+ * uuencode from there.
+ */
+static uint8_t *bench_uuencode(const uint8_t *in, size_t len, size_t *olen)
+{
+  size_t i, j, x, off, enclen, hdrlen;
+  uint8_t *out, b[3];
+  char hdr[32];
+
+  /* each line encodes up to 45 bytes in 60 characters */
+  enclen = ((len / 45) * 62) + 2;
+  if(len % 45 != 0)
+    enclen += 2 + (((len % 45) + 2) / 3) * 4;
+  hdrlen = snprintf(hdr, sizeof(hdr), "DATA %d\n", (int)enclen);
+  if((out = malloc(hdrlen + enclen)) == NULL)
+    return NULL;
+  memcpy(out, hdr, hdrlen);
+  off = hdrlen;
+
+  for(i=0; i<len; i+=x)
+    {
+      x = len - i < 45 ? len - i : 45;
+      out[off++] = (uint8_t)(x + 32);
+      for(j=0; j<x; j+=3)
+	{
+	  b[0] = in[i+j];
+	  b[1] = j + 1 < x ? in[i+j+1] : 0;
+	  b[2] = j + 2 < x ? in[i+j+2] : 0;
+	  out[off++] = UU(b[0] >> 2);
+	  out[off++] = UU(((b[0] << 4) | (b[1] >> 4)) & 0x3f);
+	  out[off++] = UU(((b[1] << 2) | (b[2] >> 6)) & 0x3f);
+	  out[off++] = UU(b[2] & 0x3f);
+	}
+      out[off++] = '\n';
+    }
+  out[off++] = '`';
+  out[off++] = '\n';
+
+  assert(off == hdrlen + enclen);
+  *olen = off;
+  return out;
+}
+
+/*
+ * bench_ring_sock
+ *
+ * send n results of len bytes over the socket, uuencoding each one as
+ * scamper does.
+ */
+static int bench_ring_sock(scamper_ctrl_t *ctrl, peer_t *peer,
+			   const uint8_t *res, size_t len, uint32_t n)
+{
+  struct timeval tv;
+  uint8_t *msg = NULL;
+  size_t msglen = 0, off = 0;
+  uint32_t sent = 0, base = datac;
+  ssize_t rc;
+  int x = -1;
+
+  while(datac - base < n && fatal == 0)
+    {
+      if(off == msglen && sent < n)
+	{
+	  if(msg != NULL) free(msg);
+	  if((msg = bench_uuencode(res, len, &msglen)) == NULL)
+	    return -1;
+	  off = 0;
+	  sent++;
+	}
+      if(off < msglen)
+	{
+	  if((rc = write(peer->fd, msg + off, msglen - off)) > 0)
+	    {
+	      off += rc;
+	      continue;
+	    }
+	  if(rc == -1 && errno != EAGAIN && errno != EINTR)
+	    goto done;
+	}
+      tv.tv_sec = 0; tv.tv_usec = 0;
+      if(scamper_ctrl_wait(ctrl, &tv) != 0)
+	goto done;
+    }
+  if(fatal == 0)
+    x = 0;
+
+ done:
+  if(msg != NULL) free(msg);
+  return x;
+}
+
+/*
+ * bench_ring_ring
+ *
+ * write n results of len bytes into the ring, signalling the data fd
+ * when the instance is waiting, as scamper does.
+ */
+static int bench_ring_ring(scamper_ctrl_t *ctrl, ring_t *ring,
+			   const uint8_t *res, size_t len, uint32_t n)
+{
+  struct timeval tv;
+  uint32_t sent = 0, base = datac;
+
+  while(datac - base < n && fatal == 0)
+    {
+      while(sent < n && ring_put(ring, 0, res, len) == 0)
+	{
+	  sent++;
+	  if(ring->hdr->rwait != 0)
+	    {
+	      ring->hdr->rwait = 0;
+	      if(ring_signal(ring) != 0)
+		return -1;
+	    }
+	}
+      tv.tv_sec = 0; tv.tv_usec = 0;
+      if(scamper_ctrl_wait(ctrl, &tv) != 0)
+	return -1;
+    }
+
+  return fatal == 0 ? 0 : -1;
+}
+
+/*
+ * bench_ring
+ *
+ * compare how long it takes to pass results to the callback over the
+ * socket and through a ring, including the time taken to encode each
+ * result or copy it into the ring.  by default, time results of 100,
+ * 1000, and 10000 bytes.  otherwise, time the sizes on the command
+ * line.
+ */
+static int bench_ring(int argc, char *argv[])
+{
+  static const int lens[] = {100, 1000, 10000};
+  scamper_attp_t *attp = NULL;
+  scamper_ctrl_t *ctrl = NULL;
+  struct timeval start, finish;
+  char exp[64];
+  double sock_us, ring_us;
+  uint8_t *res = NULL;
+  ring_t ring;
+  uint32_t n;
+  int i, len, x = -1;
+
+  if(ring_open(&ring, RING_BENCH_SIZE, 0) != 0 ||
+     (attp = scamper_attp_alloc()) == NULL)
+    {
+      printf("could not make ring\n");
+      goto done;
+    }
+  scamper_attp_ring_set(attp, RING_BENCH_SIZE);
+
+  /* the first instance gets a ring, the second does not */
+  snprintf(exp, sizeof(exp), "attach ring %d\n", RING_BENCH_SIZE);
+  if(listen_open() != 0 ||
+     (ctrl = scamper_ctrl_alloc(ctrl_cb)) == NULL ||
+     peers_open(ctrl, 2, attp) != 0 ||
+     fcntl(peers[0].fd, F_SETFL, O_NONBLOCK) != 0 ||
+     fcntl(peers[1].fd, F_SETFL, O_NONBLOCK) != 0 ||
+     peer_expect(ctrl, &peers[0], exp) != 0 ||
+     peer_expect(ctrl, &peers[1], exp) != 0 ||
+     peer_ring_ok(&peers[0], &ring) != 0 ||
+     peer_write(&peers[1], "OK\n") != 0 ||
+     peer_write(&peers[0], "MORE\n") != 0 ||
+     wait_more(ctrl, 1) != 0)
+    goto done;
+
+  for(i=0; i < (argc == 0 ? 3 : argc); i++)
+    {
+      len = argc == 0 ? lens[i] : atoi(argv[i]);
+      if(len < 1 || RING_RECLEN(len) > RING_BENCH_SIZE / 2 ||
+	 (res = malloc(len)) == NULL)
+	goto done;
+      for(n=0; n<(uint32_t)len; n++)
+	res[n] = rnd_next() & 0xff;
+      n = (uint32_t)((256 * 1024 * 1024) / (len + 64));
+
+      gettimeofday(&start, NULL);
+      if(bench_ring_sock(ctrl, &peers[1], res, len, n) != 0)
+	goto done;
+      gettimeofday(&finish, NULL);
+      sock_us = elapsed_us(&start, &finish);
+
+      gettimeofday(&start, NULL);
+      if(bench_ring_ring(ctrl, &ring, res, len, n) != 0)
+	goto done;
+      gettimeofday(&finish, NULL);
+      ring_us = elapsed_us(&start, &finish);
+
+      printf("%5d byte results: socket %6.2f us/result %7.1f MB/s, "
+	     "ring %6.2f us/result %7.1f MB/s\n", len,
+	     sock_us / n, ((double)len * n) / sock_us,
+	     ring_us / n, ((double)len * n) / ring_us);
+      free(res); res = NULL;
+    }
+
+  if(peers_close(ctrl) != 0)
+    goto done;
+  x = 0;
+
+ done:
+  if(res != NULL) free(res);
+  if(peers != NULL) peers_close(ctrl);
+  if(ctrl != NULL) scamper_ctrl_free(ctrl);
+  if(attp != NULL) scamper_attp_free(attp);
+  ring_close(&ring);
+  listen_close();
+  return x;
+}
+#endif
+
+/*
+ * bench_n
+ *
+ * time how long it takes to wait for and dispatch an event when one
+ * instance has something to say, and per event when all of them do.
+ */
+static int bench_n(int n, int rounds)
+{
+  scamper_ctrl_t *ctrl = NULL;
+  struct timeval start, finish;
+  struct rlimit rl;
+  double one_us, all_us;
+  int i, x = -1;
+
+  /* each instance needs two file descriptors */
+  if(getrlimit(RLIMIT_NOFILE, &rl) != 0)
+    return -1;
+  if(rl.rlim_cur < (rlim_t)(n * 2) + 32)
+    {
+      rl.rlim_cur = (n * 2) + 32;
+      if(rl.rlim_max < rl.rlim_cur)
+	rl.rlim_max = rl.rlim_cur;
+      if(setrlimit(RLIMIT_NOFILE, &rl) != 0)
+	{
+	  printf("%5d instances: skipped, need %d file descriptors\n",
+		 n, (n * 2) + 32);
+	  return 0;
+	}
+    }
+
+  if(listen_open() != 0 ||
+     (ctrl = scamper_ctrl_alloc(ctrl_cb)) == NULL ||
+     peers_open(ctrl, n, NULL) != 0)
+    goto done;
+
+  gettimeofday(&start, NULL);
+  for(i=0; i<rounds; i++)
+    {
+      if(peer_write(&peers[rnd_next() % n], "MORE\n") != 0 ||
+	 wait_more(ctrl, morec + 1) != 0)
+	goto done;
+    }
+  gettimeofday(&finish, NULL);
+  one_us = elapsed_us(&start, &finish);
+
+  gettimeofday(&start, NULL);
+  for(i=0; i<n; i++)
+    if(peer_write(&peers[i], "MORE\n") != 0)
+      goto done;
+  if(wait_more(ctrl, morec + n) != 0)
+    goto done;
+  gettimeofday(&finish, NULL);
+  all_us = elapsed_us(&start, &finish);
+
+  printf("%5d instances: one active %8.2f us/wait, all active %6.2f us/event\n",
+	 n, one_us / rounds, all_us / n);
+
+  if(peers_close(ctrl) != 0)
+    goto done;
+  x = 0;
+
+ done:
+  if(peers != NULL) peers_close(ctrl);
+  if(ctrl != NULL) scamper_ctrl_free(ctrl);
+  listen_close();
+  return x;
+}
+
+/*
+ * bench
+ *
+ * by default, time 10, 1000, and 10000 instances.  otherwise, time
+ * the numbers of instances on the command line.
+ */
+static int bench(int argc, char *argv[])
+{
+  static const int ns[] = {10, 1000, 10000};
+  int i, n;
+
+  if(argc == 0)
+    {
+      for(i=0; i<(int)(sizeof(ns) / sizeof(int)); i++)
+	if(bench_n(ns[i], 20000) != 0)
+	  return -1;
+      return 0;
+    }
+
+  for(i=0; i<argc; i++)
+    {
+      if((n = atoi(argv[i])) < 1 || bench_n(n, 20000) != 0)
+	return -1;
+    }
+  return 0;
+}
+
+int main(int argc, char *argv[])
+{
+  if(argc >= 2 && strcmp(argv[1], "bench") == 0)
+    return bench(argc - 2, argv + 2);
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP) && defined(SCM_RIGHTS)
+  if(argc >= 2 && strcmp(argv[1], "bench-ring") == 0)
+    return bench_ring(argc - 2, argv + 2);
+#endif
+
+  if(check_dispatch(1) != 0 || check_dispatch(64) != 0 || check_batch() != 0)
+    return -1;
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP) && defined(SCM_RIGHTS)
+  if(check_ring() != 0)
+    return -1;
+#endif
+
+  printf("OK\n");
+  return 0;
+}
@@ -0,0 +1,112 @@
+/*
+ * unit_relit : unit tests for extracting literals from regexes
+ *
+ * $Id$
+ *
+ * Copyright (C) 2025 The Regents of the University of California
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include "internal.h"
+
+#include "sc_relit.h"
+
+typedef struct sc_relit_test
+{
+  const char *re;
+  const char *lits[RELIT_MAX];
+} sc_relit_test_t;
+
+int main(int argc, char *argv[])
+{
+  sc_relit_test_t tests[] = {
+    /* plain literals, and literals broken up by other constructs */
+    {"^abc$",                       {"abc"}},
+    {"^ae\\d+\\.r\\d+\\.example\\.com$", {"ae", ".r", ".example.com"}},
+    {"^abc?d$",                     {"ab", "d"}},
+    {"^ab+c$",                      {"ab", "c"}},
+    {"^ab*c$",                      {"a", "c"}},
+    {"^ab{2}c$",                    {"a", "c"}},
+    {"^a.b$",                       {"a", "b"}},
+    {"^ab{2$",                      {NULL}},
+    /* character classes */
+    {"^foo[a-z]+bar$",              {"foo", "bar"}},
+    {"^foo[^]x]bar$",               {"foo", "bar"}},
+    {"^foo[\\]]bar$",               {"foo", "bar"}},
+    {"^[|]abc$",                    {"abc"}},
+    {"^[(]x|yz$",                   {NULL}},
+    {"[)]abc|def",                  {NULL}},
+    {"^a(b[)|]c)d$",                {"a", "b", "c", "d"}},
+    {"^foo[a-z",                    {NULL}},
+    /* escapes */
+    {"^a\\.b\\-c$",                 {"a.b-c"}},
+    {"^a\\|b$",                     {"a|b"}},
+    {"^a\\(b\\)c$",                 {"a(b)c"}},
+    {"^x\\d+y\\Sz\\bw$",            {"x", "y", "z", "w"}},
+    {"^(ab)\\1$",                   {NULL}},
+    {"^ab\\x41$",                   {NULL}},
+    {"^ab\\",                       {NULL}},
+    /* groups, including nested groups */
+    {"^(abc)def$",                  {"abc", "def"}},
+    {"^(?:ab)+cd$",                 {"ab", "cd"}},
+    {"^(ab)?cd$",                   {"cd"}},
+    {"^(ab)*cd$",                   {"cd"}},
+    {"^(ab){0,1}cd$",               {"cd"}},
+    {"^(a(b|c)d)e$",                {"a", "d", "e"}},
+    {"^(a(bc)?d)e$",                {"a", "d", "e"}},
+    {"^(a(bc)d)?e$",                {"e"}},
+    {"^((ab))$",                    {"ab"}},
+    {"^(?=ab)cd$",                  {NULL}},
+    {"^(ab$",                       {NULL}},
+    {"^ab)$",                       {NULL}},
+    /* alternation */
+    {"abc|def",                     {NULL}},
+    {"^(abc|def)\\.net$",           {".net"}},
+    {"^x(a|(b|c))y$",               {"x", "y"}},
+    {"^(?:a|b)(cd)$",               {"cd"}},
+  };
+  size_t i, j, testc = sizeof(tests) / sizeof(sc_relit_test_t);
+  sc_relit_t rl;
+  int litc;
+
+  for(i=0; i<testc; i++)
+    {
+      sc_relit_get(tests[i].re, &rl);
+      for(litc=0; litc<RELIT_MAX && tests[i].lits[litc] != NULL; litc++)
+	;
+      if(rl.litc != litc)
+	{
+	  printf("fail %d %s: %d != %d\n", (int)i, tests[i].re, rl.litc, litc);
+	  return -1;
+	}
+      for(j=0; j<(size_t)litc; j++)
+	{
+	  if(strcmp(rl.lits[j], tests[i].lits[j]) != 0 ||
+	     rl.lens[j] != strlen(tests[i].lits[j]))
+	    {
+	      printf("fail %d %s: %s != %s\n", (int)i, tests[i].re,
+		     rl.lits[j], tests[i].lits[j]);
+	      return -1;
+	    }
+	}
+    }
+
+  printf("OK\n");
+  return 0;
+}
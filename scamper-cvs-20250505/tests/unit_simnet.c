@@ -0,0 +1,355 @@
+/*
+ * unit_simnet: unit tests for the simulated network
+ *
+ * $Id$
+ *
+ * Copyright (C) 2025 The Regents of the University of California
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include "internal.h"
+
+#include "scamper_config.h"
+#include "scamper_simnet.h"
+#include "utils.h"
+
+extern scamper_config_t *config;
+
+typedef struct sc_resp
+{
+  uint8_t        pkt[1500];
+  ssize_t        len;
+  uint8_t        from[16];
+  struct timeval rx;
+  int            hlim;
+} sc_resp_t;
+
+static struct timeval now;
+
+static int setup(void)
+{
+  if(scamper_config_init(NULL) != 0)
+    return -1;
+  config->simnet_hops_min = 5;
+  config->simnet_hops_max = 5;
+  config->simnet_hop_rtt  = 1000;
+  config->simnet_dst_resp = 100;
+  config->simnet_hop_resp = 100;
+  config->simnet_lb_pct   = 0;
+  if(scamper_simnet_init() != 0)
+    return -1;
+  gettimeofday_wrap(&now);
+  return 0;
+}
+
+static void teardown(void)
+{
+  scamper_simnet_cleanup();
+  scamper_config_cleanup();
+  return;
+}
+
+/* build an IPv4 ICMP echo or UDP probe, including the IP header */
+static size_t probe4(uint8_t *buf, uint8_t proto, uint8_t ttl,
+		     const char *dst, uint16_t id)
+{
+  struct in_addr in;
+  uint16_t u16;
+  size_t len = 20 + 8 + 4;
+
+  memset(buf, 0, len);
+  buf[0] = 0x45;
+  bytes_htons(buf+2, len);
+  bytes_htons(buf+4, id);
+  buf[8] = ttl;
+  buf[9] = proto;
+  memcpy(buf+12, scamper_simnet_src(AF_INET), 4);
+  inet_pton(AF_INET, dst, &in);
+  memcpy(buf+16, &in, 4);
+  u16 = in_cksum(buf, 20);
+  memcpy(buf+10, &u16, 2);
+
+  if(proto == IPPROTO_ICMP)
+    {
+      buf[20] = ICMP_ECHO;
+      bytes_htons(buf+24, 0x1234);
+      bytes_htons(buf+26, id);
+      u16 = in_cksum(buf+20, 12);
+      memcpy(buf+22, &u16, 2);
+    }
+  else
+    {
+      bytes_htons(buf+20, 0x4000 + id);
+      bytes_htons(buf+22, 33435);
+      bytes_htons(buf+24, 12);
+    }
+
+  return len;
+}
+
+static int send4(int fd, const uint8_t *buf, size_t len)
+{
+  struct sockaddr_in sin;
+  sockaddr_compose((struct sockaddr *)&sin, AF_INET, buf+16, 0);
+  if(scamper_simnet_sendto(fd, buf, len, (struct sockaddr *)&sin,
+			   sizeof(sin)) != (ssize_t)len)
+    return -1;
+  return 0;
+}
+
+/* deliver everything that is queued, and read one response */
+static int recv_resp(int fd, int af, sc_resp_t *resp)
+{
+  struct sockaddr_storage ss;
+  struct timeval tv;
+  struct msghdr msg;
+  struct iovec iov;
+  struct cmsghdr *cmsg;
+  uint8_t ctrlbuf[256];
+
+  if(scamper_simnet_waittime(&tv) == 0)
+    return -1;
+  timeval_add_s(&tv, &now, 60);
+  scamper_simnet_run(&tv);
+
+  memset(resp, 0, sizeof(sc_resp_t));
+  iov.iov_base = resp->pkt;
+  iov.iov_len  = sizeof(resp->pkt);
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_name       = &ss;
+  msg.msg_namelen    = sizeof(ss);
+  msg.msg_iov        = &iov;
+  msg.msg_iovlen     = 1;
+  msg.msg_control    = ctrlbuf;
+  msg.msg_controllen = sizeof(ctrlbuf);
+  if((resp->len = scamper_simnet_recvmsg(fd, &msg)) <= 0)
+    return -1;
+
+  if(af == AF_INET)
+    memcpy(resp->from, &((struct sockaddr_in *)&ss)->sin_addr, 4);
+  else
+    memcpy(resp->from, &((struct sockaddr_in6 *)&ss)->sin6_addr, 16);
+
+  resp->hlim = -1;
+  for(cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+      if(cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMP)
+	memcpy(&resp->rx, CMSG_DATA(cmsg), sizeof(struct timeval));
+      else if(cmsg->cmsg_level == IPPROTO_IPV6 &&
+	      cmsg->cmsg_type == IPV6_HOPLIMIT)
+	memcpy(&resp->hlim, CMSG_DATA(cmsg), sizeof(int));
+    }
+
+  return 0;
+}
+
+static int test_icmp4(void)
+{
+  scamper_simnet_stats_t stats;
+  sc_resp_t resp;
+  uint8_t buf[64], rtr[4];
+  size_t len;
+  int fd, rc = -1;
+
+  if(setup() != 0 ||
+     (fd = scamper_simnet_open(AF_INET, IPPROTO_ICMP, 1, NULL, 0)) == -1)
+    goto done;
+
+  /* the first hop sends a time exceeded message quoting TTL 1 */
+  len = probe4(buf, IPPROTO_ICMP, 1, "192.0.2.50", 1);
+  if(send4(fd, buf, len) != 0 || recv_resp(fd, AF_INET, &resp) != 0 ||
+     resp.len != 20 + 8 + 28 || resp.pkt[9] != IPPROTO_ICMP ||
+     resp.pkt[8] != 255 || resp.pkt[20] != ICMP_TIMXCEED ||
+     resp.pkt[20+8+8] != 1 || resp.from[0] != 10 ||
+     memcmp(resp.pkt+12, resp.from, 4) != 0 ||
+     in_cksum(resp.pkt+20, resp.len-20) != 0 ||
+     timeval_diff_us(&now, &resp.rx) < 1000)
+    goto done;
+  memcpy(rtr, resp.from, 4);
+
+  /* the same hop is the same router */
+  len = probe4(buf, IPPROTO_ICMP, 1, "192.0.2.51", 2);
+  if(send4(fd, buf, len) != 0 || recv_resp(fd, AF_INET, &resp) != 0 ||
+     memcmp(rtr, resp.from, 4) != 0)
+    goto done;
+
+  /* the destination, five hops away, sends an echo reply */
+  len = probe4(buf, IPPROTO_ICMP, 64, "192.0.2.50", 3);
+  if(send4(fd, buf, len) != 0 || recv_resp(fd, AF_INET, &resp) != 0 ||
+     resp.len != 32 || resp.pkt[20] != ICMP_ECHOREPLY ||
+     resp.pkt[8] != 60 || bytes_ntohs(resp.pkt+26) != 3 ||
+     memcmp(resp.from, buf+16, 4) != 0 ||
+     in_cksum(resp.pkt+20, resp.len-20) != 0 ||
+     timeval_diff_us(&now, &resp.rx) < 5000)
+    goto done;
+
+  /* a UDP probe to the destination gets a port unreachable */
+  len = probe4(buf, IPPROTO_UDP, 64, "192.0.2.50", 4);
+  if(send4(fd, buf, len) != 0 || recv_resp(fd, AF_INET, &resp) != 0 ||
+     resp.pkt[20] != ICMP_UNREACH || resp.pkt[21] != ICMP_UNREACH_PORT ||
+     resp.pkt[20+8+8] != 60 || bytes_ntohs(resp.pkt+20+8+20+2) != 33435)
+    goto done;
+
+  scamper_simnet_stats_get(&stats);
+  if(stats.tx != 4 || stats.rx != 4)
+    goto done;
+
+  rc = 0;
+
+ done:
+  teardown();
+  return rc;
+}
+
+static int test_icmp6(void)
+{
+  struct sockaddr_in6 sin6;
+  sc_resp_t resp;
+  uint8_t buf[16];
+  int fd, rc = -1;
+
+  if(setup() != 0 ||
+     (fd = scamper_simnet_open(AF_INET6, IPPROTO_ICMPV6, 0, NULL, 0)) == -1)
+    goto done;
+
+  memset(buf, 0, sizeof(buf));
+  buf[0] = ICMP6_ECHO_REQUEST;
+  bytes_htons(buf+4, 0x1234);
+  bytes_htons(buf+6, 1);
+  sockaddr_compose_str((struct sockaddr *)&sin6, AF_INET6, "2001:db8:1::5", 0);
+
+  /* the second hop sends a time exceeded quoting the probe */
+  if(scamper_simnet_setsockopt_int(fd, IPPROTO_IPV6, IPV6_UNICAST_HOPS, 2) != 0 ||
+     scamper_simnet_sendto(fd, buf, sizeof(buf), (struct sockaddr *)&sin6,
+			   sizeof(sin6)) != sizeof(buf) ||
+     recv_resp(fd, AF_INET6, &resp) != 0 ||
+     resp.pkt[0] != ICMP6_TIME_EXCEEDED || resp.hlim != 254 ||
+     resp.from[0] != 0xfd || resp.len != 8 + 40 + sizeof(buf) ||
+     resp.pkt[8+6] != IPPROTO_ICMPV6 || resp.pkt[8+7] != 1 ||
+     memcmp(resp.pkt+8+24, &sin6.sin6_addr, 16) != 0)
+    goto done;
+
+  /* the destination sends an echo reply */
+  if(scamper_simnet_setsockopt_int(fd, IPPROTO_IPV6, IPV6_UNICAST_HOPS, 64) != 0 ||
+     scamper_simnet_sendto(fd, buf, sizeof(buf), (struct sockaddr *)&sin6,
+			   sizeof(sin6)) != sizeof(buf) ||
+     recv_resp(fd, AF_INET6, &resp) != 0 ||
+     resp.pkt[0] != ICMP6_ECHO_REPLY || resp.hlim != 60 ||
+     memcmp(resp.from, &sin6.sin6_addr, 16) != 0)
+    goto done;
+
+  rc = 0;
+
+ done:
+  teardown();
+  return rc;
+}
+
+static int test_lb(void)
+{
+  sc_resp_t resp;
+  uint8_t buf[64], rtr[4];
+  size_t len;
+  int fd, i, diff = 0, rc = -1;
+
+  if(setup() != 0)
+    goto done;
+  config->simnet_lb_pct = 100;
+  config->simnet_lb_width = 4;
+  if((fd = scamper_simnet_open(AF_INET, IPPROTO_ICMP, 1, NULL, 0)) == -1)
+    goto done;
+
+  /* different flows should see different routers at the same hop */
+  for(i=0; i<16; i++)
+    {
+      len = probe4(buf, IPPROTO_UDP, 3, "192.0.2.50", i);
+      if(send4(fd, buf, len) != 0 || recv_resp(fd, AF_INET, &resp) != 0)
+	goto done;
+      if(i == 0)
+	memcpy(rtr, resp.from, 4);
+      else if(memcmp(rtr, resp.from, 4) != 0)
+	diff++;
+    }
+  if(diff == 0)
+    goto done;
+
+  rc = 0;
+
+ done:
+  teardown();
+  return rc;
+}
+
+static int test_ratelimit(void)
+{
+  scamper_simnet_stats_t stats;
+  uint8_t buf[64];
+  size_t len;
+  int fd, i, rc = -1;
+
+  if(setup() != 0)
+    goto done;
+  config->simnet_ratelimit = 2;
+  if((fd = scamper_simnet_open(AF_INET, IPPROTO_ICMP, 1, NULL, 0)) == -1)
+    goto done;
+
+  for(i=0; i<5; i++)
+    {
+      len = probe4(buf, IPPROTO_ICMP, 1, "192.0.2.50", i);
+      if(send4(fd, buf, len) != 0)
+	goto done;
+    }
+
+  scamper_simnet_stats_get(&stats);
+  if(stats.tx != 5 || stats.ratelimited != 3)
+    goto done;
+
+  rc = 0;
+
+ done:
+  teardown();
+  return rc;
+}
+
+int main(int argc, char *argv[])
+{
+  if(test_icmp4() != 0)
+    {
+      printf("fail icmp4\n");
+      return -1;
+    }
+  if(test_icmp6() != 0)
+    {
+      printf("fail icmp6\n");
+      return -1;
+    }
+  if(test_lb() != 0)
+    {
+      printf("fail lb\n");
+      return -1;
+    }
+  if(test_ratelimit() != 0)
+    {
+      printf("fail ratelimit\n");
+      return -1;
+    }
+
+  printf("OK\n");
+  return 0;
+}
@@ -0,0 +1,332 @@
+/*
+ * unit_sources : unit tests for scamper_sources
+ *
+ * $Id$
+ *
+ * Copyright (C) 2025 The Regents of the University of California
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include "internal.h"
+
+#include "scamper_addr.h"
+#include "scamper_list.h"
+#include "scamper_file.h"
+#include "scamper_outfiles.h"
+#include "scamper_task.h"
+#include "scamper_sources.h"
+#include "neighbourdisc/scamper_neighbourdisc_cmd.h"
+#include "neighbourdisc/scamper_neighbourdisc_do.h"
+#include "scamper_debug.h"
+#include "utils.h"
+
+/*
+ * the sources code only needs a handle for each task, and a way to get
+ * back to the sourcetask that it attached to the task.
+ */
+struct scamper_task
+{
+  scamper_sourcetask_t *st;
+};
+
+void *scamper_do_neighbourdisc_alloc(char *str, char *errbuf, size_t errlen)
+{
+  return strdup(str);
+}
+
+scamper_task_t *scamper_do_neighbourdisc_alloctask(void *data,
+						   scamper_list_t *list,
+						   scamper_cycle_t *cycle,
+						   char *errbuf, size_t errlen)
+{
+  scamper_task_t *task;
+  if((task = malloc_zero(sizeof(scamper_task_t))) != NULL)
+    free(data);
+  return task;
+}
+
+void scamper_do_neighbourdisc_free(void *data)
+{
+  free(data);
+  return;
+}
+
+uint32_t scamper_do_neighbourdisc_userid(void *data)
+{
+  return 0;
+}
+
+int scamper_do_neighbourdisc_enabled(void)
+{
+  return 1;
+}
+
+void scamper_task_free(scamper_task_t *task)
+{
+  if(task->st != NULL)
+    scamper_sourcetask_free(task->st);
+  free(task);
+  return;
+}
+
+scamper_sourcetask_t *scamper_task_getsourcetask(scamper_task_t *task)
+{
+  return task->st;
+}
+
+void scamper_task_setsourcetask(scamper_task_t *task, scamper_sourcetask_t *st)
+{
+  task->st = st;
+  return;
+}
+
+void scamper_task_setcyclemon(scamper_task_t *task,
+			      struct scamper_cyclemon *cm)
+{
+  return;
+}
+
+void scamper_task_halt(scamper_task_t *task)
+{
+  return;
+}
+
+void scamper_task_sig_prepare(scamper_task_t *task)
+{
+  return;
+}
+
+scamper_task_t *scamper_task_sig_block(scamper_task_t *task)
+{
+  return NULL;
+}
+
+int scamper_task_sig_install(scamper_task_t *task)
+{
+  return 0;
+}
+
+int scamper_task_onhold(scamper_task_t *blocker, scamper_task_t *blocked)
+{
+  return -1;
+}
+
+scamper_outfile_t *scamper_outfile_use(scamper_outfile_t *sof)
+{
+  return sof;
+}
+
+void scamper_outfile_free(scamper_outfile_t *sof)
+{
+  return;
+}
+
+scamper_file_t *scamper_outfile_getfile(scamper_outfile_t *sof)
+{
+  return NULL;
+}
+
+const char *scamper_outfile_getname(const scamper_outfile_t *sof)
+{
+  return NULL;
+}
+
+int scamper_file_write_cycle_start(scamper_file_t *sf, scamper_cycle_t *cycle)
+{
+  return 0;
+}
+
+int scamper_file_write_cycle_stop(scamper_file_t *sf, scamper_cycle_t *cycle)
+{
+  return 0;
+}
+
+const char *scamper_option_monitorname_get(void)
+{
+  return NULL;
+}
+
+void printerror(const char *func, const char *format, ...)
+{
+  return;
+}
+
+void printerror_msg(const char *func, const char *format, ...)
+{
+  return;
+}
+
+#ifdef HAVE_SCAMPER_DEBUG
+void scamper_debug(const char *func, const char *format, ...)
+{
+  return;
+}
+#endif
+
+static int source_isfinished(void *data)
+{
+  return 0;
+}
+
+static scamper_source_t *source_alloc(char *name, uint32_t pps)
+{
+  scamper_source_params_t ssp;
+  scamper_source_t *source;
+
+  memset(&ssp, 0, sizeof(ssp));
+  ssp.name       = name;
+  ssp.type       = SCAMPER_SOURCE_TYPE_CONTROL;
+  ssp.priority   = 1;
+  ssp.pps        = pps;
+  ssp.isfinished = source_isfinished;
+
+  if((source = scamper_source_alloc(&ssp)) == NULL)
+    return NULL;
+  if(scamper_sources_add(source) != 0 ||
+     scamper_source_command(source, "neighbourdisc 192.0.2.1") != 0 ||
+     scamper_source_command(source, "neighbourdisc 192.0.2.2") != 0)
+    {
+      scamper_source_abandon(source);
+      scamper_source_free(source);
+      return NULL;
+    }
+
+  return source;
+}
+
+/*
+ * test_0:
+ *
+ * two paced sources, each with a task in flight.  the faster source
+ * is released first, until its task sends enough probes to push its
+ * theoretical arrival time past that of the slower source.  the
+ * slower source must then be the next to be released.
+ */
+static int test_0(void)
+{
+  scamper_source_t *slow = NULL, *fast = NULL;
+  scamper_task_t *tasks[3], *task;
+  struct timeval now, tv;
+  int i, rc = -1;
+
+  memset(tasks, 0, sizeof(tasks));
+
+  /* a source that may send a probe every 250ms, and one every 50ms */
+  if((slow = source_alloc("slow", 4)) == NULL ||
+     (fast = source_alloc("fast", 20)) == NULL)
+    goto done;
+
+  /* start a task from each source, and have each send a probe */
+  for(i=0; i<2; i++)
+    {
+      if(scamper_sources_gettask(&tasks[i]) != 0 || tasks[i] == NULL)
+	goto done;
+      scamper_sourcetask_probe(tasks[i]->st);
+    }
+  if(scamper_sourcetask_getsource(tasks[0]->st) != slow ||
+     scamper_sourcetask_getsource(tasks[1]->st) != fast)
+    goto done;
+
+  /* both sources must now wait on their pps cap */
+  if(scamper_sources_gettask(&task) != 0 || task != NULL)
+    goto done;
+
+  /*
+   * the fast source's task sends another ten probes while its source
+   * is waiting, which moves it behind the slow source
+   */
+  for(i=0; i<10; i++)
+    scamper_sourcetask_probe(tasks[1]->st);
+
+  /* the slow source is now the one that may start a task soonest */
+  gettimeofday_wrap(&now);
+  if(scamper_sources_waittime(&tv) == 0 ||
+     timeval_diff_ms(&now, &tv) > 300)
+    goto done;
+
+  /* once that time has passed, the slow source gets to start a task */
+  while(timeval_cmp(&now, &tv) <= 0)
+    {
+      usleep(timeval_diff_us(&now, &tv) + 1000);
+      gettimeofday_wrap(&now);
+    }
+  if(scamper_sources_gettask(&tasks[2]) != 0 || tasks[2] == NULL ||
+     scamper_sourcetask_getsource(tasks[2]->st) != slow)
+    goto done;
+
+  rc = 0;
+
+ done:
+  for(i=0; i<3; i++)
+    if(tasks[i] != NULL)
+      scamper_task_free(tasks[i]);
+  if(slow != NULL)
+    {
+      scamper_source_abandon(slow);
+      scamper_source_free(slow);
+    }
+  if(fast != NULL)
+    {
+      scamper_source_abandon(fast);
+      scamper_source_free(fast);
+    }
+  return rc;
+}
+
+static int check(int id, int (*func)(void))
+{
+  int rc;
+
+#ifdef DMALLOC
+  unsigned long start_mem, stop_mem;
+  dmalloc_get_stats(NULL, NULL, NULL, NULL, &start_mem, NULL, NULL, NULL, NULL);
+#endif
+
+  if(scamper_sources_init() != 0)
+    return -1;
+  if((rc = func()) != 0)
+    printf("fail: %d\n", id);
+  scamper_sources_cleanup();
+
+#ifdef DMALLOC
+  dmalloc_get_stats(NULL, NULL, NULL, NULL, &stop_mem, NULL, NULL, NULL, NULL);
+  if(start_mem != stop_mem && rc == 0)
+    {
+      printf("memory leak: %d\n", id);
+      rc = -1;
+    }
+#endif
+
+  return rc;
+}
+
+int main(int argc, char *argv[])
+{
+  static int (*const tests[])(void) = {
+    test_0,
+  };
+  int i, testc = sizeof(tests) / sizeof(void *);
+
+  for(i=0; i<testc; i++)
+    if(check(i, tests[i]) != 0)
+      return -1;
+
+  printf("OK\n");
+  return 0;
+}
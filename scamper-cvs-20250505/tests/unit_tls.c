@@ -0,0 +1,248 @@
+/*
+ * unit_tls : unit tests for gathering plaintext into TLS records
+ *
+ * $Id$
+ *
+ * Copyright (C) 2025 The Regents of the University of California
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include "internal.h"
+
+#ifdef HAVE_OPENSSL
+#include "utils_tls.h"
+
+/*
+ * tls_pair
+ *
+ * a client and a server connected through their memory BIOs.
+ */
+typedef struct tls_pair
+{
+  SSL_CTX  *sctx;
+  SSL_CTX  *cctx;
+  SSL      *s;
+  BIO      *s_rbio;
+  BIO      *s_wbio;
+  SSL      *c;
+  BIO      *c_rbio;
+  BIO      *c_wbio;
+} tls_pair_t;
+
+static int pump_cb(void *param, uint8_t *buf, int len)
+{
+  return BIO_write(param, buf, len) == len ? 0 : -1;
+}
+
+/*
+ * pump
+ *
+ * move the ciphertext that each side has written to the other side.
+ */
+static int pump(tls_pair_t *tp)
+{
+  char errbuf[64];
+  if(tls_want_read(tp->c_wbio, tp->s_rbio, errbuf, sizeof(errbuf),
+		   pump_cb) < 0 ||
+     tls_want_read(tp->s_wbio, tp->c_rbio, errbuf, sizeof(errbuf),
+		   pump_cb) < 0)
+    return -1;
+  return 0;
+}
+
+/*
+ * cert_make
+ *
+ * make a self-signed certificate for the server.
+ */
+static int cert_make(SSL_CTX *ctx)
+{
+  EVP_PKEY_CTX *kctx = NULL;
+  EVP_PKEY *pkey = NULL;
+  X509_NAME *name;
+  X509 *x509 = NULL;
+  int rc = -1;
+
+  if((kctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, NULL)) == NULL ||
+     EVP_PKEY_keygen_init(kctx) <= 0 ||
+     EVP_PKEY_CTX_set_ec_paramgen_curve_nid(kctx,
+					    NID_X9_62_prime256v1) <= 0 ||
+     EVP_PKEY_keygen(kctx, &pkey) <= 0)
+    goto done;
+
+  if((x509 = X509_new()) == NULL ||
+     X509_set_version(x509, 2) != 1 ||
+     ASN1_INTEGER_set(X509_get_serialNumber(x509), 1) != 1 ||
+     X509_gmtime_adj(X509_getm_notBefore(x509), 0) == NULL ||
+     X509_gmtime_adj(X509_getm_notAfter(x509), 3600) == NULL ||
+     X509_set_pubkey(x509, pkey) != 1 ||
+     (name = X509_get_subject_name(x509)) == NULL ||
+     X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+				(const unsigned char *)"unit_tls",
+				-1, -1, 0) != 1 ||
+     X509_set_issuer_name(x509, name) != 1 ||
+     X509_sign(x509, pkey, EVP_sha256()) == 0)
+    goto done;
+
+  if(SSL_CTX_use_certificate(ctx, x509) != 1 ||
+     SSL_CTX_use_PrivateKey(ctx, pkey) != 1)
+    goto done;
+
+  rc = 0;
+
+ done:
+  if(x509 != NULL) X509_free(x509);
+  if(pkey != NULL) EVP_PKEY_free(pkey);
+  if(kctx != NULL) EVP_PKEY_CTX_free(kctx);
+  return rc;
+}
+
+static void tls_pair_free(tls_pair_t *tp)
+{
+  tls_bio_free(tp->s, tp->s_rbio, tp->s_wbio);
+  tls_bio_free(tp->c, tp->c_rbio, tp->c_wbio);
+  if(tp->sctx != NULL) SSL_CTX_free(tp->sctx);
+  if(tp->cctx != NULL) SSL_CTX_free(tp->cctx);
+  return;
+}
+
+static int tls_pair_init(tls_pair_t *tp)
+{
+  int i;
+
+  memset(tp, 0, sizeof(tls_pair_t));
+  if((tp->sctx = SSL_CTX_new(SSLv23_method())) == NULL ||
+     (tp->cctx = SSL_CTX_new(SSLv23_method())) == NULL ||
+     cert_make(tp->sctx) != 0 ||
+     tls_bio_alloc(tp->sctx, &tp->s, &tp->s_rbio, &tp->s_wbio) != 0 ||
+     tls_bio_alloc(tp->cctx, &tp->c, &tp->c_rbio, &tp->c_wbio) != 0)
+    return -1;
+
+  SSL_set_accept_state(tp->s);
+  SSL_set_connect_state(tp->c);
+  for(i=0; i<16; i++)
+    {
+      if(SSL_is_init_finished(tp->c) && SSL_is_init_finished(tp->s))
+	return 0;
+      SSL_do_handshake(tp->c);
+      SSL_do_handshake(tp->s);
+      if(pump(tp) != 0)
+	return -1;
+    }
+
+  return -1;
+}
+
+/*
+ * gather_test
+ *
+ * write len bytes through tls_gather_write in msglen chunks, and then
+ * flush.  all of the plaintext must be encrypted and reported as
+ * waiting in the write BIO, and must reach the server intact.
+ */
+static int gather_test(tls_pair_t *tp, size_t len, size_t msglen)
+{
+  uint8_t txbuf[TLS_RECORD_LEN], *data = NULL, *rx = NULL;
+  size_t i, x, off = 0, rxlen = 0;
+  int rc = -1, r;
+
+  if((data = malloc(len)) == NULL || (rx = malloc(len)) == NULL)
+    goto done;
+  for(i=0; i<len; i++)
+    data[i] = (uint8_t)(i * 7);
+
+  for(i=0; i<len; i+=x)
+    {
+      x = len - i < msglen ? len - i : msglen;
+      tls_gather_write(tp->c, txbuf, &off, data + i, x);
+    }
+
+  /*
+   * if the data filled whole records, then tls_gather_write has
+   * already passed it all to SSL_write, but there is still
+   * ciphertext to send
+   */
+  if(off != len % TLS_RECORD_LEN ||
+     tls_gather_flush(tp->c, txbuf, &off) <= 0 || off != 0 ||
+     pump(tp) != 0 || BIO_pending(tp->c_wbio) != 0 ||
+     tls_gather_flush(tp->c, txbuf, &off) != 0)
+    goto done;
+
+  while(rxlen < len)
+    {
+      if((r = SSL_read(tp->s, rx + rxlen, (int)(len - rxlen))) <= 0)
+	goto done;
+      rxlen += (size_t)r;
+    }
+  if(memcmp(data, rx, len) != 0)
+    goto done;
+
+  rc = 0;
+
+ done:
+  if(data != NULL) free(data);
+  if(rx != NULL) free(rx);
+  return rc;
+}
+
+int main(int argc, char *argv[])
+{
+  static const size_t lens[] = {1, 1000, TLS_RECORD_LEN - 1, TLS_RECORD_LEN,
+				TLS_RECORD_LEN + 1, TLS_RECORD_LEN * 2,
+				50000};
+  static const size_t msglens[] = {10, 1000, 65536};
+  size_t i, j;
+  tls_pair_t tp;
+
+  SSL_library_init();
+
+  if(tls_pair_init(&tp) != 0)
+    {
+      printf("could not set up tls\n");
+      tls_pair_free(&tp);
+      return -1;
+    }
+
+  for(i=0; i<sizeof(lens) / sizeof(size_t); i++)
+    {
+      for(j=0; j<sizeof(msglens) / sizeof(size_t); j++)
+	{
+	  if(gather_test(&tp, lens[i], msglens[j]) != 0)
+	    {
+	      printf("fail %d %d\n", (int)lens[i], (int)msglens[j]);
+	      tls_pair_free(&tp);
+	      return -1;
+	    }
+	}
+    }
+
+  tls_pair_free(&tp);
+  printf("OK\n");
+  return 0;
+}
+
+#else
+
+int main(int argc, char *argv[])
+{
+  printf("OK\n");
+  return 0;
+}
+
+#endif /* HAVE_OPENSSL */
@@ -31,6 +31,14 @@
 #include "internal.h"
 #include "utils.h"
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 static const uint8_t inc[2][10] = {{0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
 				   {1, 0, 0, 0, 0, 0, 0, 0, 0, 0}};
 static uint8_t u32tostr(char *buf, uint32_t x);
@@ -2416,23 +2424,166 @@ int min_array(const int *array, size_t len)
   return x;
 }
 
-uint16_t in_cksum(const void *buf, size_t len)
+/*
+ * in_cksum_vec
+ *
+ * add the 16-bit words in the buffer to 32-bit lanes in a vector
+ * register.  the one's complement sum does not depend on the order the
+ * words are added, so the words can be added in whatever order suits
+ * the vector instructions.  each pass adds at most two words to each
+ * lane, so 16384 passes cannot overflow a lane before the lanes are
+ * added to the 64-bit sum.  the function returns the number of bytes
+ * summed, which is always a multiple of the vector width.
+ */
+#if defined(__AVX2__)
+static size_t in_cksum_vec(const uint8_t *buf, size_t len, uint64_t *sum)
+{
+  __m256i zero = _mm256_setzero_si256(), acc, v;
+  uint32_t lanes[8];
+  size_t off = 0, n;
+  int i;
+
+  while(len - off >= 32)
+    {
+      n = (len - off) / 32;
+      if(n > 16384)
+	n = 16384;
+      acc = zero;
+      while(n-- > 0)
+	{
+	  v = _mm256_loadu_si256((const __m256i *)(buf + off));
+	  acc = _mm256_add_epi32(acc, _mm256_unpacklo_epi16(v, zero));
+	  acc = _mm256_add_epi32(acc, _mm256_unpackhi_epi16(v, zero));
+	  off += 32;
+	}
+      _mm256_storeu_si256((__m256i *)lanes, acc);
+      for(i=0; i<8; i++)
+	*sum += lanes[i];
+    }
+
+  return off;
+}
+#elif defined(__SSE2__)
+static size_t in_cksum_vec(const uint8_t *buf, size_t len, uint64_t *sum)
+{
+  __m128i zero = _mm_setzero_si128(), acc, v;
+  uint32_t lanes[4];
+  size_t off = 0, n;
+  int i;
+
+  while(len - off >= 16)
+    {
+      n = (len - off) / 16;
+      if(n > 16384)
+	n = 16384;
+      acc = zero;
+      while(n-- > 0)
+	{
+	  v = _mm_loadu_si128((const __m128i *)(buf + off));
+	  acc = _mm_add_epi32(acc, _mm_unpacklo_epi16(v, zero));
+	  acc = _mm_add_epi32(acc, _mm_unpackhi_epi16(v, zero));
+	  off += 16;
+	}
+      _mm_storeu_si128((__m128i *)lanes, acc);
+      for(i=0; i<4; i++)
+	*sum += lanes[i];
+    }
+
+  return off;
+}
+#elif defined(__ARM_NEON)
+static size_t in_cksum_vec(const uint8_t *buf, size_t len, uint64_t *sum)
+{
+  uint32x4_t acc;
+  uint32_t lanes[4];
+  size_t off = 0, n;
+  int i;
+
+  while(len - off >= 16)
+    {
+      n = (len - off) / 16;
+      if(n > 16384)
+	n = 16384;
+      acc = vdupq_n_u32(0);
+      while(n-- > 0)
+	{
+	  acc = vpadalq_u16(acc, vreinterpretq_u16_u8(vld1q_u8(buf + off)));
+	  off += 16;
+	}
+      vst1q_u32(lanes, acc);
+      for(i=0; i<4; i++)
+	*sum += lanes[i];
+    }
+
+  return off;
+}
+#endif
+
+/*
+ * in_cksum_add
+ *
+ * add the buffer to a one's complement sum, returning the folded sum.
+ * the sum is not complemented, so that the sums of separate parts of
+ * a packet, such as a pseudo header, a transport header, and a payload,
+ * can be combined before the checksum is computed.  every part except
+ * the last must have an even length.
+ */
+uint16_t in_cksum_add(uint16_t sum, const void *buf, size_t len)
 {
-  uint16_t *w = (uint16_t *)buf;
-  size_t l = len;
-  int sum = 0;
+  const uint8_t *ptr = buf;
+  uint64_t acc = sum;
+  uint32_t a, b;
+  uint16_t w;
+  size_t off = 0;
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(__ARM_NEON)
+  off = in_cksum_vec(ptr, len, &acc);
+#endif
 
-  while(l > 1)
+  while(len - off >= 8)
     {
-      sum += *w++;
-      l   -= 2;
+      memcpy(&a, ptr + off, 4);
+      memcpy(&b, ptr + off + 4, 4);
+      acc += a;
+      acc += b;
+      off += 8;
     }
 
-  if(l != 0)
+  while(len - off >= 2)
     {
-      sum += ((uint8_t *)w)[0];
+      memcpy(&w, ptr + off, 2);
+      acc += w;
+      off += 2;
     }
 
+  if(off < len)
+    acc += ptr[off];
+
+  while((acc >> 16) != 0)
+    acc = (acc >> 16) + (acc & 0xffff);
+
+  return (uint16_t)acc;
+}
+
+uint16_t in_cksum(const void *buf, size_t len)
+{
+  return ~in_cksum_add(0, buf, len);
+}
+
+/*
+ * in_cksum_update
+ *
+ * update a checksum after a 16-bit word covered by the checksum changed
+ * from one value to another, following equation 3 of RFC 1624.  the
+ * words are passed as they appear in the packet.
+ */
+uint16_t in_cksum_update(uint16_t cksum, uint16_t from, uint16_t to)
+{
+  uint32_t sum;
+
+  sum  = (uint16_t)~cksum;
+  sum += (uint16_t)~from;
+  sum += to;
   sum  = (sum >> 16) + (sum & 0xffff);
   sum += (sum >> 16);
 
@@ -331,8 +331,12 @@ int sysctl_wrap(int *mib, u_int len, void **buf, size_t *size)
 char *offt_tostr(char *buf, size_t len, off_t off, int lz, char m)
   ATTRIBUTE_NONNULL;
 
-/* function for computing an Internet checksum */
+/* functions for computing an Internet checksum */
 uint16_t in_cksum(const void *buf, size_t len) ATTRIBUTE_NONNULL_PURE;
+uint16_t in_cksum_add(uint16_t sum, const void *buf, size_t len)
+  ATTRIBUTE_PURE;
+uint16_t in_cksum_update(uint16_t cksum, uint16_t from, uint16_t to)
+  ATTRIBUTE_CONST;
 
 /* functions for dealing with random numbers */
 void random_seed(void);
@@ -38,9 +38,14 @@
 #include "scamper_file.h"
 #include "scamper_icmpext.h"
 #include "trace/scamper_trace.h"
-#include "mjl_splaytree.h"
+#include "mjl_list.h"
+#include "mjl_threadpool.h"
 #include "utils.h"
 
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
 #define OPT_SKIP          0x00001
 #define OPT_DEBUG         0x00002
 #define OPT_DSTEND        0x00004
@@ -73,12 +78,61 @@ static int    filelist_len = 0;
 /* where the output goes.  stdout by default */
 static FILE *out = NULL;
 
+/*
+ * sc_dump
+ *
+ * the line for a trace is built in a buffer, which is written out in
+ * one go.
+ */
+typedef struct sc_dump
+{
+  char          *buf;
+  size_t         len;
+  size_t         off;
+  int            err;
+} sc_dump_t;
+
+/*
+ * sc_job
+ *
+ * a trace read from the input, and the line a formatting thread built
+ * for it.  jobs are written in the order they were read.
+ */
+typedef struct sc_job
+{
+  scamper_trace_t *trace;
+  sc_dump_t        dump;
+  int              done;
+} sc_job_t;
+
+static sc_dump_t       line;
+static slist_t        *jobs = NULL;
+static threadpool_t   *tp   = NULL;
+
+#ifdef HAVE_PTHREAD
+static long            threadc = 0;
+static pthread_mutex_t job_mutex;
+static pthread_cond_t  job_cond;
+#endif
+
+/*
+ * the number of traces that can be waiting to be formatted or written
+ * for each formatting thread.
+ */
+#define JOBS_PER_THREAD 64
+
 static void usage(void)
 {
+  const char *j = "";
+
+#ifdef HAVE_PTHREAD
+  j = " [-j threadc]";
+#endif
+
   fprintf(stderr,
 	  "usage: sc_analysis_dump [-oeCsdlctrHpihUQMT]\n"
-	  "                        [-S skip count] [-D debug count]\n"
-	  "                        [file1 file2 ... fileN]\n");
+	  "                        [-S skip count] [-D debug count]%s\n"
+	  "                        [file1 file2 ... fileN]\n", j);
 
   return;
 }
@@ -87,7 +141,17 @@ static int check_options(int argc, char *argv[])
 {
   int i, ch;
   char opts[48];
-  snprintf(opts, sizeof(opts), "oeCsdlctrHpiS:D:?UQMT");
+  size_t off = 0;
+
+#ifdef HAVE_PTHREAD
+  char *opt_threadc = NULL;
+  long lo;
+#endif
+
+  string_concat(opts, sizeof(opts), &off, "oeCsdlctrHpiS:D:?UQMT");
+#ifdef HAVE_PTHREAD
+  string_concat(opts, sizeof(opts), &off, "j:");
+#endif
 
   while((i = getopt(argc, argv, opts)) != -1)
     {
@@ -168,6 +232,12 @@ static int check_options(int argc, char *argv[])
 	  options |= OPT_SHOWIPTTL;
 	  break;
 
+#ifdef HAVE_PTHREAD
+	case 'j':
+	  opt_threadc = optarg;
+	  break;
+#endif
+
 	case '?':
 	  options |= OPT_HELP;
 	  break;
@@ -178,6 +248,18 @@ static int check_options(int argc, char *argv[])
 	}
     }
 
+#ifdef HAVE_PTHREAD
+  if(opt_threadc != NULL)
+    {
+      if(string_tolong(opt_threadc, &lo) != 0 || lo < 0)
+	{
+	  usage();
+	  return -1;
+	}
+      threadc = lo;
+    }
+#endif
+
   filelist = argv + optind;
   filelist_len = argc - optind;
 
@@ -186,7 +268,13 @@ static int check_options(int argc, char *argv[])
 
 static char *rtt_tostr(char *str, const size_t len, const struct timeval *rtt)
 {
-  if(rtt != NULL)
+  /* timeval_tostr_us formats RTTs that fit in a uint32_t of microseconds */
+  if(rtt != NULL && rtt->tv_sec >= 0 && rtt->tv_sec < 4000 &&
+     rtt->tv_usec >= 0 && rtt->tv_usec < 1000000)
+    {
+      timeval_tostr_us(rtt, str, len);
+    }
+  else if(rtt != NULL)
     {
       snprintf(str, len, "%ld.%03d",
 	       (long)((rtt->tv_sec * 1000) + (rtt->tv_usec / 1000)),
@@ -334,6 +422,15 @@ static void print_help()
   "\n"
   "  D numline - debug mode that only reads the first numline objects\n"
   "  S numline - skips first numline objects in the file\n"
+  );
+
+#ifdef HAVE_PTHREAD
+  fprintf(stderr,
+  "  j threadc - format traces using threadc threads\n"
+  );
+#endif
+
+  fprintf(stderr,
   "\n"
   "  ? - prints this message\n"
   " \n"
@@ -557,66 +654,153 @@ static void print_header_comments(void)
   return;
 }
 
-static void print_header_fields(const scamper_trace_t *trace)
+/*
+ * dump_reserve
+ *
+ * make room for len more bytes in the line being built.  an allocation
+ * failure is remembered, and the rest of the line is not built.
+ */
+static int dump_reserve(sc_dump_t *dump, size_t len)
+{
+  size_t x;
+
+  if(dump->err != 0)
+    return -1;
+  if(dump->off + len <= dump->len)
+    return 0;
+
+  x = dump->len > 0 ? dump->len : 1024;
+  while(x < dump->off + len)
+    x *= 2;
+  if(realloc_wrap((void **)&dump->buf, x) != 0)
+    {
+      dump->err = 1;
+      return -1;
+    }
+  dump->len = x;
+
+  return 0;
+}
+
+static void dump_concat(sc_dump_t *dump, const char *str)
+{
+  size_t len = strlen(str);
+  if(dump_reserve(dump, len) != 0)
+    return;
+  memcpy(dump->buf + dump->off, str, len);
+  dump->off += len;
+  return;
+}
+
+static void dump_concatc(sc_dump_t *dump, char c)
+{
+  if(dump_reserve(dump, 1) != 0)
+    return;
+  dump->buf[dump->off++] = c;
+  return;
+}
+
+/*
+ * dump_concat_long
+ *
+ * append a signed integer, as printf's %d or %ld would.
+ */
+static void dump_concat_long(sc_dump_t *dump, long val)
+{
+  char buf[32];
+  size_t off = 0;
+
+  if(val >= 0 && val <= 0xffffffffL)
+    string_concat_u32(buf, sizeof(buf), &off, NULL, (uint32_t)val);
+  else
+    snprintf(buf, sizeof(buf), "%ld", val);
+  dump_concat(dump, buf);
+
+  return;
+}
+
+static void dump_concat_addr(sc_dump_t *dump, const scamper_addr_t *addr)
+{
+  char buf[128];
+  dump_concat(dump, scamper_addr_tostr(addr, buf, sizeof(buf)));
+  return;
+}
+
+static void print_header_fields(const scamper_trace_t *trace, sc_dump_t *dump)
 {
   scamper_list_t *list;
   scamper_cycle_t *cycle;
   const struct timeval *tv;
-  char buf[256];
 
   if((options & OPT_HIDESRC) == 0)
-    fprintf(out, "\t%s", scamper_addr_tostr(scamper_trace_src_get(trace),
-					    buf, sizeof(buf)));
+    {
+      dump_concatc(dump, '\t');
+      dump_concat_addr(dump, scamper_trace_src_get(trace));
+    }
 
   if((options & OPT_HIDEDST) == 0)
-    fprintf(out, "\t%s", scamper_addr_tostr(scamper_trace_dst_get(trace),
-					    buf, sizeof(buf)));
+    {
+      dump_concatc(dump, '\t');
+      dump_concat_addr(dump, scamper_trace_dst_get(trace));
+    }
 
   if((options & OPT_HIDELIST) == 0)
     {
       list = scamper_trace_list_get(trace);
-      fprintf(out, "\t%d", (list != NULL) ? scamper_list_id_get(list) : 0);
+      dump_concatc(dump, '\t');
+      dump_concat_long(dump,
+		       (list != NULL) ? (int)scamper_list_id_get(list) : 0);
     }
 
   if((options & OPT_HIDECYCLE) == 0)
     {
       cycle = scamper_trace_cycle_get(trace);
-      fprintf(out, "\t%d", (cycle != NULL) ? scamper_cycle_id_get(cycle) : 0);
+      dump_concatc(dump, '\t');
+      dump_concat_long(dump,
+		       (cycle != NULL) ? (int)scamper_cycle_id_get(cycle) : 0);
     }
 
   if((options & OPT_SHOWUSERID) != 0)
-    fprintf(out, "\t%d", scamper_trace_userid_get(trace));
+    {
+      dump_concatc(dump, '\t');
+      dump_concat_long(dump, (int)scamper_trace_userid_get(trace));
+    }
 
   if((options & OPT_HIDETIME) == 0)
     {
       tv = scamper_trace_start_get(trace);
-      fprintf(out, "\t%ld", (long)tv->tv_sec);
+      dump_concatc(dump, '\t');
+      dump_concat_long(dump, (long)tv->tv_sec);
     }
 
   return;
 }
 
 static void print_reply_fields(const scamper_trace_probe_t *probe,
-			       const scamper_trace_reply_t *reply)
+			       const scamper_trace_reply_t *reply,
+			       sc_dump_t *dump)
 {
   char rtt[64];
 
   if(reply != NULL)
     {
       rtt_tostr(rtt, sizeof(rtt), scamper_trace_reply_rtt_get(reply));
-      fprintf(out, "\tR\t%s\t%d\t%d", rtt,
-	      scamper_trace_probe_ttl_get(probe),
-	      scamper_trace_reply_ttl_get(reply));
+      dump_concat(dump, "\tR\t");
+      dump_concat(dump, rtt);
+      dump_concatc(dump, '\t');
+      dump_concat_long(dump, scamper_trace_probe_ttl_get(probe));
+      dump_concatc(dump, '\t');
+      dump_concat_long(dump, scamper_trace_reply_ttl_get(reply));
     }
   else
     {
-      fprintf(out, "\tN\t0\t0\t0");
+      dump_concat(dump, "\tN\t0\t0\t0");
     }
 
   return;
 }
 
-static void print_halt_fields(const scamper_trace_t *trace)
+static void print_halt_fields(const scamper_trace_t *trace, sc_dump_t *dump)
 {
   int l;
 
@@ -624,43 +808,51 @@ static void print_halt_fields(const scamper_trace_t *trace)
     {
     case SCAMPER_TRACE_STOP_COMPLETED:
     case SCAMPER_TRACE_STOP_NONE:
-      fprintf(out, "\tS\t0");
+      dump_concat(dump, "\tS\t0");
       break;
 
     case SCAMPER_TRACE_STOP_UNREACH:
-      fprintf(out, "\tU\t%d", scamper_trace_stop_data_get(trace));
+      dump_concat(dump, "\tU\t");
+      dump_concat_long(dump, scamper_trace_stop_data_get(trace));
       break;
 
     case SCAMPER_TRACE_STOP_LOOP:
       if((l = scamper_trace_stop_data_get(trace)) == 0)
 	l = trace_loop(trace, 1);
-      fprintf(out, "\tL\t%d", l);
+      dump_concat(dump, "\tL\t");
+      dump_concat_long(dump, l);
       break;
 
     case SCAMPER_TRACE_STOP_GAPLIMIT:
-      fprintf(out, "\tG\t%d", scamper_trace_stop_data_get(trace));
+      dump_concat(dump, "\tG\t");
+      dump_concat_long(dump, scamper_trace_stop_data_get(trace));
       break;
 
     default:
-      fprintf(out, "\t?\t0");
+      dump_concat(dump, "\t?\t0");
       break;
     }
   return;
 }
 
 static void print_old_fields(const scamper_trace_t *trace,
-			     const scamper_trace_reply_t *hop)
+			     const scamper_trace_reply_t *hop,
+			     sc_dump_t *dump)
 {
   const struct timeval *start = scamper_trace_start_get(trace);
-  char src[256], dst[256], rtt[256];
-
-  fprintf(out, " %s %s %ld %s %d",
-	  scamper_addr_tostr(scamper_trace_src_get(trace), src, sizeof(src)),
-	  scamper_addr_tostr(scamper_trace_dst_get(trace), dst, sizeof(dst)),
-	  (long)start->tv_sec,
-	  rtt_tostr(rtt, sizeof(rtt),
-		    (hop != NULL) ? scamper_trace_reply_rtt_get(hop) : NULL),
-	  scamper_trace_hop_count_get(trace));
+  char rtt[256];
+
+  dump_concatc(dump, ' ');
+  dump_concat_addr(dump, scamper_trace_src_get(trace));
+  dump_concatc(dump, ' ');
+  dump_concat_addr(dump, scamper_trace_dst_get(trace));
+  dump_concatc(dump, ' ');
+  dump_concat_long(dump, (long)start->tv_sec);
+  dump_concatc(dump, ' ');
+  dump_concat(dump, rtt_tostr(rtt, sizeof(rtt), (hop != NULL) ?
+			      scamper_trace_reply_rtt_get(hop) : NULL));
+  dump_concatc(dump, ' ');
+  dump_concat_long(dump, scamper_trace_hop_count_get(trace));
 
   return;
 }
@@ -676,20 +868,26 @@ static char *hop_tostr(const scamper_trace_probe_t *probe,
   uint16_t u16;
   int i;
 
+  buf[0] = '\0';
+
   if((ha = scamper_trace_reply_addr_get(hop)) != NULL)
     string_concat(buf, len, &off, scamper_addr_tostr(ha, addr, sizeof(addr)));
 
   if((options & OPT_HIDEIRTT) == 0)
-    string_concaf(buf, len, &off, ",%s,%d",
-		  rtt_tostr(rtt, sizeof(rtt), scamper_trace_reply_rtt_get(hop)),
-		  scamper_trace_probe_id_get(probe));
+    {
+      string_concat2(buf, len, &off, ",",
+		     rtt_tostr(rtt, sizeof(rtt),
+			       scamper_trace_reply_rtt_get(hop)));
+      string_concat_u8(buf, len, &off, ",",
+		       scamper_trace_probe_id_get(probe));
+    }
 
   if((options & OPT_SHOWQTTL) != 0 && scamper_trace_reply_is_icmp_q(hop))
-    string_concaf(buf, len, &off, ",Q|%d",
-		  scamper_trace_reply_icmp_q_ttl_get(hop));
+    string_concat_u8(buf, len, &off, ",Q|",
+		     scamper_trace_reply_icmp_q_ttl_get(hop));
 
   if((options & OPT_SHOWIPTTL) != 0)
-    string_concaf(buf, len, &off, ",T|%d", scamper_trace_reply_ttl_get(hop));
+    string_concat_u8(buf, len, &off, ",T|", scamper_trace_reply_ttl_get(hop));
 
   if((options & OPT_SHOWMPLS) != 0 &&
      (exts = scamper_trace_reply_icmp_exts_get(hop)) != NULL)
@@ -701,11 +899,14 @@ static char *hop_tostr(const scamper_trace_probe_t *probe,
 	    {
 	      for(i=0; i<scamper_icmpext_mpls_count_get(ie); i++)
 		{
-		  string_concaf(buf, len, &off, ",M|%d|%d|%d|%d",
-				scamper_icmpext_mpls_ttl_get(ie, i),
-				scamper_icmpext_mpls_label_get(ie, i),
-				scamper_icmpext_mpls_exp_get(ie, i),
-				scamper_icmpext_mpls_s_get(ie, i));
+		  string_concat_u8(buf, len, &off, ",M|",
+				   scamper_icmpext_mpls_ttl_get(ie, i));
+		  string_concat_u32(buf, len, &off, "|",
+				    scamper_icmpext_mpls_label_get(ie, i));
+		  string_concat_u8(buf, len, &off, "|",
+				   scamper_icmpext_mpls_exp_get(ie, i));
+		  string_concat_u8(buf, len, &off, "|",
+				   scamper_icmpext_mpls_s_get(ie, i));
 		}
 	    }
 	}
@@ -716,12 +917,13 @@ static char *hop_tostr(const scamper_trace_probe_t *probe,
 
 static void print_path_fields(const scamper_trace_t *trace,
 			      const scamper_trace_probe_t *dst_probe,
-			      const scamper_trace_reply_t *dst)
+			      const scamper_trace_reply_t *dst,
+			      sc_dump_t *dump)
 {
   const scamper_trace_probe_t *probe;
   const scamper_trace_reply_t *hop;
   scamper_trace_hopiter_t *hi = NULL;
-  char buf[256], path_complete;
+  char buf[256], path_complete, sep;
   int i, j, unresponsive = 0;
 
   /*
@@ -752,12 +954,15 @@ static void print_path_fields(const scamper_trace_t *trace,
    */
   if((options & OPT_OLDFORMAT) == 0)
     {
-      fprintf(out, "\t%c", path_complete);
+      dump_concatc(dump, '\t');
+      dump_concatc(dump, path_complete);
+      sep = '\t';
     }
   else
     {
-      fprintf(out, "%c", path_complete);
-      print_old_fields(trace, dst);
+      dump_concatc(dump, path_complete);
+      print_old_fields(trace, dst, dump);
+      sep = ' ';
     }
 
   if((j = scamper_trace_hop_count_get(trace)) > 255 ||
@@ -783,27 +988,27 @@ static void print_path_fields(const scamper_trace_t *trace,
       /* print out unresponsive hops leading up to this hop records */
       while(unresponsive > 0)
 	{
-	  fprintf(out, "%c", options & OPT_OLDFORMAT ? ' ' : '\t');
-	  fprintf(out, "q");
+	  dump_concatc(dump, sep);
+	  dump_concatc(dump, 'q');
 	  unresponsive--;
 	}
 
-      fprintf(out, "%c", options & OPT_OLDFORMAT ? ' ' : '\t');
+      dump_concatc(dump, sep);
 
       for(;;)
 	{
 	  probe = scamper_trace_hopiter_probe_get(hi);
 	  if((options & OPT_OLDFORMAT) == 0)
-	    fprintf(out, "%s", hop_tostr(probe, hop, buf, sizeof(buf)));
+	    dump_concat(dump, hop_tostr(probe, hop, buf, sizeof(buf)));
 
 	  if((hop = scamper_trace_hopiter_next(trace, hi)) == NULL ||
 	     hop == dst)
 	    break;
 
 	  if((options & OPT_OLDFORMAT) == 0)
-	    fprintf(out, ";");
+	    dump_concatc(dump, ';');
 	  else
-	    fprintf(out, ",");
+	    dump_concatc(dump, ',');
 	}
     }
 
@@ -812,10 +1017,11 @@ static void print_path_fields(const scamper_trace_t *trace,
       while(i < scamper_trace_probe_ttl_get(dst_probe) - 1)
         {
 	  i++;
-	  fprintf(out, "\tq");
+	  dump_concat(dump, "\tq");
 	}
 
-      fprintf(out, "\t%s", hop_tostr(dst_probe, dst, buf, sizeof(buf)));
+      dump_concatc(dump, '\t');
+      dump_concat(dump, hop_tostr(dst_probe, dst, buf, sizeof(buf)));
     }
 
  done:
@@ -823,7 +1029,13 @@ static void print_path_fields(const scamper_trace_t *trace,
   return;
 }
 
-static void print_trace(const scamper_trace_t *trace)
+/*
+ * print_trace
+ *
+ * build the line for the trace in dump.  this function may run in a
+ * formatting thread, so it only reads the trace.
+ */
+static void print_trace(const scamper_trace_t *trace, sc_dump_t *dump)
 {
   const scamper_trace_reply_t *dst = NULL, *hop;
   scamper_trace_probe_t *dst_probe = NULL;
@@ -866,38 +1078,128 @@ static void print_trace(const scamper_trace_t *trace)
 
   if((options & OPT_OLDFORMAT) == 0)
     {
-      fprintf(out, "T");
-      print_header_fields(trace);
+      dump_concatc(dump, 'T');
+      print_header_fields(trace, dump);
 
       if((options & OPT_HIDEREPLY) == 0)
 	{
-	  print_reply_fields(dst_probe, dst);
+	  print_reply_fields(dst_probe, dst, dump);
 	}
 
       if((options & OPT_HIDEHALT) == 0)
 	{
-	  print_halt_fields(trace);
+	  print_halt_fields(trace, dump);
 	}
     }
 
   if((options & OPT_HIDEPATH) == 0 || (options & OPT_OLDFORMAT))
     {
-      print_path_fields(trace, dst_probe, dst);
+      print_path_fields(trace, dst_probe, dst, dump);
     }
 
-  fprintf(out, "\n");
-  fflush(out);
+  dump_concatc(dump, '\n');
 
   return;
 }
 
-static void process(scamper_file_t *file, scamper_file_filter_t *filter)
+/*
+ * dump_write
+ *
+ * write the line built for a trace, and reset the builder for the
+ * next trace.
+ */
+static int dump_write(sc_dump_t *dump)
+{
+  int rc = 0;
+
+  if(dump->err != 0)
+    {
+      fprintf(stderr, "could not format trace\n");
+      rc = -1;
+    }
+  else if(dump->off > 0 && fwrite(dump->buf, 1, dump->off, out) != dump->off)
+    {
+      rc = -1;
+    }
+
+  dump->off = 0;
+  dump->err = 0;
+  return rc;
+}
+
+#ifdef HAVE_PTHREAD
+static void job_free(sc_job_t *job)
+{
+  if(job->trace != NULL)
+    scamper_trace_free(job->trace);
+  if(job->dump.buf != NULL)
+    free(job->dump.buf);
+  free(job);
+  return;
+}
+
+/*
+ * job_format
+ *
+ * build the line for a trace in a formatting thread.  the trace is
+ * freed by the thread that reads the input, as traces read from the
+ * same file share reference-counted lists and cycles.
+ */
+static void job_format(sc_job_t *job)
+{
+  print_trace(job->trace, &job->dump);
+
+  pthread_mutex_lock(&job_mutex);
+  job->done = 1;
+  pthread_cond_signal(&job_cond);
+  pthread_mutex_unlock(&job_mutex);
+
+  return;
+}
+
+/*
+ * jobs_write
+ *
+ * write out the lines at the head of the list that have been built,
+ * waiting for formatting threads until no more than max jobs are
+ * outstanding.
+ */
+static int jobs_write(size_t max)
+{
+  sc_job_t *job;
+  int done, rc = 0;
+
+  while((job = slist_head_item(jobs)) != NULL)
+    {
+      pthread_mutex_lock(&job_mutex);
+      while(job->done == 0 && (size_t)slist_count(jobs) > max)
+	pthread_cond_wait(&job_cond, &job_mutex);
+      done = job->done;
+      pthread_mutex_unlock(&job_mutex);
+      if(done == 0)
+	break;
+
+      slist_head_pop(jobs);
+      rc = dump_write(&job->dump);
+      job_free(job);
+      if(rc != 0)
+	break;
+    }
+
+  return rc;
+}
+#endif
+
+static int process(scamper_file_t *file, scamper_file_filter_t *filter)
 {
+#ifdef HAVE_PTHREAD
+  sc_job_t *job;
+#endif
   scamper_trace_t *trace;
   uint16_t type;
-  int n = 0;
+  int n = 0, rc = 0;
 
-  while(scamper_file_read(file, filter, &type, (void *)&trace) == 0)
+  while(rc == 0 && scamper_file_read(file, filter, &type, (void *)&trace) == 0)
     {
       if(trace == NULL) break; /* EOF */
 
@@ -909,16 +1211,65 @@ static void process(scamper_file_t *file, scamper_file_filter_t *filter)
 
       n++;
 
-      if(n > skip_numlines)
+      if(n <= skip_numlines)
+	{
+	  scamper_trace_free(trace);
+	  continue;
+	}
+
+      if(tp == NULL)
 	{
-	  print_trace(trace);
+	  print_trace(trace, &line);
+	  rc = dump_write(&line);
+	  scamper_trace_free(trace);
+	  continue;
 	}
 
-      scamper_trace_free(trace);
+#ifdef HAVE_PTHREAD
+      if((job = malloc_zero(sizeof(sc_job_t))) == NULL)
+	{
+	  scamper_trace_free(trace);
+	  rc = -1;
+	  break;
+	}
+      job->trace = trace;
+      if(slist_tail_push(jobs, job) == NULL)
+	{
+	  job_free(job);
+	  rc = -1;
+	  break;
+	}
+      if(threadpool_tail_push(tp, (threadpool_func_t)job_format, job) != 0 ||
+	 jobs_write(threadc * JOBS_PER_THREAD) != 0)
+	rc = -1;
+#endif
     }
 
   scamper_file_close(file);
 
+  return rc;
+}
+
+/*
+ * process_error
+ *
+ * note that an input could not be opened.  lines for traces read from
+ * earlier inputs are written first, so that the comment is in order.
+ */
+static void process_error(const char *name)
+{
+  fprintf(stderr, "unable to open %s\n", name);
+
+#ifdef HAVE_PTHREAD
+  if(tp != NULL)
+    jobs_write(0);
+#endif
+
+  if((options & OPT_HIDECOMMENTS) == 0)
+    {
+      fprintf(out, "# unable to open %s\n", name);
+    }
+
   return;
 }
 
@@ -927,7 +1278,7 @@ int main(int argc, char *argv[])
   scamper_file_t *file;
   scamper_file_filter_t *filter;
   uint16_t type = SCAMPER_FILE_OBJ_TRACE;
-  int i;
+  int i, rc = -1;
 
 #ifdef HAVE_WSASTARTUP
   WSADATA wsaData;
@@ -951,6 +1302,24 @@ int main(int argc, char *argv[])
       return -1;
     }
 
+#ifdef HAVE_PTHREAD
+  if(threadc > 0)
+    {
+      if(pthread_mutex_init(&job_mutex, NULL) != 0 ||
+	 pthread_cond_init(&job_cond, NULL) != 0)
+	{
+	  fprintf(stderr, "could not init job mutex\n");
+	  goto done;
+	}
+      if((jobs = slist_alloc()) == NULL ||
+	 (tp = threadpool_alloc(threadc)) == NULL)
+	{
+	  fprintf(stderr, "could not allocate %ld threads\n", threadc);
+	  goto done;
+	}
+    }
+#endif
+
   if((options & OPT_HIDECOMMENTS) == 0)
     {
       print_header_comments();
@@ -962,32 +1331,37 @@ int main(int argc, char *argv[])
 	{
 	  if((file = scamper_file_open(filelist[i], 'r', NULL)) == NULL)
 	    {
-	      fprintf(stderr, "unable to open %s\n", filelist[i]);
-	      if((options & OPT_HIDECOMMENTS) == 0)
-		{
-		  fprintf(out, "# unable to open %s\n", filelist[i]);
-		}
-
+	      process_error(filelist[i]);
 	      continue;
 	    }
 
-	  process(file, filter);
+	  if(process(file, filter) != 0)
+	    goto done;
 	}
     }
   else
     {
       if((file = scamper_file_openfd(STDIN_FILENO, "-", 'r', "warts")) == NULL)
-	{
-	  fprintf(stderr, "unable to open stdin\n");
-	  if((options & OPT_HIDECOMMENTS) == 0)
-	    {
-	      fprintf(out, "# unable to open stdin\n");
-	    }
-	}
-      else process(file, filter);
+	process_error("stdin");
+      else if(process(file, filter) != 0)
+	goto done;
     }
 
-  scamper_file_filter_free(filter);
+#ifdef HAVE_PTHREAD
+  if(tp != NULL && jobs_write(0) != 0)
+    goto done;
+#endif
 
-  return 0;
+  rc = 0;
+
+ done:
+#ifdef HAVE_PTHREAD
+  /* wait for the formatting threads before freeing the jobs they use */
+  if(tp != NULL) threadpool_join(tp);
+  if(jobs != NULL) slist_free_cb(jobs, (slist_free_t)job_free);
+#endif
+  if(line.buf != NULL) free(line.buf);
+  scamper_file_filter_free(filter);
+  fflush(out);
+  return rc;
 }
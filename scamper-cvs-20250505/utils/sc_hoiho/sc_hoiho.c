@@ -50,9 +50,12 @@
 #include "mjl_list.h"
 #include "utils.h"
 
+#include "sc_relit.h"
+
 typedef struct sc_router sc_router_t;
 typedef struct sc_routerinf sc_routerinf_t;
 typedef struct sc_routerdom sc_routerdom_t;
+typedef struct sc_ifacedom sc_ifacedom_t;
 typedef struct sc_regex sc_regex_t;
 typedef struct sc_regex_sn sc_regex_sn_t;
 typedef struct sc_geohint sc_geohint_t;
@@ -66,6 +69,36 @@ typedef struct sc_css
   int             count;   /* count variable for counting matches */
 } sc_css_t;
 
+/*
+ * sc_ngram_t
+ *
+ * an entry in a domain's trigram index: a training interface whose
+ * hostname contains the three characters.
+ */
+typedef struct sc_ngram
+{
+  uint32_t        gram;    /* three characters */
+  uint32_t        id;      /* interface id */
+} sc_ngram_t;
+
+/*
+ * sc_rematch_t
+ *
+ * what a single regex extracts from the training interfaces in a
+ * domain, memoised so that regexes sharing a component do not apply
+ * it to the hostnames again.
+ */
+typedef struct sc_rematch
+{
+  char           *str;     /* the regex */
+  uint32_t       *ids;     /* ids of the interfaces matched, in order */
+  sc_css_t      **csss;    /* what was extracted from each interface */
+  uint8_t        *ips;     /* whether the extraction included an IP */
+  uint32_t        idc;     /* number of interfaces matched */
+  uint8_t         capc;    /* number of capture elements */
+  size_t          size;    /* approximate memory used */
+} sc_rematch_t;
+
 typedef struct sc_domain
 {
   char           *domain;  /* the domain */
@@ -81,6 +114,12 @@ typedef struct sc_domain
   sc_geohint_t  **geohints; /* domain-specific geohints */
   size_t          geohintc; /* how many domain-specific geohints */
 
+  sc_ifacedom_t **ifds;    /* training interfaces, indexed by id - 1 */
+  sc_ngram_t     *ngrams;  /* trigram index of training hostnames */
+  size_t          ngramc;  /* number of entries in the trigram index */
+  splaytree_t    *rematches; /* of sc_rematch_t: memoised regex matches */
+  size_t          rematchs; /* memory used by the memoised matches */
+
 #ifdef HAVE_PTHREAD
   pthread_mutex_t mutex;   /* lock the domain */
   uint8_t         mutex_o; /* mutex is initialised */
@@ -298,7 +337,7 @@ struct sc_router
   uint8_t         flags;   /* flags */
 };
 
-typedef struct sc_ifacedom
+struct sc_ifacedom
 {
   char           *label;   /* label excluding domain suffix */
   size_t          len;     /* length of the label */
@@ -306,7 +345,7 @@ typedef struct sc_ifacedom
   sc_routerdom_t *rd;      /* backpointer to the router */
   sc_domain_t    *dom;     /* pointer to the domain */
   uint32_t        id;      /* unique ID for the interface in this domain */
-} sc_ifacedom_t;
+};
 
 struct sc_routerdom
 {
@@ -383,6 +422,18 @@ typedef struct sc_rttload
   size_t          unknownc;
 } sc_rttload_t;
 
+/*
+ * sc_ckpt_t:
+ *
+ * a buffer holding a checkpoint of the regexes learned so far.
+ */
+typedef struct sc_ckpt
+{
+  uint8_t        *buf;
+  size_t          len;
+  size_t          off;
+} sc_ckpt_t;
+
 /*
  * sc_regex_sn
  *
@@ -642,6 +693,11 @@ typedef struct sc_dump
 #define STOP_GEO_MAX       5
 #define STOP_IP_MAX        1
 
+#define REMATCH_SIZE       (64 * 1024 * 1024)
+
+#define CKPT_MAGIC         "HOIHOCKP"
+#define CKPT_VERSION       1
+
 #define REFINE_TP    0x001
 #define REFINE_FNE   0x002
 #define REFINE_CLASS 0x004
@@ -668,6 +724,8 @@ typedef struct sc_dump
 #define OPT_RTTS      0x0200
 #define OPT_FUDGE     0x0400
 #define OPT_LIGHTSPEED 0x0800
+#define OPT_CKPT      0x2000
+#define OPT_RESUME    0x4000
 
 #ifdef PACKAGE_VERSION
 #define OPT_VERSION     0x1000
@@ -739,6 +797,9 @@ static int              do_splitlocode = 0;
 static int              no_clli      = 0;
 static int              ip_v         = 4;
 static int              stop_id      = 0;
+static const char      *ckpt_file    = NULL;
+static const char      *resume_file  = NULL;
+static int              resume_id    = 0;
 #ifdef OPT_VERSION
 static int              do_version   = 0;
 #endif
@@ -764,14 +825,18 @@ static void usage(uint32_t opts)
 #endif
 
   fprintf(stderr,
-	  "usage: sc_hoiho [-?6%s] [-d dumpid] [-D domain] [-f rtt-fudge]\n"
-	  "                [-g dict] [-l light-speed] [-O options]\n"
-	  "                [-r regex] [-R rtts] [-s stopid] [-S siblings]\n"
-	  "                [-t threadc]\n"
+	  "usage: sc_hoiho [-?6%s] [-c checkpoint] [-C checkpoint] [-d dumpid]\n"
+	  "                [-D domain] [-f rtt-fudge] [-g dict] [-l light-speed]\n"
+	  "                [-O options] [-r regex] [-R rtts] [-s stopid]\n"
+	  "                [-S siblings] [-t threadc]\n"
 	  "                <public-suffix-list> <router-file>\n\n", v);
 
   if(opts & OPT_IPV6)
     fprintf(stderr, "       -6: input files are IPv6\n");
+  if(opts & OPT_CKPT)
+    fprintf(stderr, "       -c: write a checkpoint after each stage\n");
+  if(opts & OPT_RESUME)
+    fprintf(stderr, "       -C: resume from a checkpoint\n");
   if(opts & OPT_DUMPID)
     {
       fprintf(stderr, "       -d: dump id\n");
@@ -874,7 +939,7 @@ static int check_options(int argc, char *argv[])
   long lo;
   int ch, x;
 
-  string_concat(opts, sizeof(opts), &off, "6d:D:f:g:l:O:r:R:s:S:t:?");
+  string_concat(opts, sizeof(opts), &off, "6c:C:d:D:f:g:l:O:r:R:s:S:t:?");
 #ifdef OPT_VERSION
   string_concatc(opts, sizeof(opts), &off, 'v');
 #endif
@@ -887,6 +952,14 @@ static int check_options(int argc, char *argv[])
 	  ip_v = 6;
 	  break;
 
+	case 'c':
+	  ckpt_file = optarg;
+	  break;
+
+	case 'C':
+	  resume_file = optarg;
+	  break;
+
 	case 'd':
 	  opt_dumpid = optarg;
 	  break;
@@ -1059,6 +1132,13 @@ static int check_options(int argc, char *argv[])
       return -1;
     }
 
+  /* a checkpoint holds regexes that were learned, not supplied */
+  if(resume_file != NULL && regex_eval != NULL)
+    {
+      usage(OPT_RESUME | OPT_REGEX);
+      return -1;
+    }
+
   if(regex_eval != NULL)
     {
       /*
@@ -6039,6 +6119,51 @@ static int sc_rework_matchk(sc_rework_t *rew, size_t k, const char *str)
   return 1;
 }
 
+/*
+ * sc_rework_css:
+ *
+ * build a css out of what the regex that last matched the interface
+ * captured.  the css is NULL if the regex did not capture anything.
+ */
+static int sc_rework_css(sc_rework_t *rew, const sc_iface_t *iface,
+			 sc_css_t **out)
+{
+  sc_css_t *css = NULL;
+  size_t off;
+  int i, l;
+
+  *out = NULL;
+
+  /* calc the size of the matched portion */
+  off = 0;
+  for(i=1; i<(int)rew->m; i++)
+    {
+      off += rew->ovector[(2*i)+1] - rew->ovector[2*i];
+      off++;
+    }
+  if(off == 0)
+    return 0;
+
+  /* allocate a css for the matched portion */
+  if((css = sc_css_alloc(off)) == NULL)
+    return -1;
+
+  /* fill the css */
+  off = 0;
+  for(i=1; i<(int)rew->m; i++)
+    {
+      l = rew->ovector[(2*i)+1] - rew->ovector[2*i];
+      memcpy(css->css+off, iface->name + rew->ovector[2*i], l);
+      off += l;
+      css->css[off++] = '\0';
+      css->cssc++;
+    }
+  css->len = off;
+  *out = css;
+
+  return 0;
+}
+
 /*
  * sc_rework_match:
  *
@@ -6049,9 +6174,8 @@ static int sc_rework_matchk(sc_rework_t *rew, size_t k, const char *str)
  */
 static int sc_rework_match(sc_rework_t *rew, sc_iface_t *iface, sc_css_t **out)
 {
-  sc_css_t *css = NULL;
-  size_t off, k;
-  int i, l, rc;
+  size_t k;
+  int rc;
 
   if(out != NULL)
     *out = NULL;
@@ -6092,39 +6216,9 @@ static int sc_rework_match(sc_rework_t *rew, sc_iface_t *iface, sc_css_t **out)
 
   if(out == NULL)
     return 1;
-
-  /* calc the size of the matched portion */
-  off = 0;
-  for(i=1; i<rc; i++)
-    {
-      off += rew->ovector[(2*i)+1] - rew->ovector[2*i];
-      off++;
-    }
-  if(off == 0)
-    return 1;
-
-  /* allocate a css for the matched portion */
-  if((css = sc_css_alloc(off)) == NULL)
-    goto err;
-
-  /* fill the css */
-  off = 0;
-  for(i=1; i<rc; i++)
-    {
-      l = rew->ovector[(2*i)+1] - rew->ovector[2*i];
-      memcpy(css->css+off, iface->name + rew->ovector[2*i], l);
-      off += l;
-      css->css[off++] = '\0';
-      css->cssc++;
-    }
-  css->len = off;
-  *out = css;
-
+  if(sc_rework_css(rew, iface, out) != 0)
+    return -1;
   return 1;
-
- err:
-  if(css != NULL) sc_css_free(css);
-  return -1;
 }
 
 static void sc_rework_free(sc_rework_t *rew)
@@ -8661,6 +8755,36 @@ static void sc_iface_asname_find_thread(sc_ifacedom_t *ifd)
   return;
 }
 
+/*
+ * sc_iface_asname_find_all
+ *
+ * infer which hostnames could embed an AS name, using the current
+ * AS names dictionary.
+ */
+static void sc_iface_asname_find_all(void)
+{
+  slist_node_t *sn, *s2;
+  sc_routerdom_t *rd;
+  sc_domain_t *dom;
+  int i;
+
+  threadp = threadpool_alloc(threadc);
+  for(sn=slist_head_node(domain_list); sn != NULL; sn=slist_node_next(sn))
+    {
+      dom = slist_node_item(sn);
+      for(s2=slist_head_node(dom->routers); s2 != NULL; s2=slist_node_next(s2))
+	{
+	  rd = slist_node_item(s2);
+	  for(i=0; i<rd->ifacec; i++)
+	    threadpool_tail_push(threadp,
+				 (threadpool_func_t)sc_iface_asname_find_thread,
+				 rd->ifaces[i]);
+	}
+    }
+  threadpool_join(threadp); threadp = NULL;
+  return;
+}
+
 static int sc_rtt_cmp(const void *va, const void *vb)
 {
   const sc_rtt_t *a = (const sc_rtt_t *)va;
@@ -10037,118 +10161,534 @@ static int sc_regex_ifi_build2(slist_t *ifi1_list, slist_t *ifi2_list,
   return rc;
 }
 
+static int sc_ngram_cmp(const sc_ngram_t *a, const sc_ngram_t *b)
+{
+  if(a->gram < b->gram) return -1;
+  if(a->gram > b->gram) return  1;
+  if(a->id < b->id) return -1;
+  if(a->id > b->id) return  1;
+  return 0;
+}
+
+static uint32_t sc_ngram_gram(const char *str)
+{
+  return (((uint32_t)(uint8_t)str[0]) << 16) |
+    (((uint32_t)(uint8_t)str[1]) << 8) | ((uint32_t)(uint8_t)str[2]);
+}
+
 /*
- * sc_regex_ifi_build
+ * sc_ngram_find
  *
- * Return 0 iff assignments for each interface could be evaluated and
- * added to ifi_list_out.
- * ifi_list_out will be an slist_t of sc_ifaceinf_t (although the
- * length could be 0).
+ * return the position of the first entry in the domain's trigram index
+ * for the supplied trigram, and the number of entries.
  */
-static int sc_regex_ifi_build(sc_regex_t *re, slist_t *ifi_list_out)
+static size_t sc_ngram_find(const sc_domain_t *dom, uint32_t gram, size_t *c)
 {
-  sc_routerdom_t *rd;
-  slist_node_t *sn;
-  int i, x, rc = -1, ip;
-  sc_ifacedom_t *ifd;
-  sc_css_t *css = NULL;
-  slist_t *ifi_list = NULL;
-  sc_rework_t *rew = NULL;
-
-  if((ifi_list = slist_alloc()) == NULL ||
-     (rew = sc_rework_alloc(re)) == NULL)
-    goto done;
+  size_t l = 0, r = dom->ngramc, m, x;
 
-  for(i=0; i<re->regexc; i++)
+  while(l < r)
     {
-      if((x = sc_rework_capcount(rew, i)) < 0)
-	goto done;
-      re->regexes[i]->capc = (uint32_t)x;
+      m = l + ((r - l) / 2);
+      if(dom->ngrams[m].gram < gram)
+	l = m + 1;
+      else
+	r = m;
     }
+  for(x=l; x < dom->ngramc && dom->ngrams[x].gram == gram; x++)
+    ;
+  *c = x - l;
+  return l;
+}
 
-  /* go through all the interfaces and determine router assignments */
-  for(sn=slist_head_node(re->dom->routers); sn != NULL; sn=slist_node_next(sn))
+/*
+ * sc_domain_index
+ *
+ * build a trigram index of the hostnames of the training interfaces in
+ * the domain, so that a regex only has to be applied to hostnames that
+ * contain the literals the regex requires.
+ */
+static int sc_domain_index(sc_domain_t *dom)
+{
+  sc_routerdom_t *rd;
+  sc_ifacedom_t *ifd;
+  slist_node_t *sn;
+  const char *name;
+  size_t c = 0, j, len;
+  int i;
+
+  if(dom->ifacec == 0)
+    return 0;
+  if((dom->ifds = malloc_zero(sizeof(sc_ifacedom_t *) * dom->ifacec)) == NULL)
+    return -1;
+  for(sn=slist_head_node(dom->routers); sn != NULL; sn=slist_node_next(sn))
     {
       rd = slist_node_item(sn);
       for(i=0; i<rd->ifacec; i++)
 	{
 	  ifd = rd->ifaces[i];
-	  if((x = sc_rework_match(rew, ifd->iface, &css)) < 0)
-	    goto done;
+	  dom->ifds[ifd->id-1] = ifd;
+	  if(ifd->iface->len >= 3)
+	    c += ifd->iface->len - 2;
+	}
+    }
 
-	  ip = 0;
-	  if(x == 1)
-	    {
-	      if(css != NULL)
-		ip = sc_iface_ip_matched(ifd->iface, rew);
-	      if(sc_ifaceinf_get(ifi_list, ifd, css, ip, rew->k) == NULL)
-		goto done;
-	      css = NULL;
-	    }
-	  else
-	    {
-	      if(sc_ifaceinf_get(ifi_list, ifd, NULL, ip, -1) == NULL)
-		goto done;
-	    }
+  if(c == 0 || (dom->ngrams = malloc(sizeof(sc_ngram_t) * c)) == NULL)
+    return c == 0 ? 0 : -1;
+  for(j=0; j<dom->ifacec; j++)
+    {
+      name = dom->ifds[j]->iface->name;
+      len = dom->ifds[j]->iface->len;
+      for(i=0; i+2 < (int)len; i++)
+	{
+	  dom->ngrams[dom->ngramc].gram = sc_ngram_gram(name + i);
+	  dom->ngrams[dom->ngramc].id = dom->ifds[j]->id;
+	  dom->ngramc++;
 	}
     }
+  qsort(dom->ngrams, dom->ngramc, sizeof(sc_ngram_t),
+	(int (*)(const void *, const void *))sc_ngram_cmp);
 
-  slist_concat(ifi_list_out, ifi_list);
-  rc = 0;
+  /* remove duplicate entries, where a trigram occurs twice in a name */
+  c = 0;
+  for(j=1; j<dom->ngramc; j++)
+    if(sc_ngram_cmp(&dom->ngrams[c], &dom->ngrams[j]) != 0)
+      dom->ngrams[++c] = dom->ngrams[j];
+  dom->ngramc = c + 1;
 
- done:
-  if(rew != NULL) sc_rework_free(rew);
-  if(ifi_list != NULL) slist_free_cb(ifi_list, (slist_free_t)sc_ifaceinf_free);
-  return rc;
+  return 0;
+}
+
+static int sc_rematch_cmp(const sc_rematch_t *a, const sc_rematch_t *b)
+{
+  return strcmp(a->str, b->str);
+}
+
+static void sc_rematch_free(sc_rematch_t *rm)
+{
+  uint32_t i;
+  if(rm->str != NULL) free(rm->str);
+  if(rm->ids != NULL) free(rm->ids);
+  if(rm->csss != NULL)
+    {
+      for(i=0; i<rm->idc; i++)
+	if(rm->csss[i] != NULL)
+	  sc_css_free(rm->csss[i]);
+      free(rm->csss);
+    }
+  if(rm->ips != NULL) free(rm->ips);
+  free(rm);
+  return;
 }
 
 /*
- * sc_regex_ifi_thin
- *
- * go through candidate interface inferences and remove any that are
- * identical to what the current working regex has.
+ * sc_rematch_find
  *
- * return the count of extractions made by cand_l at the end of the
- * thin process
+ * find the memoised result of applying the regex to the training
+ * interfaces in the domain, if there is one.
  */
-static int sc_regex_ifi_thin(slist_t *ifi_work_l, slist_t *ifi_cand_l)
+static sc_rematch_t *sc_rematch_find(sc_domain_t *dom, const char *str)
 {
-  slist_node_t *sn_work, *sn_cand;
-  sc_ifaceinf_t *ifi_work, *ifi_cand;
-  int c = 0;
+  sc_rematch_t fm, *rm = NULL;
 
-  sn_cand = slist_head_node(ifi_cand_l);
-  sn_work = slist_head_node(ifi_work_l);
+  fm.str = (char *)str;
+  if(sc_domain_lock(dom) != 0)
+    return NULL;
+  if(dom->rematches != NULL)
+    rm = splaytree_find(dom->rematches, &fm);
+  sc_domain_unlock(dom);
 
-  while(sn_cand != NULL)
-    {
-      ifi_work = slist_node_item(sn_work);
-      ifi_cand = slist_node_item(sn_cand);
+  return rm;
+}
 
-      assert(ifi_work->ifd == ifi_cand->ifd);
+/*
+ * sc_rematch_add
+ *
+ * memoise the result, unless the memo for the domain is full.  if
+ * another thread concurrently memoised the same regex, return that
+ * result instead.  returns NULL if the result was not memoised, in
+ * which case the caller remains responsible for it.
+ */
+static sc_rematch_t *sc_rematch_add(sc_domain_t *dom, sc_rematch_t *rm)
+{
+  sc_rematch_t *x = NULL;
 
-      /*
-       * if the css is the same across regexes, clear out the
-       * inference from cand_ifi so that it doesn't get counted as a
-       * contribution from the candidate regex (the working regex
-       * already had it covered)
-       */
-      if(ifi_cand->css != NULL && ifi_work->css != NULL &&
-	 sc_css_css_cmp(ifi_cand->css, ifi_work->css) == 0)
+  if(sc_domain_lock(dom) != 0)
+    return NULL;
+  if(dom->rematches == NULL)
+    dom->rematches = splaytree_alloc((splaytree_cmp_t)sc_rematch_cmp);
+  if(dom->rematches != NULL)
+    {
+      if((x = splaytree_find(dom->rematches, rm)) == NULL &&
+	 dom->rematchs + rm->size <= REMATCH_SIZE &&
+	 splaytree_insert(dom->rematches, rm) != NULL)
 	{
-	  sc_css_free(ifi_cand->css); ifi_cand->css = NULL;
-	  ifi_cand->ipm = 0;
-	  ifi_cand->regex = -1;
+	  dom->rematchs += rm->size;
+	  x = rm;
 	}
-
-      if(ifi_cand->css != NULL)
-	c++;
-
-      sn_work = slist_node_next(sn_work);
-      sn_cand = slist_node_next(sn_cand);
     }
+  sc_domain_unlock(dom);
 
-  return c;
+  return x;
+}
+
+/*
+ * sc_rematch_ifd
+ *
+ * apply regex k to the interface, if the interface contains all the
+ * literals the regex requires.
+ */
+static int sc_rematch_ifd(sc_rework_t *rew, size_t k, const sc_relit_t *rl,
+			  const sc_ifacedom_t *ifd)
+{
+  const sc_iface_t *iface = ifd->iface;
+  int i;
+
+  for(i=0; i<rl->litc; i++)
+    if(strstr(iface->name, rl->lits[i]) == NULL)
+      return 0;
+  return sc_rework_matchk(rew, k, iface->name);
+}
+
+/*
+ * sc_rematch_build
+ *
+ * apply regex k to the training interfaces in the domain.  if the
+ * regex requires literals, only the interfaces whose hostnames contain
+ * the least common trigram of those literals are candidates.
+ */
+static sc_rematch_t *sc_rematch_build(sc_domain_t *dom, sc_rework_t *rew,
+				      size_t k, const char *str)
+{
+  sc_rematch_t *rm = NULL;
+  sc_ifacedom_t *ifd;
+  sc_css_t *css;
+  sc_relit_t rl;
+  size_t c, min_c = 0, min_o = 0, o, j;
+  int i, x, found = 0;
+
+  if((rm = malloc_zero(sizeof(sc_rematch_t))) == NULL ||
+     (rm->str = strdup(str)) == NULL ||
+     (x = sc_rework_capcount(rew, k)) < 0)
+    goto err;
+  rm->capc = (uint8_t)x;
+
+  /* find the least common trigram across the required literals */
+  sc_relit_get(str, &rl);
+  for(i=0; i<rl.litc; i++)
+    {
+      for(j=0; j+2 < rl.lens[i]; j++)
+	{
+	  o = sc_ngram_find(dom, sc_ngram_gram(rl.lits[i] + j), &c);
+	  if(found == 0 || c < min_c)
+	    {
+	      min_c = c;
+	      min_o = o;
+	      found = 1;
+	    }
+	}
+    }
+
+  /*
+   * if we have a trigram, only the hostnames with that trigram can
+   * match.  otherwise, try all the hostnames.
+   */
+  c = found != 0 ? min_c : dom->ifacec;
+  if(c > 0 &&
+     ((rm->ids = malloc(sizeof(uint32_t) * c)) == NULL ||
+      (rm->csss = malloc(sizeof(sc_css_t *) * c)) == NULL ||
+      (rm->ips = malloc(sizeof(uint8_t) * c)) == NULL))
+    goto err;
+  for(j=0; j<c; j++)
+    {
+      if(found != 0)
+	ifd = dom->ifds[dom->ngrams[min_o + j].id - 1];
+      else
+	ifd = dom->ifds[j];
+      if((x = sc_rematch_ifd(rew, k, &rl, ifd)) < 0)
+	goto err;
+      if(x == 0)
+	continue;
+      if(sc_rework_css(rew, ifd->iface, &css) != 0)
+	goto err;
+      rm->ids[rm->idc] = ifd->id;
+      rm->csss[rm->idc] = css;
+      rm->ips[rm->idc] = css != NULL ? sc_iface_ip_matched(ifd->iface, rew) : 0;
+      rm->idc++;
+      if(css != NULL)
+	rm->size += sizeof(sc_css_t) + css->len;
+    }
+
+  rm->size += sizeof(sc_rematch_t) + strlen(str) + 1 +
+    ((sizeof(uint32_t) + sizeof(sc_css_t *) + sizeof(uint8_t)) * c);
+  return rm;
+
+ err:
+  if(rm != NULL) sc_rematch_free(rm);
+  return NULL;
+}
+
+/*
+ * sc_rematch_get
+ *
+ * return the result of applying regex k to the training interfaces,
+ * memoising it if it has not been computed before.  own is set if the
+ * result could not be memoised, and the caller must free it.
+ */
+static sc_rematch_t *sc_rematch_get(sc_regex_t *re, sc_rework_t **rew,
+				    size_t k, uint8_t *own)
+{
+  sc_domain_t *dom = re->dom;
+  const char *str = re->regexes[k]->str;
+  sc_rematch_t *rm, *x;
+
+  *own = 0;
+  if((rm = sc_rematch_find(dom, str)) != NULL)
+    return rm;
+  if(*rew == NULL && (*rew = sc_rework_alloc(re)) == NULL)
+    return NULL;
+  if((rm = sc_rematch_build(dom, *rew, k, str)) == NULL)
+    return NULL;
+  if((x = sc_rematch_add(dom, rm)) == NULL)
+    {
+      *own = 1;
+      return rm;
+    }
+  if(x != rm)
+    sc_rematch_free(rm);
+  return x;
+}
+
+/*
+ * sc_rematch_isset
+ *
+ * return 1 if the regex matched the interface with the supplied id.
+ */
+static int sc_rematch_isset(const sc_rematch_t *rm, uint32_t id)
+{
+  uint32_t l = 0, r = rm->idc, m;
+
+  while(l < r)
+    {
+      m = l + ((r - l) / 2);
+      if(rm->ids[m] == id)
+	return 1;
+      if(rm->ids[m] < id)
+	l = m + 1;
+      else
+	r = m;
+    }
+
+  return 0;
+}
+
+/*
+ * sc_regex_ifi_build_all
+ *
+ * apply the regexes to all of the training interfaces in the domain.
+ */
+static int sc_regex_ifi_build_all(sc_regex_t *re, slist_t *ifi_list_out)
+{
+  sc_routerdom_t *rd;
+  slist_node_t *sn;
+  int i, x, rc = -1, ip;
+  sc_ifacedom_t *ifd;
+  sc_css_t *css = NULL;
+  slist_t *ifi_list = NULL;
+  sc_rework_t *rew = NULL;
+
+  if((ifi_list = slist_alloc()) == NULL ||
+     (rew = sc_rework_alloc(re)) == NULL)
+    goto done;
+
+  for(i=0; i<re->regexc; i++)
+    {
+      if((x = sc_rework_capcount(rew, i)) < 0)
+	goto done;
+      re->regexes[i]->capc = (uint32_t)x;
+    }
+
+  /* go through all the interfaces and determine router assignments */
+  for(sn=slist_head_node(re->dom->routers); sn != NULL; sn=slist_node_next(sn))
+    {
+      rd = slist_node_item(sn);
+      for(i=0; i<rd->ifacec; i++)
+	{
+	  ifd = rd->ifaces[i];
+	  if((x = sc_rework_match(rew, ifd->iface, &css)) < 0)
+	    goto done;
+
+	  ip = 0;
+	  if(x == 1)
+	    {
+	      if(css != NULL)
+		ip = sc_iface_ip_matched(ifd->iface, rew);
+	      if(sc_ifaceinf_get(ifi_list, ifd, css, ip, rew->k) == NULL)
+		goto done;
+	      css = NULL;
+	    }
+	  else
+	    {
+	      if(sc_ifaceinf_get(ifi_list, ifd, NULL, ip, -1) == NULL)
+		goto done;
+	    }
+	}
+    }
+
+  slist_concat(ifi_list_out, ifi_list);
+  rc = 0;
+
+ done:
+  if(rew != NULL) sc_rework_free(rew);
+  if(ifi_list != NULL) slist_free_cb(ifi_list, (slist_free_t)sc_ifaceinf_free);
+  return rc;
+}
+
+/*
+ * sc_regex_ifi_build
+ *
+ * Return 0 iff assignments for each interface could be evaluated and
+ * added to ifi_list_out.
+ * ifi_list_out will be an slist_t of sc_ifaceinf_t (although the
+ * length could be 0).
+ *
+ * what each regex extracts from the training interfaces is memoised
+ * per domain, so a regex is only applied to the hostnames the first
+ * time it is evaluated.
+ */
+static int sc_regex_ifi_build(sc_regex_t *re, slist_t *ifi_list_out)
+{
+  sc_domain_t *dom = re->dom;
+  sc_rematch_t **rms = NULL, *rm;
+  sc_routerdom_t *rd;
+  slist_node_t *sn;
+  sc_ifacedom_t *ifd;
+  sc_css_t *css = NULL;
+  slist_t *ifi_list = NULL;
+  sc_rework_t *rew = NULL;
+  uint32_t *curs = NULL;
+  uint8_t *tmps = NULL;
+  int i, k, rc = -1;
+
+  if(dom->ifds == NULL)
+    return sc_regex_ifi_build_all(re, ifi_list_out);
+
+  if((ifi_list = slist_alloc()) == NULL ||
+     (rms = malloc_zero(sizeof(sc_rematch_t *) * re->regexc)) == NULL ||
+     (curs = malloc_zero(sizeof(uint32_t) * re->regexc)) == NULL ||
+     (tmps = malloc_zero(sizeof(uint8_t) * re->regexc)) == NULL)
+    goto done;
+
+  for(k=0; k<re->regexc; k++)
+    {
+      if((rms[k] = sc_rematch_get(re, &rew, k, &tmps[k])) == NULL)
+	goto done;
+      re->regexes[k]->capc = rms[k]->capc;
+    }
+
+  /*
+   * go through all the interfaces and determine router assignments.
+   * the interface ids are in the order of the routers, so step through
+   * the interfaces each regex matched.
+   */
+  for(sn=slist_head_node(dom->routers); sn != NULL; sn=slist_node_next(sn))
+    {
+      rd = slist_node_item(sn);
+      for(i=0; i<rd->ifacec; i++)
+	{
+	  ifd = rd->ifaces[i];
+	  for(k=0; k<re->regexc; k++)
+	    {
+	      rm = rms[k];
+	      while(curs[k] < rm->idc && rm->ids[curs[k]] < ifd->id)
+		curs[k]++;
+	      if(curs[k] < rm->idc && rm->ids[curs[k]] == ifd->id)
+		break;
+	    }
+
+	  if(k < re->regexc)
+	    {
+	      rm = rms[k];
+	      if(rm->csss[curs[k]] != NULL &&
+		 (css = sc_css_dup(rm->csss[curs[k]])) == NULL)
+		goto done;
+	      if(sc_ifaceinf_get(ifi_list, ifd, css, rm->ips[curs[k]], k) == NULL)
+		goto done;
+	      css = NULL;
+	    }
+	  else
+	    {
+	      if(sc_ifaceinf_get(ifi_list, ifd, NULL, 0, -1) == NULL)
+		goto done;
+	    }
+	}
+    }
+
+  slist_concat(ifi_list_out, ifi_list);
+  rc = 0;
+
+ done:
+  if(css != NULL) sc_css_free(css);
+  if(rms != NULL)
+    {
+      for(k=0; k<re->regexc; k++)
+	if(tmps != NULL && tmps[k] != 0)
+	  sc_rematch_free(rms[k]);
+      free(rms);
+    }
+  if(curs != NULL) free(curs);
+  if(tmps != NULL) free(tmps);
+  if(rew != NULL) sc_rework_free(rew);
+  if(ifi_list != NULL) slist_free_cb(ifi_list, (slist_free_t)sc_ifaceinf_free);
+  return rc;
+}
+
+/*
+ * sc_regex_ifi_thin
+ *
+ * go through candidate interface inferences and remove any that are
+ * identical to what the current working regex has.
+ *
+ * return the count of extractions made by cand_l at the end of the
+ * thin process
+ */
+static int sc_regex_ifi_thin(slist_t *ifi_work_l, slist_t *ifi_cand_l)
+{
+  slist_node_t *sn_work, *sn_cand;
+  sc_ifaceinf_t *ifi_work, *ifi_cand;
+  int c = 0;
+
+  sn_cand = slist_head_node(ifi_cand_l);
+  sn_work = slist_head_node(ifi_work_l);
+
+  while(sn_cand != NULL)
+    {
+      ifi_work = slist_node_item(sn_work);
+      ifi_cand = slist_node_item(sn_cand);
+
+      assert(ifi_work->ifd == ifi_cand->ifd);
+
+      /*
+       * if the css is the same across regexes, clear out the
+       * inference from cand_ifi so that it doesn't get counted as a
+       * contribution from the candidate regex (the working regex
+       * already had it covered)
+       */
+      if(ifi_cand->css != NULL && ifi_work->css != NULL &&
+	 sc_css_css_cmp(ifi_cand->css, ifi_work->css) == 0)
+	{
+	  sc_css_free(ifi_cand->css); ifi_cand->css = NULL;
+	  ifi_cand->ipm = 0;
+	  ifi_cand->regex = -1;
+	}
+
+      if(ifi_cand->css != NULL)
+	c++;
+
+      sn_work = slist_node_next(sn_work);
+      sn_cand = slist_node_next(sn_cand);
+    }
+
+  return c;
 }
 
 /*
@@ -12055,6 +12595,12 @@ static void sc_domain_free(sc_domain_t *dom)
     free(dom->domain);
   if(dom->escape != NULL)
     free(dom->escape);
+  if(dom->ifds != NULL)
+    free(dom->ifds);
+  if(dom->ngrams != NULL)
+    free(dom->ngrams);
+  if(dom->rematches != NULL)
+    splaytree_free(dom->rematches, (splaytree_free_t)sc_rematch_free);
   if(dom->routers != NULL)
     slist_free_cb(dom->routers, (slist_free_t)sc_routerdom_free);
   if(dom->regexes != NULL)
@@ -17772,6 +18318,8 @@ static int sc_regex_alias_fp_eval(slist_t *ri_list, sc_regex_t *re)
 {
   splaytree_t *tree = NULL;
   sc_rework_t *rew = NULL;
+  sc_rematch_t *rm = NULL;
+  uint8_t own = 0;
   int rc = -1, x;
   slist_node_t *sn;
   sc_routerinf_t *ri;
@@ -17779,7 +18327,13 @@ static int sc_regex_alias_fp_eval(slist_t *ri_list, sc_regex_t *re)
   sc_iface_t *iface;
   size_t i;
 
-  if((rew = sc_rework_alloc(re)) == NULL)
+  /* use the memoised matches for a single regex if we can */
+  if(re->dom->ifds != NULL && re->regexc == 1)
+    {
+      if((rm = sc_rematch_get(re, &rew, 0, &own)) == NULL)
+	goto done;
+    }
+  else if((rew = sc_rework_alloc(re)) == NULL)
     goto done;
   if((tree = splaytree_alloc((splaytree_cmp_t)ptrcmp)) == NULL)
     goto done;
@@ -17791,7 +18345,9 @@ static int sc_regex_alias_fp_eval(slist_t *ri_list, sc_regex_t *re)
       for(i=0; i<ri->ifacec; i++)
 	{
 	  iface = ri->ifaces[i]->ifd->iface;
-	  if((x = sc_rework_match(rew, iface, NULL)) < 0)
+	  if(rm != NULL)
+	    x = sc_rematch_isset(rm, ri->ifaces[i]->ifd->id);
+	  else if((x = sc_rework_match(rew, iface, NULL)) < 0)
 	    goto done;
 
 	  /* matched */
@@ -17826,6 +18382,7 @@ static int sc_regex_alias_fp_eval(slist_t *ri_list, sc_regex_t *re)
   rc = 0;
 
  done:
+  if(rm != NULL && own != 0) sc_rematch_free(rm);
   if(rew != NULL) sc_rework_free(rew);
   if(tree != NULL) splaytree_free(tree, NULL);
   return rc;
@@ -20233,9 +20790,7 @@ static int refine_dict_asnames(void)
   slist_t *ifi_list = NULL, *list = NULL, *thin = NULL, *unk_list = NULL;
   splaytree_t *tree = NULL, *unk_tree = NULL;
   slist_node_t *sn, *s2;
-  sc_routerdom_t *rd;
   sc_ifaceinf_t *ifi;
-  sc_ifacedom_t *ifd;
   sc_domain_t *dom;
   sc_as2tag_t *a2t;
   sc_regex_t *re;
@@ -20314,25 +20869,10 @@ static int refine_dict_asnames(void)
   slist_free(list); list = NULL;
 
   /* infer which hostnames could embed an AS name */
-  threadp = threadpool_alloc(threadc);
-  for(sn=slist_head_node(domain_list); sn != NULL; sn=slist_node_next(sn))
-    {
-      dom = slist_node_item(sn);
-      for(s2=slist_head_node(dom->routers); s2 != NULL; s2=slist_node_next(s2))
-	{
-	  rd = slist_node_item(s2);
-	  for(i=0; i<rd->ifacec; i++)
-	    {
-	      ifd = rd->ifaces[i];
-	      threadpool_tail_push(threadp,
-		   (threadpool_func_t)sc_iface_asname_find_thread, ifd);
-	    }
-	}
-    }
-  threadpool_join(threadp); threadp = NULL;
-
-  fprintf(stderr, "refining dictionary: %d entries\n", (int)tag2asc);
-
+  sc_iface_asname_find_all();
+
+  fprintf(stderr, "refining dictionary: %d entries\n", (int)tag2asc);
+
   for(sn=slist_head_node(domain_list); sn != NULL; sn=slist_node_next(sn))
     {
       dom = slist_node_item(sn);
@@ -20846,30 +21386,12 @@ static int load_routers_asnames_dict(void)
 
 static int load_routers_asnames(void)
 {
-  slist_node_t *sn, *s2;
-  sc_routerdom_t *rd;
-  sc_domain_t *dom;
-  int i;
-
   /* infer the initial dictionary if one is not provided */
   if(dicts == NULL && load_routers_asnames_dict() != 0)
     return -1;
 
   /* infer which hostnames could embed an AS name */
-  threadp = threadpool_alloc(threadc);
-  for(sn=slist_head_node(domain_list); sn != NULL; sn=slist_node_next(sn))
-    {
-      dom = slist_node_item(sn);
-      for(s2=slist_head_node(dom->routers); s2 != NULL; s2=slist_node_next(s2))
-	{
-	  rd = slist_node_item(s2);
-	  for(i=0; i<rd->ifacec; i++)
-	    threadpool_tail_push(threadp,
-				 (threadpool_func_t)sc_iface_asname_find_thread,
-				 rd->ifaces[i]);
-	}
-    }
-  threadpool_join(threadp); threadp = NULL;
+  sc_iface_asname_find_all();
 
   return 0;
 }
@@ -21039,6 +21561,10 @@ static int load_routers_2(void)
       rtc = slist_count(dom->routers);
       dom->tpmlen = dom->ifacec / 32 + ((dom->ifacec % 32 == 0) ? 0 : 1);
       dom->rtmlen = rtc / 32 + ((rtc % 32 == 0) ? 0 : 1);
+
+      /* index the hostnames by trigram */
+      if(sc_domain_index(dom) != 0)
+	goto done;
     }
 
   /* run some assertions on the domains */
@@ -22292,6 +22818,623 @@ static int load_rtt(void)
   return rc;
 }
 
+static int ckpt_reserve(sc_ckpt_t *ck, size_t len)
+{
+  size_t x;
+  uint8_t *buf;
+
+  if(ck->len - ck->off >= len)
+    return 0;
+  x = (ck->len == 0) ? 65536 : ck->len;
+  while(x - ck->off < len)
+    x *= 2;
+  if((buf = realloc(ck->buf, x)) == NULL)
+    return -1;
+  ck->buf = buf;
+  ck->len = x;
+  return 0;
+}
+
+static int ckpt_put_bytes(sc_ckpt_t *ck, const void *ptr, size_t len)
+{
+  if(ckpt_reserve(ck, len) != 0)
+    return -1;
+  memcpy(ck->buf + ck->off, ptr, len);
+  ck->off += len;
+  return 0;
+}
+
+static int ckpt_put_u8(sc_ckpt_t *ck, uint8_t u8)
+{
+  return ckpt_put_bytes(ck, &u8, 1);
+}
+
+static int ckpt_put_u32(sc_ckpt_t *ck, uint32_t u32)
+{
+  uint8_t buf[4];
+  bytes_htonl(buf, u32);
+  return ckpt_put_bytes(ck, buf, 4);
+}
+
+static int ckpt_put_dbl(sc_ckpt_t *ck, double d)
+{
+  uint64_t u64;
+  uint8_t buf[8];
+  memcpy(&u64, &d, 8);
+  bytes_htonl(buf, (uint32_t)(u64 >> 32));
+  bytes_htonl(buf+4, (uint32_t)(u64 & 0xffffffff));
+  return ckpt_put_bytes(ck, buf, 8);
+}
+
+/*
+ * ckpt_put_str
+ *
+ * write a length-prefixed string, where a length of 0xffffffff
+ * denotes a NULL string.
+ */
+static int ckpt_put_str(sc_ckpt_t *ck, const char *str)
+{
+  size_t len;
+  if(str == NULL)
+    return ckpt_put_u32(ck, 0xffffffff);
+  len = strlen(str);
+  if(ckpt_put_u32(ck, (uint32_t)len) != 0 ||
+     ckpt_put_bytes(ck, str, len) != 0)
+    return -1;
+  return 0;
+}
+
+static int ckpt_get_bytes(sc_ckpt_t *ck, void *ptr, size_t len)
+{
+  if(ck->len - ck->off < len)
+    return -1;
+  memcpy(ptr, ck->buf + ck->off, len);
+  ck->off += len;
+  return 0;
+}
+
+static int ckpt_get_u8(sc_ckpt_t *ck, uint8_t *u8)
+{
+  return ckpt_get_bytes(ck, u8, 1);
+}
+
+static int ckpt_get_u32(sc_ckpt_t *ck, uint32_t *u32)
+{
+  if(ck->len - ck->off < 4)
+    return -1;
+  *u32 = bytes_ntohl(ck->buf + ck->off);
+  ck->off += 4;
+  return 0;
+}
+
+static int ckpt_get_dbl(sc_ckpt_t *ck, double *d)
+{
+  uint64_t u64;
+  if(ck->len - ck->off < 8)
+    return -1;
+  u64 = ((uint64_t)bytes_ntohl(ck->buf + ck->off)) << 32;
+  u64 |= bytes_ntohl(ck->buf + ck->off + 4);
+  memcpy(d, &u64, 8);
+  ck->off += 8;
+  return 0;
+}
+
+static int ckpt_get_str(sc_ckpt_t *ck, char **out)
+{
+  uint32_t len;
+  char *str;
+
+  *out = NULL;
+  if(ckpt_get_u32(ck, &len) != 0)
+    return -1;
+  if(len == 0xffffffff)
+    return 0;
+  if(ck->len - ck->off < len || (str = malloc(len + 1)) == NULL)
+    return -1;
+  memcpy(str, ck->buf + ck->off, len);
+  str[len] = '\0';
+  ck->off += len;
+  *out = str;
+  return 0;
+}
+
+static int ckpt_learn(void)
+{
+  if(do_learnalias != 0) return 1;
+  if(do_learnasn != 0) return 2;
+  if(do_learnasnames != 0) return 3;
+  if(do_learngeo != 0) return 4;
+  return 0;
+}
+
+static int ckpt_put_geohint(sc_ckpt_t *ck, const sc_geohint_t *gh)
+{
+  if(ckpt_put_u8(ck, gh->type) != 0 ||
+     ckpt_put_u8(ck, gh->learned) != 0 ||
+     ckpt_put_u8(ck, gh->flags) != 0 ||
+     ckpt_put_u32(ck, gh->index) != 0 ||
+     ckpt_put_str(ck, gh->code) != 0 ||
+     ckpt_put_str(ck, gh->place) != 0 ||
+     ckpt_put_str(ck, gh->street) != 0 ||
+     ckpt_put_str(ck, gh->facname) != 0 ||
+     ckpt_put_bytes(ck, gh->cc, sizeof(gh->cc)) != 0 ||
+     ckpt_put_bytes(ck, gh->st, sizeof(gh->st)) != 0 ||
+     ckpt_put_dbl(ck, gh->lat) != 0 ||
+     ckpt_put_dbl(ck, gh->lng) != 0 ||
+     ckpt_put_u32(ck, gh->popn) != 0)
+    return -1;
+  return 0;
+}
+
+static sc_geohint_t *ckpt_get_geohint(sc_ckpt_t *ck)
+{
+  sc_geohint_t *gh;
+
+  if((gh = malloc_zero(sizeof(sc_geohint_t))) == NULL)
+    return NULL;
+  if(ckpt_get_u8(ck, &gh->type) != 0 ||
+     ckpt_get_u8(ck, &gh->learned) != 0 ||
+     ckpt_get_u8(ck, &gh->flags) != 0 ||
+     ckpt_get_u32(ck, &gh->index) != 0 ||
+     ckpt_get_str(ck, &gh->code) != 0 || gh->code == NULL ||
+     ckpt_get_str(ck, &gh->place) != 0 ||
+     ckpt_get_str(ck, &gh->street) != 0 ||
+     ckpt_get_str(ck, &gh->facname) != 0 ||
+     ckpt_get_bytes(ck, gh->cc, sizeof(gh->cc)) != 0 ||
+     ckpt_get_bytes(ck, gh->st, sizeof(gh->st)) != 0 ||
+     ckpt_get_dbl(ck, &gh->lat) != 0 ||
+     ckpt_get_dbl(ck, &gh->lng) != 0 ||
+     ckpt_get_u32(ck, &gh->popn) != 0)
+    {
+      sc_geohint_free(gh);
+      return NULL;
+    }
+  gh->cc[sizeof(gh->cc)-1] = '\0';
+  gh->st[sizeof(gh->st)-1] = '\0';
+  gh->codelen = strlen(gh->code);
+  gh->latr = gh->lat * (M_PI / 180.0);
+  gh->lngr = gh->lng * (M_PI / 180.0);
+  return gh;
+}
+
+static int ckpt_put_regex(sc_ckpt_t *ck, const sc_regex_t *re)
+{
+  const sc_regexn_t *ren;
+  uint32_t i;
+  size_t s;
+
+  if(ckpt_put_u32(ck, (uint32_t)re->regexc) != 0 ||
+     ckpt_put_u32(ck, (uint32_t)re->score) != 0 ||
+     ckpt_put_u8(ck, re->class) != 0 ||
+     ckpt_put_u32(ck, re->matchc) != 0 ||
+     ckpt_put_u32(ck, re->namelen) != 0 ||
+     ckpt_put_u32(ck, re->tp_c) != 0 ||
+     ckpt_put_u32(ck, re->fp_c) != 0 ||
+     ckpt_put_u32(ck, re->fne_c) != 0 ||
+     ckpt_put_u32(ck, re->fnu_c) != 0 ||
+     ckpt_put_u32(ck, re->unk_c) != 0 ||
+     ckpt_put_u32(ck, re->ip_c) != 0 ||
+     ckpt_put_u32(ck, re->sp_c) != 0 ||
+     ckpt_put_u32(ck, re->sn_c) != 0 ||
+     ckpt_put_u32(ck, re->rt_c) != 0 ||
+     ckpt_put_u8(ck, re->tp_mask != NULL ? 1 : 0) != 0)
+    return -1;
+
+  if(re->tp_mask != NULL)
+    for(i=0; i<re->dom->tpmlen; i++)
+      if(ckpt_put_u32(ck, re->tp_mask[i]) != 0)
+	return -1;
+
+  for(i=0; i<(uint32_t)re->regexc; i++)
+    {
+      ren = re->regexes[i];
+      if(ckpt_put_str(ck, ren->str) != 0 ||
+	 ckpt_put_u8(ck, ren->capc) != 0 ||
+	 ckpt_put_u8(ck, ren->plan != NULL ? 1 : 0) != 0 ||
+	 (ren->plan != NULL && ckpt_put_bytes(ck, ren->plan, ren->capc) != 0) ||
+	 ckpt_put_u32(ck, ren->matchc) != 0 ||
+	 ckpt_put_u32(ck, ren->tp_c) != 0 ||
+	 ckpt_put_u32(ck, ren->rt_c) != 0)
+	return -1;
+    }
+
+  if(ckpt_put_u32(ck, (uint32_t)re->geohintc) != 0)
+    return -1;
+  for(s=0; s<re->geohintc; s++)
+    if(ckpt_put_geohint(ck, re->geohints[s]) != 0)
+      return -1;
+
+  return 0;
+}
+
+static sc_regex_t *ckpt_get_regex(sc_ckpt_t *ck, sc_domain_t *dom)
+{
+  sc_regexn_t *ren;
+  sc_regex_t *re = NULL;
+  sc_geohint_t *gh;
+  uint32_t i, u32, ghc;
+  uint8_t u8;
+
+  if((re = malloc_zero(sizeof(sc_regex_t))) == NULL ||
+     ckpt_get_u32(ck, &u32) != 0 || u32 == 0 || u32 > 0xffff ||
+     (re->regexes = malloc_zero(sizeof(sc_regexn_t *) * u32)) == NULL)
+    goto err;
+  re->regexc = (int)u32;
+  re->dom = dom;
+
+  if(ckpt_get_u32(ck, &u32) != 0)
+    goto err;
+  re->score = (int)u32;
+  if(ckpt_get_u8(ck, &re->class) != 0 ||
+     ckpt_get_u32(ck, &re->matchc) != 0 ||
+     ckpt_get_u32(ck, &re->namelen) != 0 ||
+     ckpt_get_u32(ck, &re->tp_c) != 0 ||
+     ckpt_get_u32(ck, &re->fp_c) != 0 ||
+     ckpt_get_u32(ck, &re->fne_c) != 0 ||
+     ckpt_get_u32(ck, &re->fnu_c) != 0 ||
+     ckpt_get_u32(ck, &re->unk_c) != 0 ||
+     ckpt_get_u32(ck, &re->ip_c) != 0 ||
+     ckpt_get_u32(ck, &re->sp_c) != 0 ||
+     ckpt_get_u32(ck, &re->sn_c) != 0 ||
+     ckpt_get_u32(ck, &re->rt_c) != 0 ||
+     ckpt_get_u8(ck, &u8) != 0)
+    goto err;
+
+  if(u8 != 0)
+    {
+      if((re->tp_mask = malloc_zero(sizeof(uint32_t) * dom->tpmlen)) == NULL)
+	goto err;
+      for(i=0; i<dom->tpmlen; i++)
+	if(ckpt_get_u32(ck, &re->tp_mask[i]) != 0)
+	  goto err;
+    }
+
+  for(i=0; i<(uint32_t)re->regexc; i++)
+    {
+      if((ren = malloc_zero(sizeof(sc_regexn_t))) == NULL)
+	goto err;
+      re->regexes[i] = ren;
+      if(ckpt_get_str(ck, &ren->str) != 0 || ren->str == NULL ||
+	 ckpt_get_u8(ck, &ren->capc) != 0 ||
+	 ckpt_get_u8(ck, &u8) != 0)
+	goto err;
+      if(u8 != 0 && ren->capc > 0 &&
+	 ((ren->plan = malloc(ren->capc)) == NULL ||
+	  ckpt_get_bytes(ck, ren->plan, ren->capc) != 0))
+	goto err;
+      if(ckpt_get_u32(ck, &ren->matchc) != 0 ||
+	 ckpt_get_u32(ck, &ren->tp_c) != 0 ||
+	 ckpt_get_u32(ck, &ren->rt_c) != 0)
+	goto err;
+    }
+
+  if(ckpt_get_u32(ck, &ghc) != 0)
+    goto err;
+  for(i=0; i<ghc; i++)
+    {
+      if((gh = ckpt_get_geohint(ck)) == NULL)
+	goto err;
+      if(array_insert((void ***)&re->geohints, &re->geohintc, gh, NULL) != 0)
+	{
+	  sc_geohint_free(gh);
+	  goto err;
+	}
+    }
+  if(re->geohintc > 0)
+    sc_geohint_sort(re->geohints, re->geohintc);
+
+  return re;
+
+ err:
+  if(re != NULL) sc_regex_free(re);
+  return NULL;
+}
+
+/*
+ * checkpoint_write
+ *
+ * write the regexes for each domain, and any refined AS names
+ * dictionary, to the checkpoint file.  the checkpoint is written to a
+ * temporary file that is renamed once complete, so that an interrupted
+ * write does not clobber the checkpoint from the previous stage.
+ */
+static int checkpoint_write(int stage)
+{
+  struct timeval start, finish;
+  sc_ckpt_t ck;
+  slist_node_t *sn, *s2;
+  sc_domain_t *dom;
+  sc_as2tag_t *a2t;
+  slist_t *sxes = NULL;
+  char *tmp = NULL, *sx, buf[32];
+  size_t s, len;
+  int fd = -1, rc = -1;
+
+  if(ckpt_file == NULL)
+    return 0;
+
+  gettimeofday_wrap(&start);
+  memset(&ck, 0, sizeof(ck));
+
+  if(ckpt_put_bytes(&ck, CKPT_MAGIC, 8) != 0 ||
+     ckpt_put_u32(&ck, CKPT_VERSION) != 0 ||
+     ckpt_put_u8(&ck, ckpt_learn()) != 0 ||
+     ckpt_put_u8(&ck, ip_v) != 0 ||
+     ckpt_put_u32(&ck, refine_mask) != 0 ||
+     ckpt_put_u32(&ck, stage) != 0)
+    goto done;
+
+  /*
+   * refine_dict_asnames replaces the AS names dictionary in stage 2.
+   * record the dictionary, or that there is none, once it has.
+   */
+  if(do_learnasnames != 0 && stage >= 2 &&
+     (refine_mask & REFINE_DICT) != 0 && domain_eval == NULL)
+    {
+      if((sxes = slist_alloc()) == NULL ||
+	 ckpt_put_u8(&ck, 1) != 0 ||
+	 ckpt_put_u32(&ck, tag2ass != NULL ? tag2asc : 0) != 0)
+	goto done;
+      for(s=0; tag2ass != NULL && s<tag2asc; s++)
+	{
+	  a2t = tag2ass[s];
+	  splaytree_inorder(a2t->sxes, tree_to_slist, sxes);
+	  if(ckpt_put_u32(&ck, a2t->asn) != 0 ||
+	     ckpt_put_str(&ck, a2t->tag) != 0 ||
+	     ckpt_put_u32(&ck, slist_count(sxes)) != 0)
+	    goto done;
+	  while((sx = slist_head_pop(sxes)) != NULL)
+	    if(ckpt_put_str(&ck, sx) != 0)
+	      goto done;
+	}
+    }
+  else if(ckpt_put_u8(&ck, 0) != 0)
+    goto done;
+
+  if(ckpt_put_u32(&ck, slist_count(domain_list)) != 0)
+    goto done;
+  for(sn=slist_head_node(domain_list); sn != NULL; sn=slist_node_next(sn))
+    {
+      dom = slist_node_item(sn);
+      if(ckpt_put_str(&ck, dom->domain) != 0 ||
+	 ckpt_put_u32(&ck, dom->ifacec) != 0 ||
+	 ckpt_put_u32(&ck, dom->tpmlen) != 0 ||
+	 ckpt_put_u32(&ck, slist_count(dom->regexes)) != 0)
+	goto done;
+      for(s2=slist_head_node(dom->regexes); s2 != NULL; s2=slist_node_next(s2))
+	if(ckpt_put_regex(&ck, slist_node_item(s2)) != 0)
+	  goto done;
+    }
+
+  len = strlen(ckpt_file) + 5;
+  if((tmp = malloc(len)) == NULL)
+    goto done;
+  snprintf(tmp, len, "%s.tmp", ckpt_file);
+  if((fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644)) == -1)
+    {
+      fprintf(stderr, "%s: could not open %s: %s\n",
+	      __func__, tmp, strerror(errno));
+      goto done;
+    }
+  if(write_wrap(fd, ck.buf, NULL, ck.off) != 0)
+    {
+      fprintf(stderr, "%s: could not write %s: %s\n",
+	      __func__, tmp, strerror(errno));
+      goto done;
+    }
+  close(fd); fd = -1;
+  if(rename(tmp, ckpt_file) != 0)
+    {
+      fprintf(stderr, "%s: could not rename %s: %s\n",
+	      __func__, tmp, strerror(errno));
+      goto done;
+    }
+
+  gettimeofday_wrap(&finish);
+  fprintf(stderr, "wrote stage %d checkpoint of %d bytes in %s\n",
+	  stage, (int)ck.off, duration_tostr(buf, sizeof(buf), &start, &finish));
+  rc = 0;
+
+ done:
+  if(fd != -1)
+    {
+      close(fd);
+      unlink(tmp);
+    }
+  if(tmp != NULL) free(tmp);
+  if(sxes != NULL) slist_free(sxes);
+  if(ck.buf != NULL) free(ck.buf);
+  return rc;
+}
+
+/*
+ * checkpoint_read_dict
+ *
+ * install the AS names dictionary recorded in the checkpoint, and infer
+ * which hostnames could embed an AS name using it.
+ */
+static int checkpoint_read_dict(sc_ckpt_t *ck)
+{
+  sc_as2tag_t *a2t = NULL, **a2ts = NULL;
+  sc_domain_t *dom;
+  uint32_t i, j, a2tc, sxc;
+  char *str = NULL;
+  size_t s;
+  int rc = -1;
+
+  if(ckpt_get_u32(ck, &a2tc) != 0)
+    goto done;
+  if(a2tc > 0 && (a2ts = malloc_zero(sizeof(sc_as2tag_t *) * a2tc)) == NULL)
+    goto done;
+  for(i=0; i<a2tc; i++)
+    {
+      if((a2t = malloc_zero(sizeof(sc_as2tag_t))) == NULL ||
+	 (a2t->sxes = splaytree_alloc((splaytree_cmp_t)strcmp)) == NULL ||
+	 ckpt_get_u32(ck, &a2t->asn) != 0 ||
+	 ckpt_get_str(ck, &a2t->tag) != 0 || a2t->tag == NULL ||
+	 ckpt_get_u32(ck, &sxc) != 0)
+	goto done;
+      for(j=0; j<sxc; j++)
+	{
+	  /* the suffixes refer to the domain strings */
+	  if(ckpt_get_str(ck, &str) != 0 || str == NULL)
+	    goto done;
+	  if((dom = sc_domain_find(str)) != NULL &&
+	     splaytree_insert(a2t->sxes, dom->domain) == NULL)
+	    goto done;
+	  free(str); str = NULL;
+	}
+      a2ts[i] = a2t; a2t = NULL;
+    }
+
+  /* replace the dictionary inferred from the training data */
+  if(tag2ass != NULL)
+    {
+      for(s=0; s<tag2asc; s++)
+	if(tag2ass[s] != NULL)
+	  sc_as2tag_free(tag2ass[s]);
+      free(tag2ass); tag2ass = NULL;
+    }
+  tag2ass = a2ts; a2ts = NULL;
+  tag2asc = a2tc;
+
+  if(tag2asc > 0)
+    sc_iface_asname_find_all();
+  rc = 0;
+
+ done:
+  if(str != NULL) free(str);
+  if(a2t != NULL) sc_as2tag_free(a2t);
+  if(a2ts != NULL)
+    {
+      for(i=0; i<a2tc; i++)
+	if(a2ts[i] != NULL)
+	  sc_as2tag_free(a2ts[i]);
+      free(a2ts);
+    }
+  return rc;
+}
+
+/*
+ * checkpoint_read
+ *
+ * load the regexes for each domain from a checkpoint, in place of
+ * generating and evaluating them.  the training data is loaded from
+ * the input files beforehand, so the checkpoint must have been made
+ * with the same input files and learning mode.
+ */
+static int checkpoint_read(void)
+{
+  struct timeval start, finish;
+  struct stat sb;
+  sc_ckpt_t ck;
+  sc_domain_t *dom;
+  sc_regex_t *re;
+  uint32_t u32, i, j, domc, regexc, ifacec, tpmlen, stage;
+  char *str = NULL, buf[32];
+  uint8_t learn, v, u8;
+  int fd = -1, rc = -1, regextot = 0;
+
+  gettimeofday_wrap(&start);
+  memset(&ck, 0, sizeof(ck));
+
+  if((fd = open(resume_file, O_RDONLY)) == -1 || fstat(fd, &sb) != 0)
+    {
+      fprintf(stderr, "%s: could not open %s: %s\n",
+	      __func__, resume_file, strerror(errno));
+      goto done;
+    }
+  if(sb.st_size < 8 || (ck.buf = malloc(sb.st_size)) == NULL ||
+     read_wrap(fd, ck.buf, NULL, sb.st_size) != 0)
+    {
+      fprintf(stderr, "%s: could not read %s\n", __func__, resume_file);
+      goto done;
+    }
+  ck.len = sb.st_size;
+  close(fd); fd = -1;
+
+  if(memcmp(ck.buf, CKPT_MAGIC, 8) != 0)
+    {
+      fprintf(stderr, "%s: %s is not a checkpoint\n", __func__, resume_file);
+      goto done;
+    }
+  ck.off = 8;
+  if(ckpt_get_u32(&ck, &u32) != 0 || u32 != CKPT_VERSION ||
+     ckpt_get_u8(&ck, &learn) != 0 || ckpt_get_u8(&ck, &v) != 0 ||
+     ckpt_get_u32(&ck, &u32) != 0 || ckpt_get_u32(&ck, &stage) != 0)
+    goto err;
+  if(learn != ckpt_learn() || v != ip_v)
+    {
+      fprintf(stderr, "%s: %s is for a different learning mode\n",
+	      __func__, resume_file);
+      goto done;
+    }
+  if(stage > (uint32_t)stop_id)
+    {
+      fprintf(stderr, "%s: %s is for stage %u, beyond stop id %d\n",
+	      __func__, resume_file, stage, stop_id);
+      goto done;
+    }
+
+  if(ckpt_get_u8(&ck, &u8) != 0 ||
+     (u8 != 0 && checkpoint_read_dict(&ck) != 0) ||
+     ckpt_get_u32(&ck, &domc) != 0)
+    goto err;
+  if(domc != (uint32_t)slist_count(domain_list))
+    {
+      fprintf(stderr, "%s: %s has %u domains, expected %d\n",
+	      __func__, resume_file, domc, slist_count(domain_list));
+      goto done;
+    }
+
+  for(i=0; i<domc; i++)
+    {
+      if(ckpt_get_str(&ck, &str) != 0 || str == NULL ||
+	 ckpt_get_u32(&ck, &ifacec) != 0 || ckpt_get_u32(&ck, &tpmlen) != 0 ||
+	 ckpt_get_u32(&ck, &regexc) != 0)
+	goto err;
+      if((dom = sc_domain_find(str)) == NULL ||
+	 dom->ifacec != ifacec || dom->tpmlen != tpmlen)
+	{
+	  fprintf(stderr, "%s: %s does not match training data for %s\n",
+		  __func__, resume_file, str);
+	  goto done;
+	}
+      free(str); str = NULL;
+
+      for(j=0; j<regexc; j++)
+	{
+	  if((re = ckpt_get_regex(&ck, dom)) == NULL)
+	    goto err;
+	  if(slist_tail_push(dom->regexes, re) == NULL)
+	    {
+	      sc_regex_free(re);
+	      goto done;
+	    }
+	  regextot++;
+	}
+    }
+
+  if(ck.off != ck.len)
+    goto err;
+
+  resume_id = (int)stage;
+  gettimeofday_wrap(&finish);
+  fprintf(stderr, "resumed %d regexes from stage %d in %s\n", regextot,
+	  resume_id, duration_tostr(buf, sizeof(buf), &start, &finish));
+  rc = 0;
+  goto done;
+
+ err:
+  fprintf(stderr, "%s: %s is malformed\n", __func__, resume_file);
+
+ done:
+  if(fd != -1) close(fd);
+  if(str != NULL) free(str);
+  if(ck.buf != NULL) free(ck.buf);
+  return rc;
+}
+
 static void cleanup(void)
 {
   size_t i;
@@ -22466,27 +23609,40 @@ int main(int argc, char *argv[])
   if(do_loadonly != 0)
     return 0;
 
-  /* generate regular expressions */
-  if(generate_regexes() != 0)
-    return -1;
+  if(resume_file != NULL)
+    {
+      /* resume from the regexes saved in a checkpoint */
+      if(checkpoint_read() != 0)
+	return -1;
+    }
+  else
+    {
+      /* generate regular expressions */
+      if(generate_regexes() != 0)
+	return -1;
 
-  /* evaluate regular expressions */
-  if(eval_regexes() != 0)
-    return -1;
+      /* evaluate regular expressions */
+      if(eval_regexes() != 0)
+	return -1;
+
+      if(checkpoint_write(0) != 0)
+	return -1;
+    }
 
   if(do_learnasn != 0)
     {
-      for(j=1; j<=stop_id; j++)
+      for(j=resume_id+1; j<=stop_id; j++)
 	{
 	  if(j == 1)      { if(refine_regexes_merge() != 0) return -1; }
 	  else if(j == 2) { if(refine_regexes_class() != 0) return -1; }
 	  else if(j == 3) { if(refine_regexes_merge() != 0) return -1; }
 	  else if(j == 4) { if(refine_regexes_sets() != 0) return -1; }
+	  if(checkpoint_write(j) != 0) return -1;
 	}
     }
   else if(do_learnasnames != 0)
     {
-      for(j=1; j<=stop_id; j++)
+      for(j=resume_id+1; j<=stop_id; j++)
 	{
 	  if(j == 1)      { if(refine_regexes_merge() != 0) return -1; }
 	  else if(j == 2) { if(refine_dict_asnames() != 0) return -1; }
@@ -22494,11 +23650,12 @@ int main(int argc, char *argv[])
 	  else if(j == 4) { if(refine_regexes_merge() != 0) return -1; }
 	  else if(j == 5) { if(refine_regexes_sets() != 0) return -1; }
 	  else if(j == 6) { if(refine_regexes_ip() != 0) return -1; }
+	  if(checkpoint_write(j) != 0) return -1;
 	}
     }
   else if(do_learngeo != 0)
     {
-      for(j=1; j<=stop_id; j++)
+      for(j=resume_id+1; j<=stop_id; j++)
 	{
 	  if(j == 1)      { if(refine_regexes_merge() != 0) return -1; }
 	  else if(j == 2) { if(refine_regexes_class() != 0) return -1; }
@@ -22506,11 +23663,12 @@ int main(int argc, char *argv[])
 	  else if(j == 4) { if(refine_regexes_sets() != 0) return -1; }
 	  else if(j == 5) { if(refine_dict_geo() != 0) return -1; }
 	  else if(j == 6) { if(refine_regexes_fp() != 0) return -1; }
+	  if(checkpoint_write(j) != 0) return -1;
 	}
     }
   else if(do_learnalias != 0)
     {
-      for(j=1; j<=stop_id; j++)
+      for(j=resume_id+1; j<=stop_id; j++)
 	{
 	  if(j == 1)
 	    {
@@ -22524,6 +23682,7 @@ int main(int argc, char *argv[])
 	  else if(j == 6) { if(refine_regexes_sets() != 0) return -1; }
 	  else if(j == 7) { if(refine_regexes_ip() != 0) return -1; }
 	  else if(j == 8) { if(refine_regexes_fp() != 0) return -1; }
+	  if(checkpoint_write(j) != 0) return -1;
 	}
     }
 
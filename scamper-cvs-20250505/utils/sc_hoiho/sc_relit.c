@@ -0,0 +1,255 @@
+/*
+ * sc_relit.c
+ *
+ * $Id$
+ *
+ * extract the literal strings that any string matching a regex must
+ * contain, so that sc_hoiho only has to run the regex against
+ * hostnames that contain them.
+ *
+ * Copyright (C) 2025 The Regents of the University of California
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include "internal.h"
+
+#include "sc_relit.h"
+
+static void sc_relit_end(sc_relit_t *rl, int req)
+{
+  if(req != 0 && rl->curl > 0 && rl->litc < RELIT_MAX)
+    {
+      memcpy(rl->lits[rl->litc], rl->cur, rl->curl);
+      rl->lits[rl->litc][rl->curl] = '\0';
+      rl->lens[rl->litc] = rl->curl;
+      rl->litc++;
+    }
+  rl->curl = 0;
+  return;
+}
+
+static void sc_relit_add(sc_relit_t *rl, char c, int req)
+{
+  if(rl->curl == sizeof(rl->cur) - 1)
+    sc_relit_end(rl, req);
+  rl->cur[rl->curl++] = c;
+  return;
+}
+
+/*
+ * sc_relit_class
+ *
+ * skip over the character class that opens at str[*i].  on return,
+ * *i is the index of the closing ']'.  returns -1 if the class is not
+ * closed.
+ */
+static int sc_relit_class(const char *str, size_t *i)
+{
+  size_t x = *i;
+
+  assert(str[x] == '[');
+  x++;
+  if(str[x] == '^') x++;
+  if(str[x] == ']') x++;
+  while(str[x] != '\0' && str[x] != ']')
+    {
+      if(str[x] == '\\' && str[x+1] != '\0')
+	x++;
+      x++;
+    }
+  if(str[x] == '\0')
+    return -1;
+
+  *i = x;
+  return 0;
+}
+
+/*
+ * sc_relit_group
+ *
+ * determine if the group that opens at str[i] must be matched,
+ * i.e., it is not followed by a quantifier that allows it to be
+ * skipped, and it does not contain alternatives.
+ */
+static int sc_relit_group(const char *str, size_t i)
+{
+  int depth = 0, alt = 0;
+
+  assert(str[i] == '(');
+  while(str[i] != '\0')
+    {
+      if(str[i] == '\\')
+	{
+	  if(str[++i] == '\0')
+	    return 0;
+	}
+      else if(str[i] == '[')
+	{
+	  if(sc_relit_class(str, &i) != 0)
+	    return 0;
+	}
+      else if(str[i] == '(')
+	depth++;
+      else if(str[i] == ')')
+	{
+	  if(--depth == 0)
+	    break;
+	}
+      else if(str[i] == '|' && depth == 1)
+	alt = 1;
+      i++;
+    }
+
+  if(str[i] != ')' || alt != 0 ||
+     str[i+1] == '?' || str[i+1] == '*' || str[i+1] == '{')
+    return 0;
+  return 1;
+}
+
+/*
+ * sc_relit_get
+ *
+ * extract the literal strings that any string matching the regex must
+ * contain.  the parse is conservative: a literal is only recorded if
+ * it is not optional, not part of an alternation, and the regex only
+ * uses constructs that we understand.
+ */
+void sc_relit_get(const char *str, sc_relit_t *rl)
+{
+  uint8_t req[16];
+  int depth = 0, r = 1;
+  size_t i;
+  char c;
+
+  memset(rl, 0, sizeof(sc_relit_t));
+
+  /*
+   * an alternation outside of a group means nothing is required.
+   * parentheses and '|' inside a character class are literals.
+   */
+  for(i=0; str[i] != '\0'; i++)
+    {
+      if(str[i] == '\\' && str[i+1] != '\0')
+	i++;
+      else if(str[i] == '[')
+	{
+	  if(sc_relit_class(str, &i) != 0)
+	    return;
+	}
+      else if(str[i] == '(')
+	depth++;
+      else if(str[i] == ')')
+	depth--;
+      else if(str[i] == '|' && depth == 0)
+	return;
+    }
+  depth = 0;
+
+  i = 0;
+  while(str[i] != '\0')
+    {
+      c = str[i];
+      if(c == '\\')
+	{
+	  c = str[i+1];
+	  if(c != '\0' && strchr("dDwWsSbB", c) != NULL)
+	    {
+	      sc_relit_end(rl, r);
+	      i += 2;
+	      continue;
+	    }
+	  /* back references, hex escapes, etc */
+	  if(c == '\0' || isalnum((unsigned char)c))
+	    goto err;
+	  i += 2;
+	}
+      else if(c == '[')
+	{
+	  sc_relit_end(rl, r);
+	  if(sc_relit_class(str, &i) != 0)
+	    goto err;
+	  i++;
+	  continue;
+	}
+      else if(c == '(')
+	{
+	  /* other than capturing groups, only allow non-capturing groups */
+	  sc_relit_end(rl, r);
+	  if((str[i+1] == '?' && str[i+2] != ':') || depth == sizeof(req))
+	    goto err;
+	  req[depth++] = r;
+	  if(r != 0)
+	    r = sc_relit_group(str, i);
+	  i += (str[i+1] == '?') ? 3 : 1;
+	  continue;
+	}
+      else if(c == ')')
+	{
+	  sc_relit_end(rl, r);
+	  if(depth == 0)
+	    goto err;
+	  r = req[--depth];
+	  i++;
+	  continue;
+	}
+      else if(c == '?' || c == '*' || c == '+')
+	{
+	  sc_relit_end(rl, r);
+	  i++;
+	  continue;
+	}
+      else if(c == '{')
+	{
+	  sc_relit_end(rl, r);
+	  while(str[i] != '\0' && str[i] != '}')
+	    i++;
+	  if(str[i] == '\0')
+	    goto err;
+	  i++;
+	  continue;
+	}
+      else if(c == '^' || c == '$' || c == '.' || c == '|')
+	{
+	  sc_relit_end(rl, r);
+	  i++;
+	  continue;
+	}
+      else i++;
+
+      /*
+       * c is a literal character.  if it is optional, it ends the
+       * current literal.  if it can repeat, it ends the literal after
+       * the character.
+       */
+      if(str[i] == '?' || str[i] == '*' || str[i] == '{')
+	{
+	  sc_relit_end(rl, r);
+	  continue;
+	}
+      sc_relit_add(rl, c, r);
+      if(str[i] == '+')
+	sc_relit_end(rl, r);
+    }
+  sc_relit_end(rl, r);
+  return;
+
+ err:
+  rl->litc = 0;
+  return;
+}
@@ -0,0 +1,43 @@
+/*
+ * sc_relit.h
+ *
+ * $Id$
+ *
+ * Copyright (C) 2025 The Regents of the University of California
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef __SC_RELIT_H
+#define __SC_RELIT_H
+
+/*
+ * sc_relit_t
+ *
+ * literal strings that any string matching a regex must contain.
+ */
+#define RELIT_MAX 8
+typedef struct sc_relit
+{
+  char            lits[RELIT_MAX][64];
+  size_t          lens[RELIT_MAX];
+  int             litc;
+  char            cur[64];
+  size_t          curl;
+} sc_relit_t;
+
+void sc_relit_get(const char *str, sc_relit_t *rl);
+
+#endif /* __SC_RELIT_H */
@@ -30,13 +30,18 @@
 #endif
 #include "internal.h"
 
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
 #include "scamper_list.h"
 #include "scamper_addr.h"
 #include "scamper_file.h"
 #include "ping/scamper_ping.h"
 #include "dealias/scamper_dealias.h"
 #include "trace/scamper_trace.h"
-#include "mjl_list.h"
+#include "mjl_heap.h"
+#include "mjl_threadpool.h"
 #include "utils.h"
 
 typedef struct ipid_sample
@@ -46,8 +51,27 @@ typedef struct ipid_sample
   struct timeval  tx;
   struct timeval  rx;
   uint32_t        ipid;
+  size_t          seq;
 } ipid_sample_t;
 
+/*
+ * ipid_run
+ *
+ * the samples from one input file, which are sorted by the thread that
+ * decodes the file, and then merged with the samples from the others.
+ */
+typedef struct ipid_run
+{
+  const char     *name;
+  scamper_file_t *file;
+  int             id;
+  int             rc;
+  ipid_sample_t  *samples;
+  size_t          samplec;
+  size_t          samplem;
+  size_t          i;
+} ipid_run_t;
+
 /* file filter */
 static scamper_file_filter_t *filter;
 
@@ -55,8 +79,13 @@ static scamper_file_filter_t *filter;
 static char **filelist = NULL;
 static int    filelist_len = 0;
 
-/* the list of ipid samples to record */
-static slist_t *list = NULL;
+/* the samples from each input file */
+static ipid_run_t *runs = NULL;
+static int         runc = 0;
+
+#ifdef HAVE_PTHREAD
+static long        threadc = 0;
+#endif
 
 /* the userids to select on */
 static uint32_t *userids = 0;
@@ -73,14 +102,25 @@ static uint8_t flags = 0;
 #define OPT_USERID  0x0001
 #define OPT_IP      0x0002
 #define OPT_OPTIONS 0x0004
+#define OPT_THREADC 0x0008
 
 static void usage(uint32_t opt_mask)
 {
+  const char *j = "";
+
+#ifdef HAVE_PTHREAD
+  j = " [-j threadc]";
+#endif
+
   fprintf(stderr,
-	  "usage: sc_ipiddump [-?] [-i ips] [-O options] [-U userids]\n"
-	  "          <file.warts>\n");
+	  "usage: sc_ipiddump [-?] [-i ips]%s [-O options] [-U userids]\n"
+	  "          <file.warts>\n", j);
   if(opt_mask & OPT_IP)
     fprintf(stderr, "      -i IP address to filter\n");
+#ifdef HAVE_PTHREAD
+  if(opt_mask & OPT_THREADC)
+    fprintf(stderr, "      -j number of files to decode in parallel\n");
+#endif
   if(opt_mask & OPT_OPTIONS)
     fprintf(stderr, "      -O options [notrace]\n");
   if(opt_mask & OPT_USERID)
@@ -123,10 +163,19 @@ static int check_options(int argc, char *argv[])
   scamper_addr_t *addr_a[256], *addr;
   uint32_t u32_a[256];
   int ch, rc = -1; long lo;
-  char *opts = "?i:O:U:";
+  char opts[16];
   char *opt_userid = NULL, *opt_ips = NULL;
   char *str, *next;
-  size_t i, x;
+  size_t i, x, off = 0;
+
+#ifdef HAVE_PTHREAD
+  char *opt_threadc = NULL;
+#endif
+
+  string_concat(opts, sizeof(opts), &off, "?i:O:U:");
+#ifdef HAVE_PTHREAD
+  string_concat(opts, sizeof(opts), &off, "j:");
+#endif
 
   while((ch = getopt(argc, argv, opts)) != -1)
     {
@@ -141,6 +190,12 @@ static int check_options(int argc, char *argv[])
 	  opt_ips = strdup(optarg);
 	  break;
 
+#ifdef HAVE_PTHREAD
+	case 'j':
+	  opt_threadc = optarg;
+	  break;
+#endif
+
 	case 'O':
 	  if(strcasecmp(optarg, "notrace") == 0)
 	    flags |= FLAG_NOTRACE;
@@ -167,6 +222,18 @@ static int check_options(int argc, char *argv[])
 	}
     }
 
+#ifdef HAVE_PTHREAD
+  if(opt_threadc != NULL)
+    {
+      if(string_tolong(opt_threadc, &lo) != 0 || lo < 0)
+	{
+	  usage(OPT_THREADC);
+	  goto done;
+	}
+      threadc = lo;
+    }
+#endif
+
   if((str = opt_userid) != NULL)
     {
       x = 0;
@@ -242,9 +309,26 @@ static int check_options(int argc, char *argv[])
   return rc;
 }
 
-static int ipid_sample_cmp(const ipid_sample_t *a, const ipid_sample_t *b)
+static int ipid_sample_cmp(const void *va, const void *vb)
 {
-  return timeval_cmp(&a->tx, &b->tx);
+  const ipid_sample_t *a = va, *b = vb;
+  int rc;
+  if((rc = timeval_cmp(&a->tx, &b->tx)) != 0)
+    return rc;
+  if(a->seq < b->seq) return -1;
+  if(a->seq > b->seq) return  1;
+  return 0;
+}
+
+/* the heap returns the run with the earliest sample */
+static int ipid_run_cmp(const ipid_run_t *a, const ipid_run_t *b)
+{
+  int rc;
+  if((rc = timeval_cmp(&b->samples[b->i].tx, &a->samples[a->i].tx)) != 0)
+    return rc;
+  if(a->id < b->id) return  1;
+  if(a->id > b->id) return -1;
+  return 0;
 }
 
 static char *ipid_sample_ipid(const ipid_sample_t *sample,char *buf,size_t len)
@@ -256,19 +340,40 @@ static char *ipid_sample_ipid(const ipid_sample_t *sample,char *buf,size_t len)
   return buf;
 }
 
+/*
+ * ipid_sample_get
+ *
+ * return space for another sample at the end of the run's array.
+ */
+static ipid_sample_t *ipid_sample_get(ipid_run_t *run)
+{
+  ipid_sample_t *sample;
+  size_t m;
+
+  if(run->samplec == run->samplem)
+    {
+      m = run->samplem == 0 ? 1024 : run->samplem * 2;
+      if(realloc_wrap((void **)&run->samples, sizeof(ipid_sample_t) * m) != 0)
+	return NULL;
+      run->samplem = m;
+    }
+
+  sample = &run->samples[run->samplec];
+  memset(sample, 0, sizeof(ipid_sample_t));
+  sample->seq = run->samplec;
+  return sample;
+}
+
 static void ipid_sample_free(ipid_sample_t *sample)
 {
-  if(sample == NULL)
-    return;
   if(sample->addr != NULL)
     scamper_addr_free(sample->addr);
   if(sample->probe_src != NULL)
     scamper_addr_free(sample->probe_src);
-  free(sample);
   return;
 }
 
-static int process_dealias(scamper_dealias_t *dealias)
+static int process_dealias(ipid_run_t *run, scamper_dealias_t *dealias)
 {
   const scamper_dealias_probe_t *probe;
   const scamper_dealias_reply_t *reply;
@@ -301,7 +406,7 @@ static int process_dealias(scamper_dealias_t *dealias)
 	  else
 	    continue;
 
-	  if((sample = malloc_zero(sizeof(ipid_sample_t))) == NULL)
+	  if((sample = ipid_sample_get(run)) == NULL)
 	    goto err;
 	  def = scamper_dealias_probe_def_get(probe);
 	  def_src = scamper_dealias_probedef_src_get(def);
@@ -310,9 +415,7 @@ static int process_dealias(scamper_dealias_t *dealias)
 	  sample->ipid = u32;
 	  timeval_cpy(&sample->tx, scamper_dealias_probe_tx_get(probe));
 	  timeval_cpy(&sample->rx, scamper_dealias_reply_rx_get(reply));
-
-	  if(slist_tail_push(list, sample) == NULL)
-	    goto err;
+	  run->samplec++;
 	}
     }
 
@@ -325,7 +428,7 @@ static int process_dealias(scamper_dealias_t *dealias)
   return -1;
 }
 
-static int process_ping(scamper_ping_t *ping)
+static int process_ping(ipid_run_t *run, scamper_ping_t *ping)
 {
   const scamper_ping_probe_t *probe;
   const scamper_ping_reply_t *reply;
@@ -362,16 +465,14 @@ static int process_ping(scamper_ping_t *ping)
 	  else
 	    continue;
 
-	  if((sample = malloc_zero(sizeof(ipid_sample_t))) == NULL)
+	  if((sample = ipid_sample_get(run)) == NULL)
 	    goto err;
 	  sample->probe_src = scamper_addr_use(scamper_ping_src_get(ping));
 	  sample->addr = scamper_addr_use(r_addr);
 	  sample->ipid = u32;
 	  timeval_cpy(&sample->tx, tx);
 	  timeval_add_tv3(&sample->rx, tx, scamper_ping_reply_rtt_get(reply));
-
-	  if(slist_tail_push(list, sample) == NULL)
-	    goto err;
+	  run->samplec++;
 	}
     }
 
@@ -384,7 +485,7 @@ static int process_ping(scamper_ping_t *ping)
   return -1;
 }
 
-static int process_trace(scamper_trace_t *trace)
+static int process_trace(ipid_run_t *run, scamper_trace_t *trace)
 {
   scamper_trace_hopiter_t *hi = NULL;
   const scamper_trace_probe_t *probe;
@@ -420,7 +521,7 @@ static int process_trace(scamper_trace_t *trace)
       if(ipc > 0 && ip_find(ips, ipc, hop_addr) == 0)
 	continue;
 
-      if((sample = malloc_zero(sizeof(ipid_sample_t))) == NULL)
+      if((sample = ipid_sample_get(run)) == NULL)
 	goto done;
       sample->probe_src = scamper_addr_use(src_addr);
       sample->addr = scamper_addr_use(hop_addr);
@@ -428,9 +529,7 @@ static int process_trace(scamper_trace_t *trace)
       timeval_cpy(&sample->tx, tv);
       tv = scamper_trace_reply_rtt_get(hop);
       timeval_add_tv3(&sample->rx, &sample->tx, tv);
-
-      if(slist_tail_push(list, sample) == NULL)
-	goto done;
+      run->samplec++;
     }
 
   rc = 0;
@@ -441,33 +540,105 @@ static int process_trace(scamper_trace_t *trace)
   return rc;
 }
 
-static void process(scamper_file_t *file)
+/*
+ * process
+ *
+ * decode the samples from a file and sort them.  this function may be
+ * run by a thread, so it only uses the run passed to it.
+ */
+static void process(ipid_run_t *run)
 {
   void *data;
   uint16_t type;
+  int rc = 0;
 
-  while(scamper_file_read(file, filter, &type, &data) == 0)
+  while(rc == 0 && scamper_file_read(run->file, filter, &type, &data) == 0)
     {
       if(data == NULL) break; /* EOF */
       if(type == SCAMPER_FILE_OBJ_PING)
-	process_ping(data);
+	rc = process_ping(run, data);
       else if(type == SCAMPER_FILE_OBJ_DEALIAS)
-	process_dealias(data);
+	rc = process_dealias(run, data);
       else if(type == SCAMPER_FILE_OBJ_TRACE)
-	process_trace(data);
+	rc = process_trace(run, data);
     }
-  scamper_file_close(file);
+  scamper_file_close(run->file);
+  run->file = NULL;
+
+  if(run->samplec > 1)
+    qsort(run->samples, run->samplec, sizeof(ipid_sample_t), ipid_sample_cmp);
+  run->rc = rc;
   return;
 }
 
+/*
+ * dump
+ *
+ * print the samples from all files in order of transmit time, merging
+ * the sorted runs.
+ */
+static int dump(void)
+{
+  char probe_src[128], addr[128], ipid[10];
+  ipid_sample_t *sample;
+  ipid_run_t *run;
+  heap_t *heap;
+  int i, rc = -1;
+
+  if((heap = heap_alloc((heap_cmp_t)ipid_run_cmp)) == NULL)
+    return -1;
+
+  for(i=0; i<runc; i++)
+    {
+      if(runs[i].samplec > 0 && heap_insert(heap, &runs[i]) == NULL)
+	goto done;
+    }
+
+  while((run = heap_remove(heap)) != NULL)
+    {
+      sample = &run->samples[run->i];
+      printf("%d.%06d %d.%06d %s %s %s\n",
+	     (int)sample->tx.tv_sec, (int)sample->tx.tv_usec,
+	     (int)sample->rx.tv_sec, (int)sample->rx.tv_usec,
+	     scamper_addr_tostr(sample->probe_src,probe_src,sizeof(probe_src)),
+	     scamper_addr_tostr(sample->addr, addr, sizeof(addr)),
+	     ipid_sample_ipid(sample, ipid, sizeof(ipid)));
+      if(++run->i < run->samplec && heap_insert(heap, run) == NULL)
+	goto done;
+    }
+
+  rc = 0;
+
+ done:
+  heap_free(heap, NULL);
+  return rc;
+}
+
 static void cleanup(void)
 {
+  size_t j;
   int i;
 
-  if(list != NULL)
+  if(runs != NULL)
+    {
+      for(i=0; i<runc; i++)
+	{
+	  if(runs[i].file != NULL)
+	    scamper_file_close(runs[i].file);
+	  if(runs[i].samples == NULL)
+	    continue;
+	  for(j=0; j<runs[i].samplec; j++)
+	    ipid_sample_free(&runs[i].samples[j]);
+	  free(runs[i].samples);
+	}
+      free(runs);
+      runs = NULL;
+    }
+
+  if(filter != NULL)
     {
-      slist_free_cb(list, (slist_free_t)ipid_sample_free);
-      list = NULL;
+      scamper_file_filter_free(filter);
+      filter = NULL;
     }
 
   if(userids != NULL)
@@ -490,10 +661,9 @@ static void cleanup(void)
 
 int main(int argc, char *argv[])
 {
+  threadpool_t *tp = NULL;
   scamper_file_t *file;
-  ipid_sample_t *sample;
   uint16_t types[3];
-  char probe_src[128], addr[128], ipid[10];
   int i, typec, stdin_used = 0;
 
 #if defined(DMALLOC)
@@ -520,7 +690,7 @@ int main(int argc, char *argv[])
   if((filter = scamper_file_filter_alloc(types, typec)) == NULL)
     return -1;
 
-  if((list = slist_alloc()) == NULL)
+  if((runs = malloc_zero(sizeof(ipid_run_t) * filelist_len)) == NULL)
     return -1;
 
   for(i=0; i<filelist_len; i++)
@@ -541,25 +711,57 @@ int main(int argc, char *argv[])
 	}
 
       if(file == NULL)
-	fprintf(stderr, "unable to open %s\n", filelist[i]);
-      else
-	process(file);
+	{
+	  fprintf(stderr, "unable to open %s\n", filelist[i]);
+	  continue;
+	}
+
+      runs[runc].name = filelist[i];
+      runs[runc].file = file;
+      runs[runc].id = runc;
+      runc++;
     }
 
-  scamper_file_filter_free(filter);
+  /* decode the files in parallel, if we have been asked to */
+#ifdef HAVE_PTHREAD
+  if(threadc > 0 && runc > 1)
+    {
+      if((tp = threadpool_alloc(threadc)) == NULL)
+	{
+	  fprintf(stderr, "could not allocate %ld threads\n", threadc);
+	  return -1;
+	}
+      for(i=0; i<runc; i++)
+	{
+	  if(threadpool_tail_push(tp, (threadpool_func_t)process,
+				  &runs[i]) != 0)
+	    {
+	      fprintf(stderr, "could not push %s\n", runs[i].name);
+	      threadpool_join(tp);
+	      return -1;
+	    }
+	}
+      threadpool_join(tp);
+    }
+#endif
 
-  slist_qsort(list, (slist_cmp_t)ipid_sample_cmp);
-  while((sample = slist_head_pop(list)) != NULL)
+  if(tp == NULL)
     {
-      printf("%d.%06d %d.%06d %s %s %s\n",
-	     (int)sample->tx.tv_sec, (int)sample->tx.tv_usec,
-	     (int)sample->rx.tv_sec, (int)sample->rx.tv_usec,
-	     scamper_addr_tostr(sample->probe_src,probe_src,sizeof(probe_src)),
-	     scamper_addr_tostr(sample->addr, addr, sizeof(addr)),
-	     ipid_sample_ipid(sample, ipid, sizeof(ipid)));
-      ipid_sample_free(sample);
+      for(i=0; i<runc; i++)
+	process(&runs[i]);
     }
-  slist_free(list); list = NULL;
+
+  for(i=0; i<runc; i++)
+    {
+      if(runs[i].rc != 0)
+	{
+	  fprintf(stderr, "could not process %s\n", runs[i].name);
+	  return -1;
+	}
+    }
+
+  if(dump() != 0)
+    return -1;
 
   return 0;
 }
@@ -62,6 +62,10 @@
 #define FLAG_FIRST     0x01
 #define FLAG_RANDOM    0x02
 #define FLAG_NOSHUFFLE 0x04
+#define FLAG_RING      0x08
+
+/* size of the result ring to ask a local scamper for */
+#define RING_SIZE      (4 * 1024 * 1024)
 
 static uint32_t                options       = 0;
 static uint8_t                 flags         = 0;
@@ -160,6 +164,7 @@ static void usage(uint32_t opt_mask)
       fprintf(stderr, "        first: probe first address in prefix\n");
       fprintf(stderr, "        random: probe random address in prefix\n");
       fprintf(stderr, "        noshuffle: do not shuffle probe order\n");
+      fprintf(stderr, "        ring: receive results from scamper in shared memory\n");
 #ifdef HAVE_ZLIB
       fprintf(stderr, "        warts.gz: compress warts output using gzip compression\n");
 #endif
@@ -335,6 +340,8 @@ static int check_options(int argc, char *argv[])
 	    flags |= FLAG_RANDOM;
 	  else if(strcasecmp(optarg, "noshuffle") == 0)
 	    flags |= FLAG_NOSHUFFLE;
+	  else if(strcasecmp(optarg, "ring") == 0)
+	    flags |= FLAG_RING;
 	  else if(strcasecmp(optarg, "gz") == 0 ||
 		  strcasecmp(optarg, "warts.gz") == 0)
 	    opt_outtype = "warts.gz";
@@ -443,7 +450,7 @@ static int check_options(int argc, char *argv[])
       scamper_port = lo;
     }
 
-  if(flags == 0)
+  if((flags & ~FLAG_RING) == 0)
     {
       usage(OPT_OPTIONS);
       goto done;
@@ -485,13 +492,19 @@ static int check_options(int argc, char *argv[])
       duration = (uint32_t)lo;
     }
 
-  if(list != NULL)
+  if(list != NULL || (flags & FLAG_RING) != 0)
     {
       if((scamper_attp = scamper_attp_alloc()) == NULL)
 	{
 	  usage(OPT_LIST);
 	  goto done;
 	}
+      if((flags & FLAG_RING) != 0)
+	scamper_attp_ring_set(scamper_attp, RING_SIZE);
+    }
+
+  if(list != NULL)
+    {
       while((opt = slist_head_pop(list)) != NULL)
 	{
 	  if((dup = strdup(opt)) == NULL ||
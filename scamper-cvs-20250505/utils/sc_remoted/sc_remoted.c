@@ -278,6 +278,17 @@
 #include "utils_tls.h"
 #endif
 
+/*
+ * TLS sessions can be terminated on worker threads when we have
+ * pthreads, epoll, and an OpenSSL that is thread-safe without locking
+ * callbacks (1.1.0 and later, which have OPENSSL_thread_stop)
+ */
+#if defined(HAVE_OPENSSL) && defined(HAVE_PTHREAD) && defined(HAVE_EPOLL) && \
+  defined(HAVE_OPENSSL_THREAD_STOP)
+#include <pthread.h>
+#define HAVE_TLSTHREADS
+#endif
+
 #define SC_MESSAGE_HDRLEN 10 /* sequence:4 + channel_id:4 + msglen:2 */
 
 /*
@@ -336,10 +347,88 @@ typedef struct sc_fd
 #define FD_TYPE_ONECHAN_UNIX 3
 #define FD_TYPE_MUX_ACCEPT   4
 #define FD_TYPE_MUX          5
+#define FD_TYPE_TLSWAKE      6
 
 #define FD_FLAG_READ        0x1
 #define FD_FLAG_WRITE       0x2
 
+#ifdef HAVE_TLSTHREADS
+/*
+ * sc_tlsbuf_t
+ *
+ * a chunk of plaintext passed between the coordinator and a TLS worker.
+ */
+typedef struct sc_tlsbuf
+{
+  uint8_t            *data;
+  size_t              len;
+} sc_tlsbuf_t;
+
+/*
+ * sc_tlsworker_t
+ *
+ * a thread that terminates TLS sessions for a subset of the remote
+ * scamper instances.  the mutex protects the todo and done lists, as
+ * well as the queues, flags, and reference count of each link
+ * assigned to the worker.
+ */
+typedef struct sc_tlsworker
+{
+  pthread_t           tid;
+  pthread_mutex_t     mutex;
+  int                 epfd;        /* worker's epoll set */
+  int                 wake[2];     /* coordinator --> worker */
+  dlist_t            *todo;        /* links with work for the worker */
+  dlist_t            *done;        /* links with work for the coordinator */
+  dlist_t            *work;        /* todo links being processed */
+  uint8_t             txbuf[TLS_RECORD_LEN]; /* plaintext to encrypt */
+  size_t              txoff;
+  int                 linkc;       /* links assigned, coordinator only */
+  uint8_t             started;
+  uint8_t             stop;
+} sc_tlsworker_t;
+
+/*
+ * sc_tlslink_t
+ *
+ * the socket and TLS session of a remote scamper instance that is
+ * terminated on a worker thread.  fd, ssl, the BIOs, wb, mode,
+ * events, dead, and flush belong to the worker, and master belongs to
+ * the coordinator.  cert is set by the worker before it passes any
+ * plaintext to the coordinator.
+ */
+typedef struct sc_tlslink
+{
+  sc_tlsworker_t     *worker;
+  struct sc_master   *master;
+  int                 fd;
+  SSL                *ssl;
+  BIO                *rbio;
+  BIO                *wbio;
+  X509               *cert;
+  scamper_writebuf_t *wb;          /* ciphertext towards scamper */
+  dlist_node_t       *tnode;       /* node in worker->todo */
+  dlist_node_t       *dnode;       /* node in worker->done */
+  uint8_t             mode;        /* SSL_MODE_ACCEPT, ESTABLISHED */
+  uint8_t             events;      /* events registered with epoll */
+  uint8_t             dead;        /* fd removed from epoll */
+  uint8_t             flush;       /* close once wb is empty */
+
+  slist_t            *tx;          /* plaintext towards scamper */
+  slist_t            *rx;          /* plaintext from scamper */
+  uint8_t             flags;       /* TLSLINK_FLAG_* */
+  uint8_t             refcnt;      /* coordinator, worker */
+  char                err[64];     /* why the worker closed the link */
+} sc_tlslink_t;
+
+#define TLSLINK_FLAG_TODO   0x01 /* link is on worker->todo */
+#define TLSLINK_FLAG_DONE   0x02 /* link is on worker->done */
+#define TLSLINK_FLAG_FLUSH  0x04 /* close link once tx has been written */
+#define TLSLINK_FLAG_CLOSE  0x08 /* coordinator has detached from link */
+#define TLSLINK_FLAG_EOF    0x10 /* worker has closed the link */
+#define TLSLINK_FLAG_ERR    0x20 /* worker closed link due to TLS error */
+#endif
+
 /*
  * sc_master_t
  *
@@ -367,6 +456,16 @@ typedef struct sc_master
   SSL                *inet_ssl;
   BIO                *inet_rbio;
   BIO                *inet_wbio;
+  uint8_t             inet_txbuf[TLS_RECORD_LEN]; /* plaintext to encrypt */
+  size_t              inet_txoff;
+#endif
+
+#ifdef HAVE_TLSTHREADS
+  sc_tlslink_t       *inet_link;   /* TLS terminated on a worker thread */
+#endif
+
+#ifdef HAVE_ZLIB
+  z_stream           *inet_zs;     /* decompresses channel messages */
 #endif
 
   struct timeval      arrival;
@@ -486,6 +585,7 @@ typedef struct sc_message
 #endif
 #define OPT_METADATA 0x2000
 #define OPT_MUXSOCK 0x4000
+#define OPT_TLSTHREADS 0x8000
 #define OPT_ALL     0xffff
 
 #define FLAG_DEBUG      0x0001 /* verbose debugging */
@@ -516,6 +616,8 @@ typedef struct sc_message
 #define CONTROL_MASTER_REJ   7 /* scamper <-- remoted */
 #define CONTROL_MASTER_OK    8 /* scamper <-- remoted */
 
+#define CONTROL_OPT_ZLIB     0x01 /* compress channel messages */
+
 #define MUX_HDRLEN             8 /* channel_id:4 + msglen:4 */
 
 #define MUX_VP_UPDATE          0 /* remoted --> client */
@@ -571,6 +673,14 @@ static char        *tls_cafile     = NULL;
 #define SSL_MODE_ESTABLISHED 0x01
 #endif
 
+#ifdef HAVE_TLSTHREADS
+static sc_tlsworker_t *tls_workers = NULL;
+static long            tls_workerc = 0;
+static int             tls_wake[2] = {-1, -1}; /* worker --> coordinator */
+static dlist_t        *tls_done    = NULL;
+static slist_t        *tls_rx      = NULL;
+#endif
+
 /*
  * sc_unit_gc_t:
  *
@@ -604,6 +714,7 @@ static const sc_fd_cb_t read_cb[] = {
   (sc_fd_cb_t)sc_onechan_unix_read_do,  /* FD_TYPE_ONECHAN_UNIX */
   NULL,                                 /* FD_TYPE_MUX_ACCEPT */
   (sc_fd_cb_t)sc_mux_unix_read_do,      /* FD_TYPE_MUX */
+  NULL,                                 /* FD_TYPE_TLSWAKE */
 };
 static const sc_fd_cb_t write_cb[] = {
   NULL,                                 /* FD_TYPE_SERVER */
@@ -612,6 +723,7 @@ static const sc_fd_cb_t write_cb[] = {
   (sc_fd_cb_t)sc_onechan_unix_write_do, /* FD_TYPE_ONECHAN_UNIX */
   NULL,                                 /* FD_TYPE_MUX_ACCEPT */
   (sc_fd_cb_t)sc_mux_unix_write_do,     /* FD_TYPE_MUX */
+  NULL,                                 /* FD_TYPE_TLSWAKE */
 };
 #endif
 
@@ -632,6 +744,9 @@ static void usage(uint32_t opt_mask)
 	  "                  [-M mux-socket] [-U unix-dir] [-O option]\n"
 #ifdef HAVE_OPENSSL
 	  "                  [-C CA-file] [-c cert-file] [-p priv-file]\n"
+#endif
+#ifdef HAVE_TLSTHREADS
+	  "                  [-t threadc]\n"
 #endif
 	  "                  [-e pid-file] [-m meta-file] [-Z zombie-time]\n",
 	  v);
@@ -690,6 +805,11 @@ static void usage(uint32_t opt_mask)
     fprintf(stderr, "     -p private key in PEM format\n");
 #endif
 
+#ifdef HAVE_TLSTHREADS
+  if(opt_mask & OPT_TLSTHREADS)
+    fprintf(stderr, "     -t number of threads to terminate TLS sessions\n");
+#endif
+
   if(opt_mask & OPT_ZOMBIE)
     fprintf(stderr, "     -Z time to retain state for disconnected scamper\n");
 
@@ -700,11 +820,17 @@ static int check_options(int argc, char *argv[])
 {
   struct sockaddr_storage sas;
   char opts[32], *opt_addrport = NULL, *opt_zombie = NULL, *opt_pidfile = NULL;
+#ifdef HAVE_TLSTHREADS
+  char *opt_threadc = NULL;
+#endif
   size_t off = 0;
   long lo;
   int ch;
 
   string_concat(opts, sizeof(opts), &off, "?46DO:c:C:e:m:M:p:P:U:Z:");
+#ifdef HAVE_TLSTHREADS
+  string_concat(opts, sizeof(opts), &off, "t:");
+#endif
 #ifdef OPT_VERSION
   string_concatc(opts, sizeof(opts), &off, 'v');
 #endif
@@ -779,6 +905,13 @@ static int check_options(int argc, char *argv[])
 	  break;
 #endif
 
+#ifdef HAVE_TLSTHREADS
+	case 't':
+	  opt_threadc = optarg;
+	  options |= OPT_TLSTHREADS;
+	  break;
+#endif
+
 	case 'U':
 	  unix_dir = optarg;
 	  break;
@@ -872,6 +1005,24 @@ static int check_options(int argc, char *argv[])
       zombie = lo;
     }
 
+#ifdef HAVE_TLSTHREADS
+  /*
+   * worker threads terminate TLS sessions, and use epoll: they need
+   * a certificate, and cannot be used with select.
+   */
+  if(opt_threadc != NULL)
+    {
+      if(string_tolong(opt_threadc, &lo) != 0 || lo < 0 || lo > 256 ||
+	 (lo > 0 && ((options & OPT_TLSCERT) == 0 ||
+		     (flags & FLAG_SELECT) != 0)))
+	{
+	  usage(OPT_TLSTHREADS | OPT_TLSCERT);
+	  return -1;
+	}
+      tls_workerc = lo;
+    }
+#endif
+
   return 0;
 }
 
@@ -1073,19 +1224,539 @@ static int ssl_want_read_cb(void *param, uint8_t *buf, int len)
   return 0;
 }
 
-static int ssl_want_read(sc_master_t *ms)
+static int ssl_want_read(sc_master_t *ms)
+{
+  char errbuf[64];
+  int rc;
+
+  if((rc = tls_want_read(ms->inet_wbio, ms, errbuf, sizeof(errbuf),
+			 ssl_want_read_cb)) < 0)
+    {
+      remote_debug(__func__, "%s", errbuf);
+      return -1;
+    }
+
+  return rc;
+}
+#endif
+
+#ifdef HAVE_TLSTHREADS
+static void sc_tlslink_free(sc_tlslink_t *link)
+{
+  if(link->fd != -1) close(link->fd);
+  tls_bio_free(link->ssl, link->rbio, link->wbio);
+  if(link->cert != NULL) X509_free(link->cert);
+  if(link->wb != NULL) scamper_writebuf_free(link->wb);
+  if(link->tx != NULL) slist_free_cb(link->tx, free);
+  if(link->rx != NULL) slist_free_cb(link->rx, free);
+  if(link->tnode != NULL) dlist_node_pop(NULL, link->tnode);
+  if(link->dnode != NULL) dlist_node_pop(NULL, link->dnode);
+  free(link);
+  return;
+}
+
+/*
+ * sc_tlslink_unref
+ *
+ * drop a reference to the link, and free it once neither the
+ * coordinator nor the worker refer to it.
+ */
+static void sc_tlslink_unref(sc_tlslink_t *link)
+{
+  sc_tlsworker_t *w = link->worker;
+  uint8_t refcnt;
+
+  pthread_mutex_lock(&w->mutex);
+  refcnt = --link->refcnt;
+  pthread_mutex_unlock(&w->mutex);
+
+  if(refcnt == 0)
+    sc_tlslink_free(link);
+  return;
+}
+
+/*
+ * tlswake
+ *
+ * wake the thread reading the other end of the pipe.  if the pipe is
+ * full, then the thread already has a reason to wake.
+ */
+static int tlswake(int fd)
+{
+  uint8_t u8 = 0;
+  if(write(fd, &u8, 1) == -1 && errno != EAGAIN && errno != EINTR)
+    return -1;
+  return 0;
+}
+
+/*
+ * sc_tlslink_todo_push
+ *
+ * put the link on the worker's todo list, if it is not already
+ * there.  called with the worker's mutex held.
+ */
+static void sc_tlslink_todo_push(sc_tlslink_t *link)
+{
+  sc_tlsworker_t *w = link->worker;
+  if(link->flags & TLSLINK_FLAG_TODO)
+    return;
+  link->flags |= TLSLINK_FLAG_TODO;
+  dlist_node_tail_push(w->todo, link->tnode);
+  if(dlist_count(w->todo) == 1)
+    tlswake(w->wake[1]);
+  return;
+}
+
+/*
+ * sc_tlslink_done_push
+ *
+ * put the link on the worker's done list, if it is not already
+ * there.  called with the worker's mutex held.
+ */
+static void sc_tlslink_done_push(sc_tlslink_t *link)
+{
+  sc_tlsworker_t *w = link->worker;
+  if(link->flags & TLSLINK_FLAG_DONE)
+    return;
+  link->flags |= TLSLINK_FLAG_DONE;
+  dlist_node_tail_push(w->done, link->dnode);
+  if(dlist_count(w->done) == 1)
+    tlswake(tls_wake[1]);
+  return;
+}
+
+/*
+ * sc_tlslink_epoll
+ *
+ * set the events the worker is interested in for this link.
+ */
+static int sc_tlslink_epoll(sc_tlslink_t *link, uint8_t events)
+{
+  struct epoll_event ev;
+  int op;
+
+  if(link->events == events)
+    return 0;
+
+  ev.data.ptr = link;
+  ev.events = 0;
+  if(events & FD_FLAG_READ)
+    ev.events |= EPOLLIN;
+  if(events & FD_FLAG_WRITE)
+    ev.events |= EPOLLOUT;
+
+  if(link->events == 0)
+    op = EPOLL_CTL_ADD;
+  else if(events == 0)
+    op = EPOLL_CTL_DEL;
+  else
+    op = EPOLL_CTL_MOD;
+
+  if(epoll_ctl(link->worker->epfd, op, link->fd, &ev) != 0)
+    {
+      snprintf(link->err, sizeof(link->err), "epoll_ctl failed: %s",
+	       strerror(errno));
+      return -1;
+    }
+  link->events = events;
+  return 0;
+}
+
+/*
+ * sc_tlslink_post
+ *
+ * pass plaintext received from scamper, and the news that the worker
+ * has closed the link, to the coordinator.
+ */
+static void sc_tlslink_post(sc_tlslink_t *link, slist_t *rx, uint8_t flags)
+{
+  sc_tlsworker_t *w = link->worker;
+
+  if(flags != 0 && link->dead == 0)
+    {
+      sc_tlslink_epoll(link, 0);
+      link->dead = 1;
+    }
+
+  pthread_mutex_lock(&w->mutex);
+  if(rx != NULL)
+    slist_concat(link->rx, rx);
+  link->flags |= flags;
+  sc_tlslink_done_push(link);
+  pthread_mutex_unlock(&w->mutex);
+
+  return;
+}
+
+/*
+ * sc_tlslink_write
+ *
+ * write ciphertext to scamper.  returns -1 if the link should be closed,
+ * either because of an error, or because it has been flushed.
+ */
+static int sc_tlslink_write(sc_tlslink_t *link)
+{
+  if(scamper_writebuf_gtzero(link->wb) != 0 &&
+     scamper_writebuf_write(link->fd, link->wb) != 0)
+    {
+      snprintf(link->err, sizeof(link->err), "write failed: %s",
+	       strerror(errno));
+      return -1;
+    }
+
+  if(scamper_writebuf_gtzero(link->wb) != 0)
+    return sc_tlslink_epoll(link, FD_FLAG_READ | FD_FLAG_WRITE);
+
+  if(link->flush != 0)
+    {
+      snprintf(link->err, sizeof(link->err), "flushed");
+      return -1;
+    }
+
+  return sc_tlslink_epoll(link, FD_FLAG_READ);
+}
+
+static int sc_tlslink_want_read_cb(void *param, uint8_t *buf, int len)
+{
+  sc_tlslink_t *link = param;
+  return scamper_writebuf_send(link->wb, buf, len);
+}
+
+/*
+ * sc_tlslink_flush
+ *
+ * move the ciphertext that the TLS session has produced into the
+ * writebuf, and try to write it to scamper.
+ */
+static int sc_tlslink_flush(sc_tlslink_t *link)
+{
+  if(tls_want_read(link->wbio, link, link->err, sizeof(link->err),
+		   sc_tlslink_want_read_cb) < 0)
+    return -1;
+  return sc_tlslink_write(link);
+}
+
+/*
+ * sc_tlslink_cert
+ *
+ * the worker's equivalent of sc_master_is_valid_client_cert_0.  keep
+ * a copy of the certificate so that the coordinator can verify the
+ * monitor name later.
+ */
+static int sc_tlslink_cert(sc_tlslink_t *link)
+{
+  if(tls_cafile == NULL)
+    return 1;
+
+  if(SSL_get_verify_result(link->ssl) != X509_V_OK)
+    {
+      snprintf(link->err, sizeof(link->err), "invalid certificate");
+      return 0;
+    }
+
+  if((link->cert = SSL_get_peer_certificate(link->ssl)) == NULL)
+    {
+      snprintf(link->err, sizeof(link->err), "no peer certificate");
+      return 0;
+    }
+
+  return 1;
+}
+
+/*
+ * sc_tlslink_read
+ *
+ * the worker's equivalent of sc_master_inet_read_do: read ciphertext
+ * from scamper, and pass the plaintext to the coordinator.
+ */
+static void sc_tlslink_read(sc_tlslink_t *link)
+{
+  slist_t *rx = NULL;
+  sc_tlsbuf_t *tb;
+  uint8_t buf[16384], flags = 0;
+  size_t off = 0;
+  ssize_t rrc;
+  int rc;
+
+  if((rrc = read(link->fd, buf, sizeof(buf))) < 0)
+    {
+      if(errno == EAGAIN || errno == EINTR)
+	return;
+      snprintf(link->err, sizeof(link->err), "read failed: %s",
+	       strerror(errno));
+      flags = TLSLINK_FLAG_EOF;
+      goto done;
+    }
+
+  if(rrc == 0)
+    {
+      snprintf(link->err, sizeof(link->err), "disconnected");
+      flags = TLSLINK_FLAG_EOF;
+      goto done;
+    }
+
+  BIO_write(link->rbio, buf, rrc);
+  ERR_clear_error();
+
+  if(link->mode == SSL_MODE_ACCEPT)
+    {
+      if((rc = SSL_accept(link->ssl)) > 0)
+	{
+	  link->mode = SSL_MODE_ESTABLISHED;
+	  if(sc_tlslink_cert(link) == 0)
+	    {
+	      flags = TLSLINK_FLAG_EOF | TLSLINK_FLAG_ERR;
+	      goto done;
+	    }
+	}
+    }
+
+  /*
+   * collect the plaintext into as few chunks as possible, so that the
+   * coordinator is handed the data in large pieces
+   */
+  if(link->mode != SSL_MODE_ACCEPT)
+    {
+      while((rc = SSL_read(link->ssl, buf+off, sizeof(buf)-off)) > 0)
+	{
+	  off += rc;
+	  if(off < sizeof(buf))
+	    continue;
+	  if((rx == NULL && (rx = slist_alloc()) == NULL) ||
+	     (tb = malloc(sizeof(sc_tlsbuf_t) + off)) == NULL)
+	    goto oom;
+	  tb->data = (uint8_t *)(tb + 1);
+	  tb->len = off;
+	  memcpy(tb->data, buf, off);
+	  if(slist_tail_push(rx, tb) == NULL)
+	    {
+	      free(tb);
+	      goto oom;
+	    }
+	  off = 0;
+	}
+    }
+
+  if((rc = SSL_get_error(link->ssl, rc)) != SSL_ERROR_WANT_READ &&
+     rc != SSL_ERROR_WANT_WRITE)
+    {
+      snprintf(link->err, sizeof(link->err), "mode %s rc %d",
+	       link->mode == SSL_MODE_ACCEPT ? "accept" : "estab", rc);
+      flags = TLSLINK_FLAG_EOF | TLSLINK_FLAG_ERR;
+    }
+
+  if(off > 0)
+    {
+      if((rx == NULL && (rx = slist_alloc()) == NULL) ||
+	 (tb = malloc(sizeof(sc_tlsbuf_t) + off)) == NULL)
+	goto oom;
+      tb->data = (uint8_t *)(tb + 1);
+      tb->len = off;
+      memcpy(tb->data, buf, off);
+      if(slist_tail_push(rx, tb) == NULL)
+	{
+	  free(tb);
+	  goto oom;
+	}
+    }
+
+  if(flags == 0 && sc_tlslink_flush(link) != 0)
+    flags = TLSLINK_FLAG_EOF;
+
+ done:
+  if(flags != 0 || rx != NULL)
+    sc_tlslink_post(link, rx, flags);
+  if(rx != NULL)
+    slist_free(rx);
+  return;
+
+ oom:
+  snprintf(link->err, sizeof(link->err), "out of memory");
+  flags = TLSLINK_FLAG_EOF | TLSLINK_FLAG_ERR;
+  goto done;
+}
+
+/*
+ * sc_tlslink_todo
+ *
+ * the coordinator has plaintext to send to scamper, or has detached
+ * from the link.
+ */
+static void sc_tlslink_todo(sc_tlslink_t *link, slist_t *tx)
+{
+  sc_tlsworker_t *w = link->worker;
+  sc_tlsbuf_t *tb;
+  uint8_t flags;
+
+  pthread_mutex_lock(&w->mutex);
+  link->flags &= ~TLSLINK_FLAG_TODO;
+  flags = link->flags;
+  slist_concat(tx, link->tx);
+  pthread_mutex_unlock(&w->mutex);
+
+  if(flags & TLSLINK_FLAG_CLOSE)
+    {
+      slist_empty_cb(tx, free);
+      if(link->dead == 0)
+	{
+	  sc_tlslink_epoll(link, 0);
+	  link->dead = 1;
+	}
+      sc_tlslink_unref(link);
+      return;
+    }
+
+  if(link->dead != 0)
+    {
+      slist_empty_cb(tx, free);
+      return;
+    }
+
+  if(flags & TLSLINK_FLAG_FLUSH)
+    link->flush = 1;
+
+  /* encrypt the queued messages together, in as few records as possible */
+  while((tb = slist_head_pop(tx)) != NULL)
+    {
+      tls_gather_write(link->ssl, w->txbuf, &w->txoff, tb->data, tb->len);
+      free(tb);
+    }
+  tls_gather_flush(link->ssl, w->txbuf, &w->txoff);
+
+  if(sc_tlslink_flush(link) != 0)
+    sc_tlslink_post(link, NULL, TLSLINK_FLAG_EOF);
+
+  return;
+}
+
+/*
+ * sc_tlsworker_main
+ *
+ * the event loop of a worker thread.
+ */
+static void *sc_tlsworker_main(void *param)
+{
+  sc_tlsworker_t *w = param;
+  struct epoll_event events[256];
+  int events_c = sizeof(events) / sizeof(struct epoll_event);
+  sc_tlslink_t *link;
+  dlist_node_t *dn;
+  slist_t *tx = NULL;
+  uint8_t buf[64], stop = 0;
+  int i, rc;
+
+  if((tx = slist_alloc()) == NULL)
+    return NULL;
+
+  while(stop == 0)
+    {
+      if((rc = epoll_wait(w->epfd, events, events_c, -1)) == -1)
+	{
+	  if(errno == EINTR)
+	    continue;
+	  break;
+	}
+
+      for(i=0; i<rc; i++)
+	{
+	  if(events[i].data.ptr == w)
+	    {
+	      while(read(w->wake[0], buf, sizeof(buf)) > 0)
+		;
+	      continue;
+	    }
+	  link = events[i].data.ptr;
+	  if(link->dead == 0 && (events[i].events & (EPOLLIN|EPOLLHUP|EPOLLERR)))
+	    sc_tlslink_read(link);
+	  if(link->dead == 0 && (events[i].events & EPOLLOUT) &&
+	     sc_tlslink_write(link) != 0)
+	    sc_tlslink_post(link, NULL, TLSLINK_FLAG_EOF);
+	}
+
+      pthread_mutex_lock(&w->mutex);
+      dlist_concat(w->work, w->todo);
+      stop = w->stop;
+      pthread_mutex_unlock(&w->mutex);
+
+      while((dn = dlist_head_node(w->work)) != NULL)
+	{
+	  link = dlist_node_item(dn);
+	  dlist_node_eject(w->work, dn);
+	  sc_tlslink_todo(link, tx);
+	}
+    }
+
+  slist_free(tx);
+  OPENSSL_thread_stop();
+  return NULL;
+}
+
+/*
+ * sc_tlslink_send
+ *
+ * pass a message to the worker to send to scamper.  the header and
+ * the payload are passed together, so that they are sent in a single
+ * TLS record.
+ */
+static int sc_tlslink_send(sc_tlslink_t *link, const uint8_t *hdr,
+			   const void *ptr, uint16_t len, int flush)
+{
+  sc_tlsworker_t *w = link->worker;
+  sc_tlsbuf_t *tb;
+
+  if((tb = malloc(sizeof(sc_tlsbuf_t) + SC_MESSAGE_HDRLEN + len)) == NULL)
+    {
+      remote_debug(__func__, "could not malloc buf: %s", strerror(errno));
+      return -1;
+    }
+  tb->data = (uint8_t *)(tb + 1);
+  tb->len = SC_MESSAGE_HDRLEN + len;
+  memcpy(tb->data, hdr, SC_MESSAGE_HDRLEN);
+  memcpy(tb->data + SC_MESSAGE_HDRLEN, ptr, len);
+
+  pthread_mutex_lock(&w->mutex);
+  if(slist_tail_push(link->tx, tb) == NULL)
+    {
+      pthread_mutex_unlock(&w->mutex);
+      remote_debug(__func__, "could not push buf: %s", strerror(errno));
+      free(tb);
+      return -1;
+    }
+  if(flush != 0)
+    link->flags |= TLSLINK_FLAG_FLUSH;
+  sc_tlslink_todo_push(link);
+  pthread_mutex_unlock(&w->mutex);
+
+  return 0;
+}
+
+/*
+ * sc_tlslink_detach
+ *
+ * the master no longer needs the link.  the worker closes the socket.
+ */
+static void sc_tlslink_detach(sc_tlslink_t *link)
 {
-  char errbuf[64];
-  int rc;
+  sc_tlsworker_t *w = link->worker;
+  int unref = 0;
 
-  if((rc = tls_want_read(ms->inet_wbio, ms, errbuf, sizeof(errbuf),
-			 ssl_want_read_cb)) < 0)
-    {
-      remote_debug(__func__, "%s", errbuf);
-      return -1;
-    }
+  link->master = NULL;
+  w->linkc--;
 
-  return rc;
+  /*
+   * if the link is on the done list, the coordinator drops its
+   * reference when it takes the link off the list
+   */
+  pthread_mutex_lock(&w->mutex);
+  link->flags |= TLSLINK_FLAG_CLOSE;
+  sc_tlslink_todo_push(link);
+  if((link->flags & TLSLINK_FLAG_DONE) == 0)
+    unref = 1;
+  pthread_mutex_unlock(&w->mutex);
+
+  if(unref != 0)
+    sc_tlslink_unref(link);
+  return;
 }
 #endif
 
@@ -1199,16 +1870,24 @@ static int sc_master_inet_write(sc_master_t *ms, void *ptr, uint16_t len,
   bytes_htonl(hdr+4, channel);
   bytes_htons(hdr+8, len);
 
+#ifdef HAVE_TLSTHREADS
+  if(ms->inet_link != NULL)
+    return sc_tlslink_send(ms->inet_link, hdr, ptr, len,
+			   ms->mode == MASTER_MODE_FLUSH);
+#endif
+
 #ifdef HAVE_OPENSSL
   if(ms->inet_ssl != NULL)
     {
-      SSL_write(ms->inet_ssl, hdr, SC_MESSAGE_HDRLEN);
-      SSL_write(ms->inet_ssl, ptr, len);
-      if(ssl_want_read(ms) < 0)
-	{
-	  remote_debug(__func__, "ssl_want_read failed");
-	  return -1;
-	}
+      /*
+       * gather messages until the socket is writable, so that they
+       * are encrypted together in as few TLS records as possible
+       */
+      tls_gather_write(ms->inet_ssl, ms->inet_txbuf, &ms->inet_txoff,
+		       hdr, SC_MESSAGE_HDRLEN);
+      tls_gather_write(ms->inet_ssl, ms->inet_txbuf, &ms->inet_txoff,
+		       ptr, len);
+      sc_fd_write_add(&ms->inet_fd);
       return 0;
     }
 #endif
@@ -1294,6 +1973,16 @@ static void sc_master_inet_free(sc_master_t *ms)
 {
   remote_debug(__func__, "%s", ms->name);
 
+#ifdef HAVE_TLSTHREADS
+  /* the worker thread closes the socket */
+  if(ms->inet_link != NULL)
+    {
+      sc_tlslink_detach(ms->inet_link);
+      ms->inet_link = NULL;
+      ms->inet_fd.fd = -1;
+    }
+#endif
+
   if(ms->inet_fd.fd != -1)
     {
       sc_fd_read_del(&ms->inet_fd);
@@ -1312,6 +2001,7 @@ static void sc_master_inet_free(sc_master_t *ms)
   ms->inet_ssl = NULL;
   ms->inet_wbio = NULL;
   ms->inet_rbio = NULL;
+  ms->inet_txoff = 0;
 #endif
 
   return;
@@ -1371,6 +2061,13 @@ static int sc_master_is_valid_client_cert_1(sc_master_t *ms)
       return 0;
     }
 
+#ifdef HAVE_TLSTHREADS
+  /* the worker checked the certificate was valid when it kept it */
+  if(ms->inet_link != NULL)
+    return ms->inet_link->cert != NULL &&
+      tls_is_valid_certname(ms->inet_link->cert, ms->monitorname);
+#endif
+
   return tls_is_valid_cert(ms->inet_ssl, ms->monitorname);
 }
 #endif /* HAVE_OPENSSL */
@@ -1627,6 +2324,16 @@ static void sc_master_inet_write_do(sc_master_t *ms)
     return;
   assert(ms->inet_wb != NULL);
 
+#ifdef HAVE_OPENSSL
+  if(ms->inet_ssl != NULL &&
+     tls_gather_flush(ms->inet_ssl, ms->inet_txbuf, &ms->inet_txoff) > 0 &&
+     ssl_want_read(ms) < 0)
+    {
+      remote_debug(__func__, "ssl_want_read failed");
+      goto zombie;
+    }
+#endif
+
   if(scamper_writebuf_write(ms->inet_fd.fd, ms->inet_wb) != 0)
     goto zombie;
 
@@ -1683,6 +2390,60 @@ static int sc_master_tx_rej(sc_master_t *ms)
   return 0;
 }
 
+#ifdef HAVE_ZLIB
+/*
+ * sc_master_zlib_init
+ *
+ * scamper offered to compress channel messages, so prepare to
+ * decompress them.
+ */
+static int sc_master_zlib_init(sc_master_t *ms)
+{
+  if((ms->inet_zs = malloc_zero(sizeof(z_stream))) == NULL)
+    {
+      remote_debug(__func__, "could not malloc z_stream: %s",
+		   strerror(errno));
+      return -1;
+    }
+  if(inflateInit2(ms->inet_zs, -15) != Z_OK)
+    {
+      remote_debug(__func__, "could not init z_stream");
+      free(ms->inet_zs); ms->inet_zs = NULL;
+      return -1;
+    }
+  return 0;
+}
+
+/*
+ * sc_master_inflate
+ *
+ * decompress a channel message.  scamper ends each message with a sync
+ * flush, so the message decompresses completely, and to no more than
+ * the largest message scamper could have sent.
+ */
+static int sc_master_inflate(sc_master_t *ms, uint8_t *ptr, uint16_t len,
+			     uint8_t *out, uint16_t *outlen)
+{
+  int rc;
+
+  ms->inet_zs->next_in = ptr;
+  ms->inet_zs->avail_in = len;
+  ms->inet_zs->next_out = out;
+  ms->inet_zs->avail_out = 65536;
+
+  rc = inflate(ms->inet_zs, Z_SYNC_FLUSH);
+  if((rc != Z_OK && rc != Z_BUF_ERROR) || ms->inet_zs->avail_in != 0 ||
+     ms->inet_zs->avail_out == 0)
+    {
+      remote_debug(__func__, "could not decompress %u bytes: %d", len, rc);
+      return -1;
+    }
+
+  *outlen = 65536 - ms->inet_zs->avail_out;
+  return 0;
+}
+#endif
+
 /*
  * sc_master_control_master
  *
@@ -1694,10 +2455,10 @@ static int sc_master_tx_rej(sc_master_t *ms)
 static int sc_master_control_master(sc_master_t *ms, uint8_t *buf, size_t len)
 {
   char     sab[128];
-  uint8_t  resp[1+1+128];
+  uint8_t  resp[1+1+128+1];
   uint8_t *magic = NULL;
   char    *monitorname = NULL;
-  uint8_t  magic_len, monitorname_len, u8;
+  uint8_t  magic_len, monitorname_len, u8, opts = 0;
   size_t   off = 0;
 
   /* ensure that there is a magic value present */
@@ -1742,6 +2503,10 @@ static int sc_master_control_master(sc_master_t *ms, uint8_t *buf, size_t len)
       assert(off <= len);
     }
 
+  /* check if there are options supplied */
+  if(off < len)
+    opts = buf[off++];
+
 #ifdef HAVE_OPENSSL
   /* verify the monitorname if we are verifying TLS client certificates */
   if(sc_master_is_valid_client_cert_1(ms) == 0)
@@ -1776,7 +2541,23 @@ static int sc_master_control_master(sc_master_t *ms, uint8_t *buf, size_t len)
   resp[0] = CONTROL_MASTER_ID;
   resp[1] = off + 1;
   memcpy(resp+2, sab, off + 1);
-  if(sc_master_inet_send(ms, resp, 1 + 1 + off + 1, 0, 0) != 0)
+  off += 3;
+
+  /*
+   * acknowledge the options we agree to.  scamper only sends options
+   * if it understands the acknowledgement.
+   */
+  if(opts != 0)
+    {
+      resp[off] = 0;
+#ifdef HAVE_ZLIB
+      if((opts & CONTROL_OPT_ZLIB) != 0 && sc_master_zlib_init(ms) == 0)
+	resp[off] |= CONTROL_OPT_ZLIB;
+#endif
+      off++;
+    }
+
+  if(sc_master_inet_send(ms, resp, off, 0, 0) != 0)
     {
       remote_debug(__func__, "could not write ID: %s", strerror(errno));
       goto err;
@@ -1998,6 +2779,12 @@ static int sc_master_control_resume(sc_master_t *ms, uint8_t *buf, size_t len)
   ms2->zombie = ms->zombie;
   ms2->buf_offset = 0;
 
+#ifdef HAVE_ZLIB
+  /* scamper compresses with a new stream on each connection */
+  if(ms2->inet_zs != NULL && inflateReset(ms2->inet_zs) != Z_OK)
+    goto err;
+#endif
+
   /* switch over the file descriptors */
   sc_master_inet_free(ms2);
   sc_master_unix_free(ms2);
@@ -2010,6 +2797,13 @@ static int sc_master_control_resume(sc_master_t *ms, uint8_t *buf, size_t len)
   ms2->inet_ssl  = ms->inet_ssl;  ms->inet_ssl = NULL;
   ms2->inet_rbio = ms->inet_rbio; ms->inet_rbio = NULL;
   ms2->inet_wbio = ms->inet_wbio; ms->inet_wbio = NULL;
+  memcpy(ms2->inet_txbuf, ms->inet_txbuf, ms->inet_txoff);
+  ms2->inet_txoff = ms->inet_txoff; ms->inet_txoff = 0;
+#endif
+#ifdef HAVE_TLSTHREADS
+  ms2->inet_link = ms->inet_link; ms->inet_link = NULL;
+  if(ms2->inet_link != NULL)
+    ms2->inet_link->master = ms2;
 #endif
 
   if(ms2->inet_fd.flags & FD_FLAG_READ)
@@ -2147,6 +2941,10 @@ static void sc_master_inet_read_cb(sc_master_t *ms, uint8_t *buf, size_t len)
   size_t off = 0;
   uint8_t *ptr;
 
+#ifdef HAVE_ZLIB
+  static uint8_t zbuf[65536];
+#endif
+
   while(off < len)
     {
       /* to start with, ensure that we have a complete header */
@@ -2201,6 +2999,19 @@ static void sc_master_inet_read_cb(sc_master_t *ms, uint8_t *buf, size_t len)
 	goto err;
       ms->rcv_nxt++;
 
+#ifdef HAVE_ZLIB
+      /*
+       * decompress the message even if the channel is gone, so that
+       * the stream stays in step with scamper's.
+       */
+      if(ms->inet_zs != NULL)
+	{
+	  if(sc_master_inflate(ms, ptr, msglen, zbuf, &msglen) != 0)
+	    goto err;
+	  ptr = zbuf;
+	}
+#endif
+
       if((cn = sc_master_channel_find(ms, id)) != NULL)
 	{
 	  if(CHANNEL_IS_ONECHAN(cn))
@@ -2332,6 +3143,106 @@ static void sc_master_inet_read_do(sc_master_t *ms)
 #endif
 }
 
+#ifdef HAVE_TLSTHREADS
+/*
+ * sc_tlslink_done
+ *
+ * pass plaintext that a worker received to the master, and handle
+ * the worker closing the link.
+ */
+static void sc_tlslink_done(sc_tlslink_t *link, slist_t *rx)
+{
+  sc_tlsworker_t *w = link->worker;
+  sc_master_t *ms;
+  sc_tlsbuf_t *tb;
+  uint8_t flags;
+  int unref = 0;
+
+  for(;;)
+    {
+      /*
+       * the link stays marked as being on the done list until there is
+       * nothing left to process, so that the worker does not push it
+       * on the list again, and so that it is not freed under us
+       */
+      pthread_mutex_lock(&w->mutex);
+      slist_concat(rx, link->rx);
+      flags = link->flags;
+      link->flags &= ~(TLSLINK_FLAG_EOF | TLSLINK_FLAG_ERR);
+      if(slist_count(rx) == 0 && (flags & TLSLINK_FLAG_EOF) == 0)
+	{
+	  link->flags &= ~TLSLINK_FLAG_DONE;
+	  if(flags & TLSLINK_FLAG_CLOSE)
+	    unref = 1;
+	  pthread_mutex_unlock(&w->mutex);
+	  break;
+	}
+      pthread_mutex_unlock(&w->mutex);
+
+      while((tb = slist_head_pop(rx)) != NULL)
+	{
+	  /* the master might change if scamper resumes a session */
+	  if((ms = link->master) != NULL && ms->unit->gc == 0)
+	    {
+	      timeval_add_s(&ms->rx_abort, &now, 60);
+	      sc_master_inet_read_cb(ms, tb->data, tb->len);
+	    }
+	  free(tb);
+	}
+
+      if((flags & TLSLINK_FLAG_EOF) == 0 ||
+	 (ms = link->master) == NULL || ms->unit->gc != 0)
+	continue;
+
+      remote_debug(__func__, "%s %s", ms->name != NULL ? ms->name : "-",
+		   link->err);
+      if((flags & TLSLINK_FLAG_ERR) != 0 || zombie == 0 || ms->name == NULL)
+	sc_unit_gc(ms->unit);
+      else
+	sc_master_zombie(ms);
+    }
+
+  if(unref != 0)
+    sc_tlslink_unref(link);
+  return;
+}
+
+/*
+ * tlsworkers_done_do
+ *
+ * a worker has woken the coordinator.  process the links on each
+ * worker's done list.
+ */
+static void tlsworkers_done_do(void)
+{
+  sc_tlsworker_t *w;
+  sc_tlslink_t *link;
+  dlist_node_t *dn;
+  uint8_t buf[64];
+  long i;
+
+  while(read(tls_wake[0], buf, sizeof(buf)) > 0)
+    ;
+
+  for(i=0; i<tls_workerc; i++)
+    {
+      w = &tls_workers[i];
+      pthread_mutex_lock(&w->mutex);
+      dlist_concat(tls_done, w->done);
+      pthread_mutex_unlock(&w->mutex);
+    }
+
+  while((dn = dlist_head_node(tls_done)) != NULL)
+    {
+      link = dlist_node_item(dn);
+      dlist_node_eject(tls_done, dn);
+      sc_tlslink_done(link, tls_rx);
+    }
+
+  return;
+}
+#endif
+
 /*
  * sc_master_unix_accept_do
  *
@@ -2443,6 +3354,14 @@ static void sc_master_free(sc_master_t *ms)
 
   sc_master_inet_free(ms);
 
+#ifdef HAVE_ZLIB
+  if(ms->inet_zs != NULL)
+    {
+      inflateEnd(ms->inet_zs);
+      free(ms->inet_zs);
+    }
+#endif
+
   if(ms->tree_node != NULL) splaytree_remove_node(mstree, ms->tree_node);
   if(ms->name != NULL) free(ms->name);
   if(ms->monitorname != NULL) free(ms->monitorname);
@@ -2719,6 +3638,62 @@ static void sc_channel_free(sc_channel_t *cn)
   return;
 }
 
+#ifdef HAVE_TLSTHREADS
+/*
+ * sc_master_tlslink
+ *
+ * hand the socket and TLS session of a newly accepted master to the
+ * worker with the fewest links.
+ */
+static int sc_master_tlslink(sc_master_t *ms)
+{
+  sc_tlsworker_t *w = NULL;
+  sc_tlslink_t *link = NULL;
+  long i;
+
+  for(i=0; i<tls_workerc; i++)
+    if(w == NULL || tls_workers[i].linkc < w->linkc)
+      w = &tls_workers[i];
+
+  if((link = malloc_zero(sizeof(sc_tlslink_t))) == NULL)
+    goto err;
+  link->fd = -1;
+  if((link->tnode = dlist_node_alloc(link)) == NULL ||
+     (link->dnode = dlist_node_alloc(link)) == NULL ||
+     (link->tx = slist_alloc()) == NULL ||
+     (link->rx = slist_alloc()) == NULL ||
+     (link->wb = scamper_writebuf_alloc()) == NULL)
+    goto err;
+
+  /*
+   * the link owns the socket from now on, but the master keeps a
+   * copy of the file descriptor to get the name of the peer
+   */
+  link->worker = w;
+  link->master = ms;
+  link->refcnt = 2;
+  link->fd = ms->inet_fd.fd;
+  link->mode = ms->inet_mode;
+  link->ssl = ms->inet_ssl; ms->inet_ssl = NULL;
+  link->rbio = ms->inet_rbio; ms->inet_rbio = NULL;
+  link->wbio = ms->inet_wbio; ms->inet_wbio = NULL;
+  ms->inet_link = link;
+  w->linkc++;
+
+  /* the worker adds the socket to its epoll set */
+  pthread_mutex_lock(&w->mutex);
+  sc_tlslink_todo_push(link);
+  pthread_mutex_unlock(&w->mutex);
+
+  return 0;
+
+ err:
+  remote_debug(__func__, "could not alloc link: %s", strerror(errno));
+  if(link != NULL) sc_tlslink_free(link);
+  return -1;
+}
+#endif
+
 /*
  * serversocket_accept
  *
@@ -2750,6 +3725,14 @@ static int serversocket_accept(int ss)
   if(fd_peername(ms->inet_fd.fd, buf, sizeof(buf), 1) == 0)
     remote_debug(__func__, "%s", buf);
 
+#ifdef HAVE_TLSTHREADS
+  if(tls_workers != NULL && ms->inet_ssl != NULL)
+    {
+      if(sc_master_tlslink(ms) != 0)
+	goto err;
+    }
+  else
+#endif
   if(sc_fd_read_add(&ms->inet_fd) != 0)
     {
       remote_debug(__func__, "could not monitor inet fd: %s", strerror(errno));
@@ -3245,6 +4228,157 @@ static int unixdomain_direxists(void)
   return 0;
 }
 
+#ifdef HAVE_TLSTHREADS
+/*
+ * tlsworkers_init
+ *
+ * start the threads that terminate TLS sessions.  the threads block
+ * signals, so that the signals are delivered to the main thread.
+ */
+static int tlsworkers_init(void)
+{
+  struct epoll_event ev;
+  sc_tlsworker_t *w;
+  sigset_t set, oset;
+  long i;
+  int rc = -1;
+
+  if(pipe(tls_wake) != 0 ||
+     fcntl_set(tls_wake[0], O_NONBLOCK) == -1 ||
+     fcntl_set(tls_wake[1], O_NONBLOCK) == -1)
+    {
+      remote_debug(__func__, "could not create pipe: %s", strerror(errno));
+      return -1;
+    }
+
+  if((tls_done = dlist_alloc()) == NULL ||
+     (tls_rx = slist_alloc()) == NULL ||
+     (tls_workers = malloc_zero(sizeof(sc_tlsworker_t) * tls_workerc)) == NULL)
+    {
+      remote_debug(__func__, "could not alloc workers: %s", strerror(errno));
+      return -1;
+    }
+
+  /* only clean up the workers that have an initialised mutex */
+  for(i=0; i<tls_workerc; i++)
+    {
+      w = &tls_workers[i];
+      w->epfd = -1;
+      w->wake[0] = w->wake[1] = -1;
+      if(pthread_mutex_init(&w->mutex, NULL) != 0)
+	{
+	  remote_debug(__func__, "could not init mutex");
+	  tls_workerc = i;
+	  return -1;
+	}
+    }
+
+  for(i=0; i<tls_workerc; i++)
+    {
+      w = &tls_workers[i];
+      if((w->todo = dlist_alloc()) == NULL ||
+	 (w->done = dlist_alloc()) == NULL ||
+	 (w->work = dlist_alloc()) == NULL)
+	{
+	  remote_debug(__func__, "could not alloc lists: %s", strerror(errno));
+	  return -1;
+	}
+      if((w->epfd = epoll_create(1000)) == -1)
+	{
+	  remote_debug(__func__, "epoll_create failed: %s", strerror(errno));
+	  return -1;
+	}
+      if(pipe(w->wake) != 0 ||
+	 fcntl_set(w->wake[0], O_NONBLOCK) == -1 ||
+	 fcntl_set(w->wake[1], O_NONBLOCK) == -1)
+	{
+	  remote_debug(__func__, "could not create pipe: %s", strerror(errno));
+	  return -1;
+	}
+      ev.data.ptr = w;
+      ev.events = EPOLLIN;
+      if(epoll_ctl(w->epfd, EPOLL_CTL_ADD, w->wake[0], &ev) != 0)
+	{
+	  remote_debug(__func__, "could not add pipe: %s", strerror(errno));
+	  return -1;
+	}
+    }
+
+  sigfillset(&set);
+  if(pthread_sigmask(SIG_BLOCK, &set, &oset) != 0)
+    {
+      remote_debug(__func__, "could not block signals");
+      return -1;
+    }
+  for(i=0; i<tls_workerc; i++)
+    {
+      w = &tls_workers[i];
+      if(pthread_create(&w->tid, NULL, sc_tlsworker_main, w) != 0)
+	{
+	  remote_debug(__func__, "could not create thread");
+	  goto done;
+	}
+      w->started = 1;
+    }
+  rc = 0;
+
+ done:
+  pthread_sigmask(SIG_SETMASK, &oset, NULL);
+  return rc;
+}
+
+/*
+ * tlsworkers_cleanup
+ *
+ * stop the worker threads.  this is called after the masters have
+ * detached from their links, so that once the threads have stopped,
+ * the only references left to any link are held by the done lists.
+ */
+static void tlsworkers_cleanup(void)
+{
+  sc_tlsworker_t *w;
+  long i;
+
+  if(tls_workers == NULL)
+    return;
+
+  for(i=0; i<tls_workerc; i++)
+    {
+      w = &tls_workers[i];
+      if(w->started == 0)
+	continue;
+      pthread_mutex_lock(&w->mutex);
+      w->stop = 1;
+      tlswake(w->wake[1]);
+      pthread_mutex_unlock(&w->mutex);
+    }
+  for(i=0; i<tls_workerc; i++)
+    {
+      w = &tls_workers[i];
+      if(w->started != 0)
+	pthread_join(w->tid, NULL);
+    }
+
+  if(tls_done != NULL && tls_rx != NULL)
+    tlsworkers_done_do();
+
+  for(i=0; i<tls_workerc; i++)
+    {
+      w = &tls_workers[i];
+      if(w->epfd != -1) close(w->epfd);
+      if(w->wake[0] != -1) close(w->wake[0]);
+      if(w->wake[1] != -1) close(w->wake[1]);
+      if(w->todo != NULL) dlist_free(w->todo);
+      if(w->done != NULL) dlist_free(w->done);
+      if(w->work != NULL) dlist_free(w->work);
+      pthread_mutex_destroy(&w->mutex);
+    }
+  free(tls_workers); tls_workers = NULL;
+
+  return;
+}
+#endif
+
 static void cleanup(void)
 {
   sc_master_t *ms;
@@ -3298,6 +4432,29 @@ static void cleanup(void)
 	}
       dlist_free(mslist); mslist = NULL;
     }
+
+#ifdef HAVE_TLSTHREADS
+  tlsworkers_cleanup();
+  if(tls_done != NULL)
+    {
+      dlist_free(tls_done);
+      tls_done = NULL;
+    }
+  if(tls_rx != NULL)
+    {
+      slist_free(tls_rx);
+      tls_rx = NULL;
+    }
+  for(i=0; i<2; i++)
+    {
+      if(tls_wake[i] != -1)
+	{
+	  close(tls_wake[i]);
+	  tls_wake[i] = -1;
+	}
+    }
+#endif
+
   if(mstree != NULL)
     {
       splaytree_free(mstree, NULL);
@@ -3581,7 +4738,7 @@ static int kqueue_loop(void)
   struct timeval tv, to, *tvp;
   sc_master_t *ms;
   dlist_node_t *dn;
-  sc_fd_t *scfd, scfds[3];
+  sc_fd_t *scfd, scfds[4];
   sc_unit_t *scu;
   int i, rc;
 
@@ -3618,7 +4775,17 @@ static int kqueue_loop(void)
       scfd->fd = muxsocket;
       if(sc_fd_read_add(scfd) != 0)
 	return -1;
+      scfd++;
+    }
+#ifdef HAVE_TLSTHREADS
+  if(tls_wake[0] != -1)
+    {
+      scfd->type = FD_TYPE_TLSWAKE;
+      scfd->fd = tls_wake[0];
+      if(sc_fd_read_add(scfd) != 0)
+	return -1;
     }
+#endif
   scfd = NULL;
 
   /* main event loop */
@@ -3766,6 +4933,13 @@ static int kqueue_loop(void)
 	      muxsocket_accept(scfd->fd);
 	      continue;
 	    }
+#ifdef HAVE_TLSTHREADS
+	  else if(scfd->type == FD_TYPE_TLSWAKE)
+	    {
+	      tlsworkers_done_do();
+	      continue;
+	    }
+#endif
 
 	  scu = scfd->unit; assert(scu != NULL);
 
@@ -3920,7 +5094,7 @@ static int select_loop(void)
 		  FD_SET(ms->inet_fd.fd, &rfds);
 		  if(ms->inet_fd.fd > nfds)
 		    nfds = ms->inet_fd.fd;
-		  if(scamper_writebuf_len(ms->inet_wb) > 0)
+		  if(ms->inet_fd.flags & FD_FLAG_WRITE)
 		    {
 		      FD_SET(ms->inet_fd.fd, &wfds);
 		      wfdsp = &wfds;
@@ -4136,6 +5310,11 @@ int main(int argc, char *argv[])
      metadata_load() != 0)
     return -1;
 
+#ifdef HAVE_TLSTHREADS
+  if(tls_workerc > 0 && tls_certfile != NULL && tlsworkers_init() != 0)
+    return -1;
+#endif
+
 #if defined(HAVE_EPOLL)
   if((flags & FLAG_SELECT) == 0)
     return epoll_loop();
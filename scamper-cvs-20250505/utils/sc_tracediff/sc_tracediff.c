@@ -38,6 +38,7 @@
 
 #define OPT_NAMES    0x0001
 #define OPT_ALLPAIRS 0x0002
+#define OPT_INDEX    0x0004
 
 #define MATCH_DST       0
 #define MATCH_USERID    1
@@ -45,11 +46,30 @@
 
 typedef struct tracepair
 {
-  scamper_trace_t  *traces[2];
-  int               tracec;
-  splaytree_node_t *node;
+  scamper_trace_t    *traces[2];
+  scamper_file_raw_t *raws[2];
+  int                 tracec;
+  splaytree_node_t   *node;
 } tracepair_t;
 
+/*
+ * traceidx
+ *
+ * with -i, the first pass over the files records the key of each trace,
+ * a signature of the path it observed, and its position in each file.
+ * only pairs whose signatures differ are decoded again in the second
+ * pass.
+ */
+typedef struct traceidx
+{
+  scamper_addr_t     *dst;
+  uint32_t            userid;
+  uint32_t            ords[2];
+  uint64_t            sigs[2];
+  uint8_t             flags;
+  tracepair_t        *pair;
+} traceidx_t;
+
 static splaytree_t  *pairs = NULL;
 static char        **files = NULL;
 static int           filec = 0;
@@ -59,7 +79,7 @@ static int           match = MATCH_DST;
 static void usage(void)
 {
   fprintf(stderr,
-	  "usage: sc_tracediff [-an] [-m <match>] file1.warts file2.warts\n");
+	  "usage: sc_tracediff [-ain] [-m <match>] file1.warts file2.warts\n");
   return;
 }
 
@@ -67,7 +87,7 @@ static int check_options(int argc, char *argv[])
 {
   int i;
 
-  while((i = getopt(argc, argv, "am:n?")) != -1)
+  while((i = getopt(argc, argv, "aim:n?")) != -1)
     {
       switch(i)
 	{
@@ -75,6 +95,10 @@ static int check_options(int argc, char *argv[])
 	  options |= OPT_ALLPAIRS;
 	  break;
 
+	case 'i':
+	  options |= OPT_INDEX;
+	  break;
+
 	case 'm':
 	  if(strcasecmp(optarg, "dst") == 0)
 	    match = MATCH_DST;
@@ -242,8 +266,12 @@ static void tracepair_free(tracepair_t *pair)
   int i;
 
   for(i=0; i<filec; i++)
-    if(pair->traces[i] != NULL)
-      scamper_trace_free(pair->traces[i]);
+    {
+      if(pair->raws[i] != NULL)
+	scamper_file_raw_free(pair->raws[i]);
+      else if(pair->traces[i] != NULL)
+	scamper_trace_free(pair->traces[i]);
+    }
   free(pair);
 
   return;
@@ -437,45 +465,388 @@ static void tracepair_process(const tracepair_t *pair)
   return;
 }
 
-int main(int argc, char *argv[])
+static int file_iswarts(scamper_file_t *sf)
+{
+  char buf[8];
+
+  if(scamper_file_type_tostr(sf, buf, sizeof(buf)) != NULL &&
+     strcmp(buf, "warts") == 0)
+    return 1;
+
+  return 0;
+}
+
+static int files_open(scamper_file_t **file)
+{
+  int i;
+
+  for(i=0; i<filec; i++)
+    {
+      if((file[i] = scamper_file_open(files[i], 'r', NULL)) == NULL)
+	{
+	  fprintf(stderr, "could not open %s\n", files[i]);
+	  return -1;
+	}
+    }
+
+  return 0;
+}
+
+static void files_close(scamper_file_t **file)
+{
+  int i;
+
+  for(i=0; i<filec; i++)
+    {
+      if(file[i] != NULL)
+	{
+	  scamper_file_close(file[i]);
+	  file[i] = NULL;
+	}
+    }
+
+  return;
+}
+
+/*
+ * trace_sig
+ *
+ * hash the TTL and address of each hop that replied.  two traces with
+ * the same signature observed the same path, according to
+ * tracepair_isdiff.  two traces with different signatures might not
+ * have, as a hop that did not reply in one trace is not a difference.
+ */
+static uint64_t trace_sig(const scamper_trace_t *trace)
+{
+  const scamper_trace_reply_t *hop;
+  const scamper_addr_t *addr;
+  const uint8_t *buf;
+  uint64_t sig = 0xcbf29ce484222325ULL;
+  uint16_t hop_count = scamper_trace_hop_count_get(trace);
+  size_t j, len;
+  int i;
+
+  for(i=0; i<hop_count; i++)
+    {
+      if((hop = trace_reply_get(trace, i)) == NULL)
+	continue;
+      addr = scamper_trace_reply_addr_get(hop);
+      buf = scamper_addr_addr_get(addr);
+      len = scamper_addr_len_get(addr);
+
+      sig ^= (uint8_t)i;
+      sig *= 0x100000001b3ULL;
+      sig ^= (uint8_t)scamper_addr_type_get(addr);
+      sig *= 0x100000001b3ULL;
+      for(j=0; j<len; j++)
+	{
+	  sig ^= buf[j];
+	  sig *= 0x100000001b3ULL;
+	}
+    }
+
+  return sig;
+}
+
+static int traceidx_cmp(const traceidx_t *a, const traceidx_t *b)
+{
+  int i;
+
+  if(match != MATCH_USERID && (i = scamper_addr_cmp(a->dst, b->dst)) != 0)
+    return i;
+  if(match != MATCH_DST)
+    {
+      if(a->userid < b->userid) return -1;
+      if(a->userid > b->userid) return  1;
+    }
+
+  return 0;
+}
+
+static int traceidx_ord0_cmp(const void *va, const void *vb)
+{
+  const traceidx_t *a = *((const traceidx_t * const *)va);
+  const traceidx_t *b = *((const traceidx_t * const *)vb);
+  if(a->ords[0] < b->ords[0]) return -1;
+  if(a->ords[0] > b->ords[0]) return  1;
+  return 0;
+}
+
+static int traceidx_ord1_cmp(const void *va, const void *vb)
+{
+  const traceidx_t *a = *((const traceidx_t * const *)va);
+  const traceidx_t *b = *((const traceidx_t * const *)vb);
+  if(a->ords[1] < b->ords[1]) return -1;
+  if(a->ords[1] > b->ords[1]) return  1;
+  return 0;
+}
+
+static void traceidx_free(traceidx_t *idx)
+{
+  if(idx->dst != NULL)
+    scamper_addr_free(idx->dst);
+  if(idx->pair != NULL)
+    tracepair_free(idx->pair);
+  free(idx);
+  return;
+}
+
+/*
+ * tracediff_index_read
+ *
+ * read the next trace from a file in the second pass.  if the trace is
+ * not one that we need, then it is not decoded if the file is warts.
+ */
+static int tracediff_index_read(scamper_file_t *file, int iswarts,
+				scamper_file_filter_t *filter, int want,
+				scamper_trace_t **trace,
+				scamper_file_raw_t **raw)
+{
+  uint16_t type;
+
+  *trace = NULL;
+  *raw = NULL;
+
+  if(iswarts == 0)
+    {
+      if(scamper_file_read(file, filter, &type, (void *)trace) != 0 ||
+	 *trace == NULL)
+	return -1;
+      if(want == 0)
+	{
+	  scamper_trace_free(*trace);
+	  *trace = NULL;
+	}
+      return 0;
+    }
+
+  if(scamper_file_read_raw(file, filter, &type, raw) != 0 || *raw == NULL)
+    return -1;
+  if(want == 0)
+    {
+      scamper_file_raw_free(*raw);
+      *raw = NULL;
+    }
+  else if((*trace = (scamper_trace_t *)scamper_file_raw_decode(*raw)) == NULL)
+    return -1;
+
+  return 0;
+}
+
+/*
+ * tracediff_index
+ *
+ * compare the traces in two passes.  the first pass records a signature
+ * of each trace, and the second pass decodes the pairs of traces whose
+ * signatures differ.  the second pass reads the files in the same order
+ * as tracediff_all, so that the pairs are reported in the same order.
+ */
+static int tracediff_index(scamper_file_filter_t *filter)
 {
   scamper_file_t *file[2];
-  scamper_file_filter_t *filter;
+  scamper_file_raw_t *raw;
   scamper_trace_t *trace;
-  tracepair_t *pair, fm;
-  uint16_t type = SCAMPER_FILE_OBJ_TRACE;
+  traceidx_t *idx = NULL, *cand, fm, **cands[2];
+  uint32_t ords[2];
+  size_t candc = 0, candm = 0, c[2];
+  uint16_t type;
   char buf[256];
-  int i, filec_open;
+  int i, filec_open, iswarts[2], rc = -1;
 
-#ifdef HAVE_WSASTARTUP
-  WSADATA wsaData;
-  WSAStartup(MAKEWORD(2,2), &wsaData);
-#endif
+  memset(file, 0, sizeof(file));
+  memset(cands, 0, sizeof(cands));
+  memset(ords, 0, sizeof(ords));
 
-  if(check_options(argc, argv) != 0)
-    goto err;
+  if(files_open(file) != 0)
+    goto done;
+  filec_open = filec;
 
-  if((filter = scamper_file_filter_alloc(&type, 1)) == NULL)
+  if((pairs = splaytree_alloc((splaytree_cmp_t)traceidx_cmp)) == NULL)
     {
-      fprintf(stderr, "could not allocate filter\n");
-      goto err;
+      fprintf(stderr, "could not alloc traceidx tree\n");
+      goto done;
     }
 
-  memset(file, 0, sizeof(file));
+  while(filec_open != 0)
+    {
+      for(i=0; i<filec; i++)
+	{
+	  if(file[i] == NULL)
+	    continue;
+
+	  if(scamper_file_read(file[i], filter, &type, (void *)&trace) != 0)
+	    {
+	      fprintf(stderr, "could not read from %s\n", files[i]);
+	      goto done;
+	    }
+
+	  if(trace == NULL)
+	    {
+	      filec_open--;
+	      scamper_file_close(file[i]);
+	      file[i] = NULL;
+	      continue;
+	    }
+	  assert(type == SCAMPER_FILE_OBJ_TRACE);
+
+	  fm.dst = scamper_trace_dst_get(trace);
+	  fm.userid = scamper_trace_userid_get(trace);
+
+	  if((idx = splaytree_find(pairs, &fm)) == NULL)
+	    {
+	      if((idx = malloc_zero(sizeof(traceidx_t))) == NULL)
+		goto done;
+	      idx->dst = scamper_addr_use(fm.dst);
+	      idx->userid = fm.userid;
+	      if(splaytree_insert(pairs, idx) == NULL)
+		goto done;
+	    }
+	  else if(idx->flags & (1 << i))
+	    {
+	      scamper_addr_tostr(fm.dst, buf, sizeof(buf));
+	      fprintf(stderr, "repeated trace for %s\n", buf);
+	      idx = NULL;
+	      goto done;
+	    }
+
+	  idx->flags |= (1 << i);
+	  idx->ords[i] = ords[i]++;
+	  idx->sigs[i] = trace_sig(trace);
+	  scamper_trace_free(trace);
+
+	  if(idx->flags != 0x3)
+	    {
+	      idx = NULL;
+	      continue;
+	    }
+
+	  /*
+	   * the pair is complete: only keep it for the second pass if
+	   * the paths might differ.
+	   */
+	  splaytree_remove_item(pairs, idx);
+	  if((options & OPT_ALLPAIRS) == 0 && idx->sigs[0] == idx->sigs[1])
+	    {
+	      traceidx_free(idx);
+	      idx = NULL;
+	      continue;
+	    }
+	  if(array_insert_gb((void ***)&cands[0], &candc, &candm, 4096,
+			     idx, NULL) != 0)
+	    goto done;
+	  idx = NULL;
+	}
+    }
+
+  /* traces without a partner are not reported */
+  splaytree_free(pairs, (splaytree_free_t)traceidx_free);
+  pairs = NULL;
+
+  if(candc == 0)
+    {
+      rc = 0;
+      goto done;
+    }
+
+  /* sort the candidates by their position in each file */
+  if((cands[1] = memdup(cands[0], sizeof(traceidx_t *) * candc)) == NULL)
+    goto done;
+  qsort(cands[0], candc, sizeof(traceidx_t *), traceidx_ord0_cmp);
+  qsort(cands[1], candc, sizeof(traceidx_t *), traceidx_ord1_cmp);
+
+  if(files_open(file) != 0)
+    goto done;
   for(i=0; i<filec; i++)
     {
-      if((file[i] = scamper_file_open(files[i], 'r', NULL)) == NULL)
+      iswarts[i] = file_iswarts(file[i]);
+      ords[i] = 0;
+      c[i] = 0;
+    }
+
+  /* stop reading each file after the last trace we need from it */
+  filec_open = filec;
+  while(filec_open != 0)
+    {
+      for(i=0; i<filec; i++)
 	{
-	  fprintf(stderr, "could not open %s\n", files[i]);
-	  goto err;
+	  if(file[i] == NULL)
+	    continue;
+
+	  cand = cands[i][c[i]];
+	  if(tracediff_index_read(file[i], iswarts[i], filter,
+				  cand->ords[i] == ords[i], &trace, &raw) != 0)
+	    {
+	      fprintf(stderr, "could not read from %s\n", files[i]);
+	      goto done;
+	    }
+	  if(cand->ords[i] != ords[i]++)
+	    continue;
+
+	  if(cand->pair == NULL &&
+	     (cand->pair = malloc_zero(sizeof(tracepair_t))) == NULL)
+	    {
+	      if(raw != NULL) scamper_file_raw_free(raw);
+	      else scamper_trace_free(trace);
+	      goto done;
+	    }
+	  cand->pair->traces[i] = trace;
+	  cand->pair->raws[i] = raw;
+	  cand->pair->tracec++;
+
+	  if(++c[i] == candc)
+	    {
+	      filec_open--;
+	      scamper_file_close(file[i]);
+	      file[i] = NULL;
+	    }
+
+	  if(cand->pair->tracec == filec)
+	    {
+	      tracepair_process(cand->pair);
+	      tracepair_free(cand->pair);
+	      cand->pair = NULL;
+	    }
 	}
     }
+
+  rc = 0;
+
+ done:
+  if(idx != NULL) traceidx_free(idx);
+  if(pairs != NULL)
+    {
+      splaytree_free(pairs, (splaytree_free_t)traceidx_free);
+      pairs = NULL;
+    }
+  if(cands[0] != NULL)
+    {
+      for(c[0]=0; c[0]<candc; c[0]++)
+	traceidx_free(cands[0][c[0]]);
+      free(cands[0]);
+    }
+  if(cands[1] != NULL) free(cands[1]);
+  files_close(file);
+  return rc;
+}
+
+static int tracediff_all(scamper_file_filter_t *filter)
+{
+  scamper_file_t *file[2];
+  scamper_trace_t *trace;
+  tracepair_t *pair, fm;
+  uint16_t type;
+  char buf[256];
+  int i, filec_open;
+
+  memset(file, 0, sizeof(file));
+  if(files_open(file) != 0)
+    return -1;
   filec_open = filec;
 
   if((pairs = splaytree_alloc((splaytree_cmp_t)tracepair_cmp)) == NULL)
     {
       fprintf(stderr, "could not alloc tracepair tree\n");
-      goto err;
+      return -1;
     }
 
   while(filec_open != 0)
@@ -488,7 +859,7 @@ int main(int argc, char *argv[])
 	  if(scamper_file_read(file[i], filter, &type, (void *)&trace) != 0)
 	    {
 	      fprintf(stderr, "could not read from %s\n", files[i]);
-	      goto err;
+	      return -1;
 	    }
 
 	  if(trace == NULL)
@@ -506,11 +877,11 @@ int main(int argc, char *argv[])
 	  if((pair = splaytree_find(pairs, &fm)) == NULL)
 	    {
 	      if((pair = malloc_zero(sizeof(tracepair_t))) == NULL)
-		goto err;
+		return -1;
 	      pair->traces[i] = trace;
 	      pair->tracec = 1;
 	      if((pair->node = splaytree_insert(pairs, pair)) == NULL)
-		goto err;
+		return -1;
 	    }
 	  else
 	    {
@@ -519,7 +890,7 @@ int main(int argc, char *argv[])
 		  scamper_addr_tostr(scamper_trace_dst_get(trace),
 				     buf, sizeof(buf));
 		  fprintf(stderr, "repeated trace for %s\n", buf);
-		  goto err;
+		  return -1;
 		}
 	      pair->traces[i] = trace;
 	      pair->tracec++;
@@ -535,7 +906,33 @@ int main(int argc, char *argv[])
     }
 
   return 0;
+}
+
+int main(int argc, char *argv[])
+{
+  scamper_file_filter_t *filter;
+  uint16_t type = SCAMPER_FILE_OBJ_TRACE;
+  int rc;
+
+#ifdef HAVE_WSASTARTUP
+  WSADATA wsaData;
+  WSAStartup(MAKEWORD(2,2), &wsaData);
+#endif
+
+  if(check_options(argc, argv) != 0)
+    return -1;
+
+  if((filter = scamper_file_filter_alloc(&type, 1)) == NULL)
+    {
+      fprintf(stderr, "could not allocate filter\n");
+      return -1;
+    }
+
+  if(options & OPT_INDEX)
+    rc = tracediff_index(filter);
+  else
+    rc = tracediff_all(filter);
 
- err:
-  return -1;
+  scamper_file_filter_free(filter);
+  return rc;
 }
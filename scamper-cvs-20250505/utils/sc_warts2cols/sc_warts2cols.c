@@ -0,0 +1,218 @@
+/*
+ * sc_warts2cols
+ *
+ * convert ping, traceroute, and alias resolution measurements in warts
+ * files to the columnar format described in cols(5).
+ *
+ * $Id$
+ *
+ * Copyright (C) 2025 The Regents of the University of California
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include "internal.h"
+
+#include "scamper_addr.h"
+#include "scamper_list.h"
+#include "trace/scamper_trace.h"
+#include "ping/scamper_ping.h"
+#include "dealias/scamper_dealias.h"
+#include "scamper_file.h"
+#include "utils.h"
+
+#define OPT_OUTFILE 0x00000001 /* o: */
+#define OPT_HELP    0x00000002 /* ?: */
+
+static uint32_t                options    = 0;
+static char                  **infiles    = NULL;
+static int                     infile_cnt = 0;
+static scamper_file_t         *outfile    = NULL;
+static scamper_file_filter_t  *filter     = NULL;
+
+static void usage(const char *argv0, uint32_t opt_mask)
+{
+  fprintf(stderr, "usage: sc_warts2cols [-?] [-o outfile] [infile 1 .. N]\n");
+
+  if(opt_mask == 0) return;
+
+  fprintf(stderr, "\n");
+
+  if(opt_mask & OPT_HELP)
+    fprintf(stderr, "    -? give an overview of the usage of sc_warts2cols\n");
+
+  if(opt_mask & OPT_OUTFILE)
+    fprintf(stderr, "    -o output file to write\n");
+
+  return;
+}
+
+static int check_options(int argc, char *argv[])
+{
+  char *opts = "o:?";
+  char *opt_outfile = NULL;
+  int ch;
+
+  while((ch = getopt(argc, argv, opts)) != -1)
+    {
+      switch(ch)
+	{
+	case 'o':
+	  options |= OPT_OUTFILE;
+	  opt_outfile = optarg;
+	  break;
+
+	case '?':
+	default:
+	  usage(argv[0], 0xffffffff);
+	  return -1;
+	}
+    }
+
+  infile_cnt = argc - optind;
+  if(infile_cnt > 0)
+    infiles = argv + optind;
+
+  if(opt_outfile == NULL || string_isdash(opt_outfile) != 0)
+    {
+      if(isatty(STDOUT_FILENO))
+	{
+	  usage(argv[0], OPT_OUTFILE);
+	  return -1;
+	}
+      outfile = scamper_file_openfd(STDOUT_FILENO, "-", 'w', "cols");
+    }
+  else
+    {
+      outfile = scamper_file_open(opt_outfile, 'w', "cols");
+    }
+
+  if(outfile == NULL)
+    {
+      fprintf(stderr, "could not open %s: %s\n",
+	      opt_outfile != NULL ? opt_outfile : "stdout", strerror(errno));
+      return -1;
+    }
+
+  return 0;
+}
+
+static void obj_free(uint16_t type, void *data)
+{
+  if(type == SCAMPER_FILE_OBJ_TRACE)
+    scamper_trace_free(data);
+  else if(type == SCAMPER_FILE_OBJ_PING)
+    scamper_ping_free(data);
+  else if(type == SCAMPER_FILE_OBJ_DEALIAS)
+    scamper_dealias_free(data);
+  return;
+}
+
+static int convert(scamper_file_t *in, const char *name)
+{
+  uint16_t type;
+  void *data;
+
+  while(scamper_file_read(in, filter, &type, &data) == 0)
+    {
+      if(data == NULL)
+	return 0; /* EOF */
+      if(scamper_file_write_obj(outfile, type, data) != 0)
+	{
+	  fprintf(stderr, "could not write object from %s\n", name);
+	  obj_free(type, data);
+	  return -1;
+	}
+      obj_free(type, data);
+    }
+
+  fprintf(stderr, "could not read from %s\n", name);
+  return -1;
+}
+
+static void cleanup(void)
+{
+  if(filter != NULL)
+    {
+      scamper_file_filter_free(filter);
+      filter = NULL;
+    }
+
+  if(outfile != NULL)
+    {
+      scamper_file_close(outfile);
+      outfile = NULL;
+    }
+
+  return;
+}
+
+int main(int argc, char *argv[])
+{
+  uint16_t filter_types[] = {
+    SCAMPER_FILE_OBJ_TRACE,
+    SCAMPER_FILE_OBJ_PING,
+    SCAMPER_FILE_OBJ_DEALIAS,
+  };
+  uint16_t filter_cnt = sizeof(filter_types)/sizeof(uint16_t);
+  scamper_file_t *in;
+  int i, rc;
+
+#if defined(DMALLOC)
+  free(malloc(1));
+#endif
+
+  atexit(cleanup);
+
+  if(check_options(argc, argv) != 0)
+    return -1;
+
+  if((filter = scamper_file_filter_alloc(filter_types, filter_cnt)) == NULL)
+    {
+      fprintf(stderr, "could not allocate filter\n");
+      return -1;
+    }
+
+  if(infile_cnt == 0)
+    {
+      if((in = scamper_file_openfd(STDIN_FILENO, "-", 'r', "warts")) == NULL)
+	{
+	  fprintf(stderr, "could not use stdin\n");
+	  return -1;
+	}
+      rc = convert(in, "stdin");
+      scamper_file_close(in);
+      return rc;
+    }
+
+  for(i=0; i<infile_cnt; i++)
+    {
+      if((in = scamper_file_open(infiles[i], 'r', NULL)) == NULL)
+	{
+	  fprintf(stderr, "could not open %s: %s\n",
+		  infiles[i], strerror(errno));
+	  return -1;
+	}
+      rc = convert(in, infiles[i]);
+      scamper_file_close(in);
+      if(rc != 0)
+	return -1;
+    }
+
+  return 0;
+}
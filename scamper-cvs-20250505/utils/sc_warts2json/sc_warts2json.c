@@ -10,6 +10,7 @@
  * Copyright (C) 2006-2011 The University of Waikato
  * Copyright (C) 2013      The Regents of the University of California
  * Copyright (C) 2023      Matthew Luckie
+ * Copyright (C) 2025      The Regents of the University of California
  *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -31,6 +32,10 @@
 #endif
 #include "internal.h"
 
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
 #include "scamper_file.h"
 #include "scamper_addr.h"
 #include "scamper_list.h"
@@ -41,8 +46,288 @@
 #include "tbit/scamper_tbit.h"
 #include "host/scamper_host.h"
 #include "udpprobe/scamper_udpprobe.h"
+#include "mjl_list.h"
+#include "mjl_threadpool.h"
 #include "utils.h"
 
+typedef int  (*wf_t)(scamper_file_t *, const void *, void *);
+typedef void (*ff_t)(void *);
+
+typedef struct funcset
+{
+  wf_t write;
+  ff_t datafree;
+} funcset_t;
+
+/*
+ * sc_job
+ *
+ * an object read from the input, and the JSON an encoder thread
+ * rendered for it.  jobs are written in the order they were read.
+ */
+typedef struct sc_job
+{
+  uint16_t  type;
+  void     *data;
+  char     *buf;
+  size_t    len;
+  int       done;
+  int       rc;
+} sc_job_t;
+
+static const funcset_t funcs[] = {
+  {NULL, NULL},
+  {NULL, NULL}, /* list */
+  {NULL, (ff_t)scamper_cycle_free}, /* cycle start */
+  {NULL, NULL}, /* cycle def */
+  {NULL, (ff_t)scamper_cycle_free}, /* cycle stop */
+  {NULL, NULL}, /* addr */
+  {(wf_t)scamper_file_write_trace,    (ff_t)scamper_trace_free},
+  {(wf_t)scamper_file_write_ping,     (ff_t)scamper_ping_free},
+  {(wf_t)scamper_file_write_tracelb,  (ff_t)scamper_tracelb_free},
+  {(wf_t)scamper_file_write_dealias,  (ff_t)scamper_dealias_free},
+  {NULL, NULL}, /* neighbour discovery */
+  {(wf_t)scamper_file_write_tbit,     (ff_t)scamper_tbit_free},
+  {NULL, NULL}, /* sting */
+  {NULL, NULL}, /* sniff */
+  {(wf_t)scamper_file_write_host,     (ff_t)scamper_host_free},
+  {NULL, NULL}, /* http */
+  {(wf_t)scamper_file_write_udpprobe, (ff_t)scamper_udpprobe_free},
+};
+
+static char          **files     = NULL;
+static int             filec     = 0;
+static slist_t        *jobs      = NULL;
+static threadpool_t   *tp        = NULL;
+static scamper_file_t *encode_sf = NULL;
+
+#ifdef HAVE_PTHREAD
+static long            threadc   = 0;
+static pthread_mutex_t job_mutex;
+static pthread_cond_t  job_cond;
+#endif
+
+/*
+ * the number of objects that can be waiting to be encoded or written
+ * for each encoder thread, which bounds the memory used when one object
+ * takes much longer to encode than those read after it.
+ */
+#define JOBS_PER_THREAD 64
+
+static void usage(void)
+{
+  const char *j = "";
+
+#ifdef HAVE_PTHREAD
+  j = " [-j threadc]";
+#endif
+
+  fprintf(stderr, "usage: sc_warts2json%s [file1 .. fileN]\n", j);
+  return;
+}
+
+static int check_options(int argc, char *argv[])
+{
+  char opts[8];
+  size_t off = 0;
+  int ch;
+
+#ifdef HAVE_PTHREAD
+  char *opt_threadc = NULL;
+  long lo;
+#endif
+
+  string_concat(opts, sizeof(opts), &off, "?");
+#ifdef HAVE_PTHREAD
+  string_concat(opts, sizeof(opts), &off, "j:");
+#endif
+
+  while((ch = getopt(argc, argv, opts)) != -1)
+    {
+      switch(ch)
+	{
+#ifdef HAVE_PTHREAD
+	case 'j':
+	  opt_threadc = optarg;
+	  break;
+#endif
+
+	default:
+	  usage();
+	  return -1;
+	}
+    }
+
+#ifdef HAVE_PTHREAD
+  if(opt_threadc != NULL)
+    {
+      if(string_tolong(opt_threadc, &lo) != 0 || lo < 0)
+	{
+	  usage();
+	  return -1;
+	}
+      threadc = lo;
+    }
+#endif
+
+  filec = argc - optind;
+  if(filec > 0)
+    files = argv + optind;
+
+  return 0;
+}
+
+static void job_free(sc_job_t *job)
+{
+  if(job->data != NULL)
+    funcs[job->type].datafree(job->data);
+  if(job->buf != NULL)
+    free(job->buf);
+  free(job);
+  return;
+}
+
+#ifdef HAVE_PTHREAD
+/*
+ * json_collect
+ *
+ * the json writers call this function with the JSON for an object,
+ * which is kept with the job until the job is written.
+ */
+static int json_collect(void *param, const void *data, size_t len, void *p)
+{
+  sc_job_t *job = p;
+
+  if(realloc_wrap((void **)&job->buf, job->len + len) != 0)
+    return -1;
+  memcpy(job->buf + job->len, data, len);
+  job->len += len;
+
+  return 0;
+}
+
+/*
+ * json_encode
+ *
+ * render the object as JSON.  this runs in an encoder thread, so the
+ * object is not freed here: objects read from the same file share
+ * reference-counted lists and cycles with objects the reader is still
+ * decoding, and the reference counts are not protected by a lock.
+ */
+static void json_encode(sc_job_t *job)
+{
+  int rc;
+
+  rc = funcs[job->type].write(encode_sf, job->data, job);
+
+  pthread_mutex_lock(&job_mutex);
+  job->rc = rc;
+  job->done = 1;
+  pthread_cond_signal(&job_cond);
+  pthread_mutex_unlock(&job_mutex);
+
+  return;
+}
+
+/*
+ * jobs_write
+ *
+ * write out the jobs at the head of the list that have been encoded,
+ * waiting for encoder threads until no more than max jobs are
+ * outstanding.
+ */
+static int jobs_write(scamper_file_t *out, size_t max)
+{
+  sc_job_t *job;
+  int done, rc = 0;
+
+  while((job = slist_head_item(jobs)) != NULL)
+    {
+      pthread_mutex_lock(&job_mutex);
+      while(job->done == 0 && (size_t)slist_count(jobs) > max)
+	pthread_cond_wait(&job_cond, &job_mutex);
+      done = job->done;
+      pthread_mutex_unlock(&job_mutex);
+      if(done == 0)
+	break;
+
+      slist_head_pop(jobs);
+      if((rc = job->rc) == 0)
+	{
+	  if(funcs[job->type].write == NULL)
+	    rc = scamper_file_write_obj(out, job->type, job->data);
+	  else
+	    rc = write_wrap(STDOUT_FILENO, job->buf, NULL, job->len);
+	}
+      job_free(job);
+      if(rc != 0)
+	break;
+    }
+
+  return rc;
+}
+#endif
+
+/*
+ * process
+ *
+ * read the objects in the file.  without encoder threads, write each
+ * object as it is read.  otherwise, pass the object to an encoder
+ * thread, and write out any objects that have been encoded.
+ */
+static int process(scamper_file_t *in, scamper_file_t *out,
+		   scamper_file_filter_t *filter)
+{
+#ifdef HAVE_PTHREAD
+  sc_job_t *job;
+#endif
+  uint16_t type;
+  void *data;
+  int rc;
+
+  while(scamper_file_read(in, filter, &type, (void *)&data) == 0)
+    {
+      if(data == NULL)
+	return 0; /* EOF */
+
+      if(tp == NULL)
+	{
+	  rc = scamper_file_write_obj(out, type, data);
+	  funcs[type].datafree(data);
+	  if(rc != 0)
+	    return -1;
+	  continue;
+	}
+
+#ifdef HAVE_PTHREAD
+      if((job = malloc_zero(sizeof(sc_job_t))) == NULL)
+	{
+	  funcs[type].datafree(data);
+	  return -1;
+	}
+      job->type = type;
+      job->data = data;
+      if(slist_tail_push(jobs, job) == NULL)
+	{
+	  job_free(job);
+	  return -1;
+	}
+
+      /* cycle records are written as is, without an encoder thread */
+      if(funcs[type].write == NULL)
+	job->done = 1;
+      else if(threadpool_tail_push(tp, (threadpool_func_t)json_encode,
+				   job) != 0)
+	return -1;
+
+      if(jobs_write(out, threadc * JOBS_PER_THREAD) != 0)
+	return -1;
+#endif
+    }
+
+  return 0;
+}
+
 int main(int argc, char *argv[])
 {
   uint16_t types[] = {
@@ -56,30 +341,49 @@ int main(int argc, char *argv[])
     SCAMPER_FILE_OBJ_HOST,
     SCAMPER_FILE_OBJ_UDPPROBE,
   };
-  scamper_file_t *in, *out;
-  scamper_file_filter_t *filter;
-  char **files = NULL;
-  int filec;
-  uint16_t type;
-  void *data;
-  int i;
+  scamper_file_t *in = NULL, *out = NULL;
+  scamper_file_filter_t *filter = NULL;
+  int i, rc = -1;
+
+  if(check_options(argc, argv) != 0)
+    return -1;
 
   if((out = scamper_file_openfd(STDOUT_FILENO, NULL, 'w', "json")) == NULL)
     {
       fprintf(stderr, "could not associate stdout\n");
-      return -1;
+      goto done;
     }
 
   filter = scamper_file_filter_alloc(types, sizeof(types)/sizeof(uint16_t));
   if(filter == NULL)
     {
       fprintf(stderr, "could not allocate filter\n");
-      return -1;
+      goto done;
     }
 
-  filec = argc - 1;
-  if(filec > 0)
-    files = argv + 1;
+#ifdef HAVE_PTHREAD
+  if(threadc > 0)
+    {
+      if(pthread_mutex_init(&job_mutex, NULL) != 0 ||
+	 pthread_cond_init(&job_cond, NULL) != 0)
+	{
+	  fprintf(stderr, "could not init job mutex\n");
+	  goto done;
+	}
+      if((encode_sf = scamper_file_opennull('w', "json")) == NULL)
+	{
+	  fprintf(stderr, "could not open encoder\n");
+	  goto done;
+	}
+      scamper_file_setwritefunc(encode_sf, NULL, json_collect);
+      if((jobs = slist_alloc()) == NULL ||
+	 (tp = threadpool_alloc(threadc)) == NULL)
+	{
+	  fprintf(stderr, "could not allocate %ld threads\n", threadc);
+	  goto done;
+	}
+    }
+#endif
 
   for(i=0; i<=filec; i++)
     {
@@ -88,7 +392,7 @@ int main(int argc, char *argv[])
 	  if((in = scamper_file_openfd(STDIN_FILENO,"-",'r',"warts")) == NULL)
 	    {
 	      fprintf(stderr, "could not use stdin\n");
-	      return -1;
+	      goto done;
 	    }
 	}
       else if(i < filec)
@@ -97,42 +401,31 @@ int main(int argc, char *argv[])
 	    {
 	      fprintf(stderr, "could not open %s: %s\n",
 		      files[i], strerror(errno));
-	      return -1;
+	      goto done;
 	    }
 	}
       else break;
 
-      while(scamper_file_read(in, filter, &type, (void *)&data) == 0)
-	{
-	  if(data == NULL)
-	    break; /* EOF */
+      if(process(in, out, filter) != 0)
+	goto done;
 
-	  if(scamper_file_write_obj(out, type, data) != 0)
-	    return -1;
+      scamper_file_close(in); in = NULL;
+    }
 
-	  if(type == SCAMPER_FILE_OBJ_PING)
-	    scamper_ping_free(data);
-	  else if(type == SCAMPER_FILE_OBJ_TRACE)
-	    scamper_trace_free(data);
-	  else if(type == SCAMPER_FILE_OBJ_DEALIAS)
-	    scamper_dealias_free(data);
-	  else if(type == SCAMPER_FILE_OBJ_TBIT)
-	    scamper_tbit_free(data);
-	  else if(type == SCAMPER_FILE_OBJ_TRACELB)
-	    scamper_tracelb_free(data);
-	  else if(type == SCAMPER_FILE_OBJ_HOST)
-	    scamper_host_free(data);
-	  else if(type == SCAMPER_FILE_OBJ_UDPPROBE)
-	    scamper_udpprobe_free(data);
-	  else if(type == SCAMPER_FILE_OBJ_CYCLE_START ||
-		  type == SCAMPER_FILE_OBJ_CYCLE_STOP)
-	    scamper_cycle_free(data);
-	}
+#ifdef HAVE_PTHREAD
+  if(tp != NULL && jobs_write(out, 0) != 0)
+    goto done;
+#endif
 
-      scamper_file_close(in);
-    }
+  rc = 0;
 
-  scamper_file_filter_free(filter);
-  scamper_file_close(out);
-  return 0;
+ done:
+  /* wait for the encoder threads before freeing the jobs they use */
+  if(tp != NULL) threadpool_join(tp);
+  if(jobs != NULL) slist_free_cb(jobs, (slist_free_t)job_free);
+  if(encode_sf != NULL) scamper_file_close(encode_sf);
+  if(in != NULL) scamper_file_close(in);
+  if(filter != NULL) scamper_file_filter_free(filter);
+  if(out != NULL) scamper_file_close(out);
+  return rc;
 }
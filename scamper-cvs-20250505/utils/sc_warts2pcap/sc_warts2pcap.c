@@ -37,6 +37,7 @@
 #include "sniff/scamper_sniff.h"
 #include "utils.h"
 #include "mjl_list.h"
+#include "mjl_heap.h"
 
 /*
  * pcap file header
@@ -61,13 +62,88 @@ typedef struct prec {
   uint32_t orig_len;       /* actual length of packet */
 } prec_t;
 
+/*
+ * pcapng section header block, followed by an interface description
+ * block for the raw IP interface that all packets are recorded on.
+ */
+typedef struct ng_shb {
+  uint32_t type;           /* 0x0a0d0d0a */
+  uint32_t len;            /* block total length */
+  uint32_t magic;          /* byte-order magic */
+  uint16_t version_major;
+  uint16_t version_minor;
+  uint32_t section_len[2]; /* all bits set: not specified */
+  uint32_t len2;
+} ng_shb_t;
+
+typedef struct ng_idb {
+  uint32_t type;           /* 1 */
+  uint32_t len;
+  uint16_t linktype;
+  uint16_t reserved;
+  uint32_t snaplen;
+  uint32_t len2;
+} ng_idb_t;
+
+/*
+ * pcapng enhanced packet block header.  the packet follows, padded to
+ * a four byte boundary, and then the block total length again.
+ */
+typedef struct ng_epb {
+  uint32_t type;           /* 6 */
+  uint32_t len;
+  uint32_t ifid;
+  uint32_t ts_high;        /* microseconds since the epoch */
+  uint32_t ts_low;
+  uint32_t cap_len;
+  uint32_t orig_len;
+} ng_epb_t;
+
+/*
+ * pkt
+ *
+ * a packet held for sorting.  the data points into the object the packet
+ * came from, which is held until the packets are written.
+ */
 typedef struct pkt
 {
-  uint8_t       *data;
-  uint16_t       len;
-  struct timeval tv;
+  const uint8_t        *data;
+  uint16_t              len;
+  const struct timeval *tv;
+  size_t                seq;
 } pkt_t;
 
+/*
+ * obj
+ *
+ * an object read from a file, held while its packets are sorted.
+ */
+typedef struct obj
+{
+  uint16_t              type;
+  void                 *data;
+} obj_t;
+
+/*
+ * input
+ *
+ * an input file being merged with the others, and the packet it will
+ * write next.
+ */
+typedef struct input
+{
+  scamper_file_t       *file;
+  const char           *name;
+  int                   id;
+  uint16_t              type;
+  void                 *data;
+  uint32_t              pkti;
+  uint32_t              pktc;
+  const uint8_t        *pkt;
+  uint16_t              len;
+  const struct timeval *tv;
+} input_t;
+
 typedef struct sort
 {
   int (*init)(void);
@@ -75,12 +151,25 @@ typedef struct sort
   int (*finish)(void);
 } sort_t;
 
+#define FORMAT_PCAP   0
+#define FORMAT_PCAPNG 1
+
+#define SORT_NONE     0
+#define SORT_PACKET   1
+#define SORT_MERGE    2
+
+/* the size of the buffer that packets are written into */
+#define OBUF_SIZE     (1024 * 1024)
+
 static scamper_file_filter_t *filter = NULL;
 static char *outfile_name = NULL;
-static FILE *outfile_fd = NULL;
+static int outfile_fd = -1;
+static uint8_t *obuf = NULL;
+static size_t obuf_off = 0;
 static char **files = NULL;
 static int filec = 0;
-static int sorti = 0;
+static int sorti = SORT_NONE;
+static int format = FORMAT_PCAP;
 
 static int sort_0(uint16_t type, void *data);
 static int init_1(void);
@@ -95,7 +184,8 @@ static const sort_t sort[] = {
 static void usage(void)
 {
   fprintf(stderr,
-	  "usage: sc_warts2pcap [-o outfile] [-s sorting] warts-files\n");
+	  "usage: sc_warts2pcap [-f format] [-o outfile] [-s sorting]"
+	  " warts-files\n");
   return;
 }
 
@@ -103,21 +193,38 @@ static int check_options(int argc, char *argv[])
 {
   int ch;
 
-  while((ch = getopt(argc, argv, "o:s:")) != -1)
+  while((ch = getopt(argc, argv, "f:o:s:")) != -1)
     {
       switch(ch)
 	{
+	case 'f':
+	  if(strcasecmp(optarg, "pcap") == 0)
+	    format = FORMAT_PCAP;
+	  else if(strcasecmp(optarg, "pcapng") == 0)
+	    format = FORMAT_PCAPNG;
+	  else
+	    {
+	      usage();
+	      return -1;
+	    }
+	  break;
+
 	case 'o':
 	  outfile_name = optarg;
 	  break;
 
 	case 's':
 	  if(strcasecmp(optarg, "none") == 0)
-	    sorti = 0;
+	    sorti = SORT_NONE;
 	  else if(strcasecmp(optarg, "packet") == 0)
-	    sorti = 1;
+	    sorti = SORT_PACKET;
+	  else if(strcasecmp(optarg, "merge") == 0)
+	    sorti = SORT_MERGE;
 	  else
-	    return -1;
+	    {
+	      usage();
+	      return -1;
+	    }
 	  break;
 
 	case '?':
@@ -132,157 +239,294 @@ static int check_options(int argc, char *argv[])
   return 0;
 }
 
-static int pkt_write(const uint8_t *data, uint16_t len,
-		     const struct timeval *tv, void *p)
+static int out_flush(void)
 {
-  prec_t rec;
-
-  memset(&rec, 0, sizeof(rec));
-  rec.ts_sec = tv->tv_sec;
-  rec.ts_usec = tv->tv_usec;
-  rec.incl_len = len;
-  rec.orig_len = len;
-
-  if(fwrite(&rec, sizeof(rec), 1, outfile_fd) != 1)
-    return -1;
-  if(fwrite(data, len, 1, outfile_fd) != 1)
-    return -1;
+  if(obuf_off == 0)
+    return 0;
+  if(write_wrap(outfile_fd, obuf, NULL, obuf_off) != 0)
+    {
+      fprintf(stderr, "could not write output: %s\n", strerror(errno));
+      return -1;
+    }
+  obuf_off = 0;
   return 0;
 }
 
-static void pkt_free(pkt_t *pkt)
+/*
+ * out_reserve
+ *
+ * return a pointer to len bytes in the output buffer, writing out the
+ * buffer first if there is not enough room.
+ */
+static uint8_t *out_reserve(size_t len)
 {
-  if(pkt == NULL) return;
-  if(pkt->data != NULL) free(pkt->data);
-  free(pkt);
-  return;
+  uint8_t *ptr;
+  assert(len <= OBUF_SIZE);
+  if(obuf_off + len > OBUF_SIZE && out_flush() != 0)
+    return NULL;
+  ptr = obuf + obuf_off;
+  obuf_off += len;
+  return ptr;
 }
 
-static int pkt_cmp(const pkt_t *a, const pkt_t *b)
+static int hdr_write(void)
 {
-  return timeval_cmp(&a->tv, &b->tv);
+  phdr_t hdr;
+  ng_shb_t shb;
+  ng_idb_t idb;
+  uint8_t *ptr;
+
+  if(format == FORMAT_PCAPNG)
+    {
+      memset(&shb, 0, sizeof(shb));
+      shb.type = 0x0a0d0d0a;
+      shb.len = shb.len2 = sizeof(shb);
+      shb.magic = 0x1a2b3c4d;
+      shb.version_major = 1;
+      shb.version_minor = 0;
+      shb.section_len[0] = shb.section_len[1] = 0xffffffff;
+
+      memset(&idb, 0, sizeof(idb));
+      idb.type = 1;
+      idb.len = idb.len2 = sizeof(idb);
+      idb.linktype = 101; /* LINKTYPE_RAW */
+      idb.snaplen = 65535;
+
+      if((ptr = out_reserve(sizeof(shb) + sizeof(idb))) == NULL)
+	return -1;
+      memcpy(ptr, &shb, sizeof(shb));
+      memcpy(ptr + sizeof(shb), &idb, sizeof(idb));
+      return 0;
+    }
+
+  hdr.magic_number = 0xa1b2c3d4;
+  hdr.version_major = 2;
+  hdr.version_minor = 4;
+  hdr.thiszone = 0;
+  hdr.sigfigs = 0;
+  hdr.snaplen = 65535;
+  hdr.network = 12; /* DLT_RAW */
+  if((ptr = out_reserve(sizeof(hdr))) == NULL)
+    return -1;
+  memcpy(ptr, &hdr, sizeof(hdr));
+  return 0;
 }
 
-static int pkt_push(const uint8_t *data, uint16_t len,
-		    const struct timeval *tv, void *p)
+/*
+ * pkt_write
+ *
+ * copy the packet straight from the object it is held in to the output
+ * buffer, behind a pcap or pcapng record header.
+ */
+static int pkt_write(const uint8_t *data, uint16_t len,
+		     const struct timeval *tv, void *p)
 {
-  slist_t *list = p;
-  pkt_t *pkt = NULL;
-
-  if((pkt = malloc_zero(sizeof(pkt_t))) == NULL)
-    goto err;
-  if((pkt->data = memdup(data, len)) == NULL)
-    goto err;
-  pkt->len = len;
-  timeval_cpy(&pkt->tv, tv);
+  uint64_t ts;
+  uint32_t blen;
+  uint8_t *ptr;
+  ng_epb_t epb;
+  prec_t rec;
+  size_t pad;
 
-  if(slist_tail_push(list, pkt) == NULL)
-    goto err;
+  if(format == FORMAT_PCAPNG)
+    {
+      pad = (4 - (len % 4)) % 4;
+      blen = sizeof(epb) + len + pad + sizeof(uint32_t);
+      if((ptr = out_reserve(blen)) == NULL)
+	return -1;
+      ts = ((uint64_t)tv->tv_sec * 1000000) + tv->tv_usec;
+      epb.type = 6;
+      epb.len = blen;
+      epb.ifid = 0;
+      epb.ts_high = ts >> 32;
+      epb.ts_low = ts & 0xffffffff;
+      epb.cap_len = len;
+      epb.orig_len = len;
+      memcpy(ptr, &epb, sizeof(epb)); ptr += sizeof(epb);
+      memcpy(ptr, data, len); ptr += len;
+      memset(ptr, 0, pad); ptr += pad;
+      memcpy(ptr, &blen, sizeof(blen));
+      return 0;
+    }
 
+  if((ptr = out_reserve(sizeof(rec) + len)) == NULL)
+    return -1;
+  memset(&rec, 0, sizeof(rec));
+  rec.ts_sec = tv->tv_sec;
+  rec.ts_usec = tv->tv_usec;
+  rec.incl_len = len;
+  rec.orig_len = len;
+  memcpy(ptr, &rec, sizeof(rec));
+  memcpy(ptr + sizeof(rec), data, len);
   return 0;
+}
 
- err:
-  pkt_free(pkt);
-  return -1;
+static uint32_t obj_pktc(uint16_t type, const void *data)
+{
+  if(type == SCAMPER_FILE_OBJ_TBIT)
+    return scamper_tbit_pktc_get(data);
+  else if(type == SCAMPER_FILE_OBJ_STING)
+    return scamper_sting_pktc_get(data);
+  else if(type == SCAMPER_FILE_OBJ_SNIFF)
+    return scamper_sniff_pktc_get(data);
+  return 0;
 }
 
-static int doit(uint16_t type, void *data,
-		int (*func)(const uint8_t *, uint16_t,
-			    const struct timeval *, void *),
-		void *param)
+static void obj_pkt(uint16_t type, const void *data, uint32_t i,
+		    const uint8_t **pkt, uint16_t *len,
+		    const struct timeval **tv)
 {
-  scamper_tbit_t *tbit = NULL;
-  scamper_sting_t *sting = NULL;
-  scamper_sniff_t *sniff = NULL;
   const scamper_tbit_pkt_t *tbit_pkt;
   const scamper_sting_pkt_t *sting_pkt;
   const scamper_sniff_pkt_t *sniff_pkt;
-  uint32_t i, pktc;
 
   if(type == SCAMPER_FILE_OBJ_TBIT)
     {
-      tbit = data;
-      pktc = scamper_tbit_pktc_get(tbit);
-      for(i=0; i<pktc; i++)
-	{
-	  tbit_pkt = scamper_tbit_pkt_get(tbit, i);
-	  if(func(scamper_tbit_pkt_data_get(tbit_pkt),
-		  scamper_tbit_pkt_len_get(tbit_pkt),
-		  scamper_tbit_pkt_tv_get(tbit_pkt), param) != 0)
-	    goto err;
-	}
-      scamper_tbit_free(tbit);
+      tbit_pkt = scamper_tbit_pkt_get(data, i);
+      *pkt = scamper_tbit_pkt_data_get(tbit_pkt);
+      *len = scamper_tbit_pkt_len_get(tbit_pkt);
+      *tv = scamper_tbit_pkt_tv_get(tbit_pkt);
     }
   else if(type == SCAMPER_FILE_OBJ_STING)
     {
-      sting = data;
-      pktc = scamper_sting_pktc_get(sting);
-      for(i=0; i<pktc; i++)
-	{
-	  sting_pkt = scamper_sting_pkt_get(sting, i);
-	  if(func(scamper_sting_pkt_data_get(sting_pkt),
-		  scamper_sting_pkt_len_get(sting_pkt),
-		  scamper_sting_pkt_tv_get(sting_pkt), param) != 0)
-	    goto err;
-	}
-      scamper_sting_free(sting);
+      sting_pkt = scamper_sting_pkt_get(data, i);
+      *pkt = scamper_sting_pkt_data_get(sting_pkt);
+      *len = scamper_sting_pkt_len_get(sting_pkt);
+      *tv = scamper_sting_pkt_tv_get(sting_pkt);
     }
   else if(type == SCAMPER_FILE_OBJ_SNIFF)
     {
-      sniff = data;
-      pktc = scamper_sniff_pktc_get(sniff);
-      for(i=0; i<pktc; i++)
-	{
-	  sniff_pkt = scamper_sniff_pkt_get(sniff, i);
-	  if(func(scamper_sniff_pkt_data_get(sniff_pkt),
-		  scamper_sniff_pkt_len_get(sniff_pkt),
-		  scamper_sniff_pkt_tv_get(sniff_pkt), param) != 0)
-	    goto err;
-	}
-      scamper_sniff_free(sniff);
+      sniff_pkt = scamper_sniff_pkt_get(data, i);
+      *pkt = scamper_sniff_pkt_data_get(sniff_pkt);
+      *len = scamper_sniff_pkt_len_get(sniff_pkt);
+      *tv = scamper_sniff_pkt_tv_get(sniff_pkt);
     }
-  else return -1;
-
-  return 0;
+  return;
+}
 
- err:
-  if(tbit != NULL) scamper_tbit_free(tbit);
-  if(sting != NULL) scamper_sting_free(sting);
-  if(sniff != NULL) scamper_sniff_free(sniff);
-  return -1;
+static void obj_free(uint16_t type, void *data)
+{
+  if(type == SCAMPER_FILE_OBJ_TBIT)
+    scamper_tbit_free(data);
+  else if(type == SCAMPER_FILE_OBJ_STING)
+    scamper_sting_free(data);
+  else if(type == SCAMPER_FILE_OBJ_SNIFF)
+    scamper_sniff_free(data);
+  return;
 }
 
 static int sort_0(uint16_t type, void *data)
 {
-  return doit(type, data, pkt_write, NULL);
+  const struct timeval *tv;
+  const uint8_t *pkt;
+  uint32_t i, pktc;
+  uint16_t len;
+  int rc = 0;
+
+  pktc = obj_pktc(type, data);
+  for(i=0; i<pktc; i++)
+    {
+      obj_pkt(type, data, i, &pkt, &len, &tv);
+      if((rc = pkt_write(pkt, len, tv, NULL)) != 0)
+	break;
+    }
+  obj_free(type, data);
+  return rc;
+}
+
+static slist_t *objs = NULL;
+static pkt_t *pkts = NULL;
+static size_t pktc = 0;
+static size_t pktm = 0;
+
+static int pkt_cmp(const void *va, const void *vb)
+{
+  const pkt_t *a = va, *b = vb;
+  int rc;
+  if((rc = timeval_cmp(a->tv, b->tv)) != 0)
+    return rc;
+  if(a->seq < b->seq) return -1;
+  if(a->seq > b->seq) return  1;
+  return 0;
 }
 
-static slist_t *list = NULL;
+static void obj_free_cb(obj_t *obj)
+{
+  obj_free(obj->type, obj->data);
+  free(obj);
+  return;
+}
 
 static int init_1(void)
 {
-  if((list = slist_alloc()) == NULL)
+  if((objs = slist_alloc()) == NULL)
     return -1;
   return 0;
 }
 
+/*
+ * sort_1
+ *
+ * hold the object, and record where each of its packets are, so that
+ * the packets can be sorted without being copied.
+ */
 static int sort_1(uint16_t type, void *data)
 {
-  return doit(type, data, pkt_push, list);
+  obj_t *obj = NULL;
+  uint32_t i, c;
+  size_t m;
+
+  if((obj = malloc_zero(sizeof(obj_t))) == NULL)
+    goto err;
+  obj->type = type;
+  obj->data = data;
+  if(slist_tail_push(objs, obj) == NULL)
+    goto err;
+
+  c = obj_pktc(type, data);
+  if(pktc + c > pktm)
+    {
+      m = pktm == 0 ? 1024 : pktm;
+      while(m < pktc + c)
+	m *= 2;
+      if(realloc_wrap((void **)&pkts, sizeof(pkt_t) * m) != 0)
+	return -1;
+      pktm = m;
+    }
+
+  for(i=0; i<c; i++)
+    {
+      obj_pkt(type, data, i, &pkts[pktc].data, &pkts[pktc].len,
+	      &pkts[pktc].tv);
+      pkts[pktc].seq = pktc;
+      pktc++;
+    }
+
+  return 0;
+
+ err:
+  if(obj != NULL) free(obj);
+  obj_free(type, data);
+  return -1;
 }
 
 static int finish_1(void)
 {
-  pkt_t *pkt;
-  if(slist_qsort(list, (slist_cmp_t)pkt_cmp) != 0)
-    return -1;
-  while((pkt = slist_head_pop(list)) != NULL)
+  size_t i;
+
+  if(pktc > 0)
+    qsort(pkts, pktc, sizeof(pkt_t), pkt_cmp);
+  for(i=0; i<pktc; i++)
+    if(pkt_write(pkts[i].data, pkts[i].len, pkts[i].tv, NULL) != 0)
+      return -1;
+
+  if(pkts != NULL)
     {
-      if(pkt_write(pkt->data, pkt->len, &pkt->tv, NULL) != 0)
-	return -1;
-      pkt_free(pkt);
+      free(pkts);
+      pkts = NULL;
     }
-  slist_free(list);
+  slist_free_cb(objs, (slist_free_t)obj_free_cb);
+  objs = NULL;
   return 0;
 }
 
@@ -309,6 +553,123 @@ static int do_file(scamper_file_t *in)
   return -1;
 }
 
+/*
+ * input_next
+ *
+ * advance the input to its next packet, reading the next object from
+ * the file when the packets in the current object are exhausted.
+ * returns 1 if there is a packet, zero at the end of the file, and -1
+ * on error.
+ */
+static int input_next(input_t *input)
+{
+  input->pkti++;
+  while(input->pkti >= input->pktc)
+    {
+      if(input->data != NULL)
+	{
+	  obj_free(input->type, input->data);
+	  input->data = NULL;
+	}
+      if(scamper_file_read(input->file, filter,
+			   &input->type, &input->data) != 0)
+	{
+	  fprintf(stderr, "could not read from %s\n", input->name);
+	  return -1;
+	}
+      if(input->data == NULL)
+	return 0;
+      input->pkti = 0;
+      input->pktc = obj_pktc(input->type, input->data);
+    }
+
+  obj_pkt(input->type, input->data, input->pkti,
+	  &input->pkt, &input->len, &input->tv);
+  return 1;
+}
+
+/* the heap returns the input with the earliest packet */
+static int input_cmp(const input_t *a, const input_t *b)
+{
+  int rc;
+  if((rc = timeval_cmp(b->tv, a->tv)) != 0)
+    return rc;
+  if(a->id < b->id) return  1;
+  if(a->id > b->id) return -1;
+  return 0;
+}
+
+/*
+ * merge
+ *
+ * write the packets from all input files in timestamp order, assuming
+ * the packets in each file are in timestamp order.  only the current
+ * object from each file is held in memory.
+ */
+static int merge(void)
+{
+  input_t *inputs = NULL, *input;
+  heap_t *heap = NULL;
+  int i, c, x, rc = -1;
+
+  c = filec > 0 ? filec : 1;
+  if((inputs = malloc_zero(sizeof(input_t) * c)) == NULL ||
+     (heap = heap_alloc((heap_cmp_t)input_cmp)) == NULL)
+    goto done;
+
+  for(i=0; i<c; i++)
+    {
+      input = &inputs[i];
+      input->id = i;
+      if(filec > 0)
+	{
+	  input->name = files[i];
+	  input->file = scamper_file_open(files[i], 'r', NULL);
+	}
+      else
+	{
+	  input->name = "stdin";
+	  input->file = scamper_file_openfd(STDIN_FILENO, "-", 'r', "warts");
+	}
+      if(input->file == NULL)
+	{
+	  fprintf(stderr, "could not open %s\n", input->name);
+	  goto done;
+	}
+      input->pkti = input->pktc = 0;
+      if((x = input_next(input)) < 0)
+	goto done;
+      if(x > 0 && heap_insert(heap, input) == NULL)
+	goto done;
+    }
+
+  while((input = heap_remove(heap)) != NULL)
+    {
+      if(pkt_write(input->pkt, input->len, input->tv, NULL) != 0 ||
+	 (x = input_next(input)) < 0)
+	goto done;
+      if(x > 0 && heap_insert(heap, input) == NULL)
+	goto done;
+    }
+
+  rc = 0;
+
+ done:
+  if(heap != NULL) heap_free(heap, NULL);
+  if(inputs != NULL)
+    {
+      for(i=0; i<c; i++)
+	{
+	  if(inputs[i].data != NULL)
+	    obj_free(inputs[i].type, inputs[i].data);
+	  if(inputs[i].file != NULL)
+	    scamper_file_close(inputs[i].file);
+	}
+      free(inputs);
+    }
+  return rc;
+}
+
 int main(int argc, char *argv[])
 {
   uint16_t filter_types[] = {
@@ -318,7 +679,6 @@ int main(int argc, char *argv[])
   };
   uint16_t filter_cnt = sizeof(filter_types)/sizeof(uint16_t);
   scamper_file_t *in;
-  phdr_t hdr;
   int i;
 
   if(check_options(argc, argv) != 0)
@@ -333,7 +693,8 @@ int main(int argc, char *argv[])
   /* open the output file */
   if(outfile_name != NULL && string_isdash(outfile_name) == 0)
     {
-      if((outfile_fd = fopen(outfile_name, "w")) == NULL)
+      if((outfile_fd = open(outfile_name, O_WRONLY | O_CREAT | O_TRUNC,
+			    MODE_644)) == -1)
 	{
 	  fprintf(stderr, "could not open for output: %s\n", outfile_name);
 	  goto err;
@@ -349,59 +710,64 @@ int main(int argc, char *argv[])
 	  return -1;
 	}
 #endif
+      outfile_fd = STDOUT_FILENO;
+    }
 
-      if((outfile_fd = fdopen(STDOUT_FILENO, "w")) == NULL)
-	{
-	  fprintf(stderr, "could not fdopen stdout\n");
-	  goto err;
-	}
+  if((obuf = malloc(OBUF_SIZE)) == NULL)
+    {
+      fprintf(stderr, "could not allocate output buffer\n");
+      goto err;
     }
 
   /* write the pcap header */
-  hdr.magic_number = 0xa1b2c3d4;
-  hdr.version_major = 2;
-  hdr.version_minor = 4;
-  hdr.thiszone = 0;
-  hdr.sigfigs = 0;
-  hdr.snaplen = 65535;
-  hdr.network = 12; /* DLT_RAW */
-  if(fwrite(&hdr, sizeof(phdr_t), 1, outfile_fd) != 1)
-    goto err;
-
-  if(sort[sorti].init != NULL && sort[sorti].init() != 0)
+  if(hdr_write() != 0)
     goto err;
 
-  if(filec != 0)
+  if(sorti == SORT_MERGE)
+    {
+      if(merge() != 0)
+	goto err;
+    }
+  else
     {
-      for(i=0; i<filec; i++)
+      if(sort[sorti].init != NULL && sort[sorti].init() != 0)
+	goto err;
+
+      if(filec != 0)
 	{
-	  if((in = scamper_file_open(files[i], 'r', NULL)) == NULL)
+	  for(i=0; i<filec; i++)
 	    {
-	      fprintf(stderr, "could not open %s\n", files[i]);
+	      if((in = scamper_file_open(files[i], 'r', NULL)) == NULL)
+		{
+		  fprintf(stderr, "could not open %s\n", files[i]);
+		  goto err;
+		}
+
+	      if(do_file(in) != 0)
+		goto err;
+	    }
+	}
+      else
+	{
+	  if((in = scamper_file_openfd(STDIN_FILENO,"-",'r',"warts")) == NULL)
+	    {
+	      fprintf(stderr, "could not open stdin for reading\n");
 	      goto err;
 	    }
 
 	  if(do_file(in) != 0)
 	    goto err;
 	}
-    }
-  else
-    {
-      if((in = scamper_file_openfd(STDIN_FILENO, "-", 'r', "warts")) == NULL)
-	{
-	  fprintf(stderr, "could not open stdin for reading\n");
-	  goto err;
-	}
 
-      if(do_file(in) != 0)
+      if(sort[sorti].finish != NULL && sort[sorti].finish() != 0)
 	goto err;
     }
 
-  if(sort[sorti].finish != NULL && sort[sorti].finish() != 0)
+  if(out_flush() != 0)
     goto err;
-
-  fclose(outfile_fd);
-  outfile_fd = NULL;
+  close(outfile_fd);
+  outfile_fd = -1;
+  free(obuf);
 
   return 0;
 
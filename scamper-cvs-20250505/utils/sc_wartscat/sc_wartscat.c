@@ -50,12 +50,29 @@
 #define OPT_OUTFILE 0x00000001 /* o: */
 #define OPT_SORT    0x00000002 /* s: */
 #define OPT_HELP    0x00000004 /* ?: */
+#define OPT_MEMORY  0x00000008 /* m: */
+#define OPT_TMPDIR  0x00000010 /* T: */
 
 static uint32_t                options    = 0;
 static int                     infile_cnt = 0;
 static scamper_file_t        **infiles    = NULL;
 static scamper_file_t         *outfile    = NULL;
 static scamper_file_filter_t  *filter     = NULL;
+static size_t                  sort_mem   = 256 * 1024 * 1024;
+static char                   *tmp_dir    = NULL;
+static char                  **runs       = NULL;
+static int                     runc       = 0;
+
+/*
+ * the memory an object held for sorting is assumed to use, in addition
+ * to the warts record.  objects read from files not in warts format are
+ * held decoded, and are assumed to use SORT_OBJ_SIZE bytes.
+ */
+#define SORT_OVERHEAD 128
+#define SORT_OBJ_SIZE 2048
+
+/* the number of runs that are merged at once */
+#define RUN_MERGE_MAX 64
 
 /*
  * sort_struct
@@ -64,21 +81,26 @@ static scamper_file_filter_t  *filter     = NULL;
  */
 typedef struct sort_struct
 {
-  /* type type and data just read from the file */
-  uint16_t        type;
-  void           *data;
+  /*
+   * type and data just read from the file.  records read from warts
+   * files are held in raw, and objects from other files in data.
+   */
+  uint16_t            type;
+  void               *data;
+  scamper_file_raw_t *raw;
 
   /* timestamp associated with the data object */
-  struct timeval  tv;
+  struct timeval      tv;
 
-  /* index into infiles array */
-  int             file;
+  /* the order the object was read in, or the run it was read from */
+  uint64_t            seq;
 } sort_struct_t;
 
 static void usage(const char *argv0, uint32_t opt_mask)
 {
   fprintf(stderr,
-	  "usage: sc_wartscat [-?s] [-o outfile] <infile 1, 2, .. N>\n");
+	  "usage: sc_wartscat [-?s] [-m memory] [-o outfile] [-T tmpdir]\n"
+	  "                   <infile 1, 2, .. N>\n");
 
   if(opt_mask == 0) return;
 
@@ -87,28 +109,40 @@ static void usage(const char *argv0, uint32_t opt_mask)
   if(opt_mask & OPT_HELP)
     fprintf(stderr, "    -? give an overview of the usage of sc_wartscat\n");
 
+  if(opt_mask & OPT_MEMORY)
+    fprintf(stderr, "    -m megabytes of objects to sort in memory\n");
+
   if(opt_mask & OPT_OUTFILE)
     fprintf(stderr, "    -o output file to concatenate to\n");
 
   if(opt_mask & OPT_SORT)
     fprintf(stderr, "    -s sort objects in input file by timestamp\n");
 
+  if(opt_mask & OPT_TMPDIR)
+    fprintf(stderr, "    -T directory for temporary files when sorting\n");
+
   return;
 }
 
 static int check_options(int argc, char *argv[])
 {
   int   i, ch;
-  char *opts = "o:s?";
-  char *opt_outfile = NULL;
+  char *opts = "m:o:sT:?";
+  char *opt_outfile = NULL, *opt_memory = NULL;
   char *outfile_type = "warts";
   char m = 'a';
+  long lo;
 
   while((i = getopt(argc, argv, opts)) != -1)
     {
       ch = (char)i;
       switch(ch)
 	{
+	case 'm':
+	  options |= OPT_MEMORY;
+	  opt_memory = optarg;
+	  break;
+
 	case 'o':
 	  options |= OPT_OUTFILE;
 	  opt_outfile = optarg;
@@ -118,6 +152,11 @@ static int check_options(int argc, char *argv[])
 	  options |= OPT_SORT;
 	  break;
 
+	case 'T':
+	  options |= OPT_TMPDIR;
+	  tmp_dir = optarg;
+	  break;
+
 	case '?':
 	default:
 	  usage(argv[0], 0xffffffff);
@@ -125,6 +164,20 @@ static int check_options(int argc, char *argv[])
 	}
     }
 
+  if(opt_memory != NULL)
+    {
+      if(string_tolong(opt_memory, &lo) != 0 || lo < 1 ||
+	 (unsigned long)lo > SIZE_MAX / (1024 * 1024))
+	{
+	  usage(argv[0], OPT_MEMORY);
+	  return -1;
+	}
+      sort_mem = (size_t)lo * 1024 * 1024;
+    }
+
+  if(tmp_dir == NULL && (tmp_dir = getenv("TMPDIR")) == NULL)
+    tmp_dir = "/tmp";
+
   /* figure out how many input files there are to process */
   if((infile_cnt = argc - optind) < 1)
     {
@@ -230,6 +283,17 @@ static void cleanup(void)
 {
   int i;
 
+  if(runs != NULL)
+    {
+      for(i=0; i<runc; i++)
+	{
+	  unlink(runs[i]);
+	  free(runs[i]);
+	}
+      free(runs);
+      runs = NULL;
+    }
+
   if(filter != NULL)
     {
       scamper_file_filter_free(filter);
@@ -258,122 +322,161 @@ static void cleanup(void)
   return;
 }
 
-static int write_obj(uint16_t type, void *data)
+static int write_err(scamper_file_t *in, uint16_t type)
 {
-  int rc = 0;
+  const char *objtype;
+  if((objtype = scamper_file_objtype_tostr(type)) == NULL)
+    objtype = "unknown-type";
+  fprintf(stderr, "could not write %s record from %s\n",
+	  objtype, scamper_file_getfilename(in));
+  return -2;
+}
 
-  /* write the object out */
+static void free_obj(uint16_t type, void *data)
+{
   switch(type)
     {
     case SCAMPER_FILE_OBJ_CYCLE_START:
-      if(scamper_file_write_cycle_start(outfile, data) != 0)
-	rc = -1;
-      scamper_cycle_free(data);
-      break;
-
     case SCAMPER_FILE_OBJ_CYCLE_STOP:
-      if(scamper_file_write_cycle_stop(outfile, data) != 0)
-	rc = -1;
       scamper_cycle_free(data);
       break;
 
     case SCAMPER_FILE_OBJ_TRACE:
-      if(scamper_file_write_trace(outfile, data, NULL) != 0)
-	rc = -1;
       scamper_trace_free(data);
       break;
 
     case SCAMPER_FILE_OBJ_PING:
-      if(scamper_file_write_ping(outfile, data, NULL) != 0)
-	rc = -1;
       scamper_ping_free(data);
       break;
 
     case SCAMPER_FILE_OBJ_TRACELB:
-      if(scamper_file_write_tracelb(outfile, data, NULL) != 0)
-	rc = -1;
       scamper_tracelb_free(data);
       break;
 
     case SCAMPER_FILE_OBJ_DEALIAS:
-      if(scamper_file_write_dealias(outfile, data, NULL) != 0)
-	rc = -1;
       scamper_dealias_free(data);
       break;
 
     case SCAMPER_FILE_OBJ_NEIGHBOURDISC:
-      if(scamper_file_write_neighbourdisc(outfile, data, NULL) != 0)
-	rc = -1;
       scamper_neighbourdisc_free(data);
       break;
 
     case SCAMPER_FILE_OBJ_TBIT:
-      if(scamper_file_write_tbit(outfile, data, NULL) != 0)
-	rc = -1;
       scamper_tbit_free(data);
       break;
 
     case SCAMPER_FILE_OBJ_STING:
-      if(scamper_file_write_sting(outfile, data, NULL) != 0)
-	rc = -1;
       scamper_sting_free(data);
       break;
 
     case SCAMPER_FILE_OBJ_SNIFF:
-      if(scamper_file_write_sniff(outfile, data, NULL) != 0)
-	rc = -1;
       scamper_sniff_free(data);
       break;
 
     case SCAMPER_FILE_OBJ_HOST:
-      if(scamper_file_write_host(outfile, data, NULL) != 0)
-	rc = -1;
       scamper_host_free(data);
       break;
 
     case SCAMPER_FILE_OBJ_HTTP:
-      if(scamper_file_write_http(outfile, data, NULL) != 0)
-	rc = -1;
       scamper_http_free(data);
       break;
 
     case SCAMPER_FILE_OBJ_UDPPROBE:
-      if(scamper_file_write_udpprobe(outfile, data, NULL) != 0)
-	rc = -1;
       scamper_udpprobe_free(data);
       break;
+    }
+
+  return;
+}
 
-    default:
-      fprintf(stderr, "unhandled data object 0x%04x\n", type);
-      rc = -1;
+static int write_obj(scamper_file_t *out, uint16_t type, void *data)
+{
+  int rc = scamper_file_write_obj(out, type, data);
+  free_obj(type, data);
+
+  return rc;
+}
+
+/*
+ * file_iswarts
+ *
+ * records in warts files can be copied without decoding them.
+ */
+static int file_iswarts(scamper_file_t *sf)
+{
+  char buf[8];
+
+  if(scamper_file_type_tostr(sf, buf, sizeof(buf)) != NULL &&
+     strcmp(buf, "warts") == 0)
+    return 1;
+
+  return 0;
+}
+
+/*
+ * raw_cat
+ *
+ * copy the records in a warts file to the output without decoding them.
+ * returns -1 if the input could not be read, and -2 if the output could
+ * not be written.
+ */
+static int raw_cat(scamper_file_t *in)
+{
+  scamper_file_raw_t *raw;
+  uint16_t type;
+  int rc;
+
+  while((rc = scamper_file_read_raw(in, filter, &type, &raw)) == 0)
+    {
+      /* EOF */
+      if(raw == NULL)
+	break;
+      rc = scamper_file_write_raw(outfile, raw);
+      scamper_file_raw_free(raw);
+      if(rc != 0)
+	return write_err(in, type);
     }
 
   return rc;
 }
 
-static int simple_cat(void)
+/*
+ * obj_cat
+ *
+ * copy the objects in a file that is not in warts format to the output.
+ */
+static int obj_cat(scamper_file_t *in)
 {
-  const char *objtype;
   uint16_t type;
   void *data;
+  int rc;
+
+  while((rc = scamper_file_read(in, filter, &type, &data)) == 0)
+    {
+      /* EOF */
+      if(data == NULL)
+	break;
+      if(write_obj(outfile, type, data) != 0)
+	return write_err(in, type);
+    }
+
+  return rc;
+}
+
+static int simple_cat(void)
+{
   int i, rc;
 
   for(i=0; i<infile_cnt; i++)
     {
-      while((rc = scamper_file_read(infiles[i], filter, &type, &data)) == 0)
-	{
-	  /* EOF */
-	  if(data == NULL)
-	    break;
-	  if(write_obj(type, data) != 0)
-	    {
-	      if((objtype = scamper_file_objtype_tostr(type)) == NULL)
-		objtype = "unknown-type";
-	      fprintf(stderr, "%s: could not write %s record from %s\n",
-		      __func__, objtype, scamper_file_getfilename(infiles[i]));
-	      return -1;
-	    }
-	}
+      if(file_iswarts(infiles[i]) != 0)
+	rc = raw_cat(infiles[i]);
+      else
+	rc = obj_cat(infiles[i]);
+
+      /* error when writing the output file */
+      if(rc == -2)
+	return -1;
 
       /* error when reading the input file */
       if(rc != 0)
@@ -393,185 +496,468 @@ static int simple_cat(void)
 /*
  * sort_struct_cmp
  *
- * prioritise sort_struct objects for output to file.
+ * order sort_struct objects by timestamp.  objects with identical
+ * timestamps are kept in the order they were read.
  */
 static int sort_struct_cmp(const sort_struct_t *a, const sort_struct_t *b)
 {
   int i;
 
-  if((i = timeval_cmp(&b->tv, &a->tv)) != 0)
+  if((i = timeval_cmp(&a->tv, &b->tv)) != 0)
     return i;
 
   /* if timestamps are identical, cycle start objects have first priority */
   if(a->type == SCAMPER_FILE_OBJ_CYCLE_START)
     {
-      if(b->type == SCAMPER_FILE_OBJ_CYCLE_START) return 0;
-      else return 1;
+      if(b->type != SCAMPER_FILE_OBJ_CYCLE_START) return -1;
     }
-  if(b->type == SCAMPER_FILE_OBJ_CYCLE_START) return -1;
+  else if(b->type == SCAMPER_FILE_OBJ_CYCLE_START) return 1;
 
-  /* if timestamps are identical, cycle start objects have second priority */
+  /* if timestamps are identical, cycle stop objects have second priority */
   if(a->type == SCAMPER_FILE_OBJ_CYCLE_STOP)
     {
-      if(b->type == SCAMPER_FILE_OBJ_CYCLE_STOP) return 0;
-      else return 1;
+      if(b->type != SCAMPER_FILE_OBJ_CYCLE_STOP) return -1;
     }
-  if(b->type == SCAMPER_FILE_OBJ_CYCLE_STOP) return -1;
+  else if(b->type == SCAMPER_FILE_OBJ_CYCLE_STOP) return 1;
 
+  if(a->seq < b->seq) return -1;
+  if(a->seq > b->seq) return 1;
   return 0;
 }
 
-static int sort_cat_fill(heap_t *heap, sort_struct_t *s)
+/*
+ * sort_struct_heap_cmp
+ *
+ * the heap returns the item that compares largest first.
+ */
+static int sort_struct_heap_cmp(const sort_struct_t *a, const sort_struct_t *b)
 {
-  const char *objtype;
-  int i = s->file;
+  return sort_struct_cmp(b, a);
+}
+
+static void sort_struct_free(sort_struct_t *s)
+{
+  if(s->raw != NULL) scamper_file_raw_free(s->raw);
+  if(s->data != NULL) free_obj(s->type, s->data);
+  free(s);
+  return;
+}
 
-  if(scamper_file_read(infiles[i], filter, &s->type, &s->data) == 0)
+/*
+ * sort_struct_size
+ *
+ * the memory an object held for sorting uses, approximately.
+ */
+static size_t sort_struct_size(const sort_struct_t *s)
+{
+  if(s->raw != NULL)
+    return SORT_OVERHEAD + scamper_file_raw_len(s->raw);
+  return SORT_OVERHEAD + SORT_OBJ_SIZE;
+}
+
+static void sort_struct_tv(sort_struct_t *s, const void *data)
+{
+  switch(s->type)
     {
-      /* EOF */
-      if(s->data == NULL)
-	{
-	  scamper_file_close(infiles[i]);
-	  infiles[i] = NULL;
-	  return 0;
-	}
+    case SCAMPER_FILE_OBJ_CYCLE_START:
+      s->tv.tv_sec = scamper_cycle_start_time_get(data);
+      s->tv.tv_usec = 0;
+      break;
 
-      switch(s->type)
-	{
-	case SCAMPER_FILE_OBJ_CYCLE_START:
-	  s->tv.tv_sec = scamper_cycle_start_time_get(s->data);
-	  s->tv.tv_usec = 0;
-	  break;
+    case SCAMPER_FILE_OBJ_CYCLE_STOP:
+      s->tv.tv_sec = scamper_cycle_stop_time_get(data);
+      s->tv.tv_usec = 1000000;
+      break;
 
-	case SCAMPER_FILE_OBJ_CYCLE_STOP:
-	  s->tv.tv_sec = scamper_cycle_stop_time_get(s->data);
-	  s->tv.tv_usec = 1000000;
-	  break;
+    case SCAMPER_FILE_OBJ_TRACE:
+      timeval_cpy(&s->tv, scamper_trace_start_get(data));
+      break;
 
-	case SCAMPER_FILE_OBJ_TRACE:
-	  timeval_cpy(&s->tv, scamper_trace_start_get(s->data));
-	  break;
+    case SCAMPER_FILE_OBJ_PING:
+      timeval_cpy(&s->tv, scamper_ping_start_get(data));
+      break;
 
-	case SCAMPER_FILE_OBJ_PING:
-	  timeval_cpy(&s->tv, scamper_ping_start_get(s->data));
-	  break;
+    case SCAMPER_FILE_OBJ_TRACELB:
+      timeval_cpy(&s->tv, scamper_tracelb_start_get(data));
+      break;
 
-	case SCAMPER_FILE_OBJ_TRACELB:
-	  timeval_cpy(&s->tv, scamper_tracelb_start_get(s->data));
-	  break;
+    case SCAMPER_FILE_OBJ_DEALIAS:
+      timeval_cpy(&s->tv, scamper_dealias_start_get(data));
+      break;
 
-	case SCAMPER_FILE_OBJ_DEALIAS:
-	  timeval_cpy(&s->tv, scamper_dealias_start_get(s->data));
-	  break;
+    case SCAMPER_FILE_OBJ_NEIGHBOURDISC:
+      timeval_cpy(&s->tv, scamper_neighbourdisc_start_get(data));
+      break;
 
-	case SCAMPER_FILE_OBJ_NEIGHBOURDISC:
-	  timeval_cpy(&s->tv, scamper_neighbourdisc_start_get(s->data));
-	  break;
+    case SCAMPER_FILE_OBJ_TBIT:
+      timeval_cpy(&s->tv, scamper_tbit_start_get(data));
+      break;
 
-	case SCAMPER_FILE_OBJ_TBIT:
-	  timeval_cpy(&s->tv, scamper_tbit_start_get(s->data));
-	  break;
+    case SCAMPER_FILE_OBJ_STING:
+      timeval_cpy(&s->tv, scamper_sting_start_get(data));
+      break;
 
-	case SCAMPER_FILE_OBJ_STING:
-	  timeval_cpy(&s->tv, scamper_sting_start_get(s->data));
-	  break;
+    case SCAMPER_FILE_OBJ_SNIFF:
+      timeval_cpy(&s->tv, scamper_sniff_start_get(data));
+      break;
 
-	case SCAMPER_FILE_OBJ_SNIFF:
-	  timeval_cpy(&s->tv, scamper_sniff_start_get(s->data));
-	  break;
+    case SCAMPER_FILE_OBJ_HOST:
+      timeval_cpy(&s->tv, scamper_host_start_get(data));
+      break;
 
-	case SCAMPER_FILE_OBJ_HOST:
-	  timeval_cpy(&s->tv, scamper_host_start_get(s->data));
-	  break;
+    case SCAMPER_FILE_OBJ_HTTP:
+      timeval_cpy(&s->tv, scamper_http_start_get(data));
+      break;
 
-	case SCAMPER_FILE_OBJ_HTTP:
-	  timeval_cpy(&s->tv, scamper_http_start_get(s->data));
-	  break;
+    case SCAMPER_FILE_OBJ_UDPPROBE:
+      timeval_cpy(&s->tv, scamper_udpprobe_start_get(data));
+      break;
+    }
 
-	case SCAMPER_FILE_OBJ_UDPPROBE:
-	  timeval_cpy(&s->tv, scamper_udpprobe_start_get(s->data));
-	  break;
-	}
+  return;
+}
 
-      if(heap_insert(heap, s) == NULL)
-	{
-	  if((objtype = scamper_file_objtype_tostr(s->type)) == NULL)
-	    objtype = "unknown-type";
-	  fprintf(stderr, "%s: could not add %s from %s to heap\n", __func__,
-		  objtype, scamper_file_getfilename(infiles[i]));
-	  return -1;
-	}
+/*
+ * sort_struct_read
+ *
+ * read the next object from the file, and note its timestamp.  records
+ * in warts files are held as they were read, as the decoded object is
+ * only needed for the timestamp.  returns one if an object was read,
+ * zero at EOF, and -1 on error.
+ */
+static int sort_struct_read(scamper_file_t *in, sort_struct_t *s)
+{
+  const void *data;
+
+  if(file_iswarts(in) == 0)
+    {
+      if(scamper_file_read(in, filter, &s->type, &s->data) != 0)
+	goto err;
+      if(s->data == NULL)
+	return 0;
+      sort_struct_tv(s, s->data);
+      return 1;
+    }
+
+  if(scamper_file_read_raw(in, filter, &s->type, &s->raw) != 0)
+    goto err;
+  if(s->raw == NULL)
+    return 0;
+  if((data = scamper_file_raw_decode(s->raw)) == NULL)
+    goto err;
+  sort_struct_tv(s, data);
+  scamper_file_raw_decode_free(s->raw);
+  return 1;
+
+ err:
+  fprintf(stderr, "%s: could not read from %s\n", __func__,
+	  scamper_file_getfilename(in));
+  return -1;
+}
+
+static int sort_struct_write(scamper_file_t *out, sort_struct_t *s)
+{
+  const char *objtype;
+  int rc;
+
+  if(s->raw != NULL)
+    {
+      rc = scamper_file_write_raw(out, s->raw);
+      scamper_file_raw_free(s->raw); s->raw = NULL;
     }
   else
     {
-      fprintf(stderr, "%s: could not read from %s\n", __func__,
-	      scamper_file_getfilename(infiles[i]));
+      rc = write_obj(out, s->type, s->data);
+      s->data = NULL;
+    }
+
+  if(rc != 0)
+    {
+      if((objtype = scamper_file_objtype_tostr(s->type)) == NULL)
+	objtype = "unknown-type";
+      fprintf(stderr, "%s: could not write %s record to %s\n", __func__,
+	      objtype, scamper_file_getfilename(out));
+    }
+
+  return rc;
+}
+
+/*
+ * run_open
+ *
+ * create a temporary warts file to write a sorted run to.
+ */
+static scamper_file_t *run_open(char **name_out)
+{
+  scamper_file_t *sf;
+  char *name;
+  size_t len;
+  int fd;
+
+  len = strlen(tmp_dir) + 20;
+  if((name = malloc(len)) == NULL)
+    {
+      fprintf(stderr, "%s: could not malloc name\n", __func__);
+      return NULL;
+    }
+  snprintf(name, len, "%s/sc_wartscat.XXXXXX", tmp_dir);
+
+  if((fd = mkstemp(name)) == -1)
+    {
+      fprintf(stderr, "%s: could not create temporary file in %s: %s\n",
+	      __func__, tmp_dir, strerror(errno));
+      free(name);
+      return NULL;
+    }
+
+  if((sf = scamper_file_openfd(fd, name, 'w', "warts")) == NULL)
+    {
+      fprintf(stderr, "%s: could not open %s\n", __func__, name);
+      close(fd);
+      unlink(name);
+      free(name);
+      return NULL;
+    }
+
+  *name_out = name;
+  return sf;
+}
+
+/*
+ * run_write
+ *
+ * sort the objects held in memory and write them out, freeing them.
+ */
+static int run_write(scamper_file_t *out, sort_struct_t **ss, size_t ssc)
+{
+  size_t i;
+  int rc = 0;
+
+  array_qsort((void **)ss, ssc, (array_cmp_t)sort_struct_cmp);
+
+  for(i=0; i<ssc; i++)
+    {
+      if(rc == 0 && sort_struct_write(out, ss[i]) != 0)
+	rc = -1;
+      sort_struct_free(ss[i]);
+    }
+
+  return rc;
+}
+
+/*
+ * run_spill
+ *
+ * write the objects held in memory to a new run in a temporary file.
+ */
+static int run_spill(sort_struct_t **ss, size_t ssc)
+{
+  scamper_file_t *sf;
+  char *name = NULL;
+  size_t i;
+
+  if(realloc_wrap((void **)&runs, sizeof(char *) * (runc + 1)) != 0 ||
+     (sf = run_open(&name)) == NULL)
+    {
+      for(i=0; i<ssc; i++)
+	sort_struct_free(ss[i]);
+      return -1;
+    }
+  runs[runc++] = name;
+
+  if(run_write(sf, ss, ssc) != 0)
+    {
+      scamper_file_close(sf);
       return -1;
     }
 
+  scamper_file_close(sf);
   return 0;
 }
 
-static int sort_cat(void)
+/*
+ * run_merge
+ *
+ * merge sorted runs into the output file.  the heap holds the next
+ * object from each run, and the run that an object was read from is
+ * read again when the object is written.
+ */
+static int run_merge(char **names, int namec, scamper_file_t *out)
 {
-  const char    *objtype;
-  heap_t        *heap = NULL;
-  sort_struct_t *ss = NULL;
+  scamper_file_t **in = NULL;
+  sort_struct_t **ss = NULL;
   sort_struct_t *s;
-  int i;
+  heap_t *heap = NULL;
+  int i, x, rc = -1;
 
-  if((heap = heap_alloc((heap_cmp_t)sort_struct_cmp)) == NULL)
+  if((in = malloc_zero(sizeof(scamper_file_t *) * namec)) == NULL ||
+     (ss = malloc_zero(sizeof(sort_struct_t *) * namec)) == NULL ||
+     (heap = heap_alloc((heap_cmp_t)sort_struct_heap_cmp)) == NULL)
     {
-      fprintf(stderr, "%s: could not alloc heap\n", __func__);
-      goto err;
+      fprintf(stderr, "%s: could not alloc %d runs\n", __func__, namec);
+      goto done;
     }
 
-  if((ss = malloc_zero(sizeof(sort_struct_t) * infile_cnt)) == NULL)
+  for(i=0; i<namec; i++)
     {
-      fprintf(stderr, "%s: could not alloc sorting %d structures\n",
-	      __func__, infile_cnt);
-      goto err;
+      if((in[i] = scamper_file_open(names[i], 'r', "warts")) == NULL)
+	{
+	  fprintf(stderr, "%s: could not open %s\n", __func__, names[i]);
+	  goto done;
+	}
+      if((ss[i] = malloc_zero(sizeof(sort_struct_t))) == NULL)
+	goto done;
+      ss[i]->seq = i;
+      if((x = sort_struct_read(in[i], ss[i])) < 0 ||
+	 (x == 1 && heap_insert(heap, ss[i]) == NULL))
+	goto done;
     }
 
-  /*
-   * start by filling all file slots with the first data object from
-   * each file
-   */
-  for(i=0; i<infile_cnt; i++)
+  while((s = heap_remove(heap)) != NULL)
     {
-      ss[i].file = i;
-      if(sort_cat_fill(heap, &ss[i]) != 0)
-	goto err;
+      if(sort_struct_write(out, s) != 0)
+	goto done;
+      i = (int)s->seq;
+      if((x = sort_struct_read(in[i], s)) < 0 ||
+	 (x == 1 && heap_insert(heap, s) == NULL))
+	goto done;
     }
 
-  /*
-   * now, read each object off the heap in their appropriate priority and
-   * replace each heap object with another from the file until there is
-   * nothing left.
-   */
-  while((s = (sort_struct_t *)heap_remove(heap)) != NULL)
+  rc = 0;
+
+ done:
+  if(heap != NULL) heap_free(heap, NULL);
+  for(i=0; i<namec; i++)
+    {
+      if(in != NULL && in[i] != NULL) scamper_file_close(in[i]);
+      if(ss != NULL && ss[i] != NULL) sort_struct_free(ss[i]);
+    }
+  if(in != NULL) free(in);
+  if(ss != NULL) free(ss);
+  return rc;
+}
+
+/*
+ * sort_merge
+ *
+ * merge the runs into the output file.  if there are more runs than can
+ * be open at once, the first runs are merged into a single run, which
+ * takes their place so that objects with identical timestamps stay in
+ * the order they were read.
+ */
+static int sort_merge(void)
+{
+  scamper_file_t *sf;
+  char *name = NULL;
+  int i;
+
+  while(runc > RUN_MERGE_MAX)
     {
-      if(write_obj(s->type, s->data) != 0)
+      if((sf = run_open(&name)) == NULL)
+	return -1;
+      if(run_merge(runs, RUN_MERGE_MAX, sf) != 0)
 	{
-	  if((objtype = scamper_file_objtype_tostr(s->type)) == NULL)
-	    objtype = "unknown-type";
-	  fprintf(stderr, "%s: could not write %s record from %s\n", __func__,
-		  objtype, scamper_file_getfilename(infiles[s->file]));
-	  goto err;
+	  scamper_file_close(sf);
+	  unlink(name);
+	  free(name);
+	  return -1;
 	}
-      if(sort_cat_fill(heap, s) != 0)
-	goto err;
+      scamper_file_close(sf);
+
+      for(i=0; i<RUN_MERGE_MAX; i++)
+	{
+	  unlink(runs[i]);
+	  free(runs[i]);
+	}
+      runs[0] = name;
+      memmove(runs + 1, runs + RUN_MERGE_MAX,
+	      sizeof(char *) * (runc - RUN_MERGE_MAX));
+      runc -= RUN_MERGE_MAX - 1;
     }
 
-  heap_free(heap, NULL);
-  free(ss);
+  return run_merge(runs, runc, outfile);
+}
 
-  return 0;
+/*
+ * sort_cat
+ *
+ * read objects into memory until the memory limit is reached, and then
+ * sort them and write them to a temporary file as a run.  once all the
+ * input is read, merge the runs into the output file.  if the input fits
+ * in memory, the objects are sorted and written to the output file
+ * without temporary files.
+ */
+static int sort_cat(void)
+{
+  sort_struct_t **ss = NULL, *s = NULL;
+  size_t ssc = 0, ssm = 0, n, mem = 0;
+  uint64_t seq = 0;
+  int i, x, rc = -1;
 
- err:
-  if(heap != NULL) heap_free(heap, NULL);
+  for(i=0; i<infile_cnt; i++)
+    {
+      for(;;)
+	{
+	  if(s == NULL && (s = malloc_zero(sizeof(sort_struct_t))) == NULL)
+	    {
+	      fprintf(stderr, "%s: could not malloc sort struct\n", __func__);
+	      goto done;
+	    }
+	  if((x = sort_struct_read(infiles[i], s)) < 0)
+	    goto done;
+	  if(x == 0)
+	    break;
+
+	  if(ssc == ssm)
+	    {
+	      n = ssm == 0 ? 4096 : ssm * 2;
+	      if(realloc_wrap((void **)&ss, sizeof(sort_struct_t *) * n) != 0)
+		{
+		  fprintf(stderr, "%s: could not grow sort array\n", __func__);
+		  goto done;
+		}
+	      ssm = n;
+	    }
+	  s->seq = seq++;
+	  mem += sort_struct_size(s);
+	  ss[ssc++] = s; s = NULL;
+
+	  if(mem >= sort_mem)
+	    {
+	      x = run_spill(ss, ssc);
+	      ssc = 0; mem = 0;
+	      if(x != 0)
+		goto done;
+	    }
+	}
+
+      scamper_file_close(infiles[i]);
+      infiles[i] = NULL;
+    }
+
+  if(runc == 0)
+    {
+      x = run_write(outfile, ss, ssc);
+      ssc = 0;
+      if(x != 0)
+	goto done;
+    }
+  else
+    {
+      x = run_spill(ss, ssc);
+      ssc = 0;
+      if(x != 0 || sort_merge() != 0)
+	goto done;
+    }
+
+  rc = 0;
+
+ done:
+  if(s != NULL) sort_struct_free(s);
+  while(ssc > 0)
+    sort_struct_free(ss[--ssc]);
   if(ss != NULL) free(ss);
-  return -1;
+  return rc;
 }
 
 int main(int argc, char *argv[])
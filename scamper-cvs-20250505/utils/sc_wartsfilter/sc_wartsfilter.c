@@ -394,7 +394,7 @@ static int addr_matched(scamper_addr_t *addr)
   return 1;
 }
 
-static void process_dealias(scamper_dealias_t *dealias)
+static int match_dealias(const scamper_dealias_t *dealias)
 {
   const scamper_dealias_mercator_t *mc;
   const scamper_dealias_ally_t *ally;
@@ -403,117 +403,78 @@ static void process_dealias(scamper_dealias_t *dealias)
   const scamper_dealias_probedef_t *def, *def1;
   uint32_t i, probedefc;
 
-  if(addrc > 0)
+  if((mc = scamper_dealias_mercator_get(dealias)) != NULL)
     {
-      if((mc = scamper_dealias_mercator_get(dealias)) != NULL)
-	{
-	  def = scamper_dealias_mercator_def_get(mc);
-	  if(addr_matched(scamper_dealias_probedef_dst_get(def)) == 0)
-	    goto done;
-	}
-      else if((ally = scamper_dealias_ally_get(dealias)) != NULL)
-	{
-	  def = scamper_dealias_ally_def0_get(ally);
-	  def1 = scamper_dealias_ally_def1_get(ally);
-	  if(addr_matched(scamper_dealias_probedef_dst_get(def)) == 0 &&
-	     addr_matched(scamper_dealias_probedef_dst_get(def1)) == 0)
-	    goto done;
-	}
-      else if((rg = scamper_dealias_radargun_get(dealias)) != NULL)
+      def = scamper_dealias_mercator_def_get(mc);
+      return addr_matched(scamper_dealias_probedef_dst_get(def));
+    }
+  else if((ally = scamper_dealias_ally_get(dealias)) != NULL)
+    {
+      def = scamper_dealias_ally_def0_get(ally);
+      def1 = scamper_dealias_ally_def1_get(ally);
+      if(addr_matched(scamper_dealias_probedef_dst_get(def)) != 0 ||
+	 addr_matched(scamper_dealias_probedef_dst_get(def1)) != 0)
+	return 1;
+    }
+  else if((rg = scamper_dealias_radargun_get(dealias)) != NULL)
+    {
+      probedefc = scamper_dealias_radargun_defc_get(rg);
+      for(i=0; i<probedefc; i++)
 	{
-	  probedefc = scamper_dealias_radargun_defc_get(rg);
-	  for(i=0; i<probedefc; i++)
-	    {
-	      def = scamper_dealias_radargun_def_get(rg, i);
-	      if(addr_matched(scamper_dealias_probedef_dst_get(def)) != 0)
-		break;
-	    }
-	  if(i == probedefc)
-	    goto done;
+	  def = scamper_dealias_radargun_def_get(rg, i);
+	  if(addr_matched(scamper_dealias_probedef_dst_get(def)) != 0)
+	    return 1;
 	}
-      else if((pfs = scamper_dealias_prefixscan_get(dealias)) != NULL)
+    }
+  else if((pfs = scamper_dealias_prefixscan_get(dealias)) != NULL)
+    {
+      probedefc = scamper_dealias_prefixscan_defc_get(pfs);
+      for(i=0; i<probedefc; i++)
 	{
-	  probedefc = scamper_dealias_prefixscan_defc_get(pfs);
-	  for(i=0; i<probedefc; i++)
-	    {
-	      def = scamper_dealias_prefixscan_def_get(pfs, i);
-	      if(addr_matched(scamper_dealias_probedef_dst_get(def)) != 0)
-		break;
-	    }
-	  if(i == probedefc)
-	    goto done;
+	  def = scamper_dealias_prefixscan_def_get(pfs, i);
+	  if(addr_matched(scamper_dealias_probedef_dst_get(def)) != 0)
+	    return 1;
 	}
-      else goto done;
     }
-  scamper_file_write_dealias(outfile, dealias, NULL);
 
- done:
-  scamper_dealias_free(dealias);
-  return;
+  return 0;
 }
 
-static void process_ping(scamper_ping_t *ping)
+static int match_ping(const scamper_ping_t *ping)
 {
-  if(addrc > 0 && addr_matched(scamper_ping_dst_get(ping)) == 0)
-    goto done;
-  scamper_file_write_ping(outfile, ping, NULL);
-
- done:
-  scamper_ping_free(ping);
-  return;
+  return addr_matched(scamper_ping_dst_get(ping));
 }
 
-static void process_tbit(scamper_tbit_t *tbit)
+static int match_tbit(const scamper_tbit_t *tbit)
 {
-  if(addrc > 0 && addr_matched(scamper_tbit_dst_get(tbit)) == 0)
-    goto done;
-  scamper_file_write_tbit(outfile, tbit, NULL);
-
- done:
-  scamper_tbit_free(tbit);
-  return;
+  return addr_matched(scamper_tbit_dst_get(tbit));
 }
 
-static void process_trace(scamper_trace_t *trace)
+static int match_trace(const scamper_trace_t *trace)
 {
   scamper_trace_hopiter_t *hi = NULL;
   const scamper_trace_reply_t *reply;
-  scamper_addr_t *addr;
+  int rc = 0;
 
-  if(addrc == 0)
-    {
-      scamper_file_write_trace(outfile, trace, NULL);
-      goto done;
-    }
-  addr = scamper_trace_dst_get(trace);
-  if(addr_matched(addr) != 0)
-    {
-      scamper_file_write_trace(outfile, trace, NULL);
-      goto done;
-    }
+  if(addr_matched(scamper_trace_dst_get(trace)) != 0)
+    return 1;
 
-  if(check_hops != 0)
+  if(check_hops == 0 || (hi = scamper_trace_hopiter_alloc()) == NULL)
+    return 0;
+  while((reply = scamper_trace_hopiter_next(trace, hi)) != NULL)
     {
-      if((hi = scamper_trace_hopiter_alloc()) == NULL)
-	goto done;
-      while((reply = scamper_trace_hopiter_next(trace, hi)) != NULL)
+      if(addr_matched(scamper_trace_reply_addr_get(reply)) != 0)
 	{
-	  addr = scamper_trace_reply_addr_get(reply);
-	  if(addr_matched(addr) != 0)
-	    {
-	      scamper_file_write_trace(outfile, trace, NULL);
-	      goto done;
-	    }
+	  rc = 1;
+	  break;
 	}
     }
+  scamper_trace_hopiter_free(hi);
 
- done:
-  if(hi != NULL) scamper_trace_hopiter_free(hi);
-  scamper_trace_free(trace);
-  return;
+  return rc;
 }
 
-static int process_tracelb(scamper_tracelb_t *tracelb)
+static int match_tracelb(const scamper_tracelb_t *tracelb)
 {
   const scamper_tracelb_node_t *node, *to;
   const scamper_tracelb_link_t *link;
@@ -524,66 +485,82 @@ static int process_tracelb(scamper_tracelb_t *tracelb)
   scamper_addr_t *addr;
   uint8_t k, hopc;
 
-  if(addrc == 0)
-    {
-      scamper_file_write_tracelb(outfile, tracelb, NULL);
-      goto done;
-    }
-  else if(addr_matched(scamper_tracelb_dst_get(tracelb)) != 0)
-    {
-      scamper_file_write_tracelb(outfile, tracelb, NULL);
-      goto done;
-    }
-  else if(check_hops != 0)
+  if(addr_matched(scamper_tracelb_dst_get(tracelb)) != 0)
+    return 1;
+
+  if(check_hops == 0)
+    return 0;
+
+  nodec = scamper_tracelb_nodec_get(tracelb);
+  for(i=0; i<nodec; i++)
     {
-      nodec = scamper_tracelb_nodec_get(tracelb);
-      for(i=0; i<nodec; i++)
+      node = scamper_tracelb_node_get(tracelb, i);
+      if((addr = scamper_tracelb_node_addr_get(node)) != NULL &&
+	 addr_matched(addr) != 0)
+	return 1;
+      linkc = scamper_tracelb_node_linkc_get(node);
+      for(j=0; j<linkc; j++)
 	{
-	  node = scamper_tracelb_node_get(tracelb, i);
-	  if((addr = scamper_tracelb_node_addr_get(node)) != NULL &&
-	     addr_matched(addr) != 0)
-	    {
-	      scamper_file_write_tracelb(outfile, tracelb, NULL);
-	      goto done;
-	    }
-	  linkc = scamper_tracelb_node_linkc_get(node);
-	  for(j=0; j<linkc; j++)
+	  link = scamper_tracelb_node_link_get(node, j);
+	  if((to = scamper_tracelb_link_to_get(link)) != NULL &&
+	     addr_matched(scamper_tracelb_node_addr_get(to)) != 0)
+	    return 1;
+	  if((hopc = scamper_tracelb_link_hopc_get(link)) < 1)
+	    continue;
+	  for(k=0; k<hopc-1; k++)
 	    {
-	      link = scamper_tracelb_node_link_get(node, j);
-	      if((to = scamper_tracelb_link_to_get(link)) != NULL &&
-		 addr_matched(scamper_tracelb_node_addr_get(to)) != 0)
+	      set = scamper_tracelb_link_probeset_get(link, k);
+	      probec = scamper_tracelb_probeset_probec_get(set);
+	      for(l=0; l<probec; l++)
 		{
-		  scamper_file_write_tracelb(outfile, tracelb, NULL);
-		  goto done;
-		}
-	      if((hopc = scamper_tracelb_link_hopc_get(link)) < 1)
-		continue;
-	      for(k=0; k<hopc-1; k++)
-		{
-		  set = scamper_tracelb_link_probeset_get(link, k);
-		  probec = scamper_tracelb_probeset_probec_get(set);
-		  for(l=0; l<probec; l++)
+		  probe = scamper_tracelb_probeset_probe_get(set, l);
+		  rxc = scamper_tracelb_probe_rxc_get(probe);
+		  for(m=0; m<rxc; m++)
 		    {
-		      probe = scamper_tracelb_probeset_probe_get(set, l);
-		      rxc = scamper_tracelb_probe_rxc_get(probe);
-		      for(m=0; m<rxc; m++)
-			{
-			  reply = scamper_tracelb_probe_rx_get(probe, m);
-			  addr = scamper_tracelb_reply_from_get(reply);
-			  if(addr_matched(addr) != 0)
-			    {
-			      scamper_file_write_tracelb(outfile,tracelb,NULL);
-			      goto done;
-			    }
-			}
+		      reply = scamper_tracelb_probe_rx_get(probe, m);
+		      addr = scamper_tracelb_reply_from_get(reply);
+		      if(addr_matched(addr) != 0)
+			return 1;
 		    }
 		}
 	    }
 	}
     }
 
- done:
-  scamper_tracelb_free(tracelb);
+  return 0;
+}
+
+/*
+ * process
+ *
+ * decide if the record should be written to the output.  the record is
+ * only decoded if it has to be matched against the addresses, and is
+ * written out as it was read.
+ */
+static int process(uint16_t type, scamper_file_raw_t *raw)
+{
+  const void *data;
+  int match = 0;
+
+  if(addrc == 0)
+    return scamper_file_write_raw(outfile, raw);
+
+  if((data = scamper_file_raw_decode(raw)) == NULL)
+    return -1;
+
+  if(type == SCAMPER_FILE_OBJ_DEALIAS)
+    match = match_dealias(data);
+  else if(type == SCAMPER_FILE_OBJ_PING)
+    match = match_ping(data);
+  else if(type == SCAMPER_FILE_OBJ_TRACE)
+    match = match_trace(data);
+  else if(type == SCAMPER_FILE_OBJ_TBIT)
+    match = match_tbit(data);
+  else if(type == SCAMPER_FILE_OBJ_TRACELB)
+    match = match_tracelb(data);
+
+  if(match != 0)
+    return scamper_file_write_raw(outfile, raw);
   return 0;
 }
 
@@ -624,8 +601,9 @@ static void cleanup(void)
 
 int main(int argc, char *argv[])
 {
+  scamper_file_raw_t *raw;
   uint16_t type;
-  void *data;
+  int rc;
 
 #ifdef DMALLOC
   free(malloc(1));
@@ -643,21 +621,14 @@ int main(int argc, char *argv[])
   if(check_options(argc, argv) != 0)
     goto err;
 
-  while(scamper_file_read(infile, filter, &type, (void *)&data) == 0)
+  while(scamper_file_read_raw(infile, filter, &type, &raw) == 0)
     {
-      if(data == NULL)
+      if(raw == NULL)
 	break; /* EOF */
-
-      if(type == SCAMPER_FILE_OBJ_DEALIAS)
-	process_dealias(data);
-      else if(type == SCAMPER_FILE_OBJ_PING)
-	process_ping(data);
-      else if(type == SCAMPER_FILE_OBJ_TRACE)
-	process_trace(data);
-      else if(type == SCAMPER_FILE_OBJ_TBIT)
-	process_tbit(data);
-      else if(type == SCAMPER_FILE_OBJ_TRACELB)
-	process_tracelb(data);
+      rc = process(type, raw);
+      scamper_file_raw_free(raw);
+      if(rc != 0)
+	goto err;
     }
 
   return 0;
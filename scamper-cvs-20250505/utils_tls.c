@@ -31,6 +31,52 @@
 
 #include "utils_tls.h"
 
+/*
+ * tls_gather_write
+ *
+ * append plaintext to a buffer of TLS_RECORD_LEN bytes, passing the
+ * buffer to SSL_write each time it fills, so that a stream of small
+ * messages is encrypted into as few TLS records as possible.
+ */
+void tls_gather_write(SSL *ssl, uint8_t *buf, size_t *off,
+		      const void *ptr, size_t len)
+{
+  const uint8_t *data = ptr;
+  size_t x;
+
+  while(len > 0)
+    {
+      if((x = TLS_RECORD_LEN - *off) > len)
+	x = len;
+      memcpy(buf + *off, data, x);
+      *off += x;
+      data += x;
+      len -= x;
+      if(*off == TLS_RECORD_LEN)
+	tls_gather_flush(ssl, buf, off);
+    }
+
+  return;
+}
+
+/*
+ * tls_gather_flush
+ *
+ * pass any plaintext left in the buffer to SSL_write.  return the
+ * number of bytes of ciphertext waiting in the write BIO.  this is
+ * not zero when tls_gather_write passed a full buffer to SSL_write,
+ * even if there was nothing left to flush here.
+ */
+int tls_gather_flush(SSL *ssl, uint8_t *buf, size_t *off)
+{
+  if(*off > 0)
+    {
+      SSL_write(ssl, buf, *off);
+      *off = 0;
+    }
+  return BIO_pending(SSL_get_wbio(ssl));
+}
+
 int tls_want_read(BIO *wbio, void *param, char *errbuf, size_t errlen,
 		  int (*cb)(void *param, uint8_t *buf, int len))
 {
@@ -165,7 +211,28 @@ static int tls_certname_matches(const char *certname, const char *hostname)
  */
 int tls_is_valid_cert(SSL *ssl, const char *hostname)
 {
-  X509 *cert = NULL;
+  X509 *cert;
+  int rc;
+
+  if(SSL_get_verify_result(ssl) != X509_V_OK)
+    return 0;
+
+  if((cert = SSL_get_peer_certificate(ssl)) == NULL)
+    return 0;
+
+  rc = tls_is_valid_certname(cert, hostname);
+  X509_free(cert);
+  return rc;
+}
+
+/*
+ * tls_is_valid_certname
+ *
+ * check that the name provided in a certificate that has already been
+ * verified corresponds to the name of our peer.
+ */
+int tls_is_valid_certname(X509 *cert, const char *hostname)
+{
   X509_NAME *name;
   STACK_OF(GENERAL_NAME) *names = NULL;
   const GENERAL_NAME *gname;
@@ -174,12 +241,6 @@ int tls_is_valid_cert(SSL *ssl, const char *hostname)
   int rc = 0;
   int i, count;
 
-  if(SSL_get_verify_result(ssl) != X509_V_OK)
-    return 0;
-
-  if((cert = SSL_get_peer_certificate(ssl)) == NULL)
-    return 0;
-
   if((names = X509_get_ext_d2i(cert, NID_subject_alt_name, NULL, NULL)) != NULL)
     {
       count = sk_GENERAL_NAME_num(names);
@@ -215,7 +276,6 @@ int tls_is_valid_cert(SSL *ssl, const char *hostname)
 
  done:
   if(names != NULL) sk_GENERAL_NAME_pop_free(names, GENERAL_NAME_free);
-  if(cert != NULL) X509_free(cert);
   return rc;
 }
 
@@ -31,6 +31,14 @@ int tls_bio_alloc(SSL_CTX *ctx, SSL **ssl, BIO **rbio, BIO **wbio);
 void tls_bio_free(SSL *ssl, BIO *rbio, BIO *wbio);
 
 int tls_is_valid_cert(SSL *ssl, const char *hostname);
+int tls_is_valid_certname(X509 *cert, const char *hostname);
+
+/* the largest amount of plaintext that fits in a single TLS record */
+#define TLS_RECORD_LEN 16384
+
+void tls_gather_write(SSL *ssl, uint8_t *buf, size_t *off,
+		      const void *ptr, size_t len);
+int tls_gather_flush(SSL *ssl, uint8_t *buf, size_t *off);
 
 int tls_want_read(BIO *wbio, void *param, char *errbuf, size_t errlen,
 		  int (*cb)(void *param, uint8_t *buf, int len));